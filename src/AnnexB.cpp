@@ -0,0 +1,245 @@
+#include "AnnexB.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define ANNEXB_HAVE_SSE2 1
+  #include <immintrin.h>
+  #ifdef _MSC_VER
+    #include <intrin.h>
+  #endif
+#else
+  #define ANNEXB_HAVE_SSE2 0
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+  #define ANNEXB_TARGET_AVX2
+#else
+  #define ANNEXB_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace {
+
+inline unsigned LowestBit(uint32_t mask)
+{
+#ifdef _MSC_VER
+    unsigned long idx = 0;
+    _BitScanForward(&idx, mask);
+    return (unsigned)idx;
+#else
+    return (unsigned)__builtin_ctz(mask);
+#endif
+}
+
+#if ANNEXB_HAVE_SSE2
+
+// Стартовый код в позиции i: p[i] == 0, p[i+1] == 0, p[i+2] == 1. Сравниваем
+// три невыровненные загрузки со сдвигом 0/1/2 и получаем точную маску позиций.
+size_t FindStartCodeSse2(const uint8_t* p, size_t n, size_t pos)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one  = _mm_set1_epi8(1);
+
+    while (pos + 18 <= n) {
+        __m128i b  = _mm_loadu_si128((const __m128i*)(p + pos + 1));
+        __m128i zb = _mm_cmpeq_epi8(b, zero);
+        // Быстрый отказ: в сжатых данных нулевой байт редок.
+        if (_mm_movemask_epi8(zb) == 0) {
+            pos += 16;
+            continue;
+        }
+
+        __m128i a = _mm_loadu_si128((const __m128i*)(p + pos));
+        __m128i c = _mm_loadu_si128((const __m128i*)(p + pos + 2));
+        __m128i m = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(a, zero), zb),
+                                  _mm_cmpeq_epi8(c, one));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(m);
+        if (mask)
+            return pos + LowestBit(mask);
+        pos += 16;
+    }
+    return FindStartCodeScalar(p, n, pos);
+}
+
+ANNEXB_TARGET_AVX2
+size_t FindStartCodeAvx2(const uint8_t* p, size_t n, size_t pos)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one  = _mm256_set1_epi8(1);
+
+    while (pos + 34 <= n) {
+        __m256i b  = _mm256_loadu_si256((const __m256i*)(p + pos + 1));
+        __m256i zb = _mm256_cmpeq_epi8(b, zero);
+        if (_mm256_movemask_epi8(zb) == 0) {
+            pos += 32;
+            continue;
+        }
+
+        __m256i a = _mm256_loadu_si256((const __m256i*)(p + pos));
+        __m256i c = _mm256_loadu_si256((const __m256i*)(p + pos + 2));
+        __m256i m = _mm256_and_si256(_mm256_and_si256(_mm256_cmpeq_epi8(a, zero), zb),
+                                     _mm256_cmpeq_epi8(c, one));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(m);
+        if (mask)
+            return pos + LowestBit(mask);
+        pos += 32;
+    }
+    return FindStartCodeSse2(p, n, pos);
+}
+
+bool CpuHasAvx2()
+{
+#ifdef _MSC_VER
+    int regs[4] = {};
+    __cpuid(regs, 0);
+    if (regs[0] < 7)
+        return false;
+
+    __cpuid(regs, 1);
+    const bool osxsave = (regs[2] & (1 << 27)) != 0;
+    const bool avx     = (regs[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx)
+        return false;
+    // ОС должна сохранять YMM-регистры.
+    if ((_xgetbv(0) & 0x6) != 0x6)
+        return false;
+
+    __cpuidex(regs, 7, 0);
+    return (regs[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // ANNEXB_HAVE_SSE2
+
+typedef size_t (*FindStartCodeFn)(const uint8_t*, size_t, size_t);
+
+FindStartCodeFn SelectFindStartCode()
+{
+#if ANNEXB_HAVE_SSE2
+    if (CpuHasAvx2())
+        return FindStartCodeAvx2;
+    return FindStartCodeSse2;
+#else
+    return FindStartCodeScalar;
+#endif
+}
+
+const FindStartCodeFn g_findStartCode = SelectFindStartCode();
+
+inline uint8_t NalType(NalCodec codec, uint8_t header)
+{
+    return codec == NalCodec::H264 ? (uint8_t)(header & 0x1F)
+                                   : (uint8_t)((header & 0x7E) >> 1);
+}
+
+} // namespace
+
+size_t FindStartCodeScalar(const uint8_t* p, size_t n, size_t pos)
+{
+    size_t i = pos;
+    while (i + 3 <= n) {
+        // Если p[i+2] > 1, стартовый код не может начинаться ни в i, ни в i+1, ни в i+2.
+        if (p[i + 2] > 1) {
+            i += 3;
+        }
+        else if (p[i] == 0 && p[i + 1] == 0 && p[i + 2] == 1) {
+            return i;
+        }
+        else {
+            ++i;
+        }
+    }
+    return n;
+}
+
+size_t FindStartCode(const uint8_t* p, size_t n, size_t pos)
+{
+    return g_findStartCode(p, n, pos);
+}
+
+void BuildNalIndex(const uint8_t* p, size_t n, NalCodec codec, std::vector<NalUnit>& out)
+{
+    out.clear();
+
+    size_t sc = FindStartCode(p, n, 0);
+    while (sc < n) {
+        const size_t start = sc + 3;
+        const size_t next  = start < n ? FindStartCode(p, n, start) : n;
+
+        // Срезаем trailing_zero_8bits и ведущий ноль 4-байтного стартового кода.
+        size_t end = next;
+        while (end > start && p[end - 1] == 0)
+            --end;
+
+        if (end > start) {
+            NalUnit u;
+            u.offset = (uint32_t)start;
+            u.size   = (uint32_t)(end - start);
+            u.type   = NalType(codec, p[start]);
+            out.push_back(u);
+        }
+        sc = next;
+    }
+}
+
+bool NalIsIdr(NalCodec codec, uint8_t type)
+{
+    if (codec == NalCodec::H264)
+        return type == 5;
+    return type == 19 || type == 20;
+}
+
+bool NalIsParameterSet(NalCodec codec, uint8_t type)
+{
+    if (codec == NalCodec::H264)
+        return type == 7 || type == 8;
+    return type == 32 || type == 33 || type == 34;
+}
+
+bool NalIndexHasIdr(const std::vector<NalUnit>& nals, NalCodec codec)
+{
+    for (const NalUnit& u : nals) {
+        if (NalIsIdr(codec, u.type))
+            return true;
+    }
+    return false;
+}
+
+bool NalIndexIsDisposable(const uint8_t* p, const std::vector<NalUnit>& nals, NalCodec codec)
+{
+    bool vcl = false;
+    for (const NalUnit& u : nals) {
+        if (codec == NalCodec::H264) {
+            if (u.type < 1 || u.type > 5)
+                continue;
+            // nal_ref_idc == 0: на кадр никто не ссылается.
+            if (p[u.offset] & 0x60)
+                return false;
+        }
+        else {
+            if (u.type > 31)
+                continue;
+            // Неопорные типы подслоя: TRAIL_N, TSA_N, STSA_N, RADL_N, RASL_N.
+            if (u.type > 14 || (u.type & 1))
+                return false;
+        }
+        vcl = true;
+    }
+    return vcl;
+}
+
+bool ExtractParameterSets(const uint8_t* p, const std::vector<NalUnit>& nals,
+                          NalCodec codec, std::vector<uint8_t>& out)
+{
+    static const uint8_t kStartCode[4] = { 0, 0, 0, 1 };
+
+    out.clear();
+    for (const NalUnit& u : nals) {
+        if (!NalIsParameterSet(codec, u.type))
+            continue;
+        out.insert(out.end(), kStartCode, kStartCode + 4);
+        out.insert(out.end(), p + u.offset, p + u.offset + u.size);
+    }
+    return !out.empty();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Разбор Annex-B потока H.264/HEVC: поиск стартовых кодов и индекс NAL-юнитов.
+// Индекс строится один раз на пакет, а дальше им пользуются все: определение
+// IDR, извлечение SPS/PPS/VPS, пакетизация.
+
+// Кодек потока для индекса и пакетизации. AV1 идёт не Annex-B, а потоком
+// OBU (см. Av1Obu.h); функции этого файла для него не применяются.
+enum class NalCodec
+{
+    H264,
+    H265,
+    AV1,
+};
+
+// Один NAL-юнит внутри пакета: offset указывает на NAL-заголовок (после
+// стартового кода), size - без стартового кода и хвостовых нулей.
+struct NalUnit
+{
+    uint32_t offset = 0;
+    uint32_t size = 0;
+    uint8_t  type = 0;
+};
+
+// Позиция первого стартового кода 00 00 01 начиная с pos, либо n, если его нет.
+// Использует AVX2/SSE2, если они есть, иначе скалярный цикл.
+size_t FindStartCode(const uint8_t* p, size_t n, size_t pos);
+
+// Скалярная версия FindStartCode (эталон и запасной вариант).
+size_t FindStartCodeScalar(const uint8_t* p, size_t n, size_t pos);
+
+// Заполняет out списком NAL-юнитов пакета за один проход. Память out
+// переиспользуется, поэтому при повторных вызовах аллокаций нет.
+void BuildNalIndex(const uint8_t* p, size_t n, NalCodec codec, std::vector<NalUnit>& out);
+
+// IDR (H.264) / IDR_W_RADL, IDR_N_LP (HEVC).
+bool NalIsIdr(NalCodec codec, uint8_t type);
+
+// SPS/PPS (H.264) / VPS/SPS/PPS (HEVC).
+bool NalIsParameterSet(NalCodec codec, uint8_t type);
+
+bool NalIndexHasIdr(const std::vector<NalUnit>& nals, NalCodec codec);
+
+// Кадр без опорных срезов: его можно выбросить, не ломая декодирование
+// остальных. Только H.264/HEVC (AV1 сюда не передавать).
+bool NalIndexIsDisposable(const uint8_t* p, const std::vector<NalUnit>& nals, NalCodec codec);
+
+// Собирает параметры кодека из пакета в Annex-B вид (стартовый код 00 00 00 01
+// перед каждым NAL). Возвращает false, если в пакете их нет.
+bool ExtractParameterSets(const uint8_t* p, const std::vector<NalUnit>& nals,
+                          NalCodec codec, std::vector<uint8_t>& out);
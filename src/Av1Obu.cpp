@@ -0,0 +1,222 @@
+#include "Av1Obu.h"
+
+namespace {
+
+inline uint8_t ObuType(uint8_t header)
+{
+    return (uint8_t)((header >> 3) & 0x0F);
+}
+
+// Последовательное чтение битов старшим вперёд (f(n) из спецификации AV1).
+class BitReader
+{
+public:
+    BitReader(const uint8_t* p, size_t n) : m_p(p), m_bits(n * 8) {}
+
+    uint32_t Read(int n)
+    {
+        uint32_t v = 0;
+        for (int i = 0; i < n; ++i) {
+            uint32_t bit = 0;
+            if (m_pos < m_bits)
+                bit = (m_p[m_pos >> 3] >> (7 - (m_pos & 7))) & 1;
+            else
+                m_overrun = true;
+            v = (v << 1) | bit;
+            ++m_pos;
+        }
+        return v;
+    }
+
+    // uvlc(): число ведущих нулей, затем столько же бит значения.
+    uint32_t ReadUvlc()
+    {
+        int zeros = 0;
+        while (!Read(1)) {
+            if (++zeros >= 32 || m_overrun)
+                return 0;
+        }
+        return zeros ? Read(zeros) + ((1u << zeros) - 1) : 0;
+    }
+
+    bool Overrun() const { return m_overrun; }
+
+private:
+    const uint8_t* m_p;
+    size_t m_bits;
+    size_t m_pos = 0;
+    bool m_overrun = false;
+};
+
+} // namespace
+
+size_t ReadLeb128(const uint8_t* p, size_t n, uint64_t& value)
+{
+    value = 0;
+    for (size_t i = 0; i < 8 && i < n; ++i) {
+        value |= (uint64_t)(p[i] & 0x7F) << (7 * i);
+        if (!(p[i] & 0x80))
+            return i + 1;
+    }
+    return 0;
+}
+
+size_t Leb128Size(uint64_t value)
+{
+    size_t n = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++n;
+    }
+    return n;
+}
+
+size_t WriteLeb128(uint8_t* p, uint64_t value)
+{
+    size_t n = 0;
+    do {
+        uint8_t b = (uint8_t)(value & 0x7F);
+        value >>= 7;
+        p[n++] = value ? (uint8_t)(b | 0x80) : b;
+    } while (value);
+    return n;
+}
+
+bool SplitObu(const uint8_t* obu, size_t size, ObuParts& out)
+{
+    if (size < 1 || (obu[0] & 0x80))
+        return false;
+
+    const bool ext     = (obu[0] & 0x04) != 0;
+    const bool hasSize = (obu[0] & 0x02) != 0;
+    out.headerSize = ext ? 2 : 1;
+    if (size < out.headerSize)
+        return false;
+
+    if (!hasSize) {
+        out.payloadOffset = out.headerSize;
+        out.payloadSize = (uint32_t)(size - out.headerSize);
+        return true;
+    }
+
+    uint64_t len = 0;
+    size_t lebLen = ReadLeb128(obu + out.headerSize, size - out.headerSize, len);
+    if (!lebLen || out.headerSize + lebLen + len > size)
+        return false;
+    out.payloadOffset = (uint32_t)(out.headerSize + lebLen);
+    out.payloadSize = (uint32_t)len;
+    return true;
+}
+
+void BuildObuIndex(const uint8_t* p, size_t n, std::vector<NalUnit>& out)
+{
+    out.clear();
+
+    size_t pos = 0;
+    while (pos < n) {
+        const uint8_t hdr = p[pos];
+        if (hdr & 0x80)
+            break;   // obu_forbidden_bit: дальше не поток OBU
+
+        const size_t hdrLen = (hdr & 0x04) ? 2 : 1;
+        size_t total = n - pos;
+        if (hdr & 0x02) {
+            if (pos + hdrLen > n)
+                break;
+            uint64_t len = 0;
+            size_t lebLen = ReadLeb128(p + pos + hdrLen, n - pos - hdrLen, len);
+            if (!lebLen || len > n - pos - hdrLen - lebLen)
+                break;
+            total = hdrLen + lebLen + (size_t)len;
+        }
+        else if (total < hdrLen) {
+            break;
+        }
+
+        NalUnit u;
+        u.offset = (uint32_t)pos;
+        u.size   = (uint32_t)total;
+        u.type   = ObuType(hdr);
+        out.push_back(u);
+        pos += total;
+    }
+}
+
+bool ObuIndexHasKeyFrame(const uint8_t* p, const std::vector<NalUnit>& obus)
+{
+    for (const NalUnit& u : obus) {
+        if (u.type != kObuFrame && u.type != kObuFrameHeader)
+            continue;
+
+        ObuParts parts;
+        if (!SplitObu(p + u.offset, u.size, parts) || !parts.payloadSize)
+            continue;
+
+        // uncompressed_header(): show_existing_frame f(1), frame_type f(2).
+        // reduced_still_picture_header NVENC не использует.
+        const uint8_t b = p[u.offset + parts.payloadOffset];
+        const bool showExisting = (b & 0x80) != 0;
+        const uint32_t frameType = (b >> 5) & 0x03;
+        if (!showExisting && frameType == 0)
+            return true;
+    }
+    return false;
+}
+
+bool ExtractSequenceHeader(const uint8_t* p, const std::vector<NalUnit>& obus,
+                           std::vector<uint8_t>& out)
+{
+    out.clear();
+    for (const NalUnit& u : obus) {
+        if (u.type != kObuSequenceHeader)
+            continue;
+        out.assign(p + u.offset, p + u.offset + u.size);
+        return true;
+    }
+    return false;
+}
+
+bool ParseAv1SequenceHeader(const uint8_t* p, size_t n, Av1SequenceInfo& out)
+{
+    std::vector<NalUnit> obus;
+    BuildObuIndex(p, n, obus);
+
+    for (const NalUnit& u : obus) {
+        ObuParts parts;
+        if (u.type != kObuSequenceHeader || !SplitObu(p + u.offset, u.size, parts))
+            continue;
+
+        BitReader br(p + u.offset + parts.payloadOffset, parts.payloadSize);
+        out = Av1SequenceInfo();
+        out.profile = br.Read(3);
+        br.Read(1);                                   // still_picture
+        const bool reduced = br.Read(1) != 0;         // reduced_still_picture_header
+        if (reduced) {
+            out.levelIdx = br.Read(5);
+            return !br.Overrun();
+        }
+
+        if (br.Read(1)) {                             // timing_info_present_flag
+            br.Read(32);                              // num_units_in_display_tick
+            br.Read(32);                              // time_scale
+            if (br.Read(1))                           // equal_picture_interval
+                br.ReadUvlc();                        // num_ticks_per_picture_minus_1
+            if (br.Read(1)) {                         // decoder_model_info_present_flag
+                br.Read(5);                           // buffer_delay_length_minus_1
+                br.Read(32);                          // num_units_in_decoding_tick
+                br.Read(5);                           // buffer_removal_time_length_minus_1
+                br.Read(5);                           // frame_presentation_time_length_minus_1
+            }
+        }
+        br.Read(1);                                   // initial_display_delay_present_flag
+        br.Read(5);                                   // operating_points_cnt_minus_1
+
+        // Для SDP нужна только рабочая точка 0 - она идёт первой.
+        br.Read(12);                                  // operating_point_idc[0]
+        out.levelIdx = br.Read(5);
+        if (out.levelIdx > 7)
+            out.tier = br.Read(1);
+        return !br.Overrun();
+    }
+    return false;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "AnnexB.h"
+
+// Разбор AV1 в low-overhead формате (раздел 5 спецификации AV1): поток OBU,
+// у каждого заголовок с obu_has_size_field и длиной в LEB128. Стартовых
+// кодов нет, поэтому индекс строится по длинам, а не поиском. Индекс
+// хранится в тех же NalUnit: offset - заголовок OBU, size - весь OBU вместе
+// с полем длины, type - obu_type.
+
+static const uint8_t kObuSequenceHeader     = 1;
+static const uint8_t kObuTemporalDelimiter  = 2;
+static const uint8_t kObuFrameHeader        = 3;
+static const uint8_t kObuTileGroup          = 4;
+static const uint8_t kObuMetadata           = 5;
+static const uint8_t kObuFrame              = 6;
+static const uint8_t kObuRedundantFrameHeader = 7;
+static const uint8_t kObuTileList           = 8;
+static const uint8_t kObuPadding            = 15;
+
+// Части одного OBU относительно его начала.
+struct ObuParts
+{
+    uint32_t headerSize = 0;     // 1 или 2 (с obu_extension_header)
+    uint32_t payloadOffset = 0;  // после заголовка и поля длины
+    uint32_t payloadSize = 0;
+};
+
+// LEB128 (до 8 байт). Возвращает число прочитанных байт, 0 - ошибка.
+size_t ReadLeb128(const uint8_t* p, size_t n, uint64_t& value);
+size_t Leb128Size(uint64_t value);
+// p должен вмещать Leb128Size(value) байт; возвращает записанное число байт.
+size_t WriteLeb128(uint8_t* p, uint64_t value);
+
+// Заполняет out списком OBU пакета. Битый хвост (длина за пределами данных)
+// в индекс не попадает. OBU без поля длины занимает остаток пакета.
+void BuildObuIndex(const uint8_t* p, size_t n, std::vector<NalUnit>& out);
+
+// obu - начало OBU, size - его размер из индекса.
+bool SplitObu(const uint8_t* obu, size_t size, ObuParts& out);
+
+// Есть ли в кадре KEY_FRAME: заголовок кадра (OBU_FRAME/OBU_FRAME_HEADER)
+// с show_existing_frame = 0 и frame_type = KEY_FRAME.
+bool ObuIndexHasKeyFrame(const uint8_t* p, const std::vector<NalUnit>& obus);
+
+// Копирует OBU sequence header как есть (с полем длины) в out. false - его нет.
+bool ExtractSequenceHeader(const uint8_t* p, const std::vector<NalUnit>& obus,
+                           std::vector<uint8_t>& out);
+
+// Поля sequence header, нужные для SDP (profile, level-idx, tier).
+struct Av1SequenceInfo
+{
+    uint32_t profile = 0;
+    uint32_t levelIdx = 0;
+    uint32_t tier = 0;
+};
+
+// p - поток OBU, в котором есть sequence header (например, из ExtractSequenceHeader).
+bool ParseAv1SequenceHeader(const uint8_t* p, size_t n, Av1SequenceInfo& out);
@@ -0,0 +1,69 @@
+#include "ColorConvert.h"
+
+namespace {
+
+// Коэффициенты Kr = 0.2126, Kb = 0.0722, умноженные на 256 и округлённые
+// так, чтобы белый давал ровно 235 (255), а серый - нулевую цветность.
+const YuvCoeffs kLimited = {
+    {  47,  157,  16,  16 },
+    { -26,  -86, 112, 128 },
+    { 112, -102, -10, 128 },
+};
+
+const YuvCoeffs kFull = {
+    {  54,  183,  19,   0 },
+    { -29,  -99, 128, 128 },
+    { 128, -116, -12, 128 },
+};
+
+inline uint8_t Apply(const int32_t c[4], int32_t r, int32_t g, int32_t b)
+{
+    int32_t v = ((c[0] * r + c[1] * g + c[2] * b + 128) >> 8) + c[3];
+    return (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v);
+}
+
+} // namespace
+
+const YuvCoeffs& Bt709Coeffs(Nv12Range range)
+{
+    return range == Nv12Range::Full ? kFull : kLimited;
+}
+
+void ConvertRgbaToNv12(const uint8_t* src, size_t srcPitch, bool bgra,
+                       uint32_t w, uint32_t h,
+                       uint8_t* dstY, size_t yPitch,
+                       uint8_t* dstUV, size_t uvPitch,
+                       Nv12Range range)
+{
+    const YuvCoeffs& c = Bt709Coeffs(range);
+    const int ri = bgra ? 2 : 0;
+    const int bi = bgra ? 0 : 2;
+
+    for (uint32_t y = 0; y < h; y += 2) {
+        const uint8_t* row0 = src + (size_t)y * srcPitch;
+        const uint8_t* row1 = row0 + srcPitch;
+        uint8_t* y0 = dstY + (size_t)y * yPitch;
+        uint8_t* y1 = y0 + yPitch;
+        uint8_t* uv = dstUV + (size_t)(y / 2) * uvPitch;
+
+        for (uint32_t x = 0; x < w; x += 2) {
+            const uint8_t* p[4] = { row0 + x * 4, row0 + x * 4 + 4, row1 + x * 4, row1 + x * 4 + 4 };
+            uint8_t* out[4] = { y0 + x, y0 + x + 1, y1 + x, y1 + x + 1 };
+
+            int32_t sr = 0, sg = 0, sb = 0;
+            for (int i = 0; i < 4; ++i) {
+                int32_t r = p[i][ri], g = p[i][1], b = p[i][bi];
+                *out[i] = Apply(c.y, r, g, b);
+                sr += r;
+                sg += g;
+                sb += b;
+            }
+
+            sr = (sr + 2) >> 2;
+            sg = (sg + 2) >> 2;
+            sb = (sb + 2) >> 2;
+            uv[x]     = Apply(c.u, sr, sg, sb);
+            uv[x + 1] = Apply(c.v, sr, sg, sb);
+        }
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Диапазон YUV на выходе преобразования RGB -> NV12 (BT.709).
+enum class Nv12Range
+{
+    Limited,   // Y 16..235, UV 16..240 - то, что ждут плееры по умолчанию
+    Full,      // 0..255
+};
+
+// Целочисленные коэффициенты BT.709 для 8 бит: value = ((r*c[0] + g*c[1] +
+// b*c[2] + 128) >> 8) + c[3], с насыщением до 0..255. Одна и та же таблица
+// уходит в шейдер Nv12Converter и в CPU-эталон, поэтому они совпадают бит в бит.
+struct YuvCoeffs
+{
+    int32_t y[4];
+    int32_t u[4];
+    int32_t v[4];
+};
+
+const YuvCoeffs& Bt709Coeffs(Nv12Range range);
+
+// CPU-эталон прохода Nv12Converter: RGBA/BGRA 8 бит -> NV12 того же размера
+// (w и h чётные). Яркость - по каждому пикселю, цветность - по среднему
+// блока 2x2 (округление к ближайшему).
+void ConvertRgbaToNv12(const uint8_t* src, size_t srcPitch, bool bgra,
+                       uint32_t w, uint32_t h,
+                       uint8_t* dstY, size_t yPitch,
+                       uint8_t* dstUV, size_t uvPitch,
+                       Nv12Range range);
@@ -0,0 +1,14 @@
+#pragma once
+
+// Direct3D 11 и ComPtr: настоящие на Windows, программный фейк на остальных
+// платформах (см. FakeD3D11.h).
+
+#include "Platform.h"
+
+#ifdef _WIN32
+#include <d3d11.h>
+#include <d3d11_4.h>
+#include <wrl/client.h>
+#else
+#include "FakeD3D11.h"
+#endif
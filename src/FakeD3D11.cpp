@@ -0,0 +1,117 @@
+#include "FakeD3D11.h"
+
+#ifndef _WIN32
+
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+thread_local int64_t t_lockWaitNs = 0;
+
+} // namespace
+
+void ID3D11Multithread::Enter()
+{
+    if (m_mx.try_lock())
+        return;
+    const auto t0 = std::chrono::steady_clock::now();
+    m_mx.lock();
+    t_lockWaitNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - t0).count();
+}
+
+FakeContextCall::FakeContextCall(ID3D11DeviceContext* ctx)
+{
+    if (ctx && ctx->Multithread()->GetMultithreadProtected()) {
+        m_mt = ctx->Multithread();
+        m_mt->Enter();
+    }
+}
+
+FakeContextCall::~FakeContextCall()
+{
+    if (m_mt)
+        m_mt->Leave();
+}
+
+int64_t FakeD3D11LockWaitNs()
+{
+    return t_lockWaitNs;
+}
+
+ID3D11Texture2D::ID3D11Texture2D(const D3D11_TEXTURE2D_DESC& desc)
+    : m_desc(desc)
+{
+    // NV12: плоскость яркости и под ней половинная плоскость UV с тем же шагом.
+    if (desc.Format == DXGI_FORMAT_NV12) {
+        m_pitch = desc.Width;
+        m_data.resize((size_t)m_pitch * desc.Height * 3 / 2);
+    }
+    else {
+        m_pitch = desc.Width * 4;
+        m_data.resize((size_t)m_pitch * desc.Height);
+    }
+}
+
+void ID3D11DeviceContext::CopyResource(ID3D11Resource* dst, ID3D11Resource* src)
+{
+    // Как и в D3D11, размеры и формат должны совпадать; иначе копия молча
+    // не выполняется.
+    ID3D11Texture2D* d = static_cast<ID3D11Texture2D*>(dst);
+    ID3D11Texture2D* s = static_cast<ID3D11Texture2D*>(src);
+    if (!d || !s || d == s || d->DataSize() != s->DataSize())
+        return;
+    FakeContextCall call(this);
+    memcpy(d->Data(), s->Data(), s->DataSize());
+}
+
+ID3D11Device::ID3D11Device()
+    : m_ctx(new ID3D11DeviceContext())
+{
+}
+
+ID3D11Device::~ID3D11Device()
+{
+    m_ctx->Release();
+}
+
+HRESULT ID3D11Device::CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc,
+                                      const D3D11_SUBRESOURCE_DATA* initData,
+                                      ID3D11Texture2D** out)
+{
+    if (!desc || !out || !desc->Width || !desc->Height)
+        return E_INVALIDARG;
+
+    ID3D11Texture2D* tex = new ID3D11Texture2D(*desc);
+    if (initData && initData->pSysMem) {
+        const uint8_t* src = (const uint8_t*)initData->pSysMem;
+        UINT srcPitch = initData->SysMemPitch ? initData->SysMemPitch : tex->RowPitch();
+        UINT rows = (UINT)(tex->DataSize() / tex->RowPitch());
+        for (UINT y = 0; y < rows; ++y)
+            memcpy(tex->Data() + (size_t)y * tex->RowPitch(), src + (size_t)y * srcPitch,
+                   tex->RowPitch());
+    }
+
+    *out = tex;
+    return S_OK;
+}
+
+void ID3D11Device::GetImmediateContext(ID3D11DeviceContext** out)
+{
+    m_ctx->AddRef();
+    *out = m_ctx;
+}
+
+HRESULT FakeD3D11CreateDevice(ID3D11Device** device, ID3D11DeviceContext** context)
+{
+    if (!device)
+        return E_INVALIDARG;
+
+    *device = new ID3D11Device();
+    if (context)
+        (*device)->GetImmediateContext(context);
+    return S_OK;
+}
+
+#endif
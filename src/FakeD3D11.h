@@ -0,0 +1,234 @@
+#pragma once
+
+// Программная замена того подмножества D3D11, которым пользуется плагин,
+// для сборки вне Windows (CI, бенчмарки без GPU). Текстура - кусок памяти
+// CPU, CopyResource - memcpy. Подключается через D3D11Compat.h.
+
+#ifndef _WIN32
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "Platform.h"
+
+enum DXGI_FORMAT
+{
+    DXGI_FORMAT_UNKNOWN             = 0,
+    DXGI_FORMAT_R8G8B8A8_TYPELESS   = 27,
+    DXGI_FORMAT_R8G8B8A8_UNORM      = 28,
+    DXGI_FORMAT_R8G8B8A8_UNORM_SRGB = 29,
+    DXGI_FORMAT_NV12                = 103,
+    DXGI_FORMAT_B8G8R8A8_UNORM      = 87,
+    DXGI_FORMAT_B8G8R8A8_TYPELESS   = 90,
+    DXGI_FORMAT_B8G8R8A8_UNORM_SRGB = 91,
+};
+
+enum D3D11_USAGE
+{
+    D3D11_USAGE_DEFAULT   = 0,
+    D3D11_USAGE_IMMUTABLE = 1,
+    D3D11_USAGE_DYNAMIC   = 2,
+    D3D11_USAGE_STAGING   = 3,
+};
+
+enum D3D11_BIND_FLAG
+{
+    D3D11_BIND_SHADER_RESOURCE  = 0x8,
+    D3D11_BIND_RENDER_TARGET    = 0x20,
+    D3D11_BIND_UNORDERED_ACCESS = 0x80,
+};
+
+struct DXGI_SAMPLE_DESC
+{
+    UINT Count;
+    UINT Quality;
+};
+
+struct D3D11_TEXTURE2D_DESC
+{
+    UINT Width;
+    UINT Height;
+    UINT MipLevels;
+    UINT ArraySize;
+    DXGI_FORMAT Format;
+    DXGI_SAMPLE_DESC SampleDesc;
+    D3D11_USAGE Usage;
+    UINT BindFlags;
+    UINT CPUAccessFlags;
+    UINT MiscFlags;
+};
+
+struct D3D11_SUBRESOURCE_DATA
+{
+    const void* pSysMem;
+    UINT SysMemPitch;
+    UINT SysMemSlicePitch;
+};
+
+// Счётчик ссылок в духе IUnknown.
+struct FakeUnknown
+{
+    virtual ~FakeUnknown() = default;
+
+    unsigned long AddRef() { return ++m_refs; }
+    unsigned long Release()
+    {
+        unsigned long n = --m_refs;
+        if (!n)
+            delete this;
+        return n;
+    }
+
+private:
+    std::atomic<unsigned long> m_refs{1};
+};
+
+struct ID3D11Resource : FakeUnknown
+{
+};
+
+struct ID3D11Texture2D : ID3D11Resource
+{
+    explicit ID3D11Texture2D(const D3D11_TEXTURE2D_DESC& desc);
+
+    void GetDesc(D3D11_TEXTURE2D_DESC* desc) const { *desc = m_desc; }
+
+    // Только у фейка: пиксели текстуры (RowPitch байт на строку), чтобы
+    // тесты и бенчмарки могли рисовать кадры без GPU.
+    uint8_t* Data() { return m_data.data(); }
+    const uint8_t* Data() const { return m_data.data(); }
+    UINT RowPitch() const { return m_pitch; }
+    size_t DataSize() const { return m_data.size(); }
+
+private:
+    D3D11_TEXTURE2D_DESC m_desc;
+    UINT m_pitch = 0;
+    std::vector<uint8_t> m_data;
+};
+
+// Блокировка устройства, как в D3D11: при включённой защите каждый вызов
+// immediate context идёт под общим мьютексом, Enter/Leave берут его всегда.
+struct ID3D11Multithread : FakeUnknown
+{
+    BOOL SetMultithreadProtected(BOOL on)
+    {
+        return m_protected.exchange(on ? TRUE : FALSE) ? TRUE : FALSE;
+    }
+    BOOL GetMultithreadProtected() const { return m_protected.load(); }
+    void Enter();
+    void Leave() { m_mx.unlock(); }
+
+private:
+    std::atomic<BOOL> m_protected{FALSE};
+    std::recursive_mutex m_mx;
+};
+
+struct ID3D11DeviceContext : FakeUnknown
+{
+    void CopyResource(ID3D11Resource* dst, ID3D11Resource* src);
+    void Flush() {}
+
+    // Только у фейка: ID3D11Multithread устройства (вместо QueryInterface).
+    ID3D11Multithread* Multithread() { return &m_mt; }
+
+private:
+    ID3D11Multithread m_mt;
+};
+
+// Только у фейка: вызов контекста целиком (копия, проход шейдера на CPU)
+// под блокировкой устройства, если защита включена.
+class FakeContextCall
+{
+public:
+    explicit FakeContextCall(ID3D11DeviceContext* ctx);
+    ~FakeContextCall();
+    FakeContextCall(const FakeContextCall&) = delete;
+    FakeContextCall& operator=(const FakeContextCall&) = delete;
+
+private:
+    ID3D11Multithread* m_mt = nullptr;
+};
+
+// Сколько текущий поток ждал блокировки устройства, нс (для бенчмарков).
+int64_t FakeD3D11LockWaitNs();
+
+struct ID3D11Device : FakeUnknown
+{
+    ID3D11Device();
+    ~ID3D11Device() override;
+
+    HRESULT CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc,
+                            const D3D11_SUBRESOURCE_DATA* initData,
+                            ID3D11Texture2D** out);
+    void GetImmediateContext(ID3D11DeviceContext** out);
+
+private:
+    ID3D11DeviceContext* m_ctx = nullptr;
+};
+
+// Новое фейковое устройство (счётчик ссылок 1).
+HRESULT FakeD3D11CreateDevice(ID3D11Device** device, ID3D11DeviceContext** context);
+
+namespace Microsoft {
+namespace WRL {
+
+// Минимальный ComPtr: ровно то, что используется в плагине.
+template <typename T>
+class ComPtr
+{
+public:
+    ComPtr() = default;
+    ComPtr(T* p) : m_p(p) { if (m_p) m_p->AddRef(); }
+    ComPtr(const ComPtr& o) : m_p(o.m_p) { if (m_p) m_p->AddRef(); }
+    ComPtr(ComPtr&& o) noexcept : m_p(o.m_p) { o.m_p = nullptr; }
+    ~ComPtr() { Reset(); }
+
+    ComPtr& operator=(const ComPtr& o)
+    {
+        if (o.m_p)
+            o.m_p->AddRef();
+        Reset();
+        m_p = o.m_p;
+        return *this;
+    }
+    ComPtr& operator=(ComPtr&& o) noexcept
+    {
+        if (this != &o) {
+            Reset();
+            m_p = o.m_p;
+            o.m_p = nullptr;
+        }
+        return *this;
+    }
+
+    T* Get() const { return m_p; }
+    T* operator->() const { return m_p; }
+    explicit operator bool() const { return m_p != nullptr; }
+
+    T** GetAddressOf() { return &m_p; }
+    T** ReleaseAndGetAddressOf() { Reset(); return &m_p; }
+
+    void Attach(T* p) { Reset(); m_p = p; }
+    T* Detach() { T* p = m_p; m_p = nullptr; return p; }
+
+    unsigned long Reset()
+    {
+        unsigned long n = 0;
+        if (m_p) {
+            n = m_p->Release();
+            m_p = nullptr;
+        }
+        return n;
+    }
+
+private:
+    T* m_p = nullptr;
+};
+
+}
+}
+
+#endif
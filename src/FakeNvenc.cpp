@@ -0,0 +1,608 @@
+#include "FakeNvenc.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "Av1Obu.h"
+
+namespace {
+
+// Заготовки параметров потока: валидные по структуре NAL, содержимое
+// соответствует небольшому baseline/main потоку.
+const uint8_t kH264Sps[] = { 0x67, 0x42, 0xC0, 0x1F, 0xDA, 0x01, 0x40, 0x16, 0xEC, 0x04,
+                             0x40, 0x00, 0x00, 0x03, 0x00, 0x40, 0x00, 0x00, 0x0F, 0x03,
+                             0xC6, 0x0C, 0xA8 };
+const uint8_t kH264Pps[] = { 0x68, 0xCE, 0x3C, 0x80 };
+const uint8_t kH264Idr[] = { 0x65, 0x88, 0x84 };
+const uint8_t kH264P[]   = { 0x41, 0x9A, 0x02 };
+const uint8_t kH264NonRefP[] = { 0x01, 0x9A, 0x02 };   // nal_ref_idc = 0
+
+const uint8_t kHevcVps[] = { 0x40, 0x01, 0x0C, 0x01, 0xFF, 0xFF, 0x01, 0x60, 0x00, 0x00,
+                             0x03, 0x00, 0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00,
+                             0x5D, 0x95, 0x98, 0x09 };
+const uint8_t kHevcSps[] = { 0x42, 0x01, 0x01, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00, 0x90,
+                             0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0x5D, 0xA0, 0x02,
+                             0x80, 0x80, 0x2D, 0x16, 0x59, 0x59, 0xA4, 0x93, 0x2B, 0xC0,
+                             0x40 };
+const uint8_t kHevcPps[] = { 0x44, 0x01, 0xC1, 0x72, 0xB4, 0x62, 0x40 };
+const uint8_t kHevcIdr[] = { 0x26, 0x01, 0xAF };
+const uint8_t kHevcP[]   = { 0x02, 0x01, 0xD0 };
+const uint8_t kHevcNonRefP[] = { 0x00, 0x01, 0xD0 };   // TRAIL_N
+
+// AV1: temporal delimiter и sequence header (profile 0, level-idx 8, без
+// timing info) с полем длины; заголовок кадра - OBU_FRAME.
+const uint8_t kAv1TemporalDelimiter[] = { 0x12, 0x00 };
+const uint8_t kAv1SeqHdr[] = { 0x0A, 0x0B, 0x00, 0x00, 0x00, 0x42, 0xA7, 0xBF,
+                               0xE6, 0x2E, 0x9F, 0x96, 0x00 };
+const uint8_t kAv1FrameObuHeader = 0x32;
+const uint8_t kAv1KeyFrame   = 0x10;   // show_existing_frame = 0, KEY_FRAME, show_frame
+const uint8_t kAv1InterFrame = 0x30;   // INTER_FRAME
+
+const uint8_t kStartCode[] = { 0x00, 0x00, 0x00, 0x01 };
+
+int64_t NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+std::mutex g_cfgMx;
+FakeNvencConfig g_cfg;
+bool g_cfgLoaded = false;
+
+// Регистрации ресурсов по всем сессиям (FakeNvencResources).
+std::atomic<uint64_t> g_resRegistered{0};
+std::atomic<uint64_t> g_resLive{0};
+
+FakeNvencConfig LoadConfig()
+{
+    std::lock_guard<std::mutex> lk(g_cfgMx);
+    if (!g_cfgLoaded) {
+        if (const char* env = getenv("NVRTSP_FAKE_ENCODE_DELAY_US"))
+            g_cfg.encodeDelayUs = (uint32_t)strtoul(env, nullptr, 10);
+        g_cfgLoaded = true;
+    }
+    return g_cfg;
+}
+
+struct FakeBitstream
+{
+    std::vector<uint8_t> data;
+    bool pending = false;
+    bool locked = false;
+    int64_t readyNs = 0;
+    uint64_t ts = 0;
+    uint32_t frameIdx = 0;
+    NV_ENC_PIC_TYPE type = NV_ENC_PIC_TYPE_P;
+};
+
+struct FakeResource
+{
+    void* tex = nullptr;
+};
+
+struct FakeSession
+{
+    std::mutex mx;
+    FakeNvencConfig cfg;
+
+    bool initialized = false;
+    bool hevc = false;
+    bool av1 = false;
+    uint32_t idrPeriod = 0;
+    uint32_t irPeriod = 0;     // 0 - intra refresh выключен
+    bool nonRefP = false;      // rcParams.enableNonRefP
+    uint32_t bitrate = 0;      // бит/с
+    uint32_t fpsNum = 30;
+    uint32_t fpsDen = 1;
+
+    uint32_t frames = 0;
+    uint32_t sinceIdr = 0;
+    bool forceIdr = true;
+
+    std::unordered_set<FakeBitstream*> bitstreams;
+    std::unordered_set<FakeResource*> resources;
+};
+
+bool SameGuid(const GUID& a, const GUID& b)
+{
+    return memcmp(&a, &b, sizeof(GUID)) == 0;
+}
+
+void Append(std::vector<uint8_t>& out, const uint8_t* p, size_t n)
+{
+    out.insert(out.end(), p, p + n);
+}
+
+void AppendNal(std::vector<uint8_t>& out, const uint8_t* p, size_t n)
+{
+    Append(out, kStartCode, sizeof(kStartCode));
+    Append(out, p, n);
+}
+
+// Тело среза: псевдослучайные ненулевые байты, поэтому в нём нет ни
+// стартовых кодов, ни emulation prevention.
+void AppendFiller(std::vector<uint8_t>& out, size_t n, uint32_t seed)
+{
+    uint32_t x = seed * 2654435761u + 1;
+    for (size_t i = 0; i < n; ++i) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        uint8_t b = (uint8_t)x;
+        out.push_back(b ? b : 0xFF);
+    }
+    // rbsp_stop_one_bit
+    if (n)
+        out.back() = 0x80;
+}
+
+uint32_t CodecIdrPeriod(const NV_ENC_CONFIG& cfg, const FakeSession& s)
+{
+    uint32_t idr = s.av1  ? cfg.encodeCodecConfig.av1Config.idrPeriod
+                 : s.hevc ? cfg.encodeCodecConfig.hevcConfig.idrPeriod
+                          : cfg.encodeCodecConfig.h264Config.idrPeriod;
+    return idr ? idr : cfg.gopLength;
+}
+
+uint32_t CodecIntraRefreshPeriod(const NV_ENC_CONFIG& cfg, const FakeSession& s)
+{
+    if (s.av1)
+        return cfg.encodeCodecConfig.av1Config.enableIntraRefresh
+            ? cfg.encodeCodecConfig.av1Config.intraRefreshPeriod : 0;
+    if (s.hevc)
+        return cfg.encodeCodecConfig.hevcConfig.enableIntraRefresh
+            ? cfg.encodeCodecConfig.hevcConfig.intraRefreshPeriod : 0;
+    return cfg.encodeCodecConfig.h264Config.enableIntraRefresh
+        ? cfg.encodeCodecConfig.h264Config.intraRefreshPeriod : 0;
+}
+
+void ApplyParams(FakeSession& s, const NV_ENC_INITIALIZE_PARAMS& p)
+{
+    if (p.frameRateNum && p.frameRateDen) {
+        s.fpsNum = p.frameRateNum;
+        s.fpsDen = p.frameRateDen;
+    }
+    if (p.encodeConfig) {
+        s.idrPeriod = CodecIdrPeriod(*p.encodeConfig, s);
+        s.irPeriod = CodecIntraRefreshPeriod(*p.encodeConfig, s);
+        s.nonRefP = p.encodeConfig->rcParams.enableNonRefP != 0;
+        s.bitrate = p.encodeConfig->rcParams.averageBitRate;
+    }
+}
+
+size_t FrameBytes(const FakeSession& s, bool idr)
+{
+    uint64_t bytes = s.cfg.frameBytes;
+    if (!bytes)
+        bytes = (uint64_t)s.bitrate * s.fpsDen / (8ull * s.fpsNum);
+    if (idr)
+        bytes *= 4;
+    // Intra refresh: лишние три P-кадра внутрикадрового кодирования
+    // размазаны по периоду обновления.
+    else if (s.irPeriod)
+        bytes += bytes * 3 / s.irPeriod;
+    return bytes < 16 ? 16 : (size_t)bytes;
+}
+
+// Temporal unit AV1: TD, sequence header на ключевом кадре, OBU_FRAME.
+void BuildTemporalUnit(FakeSession& s, FakeBitstream& bs, bool key, size_t target)
+{
+    Append(bs.data, kAv1TemporalDelimiter, sizeof(kAv1TemporalDelimiter));
+    if (key)
+        Append(bs.data, kAv1SeqHdr, sizeof(kAv1SeqHdr));
+
+    size_t used = bs.data.size() + 1 + 8;
+    size_t body = target > used ? target - used : 1;
+
+    uint8_t leb[8];
+    bs.data.push_back(kAv1FrameObuHeader);
+    Append(bs.data, leb, WriteLeb128(leb, body + 1));
+    bs.data.push_back(key ? kAv1KeyFrame : kAv1InterFrame);
+    AppendFiller(bs.data, body, s.frames);
+}
+
+void BuildAccessUnit(FakeSession& s, FakeBitstream& bs, bool idr, bool nonRef)
+{
+    bs.data.clear();
+    size_t target = FrameBytes(s, idr);
+
+    if (s.av1) {
+        BuildTemporalUnit(s, bs, idr, target);
+        return;
+    }
+
+    if (s.hevc) {
+        if (idr) {
+            AppendNal(bs.data, kHevcVps, sizeof(kHevcVps));
+            AppendNal(bs.data, kHevcSps, sizeof(kHevcSps));
+            AppendNal(bs.data, kHevcPps, sizeof(kHevcPps));
+            AppendNal(bs.data, kHevcIdr, sizeof(kHevcIdr));
+        }
+        else if (nonRef) {
+            AppendNal(bs.data, kHevcNonRefP, sizeof(kHevcNonRefP));
+        }
+        else {
+            AppendNal(bs.data, kHevcP, sizeof(kHevcP));
+        }
+    }
+    else {
+        if (idr) {
+            AppendNal(bs.data, kH264Sps, sizeof(kH264Sps));
+            AppendNal(bs.data, kH264Pps, sizeof(kH264Pps));
+            AppendNal(bs.data, kH264Idr, sizeof(kH264Idr));
+        }
+        else if (nonRef) {
+            AppendNal(bs.data, kH264NonRefP, sizeof(kH264NonRefP));
+        }
+        else {
+            AppendNal(bs.data, kH264P, sizeof(kH264P));
+        }
+    }
+
+    size_t filler = target > bs.data.size() ? target - bs.data.size() : 1;
+    AppendFiller(bs.data, filler, s.frames);
+}
+
+FakeSession* Sess(void* encoder)
+{
+    return (FakeSession*)encoder;
+}
+
+// -----------------------------------------------------------------------------
+// Реализация функций таблицы
+// -----------------------------------------------------------------------------
+
+NVENCSTATUS NVENCAPI FakeOpenEncodeSessionEx(NV_ENC_OPEN_ENCODE_SESSION_EX_PARAMS* params,
+                                             void** encoder)
+{
+    if (!params || !encoder)
+        return NV_ENC_ERR_INVALID_PTR;
+
+    FakeSession* s = new FakeSession();
+    s->cfg = LoadConfig();
+    *encoder = s;
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NVENCAPI FakeGetEncodePresetConfigEx(void* encoder, GUID, GUID, NV_ENC_TUNING_INFO,
+                                                 NV_ENC_PRESET_CONFIG* preset)
+{
+    if (!encoder || !preset)
+        return NV_ENC_ERR_INVALID_PTR;
+
+    uint32_t ver = preset->presetCfg.version;
+    memset(&preset->presetCfg, 0, sizeof(preset->presetCfg));
+    preset->presetCfg.version = ver;
+    preset->presetCfg.gopLength = NVENC_INFINITE_GOPLENGTH;
+    preset->presetCfg.frameIntervalP = 1;
+    preset->presetCfg.rcParams.rateControlMode = NV_ENC_PARAMS_RC_CBR;
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NVENCAPI FakeGetEncodeCaps(void* encoder, GUID, NV_ENC_CAPS_PARAM* caps, int* val)
+{
+    if (!encoder || !caps || !val)
+        return NV_ENC_ERR_INVALID_PTR;
+
+    // Асинхронного режима у фейка нет; остальные возможности "есть".
+    *val = caps->capsToQuery == NV_ENC_CAPS_ASYNC_ENCODE_SUPPORT ? 0 : 1;
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NVENCAPI FakeInitializeEncoder(void* encoder, NV_ENC_INITIALIZE_PARAMS* p)
+{
+    FakeSession* s = Sess(encoder);
+    if (!s || !p)
+        return NV_ENC_ERR_INVALID_PTR;
+    if (p->enableEncodeAsync)
+        return NV_ENC_ERR_UNSUPPORTED_PARAM;
+
+    std::lock_guard<std::mutex> lk(s->mx);
+    if (SameGuid(p->encodeGUID, NV_ENC_CODEC_HEVC_GUID))
+        s->hevc = true;
+    else if (SameGuid(p->encodeGUID, NV_ENC_CODEC_AV1_GUID))
+        s->av1 = true;
+    else if (!SameGuid(p->encodeGUID, NV_ENC_CODEC_H264_GUID))
+        return NV_ENC_ERR_UNSUPPORTED_PARAM;
+
+    ApplyParams(*s, *p);
+    s->initialized = true;
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NVENCAPI FakeReconfigureEncoder(void* encoder, NV_ENC_RECONFIGURE_PARAMS* rp)
+{
+    FakeSession* s = Sess(encoder);
+    if (!s || !rp)
+        return NV_ENC_ERR_INVALID_PTR;
+
+    std::lock_guard<std::mutex> lk(s->mx);
+    if (!s->initialized)
+        return NV_ENC_ERR_ENCODER_NOT_INITIALIZED;
+
+    ApplyParams(*s, rp->reInitEncodeParams);
+    if (rp->resetEncoder || rp->forceIDR)
+        s->forceIdr = true;
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NVENCAPI FakeGetSequenceParams(void* encoder, NV_ENC_SEQUENCE_PARAM_PAYLOAD* p)
+{
+    FakeSession* s = Sess(encoder);
+    if (!s || !p || !p->spsppsBuffer || !p->outSPSPPSPayloadSize)
+        return NV_ENC_ERR_INVALID_PTR;
+
+    std::vector<uint8_t> hdr;
+    if (s->av1) {
+        Append(hdr, kAv1SeqHdr, sizeof(kAv1SeqHdr));
+    }
+    else if (s->hevc) {
+        AppendNal(hdr, kHevcVps, sizeof(kHevcVps));
+        AppendNal(hdr, kHevcSps, sizeof(kHevcSps));
+        AppendNal(hdr, kHevcPps, sizeof(kHevcPps));
+    }
+    else {
+        AppendNal(hdr, kH264Sps, sizeof(kH264Sps));
+        AppendNal(hdr, kH264Pps, sizeof(kH264Pps));
+    }
+    if (hdr.size() > p->inBufferSize)
+        return NV_ENC_ERR_NOT_ENOUGH_BUFFER;
+
+    memcpy(p->spsppsBuffer, hdr.data(), hdr.size());
+    *p->outSPSPPSPayloadSize = (uint32_t)hdr.size();
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NVENCAPI FakeCreateBitstreamBuffer(void* encoder, NV_ENC_CREATE_BITSTREAM_BUFFER* p)
+{
+    FakeSession* s = Sess(encoder);
+    if (!s || !p)
+        return NV_ENC_ERR_INVALID_PTR;
+
+    FakeBitstream* bs = new FakeBitstream();
+    std::lock_guard<std::mutex> lk(s->mx);
+    s->bitstreams.insert(bs);
+    p->bitstreamBuffer = bs;
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NVENCAPI FakeDestroyBitstreamBuffer(void* encoder, NV_ENC_OUTPUT_PTR buf)
+{
+    FakeSession* s = Sess(encoder);
+    if (!s)
+        return NV_ENC_ERR_INVALID_PTR;
+
+    std::lock_guard<std::mutex> lk(s->mx);
+    FakeBitstream* bs = (FakeBitstream*)buf;
+    if (!s->bitstreams.erase(bs))
+        return NV_ENC_ERR_INVALID_PARAM;
+    delete bs;
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NVENCAPI FakeRegisterResource(void* encoder, NV_ENC_REGISTER_RESOURCE* p)
+{
+    FakeSession* s = Sess(encoder);
+    if (!s || !p || !p->resourceToRegister)
+        return NV_ENC_ERR_INVALID_PTR;
+
+    FakeResource* r = new FakeResource();
+    r->tex = p->resourceToRegister;
+    std::lock_guard<std::mutex> lk(s->mx);
+    s->resources.insert(r);
+    p->registeredResource = r;
+    g_resRegistered.fetch_add(1, std::memory_order_relaxed);
+    g_resLive.fetch_add(1, std::memory_order_relaxed);
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NVENCAPI FakeUnregisterResource(void* encoder, NV_ENC_REGISTERED_PTR reg)
+{
+    FakeSession* s = Sess(encoder);
+    if (!s)
+        return NV_ENC_ERR_INVALID_PTR;
+
+    std::lock_guard<std::mutex> lk(s->mx);
+    FakeResource* r = (FakeResource*)reg;
+    if (!s->resources.erase(r))
+        return NV_ENC_ERR_RESOURCE_NOT_REGISTERED;
+    delete r;
+    g_resLive.fetch_sub(1, std::memory_order_relaxed);
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NVENCAPI FakeMapInputResource(void* encoder, NV_ENC_MAP_INPUT_RESOURCE* p)
+{
+    FakeSession* s = Sess(encoder);
+    if (!s || !p)
+        return NV_ENC_ERR_INVALID_PTR;
+
+    std::lock_guard<std::mutex> lk(s->mx);
+    if (!s->resources.count((FakeResource*)p->registeredResource))
+        return NV_ENC_ERR_RESOURCE_NOT_REGISTERED;
+    // Отображение ничего не делает: входом служит сама регистрация.
+    p->mappedResource = p->registeredResource;
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NVENCAPI FakeUnmapInputResource(void* encoder, NV_ENC_INPUT_PTR)
+{
+    return encoder ? NV_ENC_SUCCESS : NV_ENC_ERR_INVALID_PTR;
+}
+
+NVENCSTATUS NVENCAPI FakeEncodePicture(void* encoder, NV_ENC_PIC_PARAMS* pic)
+{
+    FakeSession* s = Sess(encoder);
+    if (!s || !pic)
+        return NV_ENC_ERR_INVALID_PTR;
+
+    std::lock_guard<std::mutex> lk(s->mx);
+    if (!s->initialized)
+        return NV_ENC_ERR_ENCODER_NOT_INITIALIZED;
+
+    // EOS: в синхронном режиме вывода нет.
+    if (pic->encodePicFlags & NV_ENC_PIC_FLAG_EOS)
+        return NV_ENC_SUCCESS;
+
+    FakeBitstream* bs = (FakeBitstream*)pic->outputBitstream;
+    if (!s->bitstreams.count(bs) || !s->resources.count((FakeResource*)pic->inputBuffer))
+        return NV_ENC_ERR_INVALID_PARAM;
+    if (bs->pending)
+        return NV_ENC_ERR_INVALID_CALL;
+
+    bool idr = s->forceIdr || (pic->encodePicFlags & NV_ENC_PIC_FLAG_FORCEIDR) ||
+               (s->idrPeriod && s->idrPeriod != NVENC_INFINITE_GOPLENGTH &&
+                s->sinceIdr >= s->idrPeriod);
+    if (idr) {
+        s->forceIdr = false;
+        s->sinceIdr = 0;
+    }
+
+    // Неопорный - каждый второй P-кадр после IDR: следующий ссылается на
+    // предыдущий опорный. У AV1 фейк неопорных кадров не делает.
+    const bool nonRef = !idr && s->nonRefP && !s->av1 && (s->sinceIdr & 1);
+    BuildAccessUnit(*s, *bs, idr, nonRef);
+    bs->pending = true;
+    bs->readyNs = NowNs() + (int64_t)s->cfg.encodeDelayUs * 1000;
+    bs->ts = pic->inputTimeStamp;
+    bs->frameIdx = s->frames;
+    bs->type = idr ? NV_ENC_PIC_TYPE_IDR : nonRef ? NV_ENC_PIC_TYPE_NONREF_P : NV_ENC_PIC_TYPE_P;
+
+    ++s->frames;
+    ++s->sinceIdr;
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NVENCAPI FakeLockBitstream(void* encoder, NV_ENC_LOCK_BITSTREAM* lock)
+{
+    FakeSession* s = Sess(encoder);
+    if (!s || !lock)
+        return NV_ENC_ERR_INVALID_PTR;
+
+    FakeBitstream* bs = (FakeBitstream*)lock->outputBitstream;
+    int64_t readyNs;
+    {
+        std::lock_guard<std::mutex> lk(s->mx);
+        if (!s->bitstreams.count(bs) || !bs->pending)
+            return NV_ENC_ERR_INVALID_PARAM;
+        readyNs = bs->readyNs;
+    }
+
+    // Ждём "кодирования" без мьютекса сессии, как настоящий NVENC.
+    int64_t now = NowNs();
+    if (now < readyNs) {
+        if (lock->doNotWait)
+            return NV_ENC_ERR_LOCK_BUSY;
+        std::this_thread::sleep_for(std::chrono::nanoseconds(readyNs - now));
+    }
+
+    std::lock_guard<std::mutex> lk(s->mx);
+    bs->locked = true;
+    lock->bitstreamBufferPtr   = bs->data.data();
+    lock->bitstreamSizeInBytes = (uint32_t)bs->data.size();
+    lock->outputTimeStamp      = bs->ts;
+    lock->frameIdx             = bs->frameIdx;
+    lock->pictureType          = bs->type;
+    lock->pictureStruct        = NV_ENC_PIC_STRUCT_FRAME;
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NVENCAPI FakeUnlockBitstream(void* encoder, NV_ENC_OUTPUT_PTR buf)
+{
+    FakeSession* s = Sess(encoder);
+    if (!s)
+        return NV_ENC_ERR_INVALID_PTR;
+
+    std::lock_guard<std::mutex> lk(s->mx);
+    FakeBitstream* bs = (FakeBitstream*)buf;
+    if (!s->bitstreams.count(bs) || !bs->locked)
+        return NV_ENC_ERR_INVALID_PARAM;
+    bs->locked = false;
+    bs->pending = false;
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS NVENCAPI FakeRegisterAsyncEvent(void*, NV_ENC_EVENT_PARAMS*)
+{
+    return NV_ENC_ERR_UNSUPPORTED_PARAM;
+}
+
+NVENCSTATUS NVENCAPI FakeDestroyEncoder(void* encoder)
+{
+    FakeSession* s = Sess(encoder);
+    if (!s)
+        return NV_ENC_ERR_INVALID_PTR;
+
+    for (FakeBitstream* bs : s->bitstreams)
+        delete bs;
+    // Не снятые до nvEncDestroyEncoder регистрации остаются в g_resLive:
+    // так тест видит, что энкодер их не освободил.
+    for (FakeResource* r : s->resources)
+        delete r;
+    delete s;
+    return NV_ENC_SUCCESS;
+}
+
+NV_ENCODE_API_FUNCTION_LIST MakeFunctionList()
+{
+    NV_ENCODE_API_FUNCTION_LIST fn;
+    memset(&fn, 0, sizeof(fn));
+    fn.version = NV_ENCODE_API_FUNCTION_LIST_VER;
+
+    fn.nvEncOpenEncodeSessionEx      = FakeOpenEncodeSessionEx;
+    fn.nvEncGetEncodePresetConfigEx  = FakeGetEncodePresetConfigEx;
+    fn.nvEncGetEncodeCaps            = FakeGetEncodeCaps;
+    fn.nvEncInitializeEncoder        = FakeInitializeEncoder;
+    fn.nvEncReconfigureEncoder       = FakeReconfigureEncoder;
+    fn.nvEncGetSequenceParams        = FakeGetSequenceParams;
+    fn.nvEncCreateBitstreamBuffer    = FakeCreateBitstreamBuffer;
+    fn.nvEncDestroyBitstreamBuffer   = FakeDestroyBitstreamBuffer;
+    fn.nvEncRegisterResource         = FakeRegisterResource;
+    fn.nvEncUnregisterResource       = FakeUnregisterResource;
+    fn.nvEncMapInputResource         = FakeMapInputResource;
+    fn.nvEncUnmapInputResource       = FakeUnmapInputResource;
+    fn.nvEncEncodePicture            = FakeEncodePicture;
+    fn.nvEncLockBitstream            = FakeLockBitstream;
+    fn.nvEncUnlockBitstream          = FakeUnlockBitstream;
+    fn.nvEncRegisterAsyncEvent       = FakeRegisterAsyncEvent;
+    fn.nvEncUnregisterAsyncEvent     = FakeRegisterAsyncEvent;
+    fn.nvEncDestroyEncoder           = FakeDestroyEncoder;
+    return fn;
+}
+
+}
+
+const NV_ENCODE_API_FUNCTION_LIST* FakeNvencFunctionList()
+{
+    static const NV_ENCODE_API_FUNCTION_LIST fn = MakeFunctionList();
+    return &fn;
+}
+
+void FakeNvencSetConfig(const FakeNvencConfig& cfg)
+{
+    std::lock_guard<std::mutex> lk(g_cfgMx);
+    g_cfg = cfg;
+    g_cfgLoaded = true;
+}
+
+FakeNvencConfig FakeNvencGetConfig()
+{
+    return LoadConfig();
+}
+
+FakeNvencResourceStats FakeNvencResources()
+{
+    FakeNvencResourceStats st;
+    st.registered = g_resRegistered.load(std::memory_order_relaxed);
+    st.live = g_resLive.load(std::memory_order_relaxed);
+    return st;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Platform.h"
+#include "nvEncodeAPI.h"
+
+// Параметры программного NVENC.
+struct FakeNvencConfig
+{
+    // Сколько "кодируется" кадр: nvEncLockBitstream отдаёт результат не
+    // раньше, чем через столько микросекунд после nvEncEncodePicture.
+    uint32_t encodeDelayUs = 2000;
+    // Размер кадра в байтах; 0 - по битрейту и частоте (bitrate / 8 / fps),
+    // IDR вчетверо больше P-кадра. С intra refresh лишнее на IDR
+    // распределено по кадрам периода обновления.
+    uint32_t frameBytes = 0;
+};
+
+// Программная замена таблицы функций NVENC для CI и бенчмарков без GPU.
+// Работает только в синхронном режиме (как NVENC вне Windows) и вместо
+// кодирования выдаёт заготовленные кадры:
+//   H.264 - SPS/PPS + IDR (NAL 5) или P-срез (NAL 1);
+//   HEVC  - VPS/SPS/PPS + IDR_W_RADL (NAL 19) или TRAIL_R (NAL 1);
+//   AV1   - поток OBU: temporal delimiter, sequence header + KEY_FRAME
+//           или INTER_FRAME (OBU_FRAME).
+// IDR выдаётся на первом кадре, по периоду GOP, по NV_ENC_PIC_FLAG_FORCEIDR
+// и после nvEncReconfigureEncoder с forceIDR. С rcParams.enableNonRefP
+// каждый второй P-кадр неопорный (H.264 nal_ref_idc = 0, HEVC TRAIL_N).
+// Текстуры не читаются.
+const NV_ENCODE_API_FUNCTION_LIST* FakeNvencFunctionList();
+
+// Применяется к сессиям, открытым после вызова. Начальные значения можно
+// задать переменной окружения NVRTSP_FAKE_ENCODE_DELAY_US.
+void FakeNvencSetConfig(const FakeNvencConfig& cfg);
+FakeNvencConfig FakeNvencGetConfig();
+
+// Регистрации ресурсов по всем сессиям: всего вызовов nvEncRegisterResource
+// и сколько из них не снято nvEncUnregisterResource. Регистрация, оставшаяся
+// к nvEncDestroyEncoder, так и считается живой - это утечка энкодера.
+struct FakeNvencResourceStats
+{
+    uint64_t registered = 0;
+    uint64_t live = 0;
+};
+FakeNvencResourceStats FakeNvencResources();
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "IUnityInterface.h"
+
+// Заглушка IUnityGraphics (см. IUnityInterface.h рядом).
+
+enum UnityGfxRenderer
+{
+    kUnityGfxRendererD3D11 = 2,
+    kUnityGfxRendererNull  = 4,
+};
+
+enum UnityGfxDeviceEventType
+{
+    kUnityGfxDeviceEventInitialize  = 0,
+    kUnityGfxDeviceEventShutdown    = 1,
+    kUnityGfxDeviceEventBeforeReset = 2,
+    kUnityGfxDeviceEventAfterReset  = 3,
+};
+
+typedef void (UNITY_INTERFACE_API* IUnityGraphicsDeviceEventCallback)(UnityGfxDeviceEventType eventType);
+
+struct IUnityGraphics : IUnityInterface
+{
+    UnityGfxRenderer (UNITY_INTERFACE_API* GetRenderer)();
+    void (UNITY_INTERFACE_API* RegisterDeviceEventCallback)(IUnityGraphicsDeviceEventCallback callback);
+    void (UNITY_INTERFACE_API* UnregisterDeviceEventCallback)(IUnityGraphicsDeviceEventCallback callback);
+    int (UNITY_INTERFACE_API* ReserveEventIDRange)(int count);
+};
+
+typedef void (UNITY_INTERFACE_API* UnityRenderingEvent)(int eventId);
+typedef void (UNITY_INTERFACE_API* UnityRenderingEventAndData)(int eventId, void* data);
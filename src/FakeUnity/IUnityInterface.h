@@ -0,0 +1,24 @@
+#pragma once
+
+// Заглушка Unity PluginAPI для сборок без Unity SDK (NVRTSP_FAKE_NVENC вне
+// Windows: тесты, бенчмарки). Только то, чем пользуется плагин; плагин с
+// ней собирается, но UnityPluginLoad получает от Unity настоящие заголовки.
+
+#if defined(_WIN32)
+#define UNITY_INTERFACE_API __stdcall
+#define UNITY_INTERFACE_EXPORT __declspec(dllexport)
+#else
+#define UNITY_INTERFACE_API
+#define UNITY_INTERFACE_EXPORT __attribute__((visibility("default")))
+#endif
+
+struct IUnityInterface
+{
+};
+
+struct IUnityInterfaces
+{
+    // Без Unity интерфейсов нет.
+    template <typename T>
+    T* Get() { return nullptr; }
+};
@@ -0,0 +1,359 @@
+#include "FrameCaptureRing.h"
+
+#include "D3D11Compat.h"
+#include "FrameScaler.h"
+#include "Nv12Converter.h"
+
+// Объявление логгера из NvencRtspPlugin.cpp
+void Log(const char* msg);
+
+FrameCaptureRing::FrameCaptureRing(ID3D11Device* dev, uint32_t slots, uint32_t fps)
+    : m_dev(dev)
+    , m_slots(slots ? slots : 1)
+    , m_interval100ns(10000000LL / (fps ? fps : 30))
+{
+}
+
+FrameCaptureRing::~FrameCaptureRing() = default;
+
+bool FrameCaptureRing::EnsureSlotTexture(Slot& slot, ID3D11Texture2D* src, bool nv12,
+                                         uint32_t w, uint32_t h)
+{
+    D3D11_TEXTURE2D_DESC desc = {};
+    src->GetDesc(&desc);
+    if (w && h) {
+        desc.Width = w;
+        desc.Height = h;
+    }
+
+    // Typeless-формат Unity NVENC не понимает - копируем в типизированный.
+    DXGI_FORMAT fmt = desc.Format;
+    if (nv12)
+        fmt = DXGI_FORMAT_NV12;
+    else if (fmt == DXGI_FORMAT_R8G8B8A8_TYPELESS)
+        fmt = DXGI_FORMAT_R8G8B8A8_UNORM;
+    else if (fmt == DXGI_FORMAT_B8G8R8A8_TYPELESS)
+        fmt = DXGI_FORMAT_B8G8R8A8_UNORM;
+
+    if (slot.tex && slot.w == desc.Width && slot.h == desc.Height && slot.fmt == (int)fmt)
+        return true;
+
+    D3D11_TEXTURE2D_DESC tdesc = desc;
+    if (nv12) {
+        tdesc = Nv12Converter::TargetDesc(desc.Width, desc.Height);
+    }
+    else {
+        tdesc.Format = fmt;
+        tdesc.Usage = D3D11_USAGE_DEFAULT;
+        tdesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+        tdesc.CPUAccessFlags = 0;
+        tdesc.MiscFlags = 0;
+    }
+
+    if (slot.tex && m_nv12)
+        m_nv12->Forget(slot.tex.Get());
+    slot.tex.Reset();
+    HRESULT hr = m_dev->CreateTexture2D(&tdesc, nullptr, slot.tex.GetAddressOf());
+    if (FAILED(hr)) {
+        Log("FrameCaptureRing: CreateTexture2D failed");
+        return false;
+    }
+    slot.w = desc.Width;
+    slot.h = desc.Height;
+    slot.fmt = (int)fmt;
+    return true;
+}
+
+bool FrameCaptureRing::WantsNv12Locked(ID3D11Texture2D* src) const
+{
+    if (!m_format.nv12 || m_nv12Failed)
+        return false;
+
+    // sRGB шейдер прочитал бы линеаризованным - такие кадры идут как RGB.
+    D3D11_TEXTURE2D_DESC desc = {};
+    src->GetDesc(&desc);
+    DXGI_FORMAT view;
+    return Nv12Converter::SourceViewFormat(desc.Format, view) &&
+           (desc.Width & 1) == 0 && (desc.Height & 1) == 0;
+}
+
+// Проходы привязаны к контексту, на котором созданы.
+void FrameCaptureRing::BindPassesLocked(ID3D11DeviceContext* ctx)
+{
+    if (ctx != m_passCtx) {
+        m_scaler.reset();
+        m_nv12.reset();
+        m_passCtx = ctx;
+    }
+}
+
+FrameScaler* FrameCaptureRing::ScalerLocked(ID3D11DeviceContext* ctx)
+{
+    if (!m_scaler && !m_scalerFailed) {
+        std::unique_ptr<FrameScaler> scaler(new FrameScaler(m_dev, ctx));
+        if (scaler->Initialize())
+            m_scaler = std::move(scaler);
+        else {
+            m_scalerFailed = true;
+            Log("FrameCaptureRing: no scale pass, the encoder scales frames itself");
+        }
+    }
+    return m_scaler.get();
+}
+
+bool FrameCaptureRing::PrepareLocked(ID3D11DeviceContext* ctx, Slot& slot, ID3D11Texture2D* src)
+{
+    D3D11_TEXTURE2D_DESC desc = {};
+    src->GetDesc(&desc);
+
+    if (desc.SampleDesc.Count != 1 || desc.ArraySize != 1 || desc.MipLevels != 1) {
+        Log("FrameCaptureRing: MSAA/array/mipmapped textures are not supported");
+        return false;
+    }
+
+    BindPassesLocked(ctx);
+
+    // Размер кодирования другой: масштабированный кадр живёт в текстуре
+    // прохода до следующего вызова, дальше он копируется или идёт в NV12.
+    if (m_format.w && m_format.h && (desc.Width != m_format.w || desc.Height != m_format.h)) {
+        if (FrameScaler* scaler = ScalerLocked(ctx)) {
+            src = scaler->Scale(src, m_format.w, m_format.h, m_format.filter);
+            if (!src)
+                return false;
+        }
+    }
+
+    bool nv12 = WantsNv12Locked(src);
+    if (nv12 && !m_nv12) {
+        std::unique_ptr<Nv12Converter> conv(new Nv12Converter(m_dev, ctx));
+        if (conv->Initialize())
+            m_nv12 = std::move(conv);
+        else {
+            m_nv12Failed = true;
+            nv12 = false;
+            Log("FrameCaptureRing: no NV12 pass, the encoder converts frames itself");
+        }
+    }
+
+    if (!EnsureSlotTexture(slot, src, nv12))
+        return false;
+    if (nv12)
+        return m_nv12->Convert(src, slot.tex.Get(), m_format.range);
+    ctx->CopyResource(slot.tex.Get(), src);
+    return true;
+}
+
+// Ступень симулкаста: NV12 основного стрима уже посчитан на этом кадре -
+// копия 1:1 или масштаб плоскостей прямо в слот. Из меньшего кадра ступень
+// не растягивает (потеряла бы резкость) - тогда обычный путь от src.
+bool FrameCaptureRing::PrepareSharedLocked(ID3D11DeviceContext* ctx, Slot& slot,
+                                           ID3D11Texture2D* src, const Prepared& shared)
+{
+    D3D11_TEXTURE2D_DESC sd = {};
+    src->GetDesc(&sd);
+    D3D11_TEXTURE2D_DESC nd = {};
+    shared.tex->GetDesc(&nd);
+
+    const uint32_t w = m_format.w && m_format.h ? m_format.w : sd.Width;
+    const uint32_t h = m_format.w && m_format.h ? m_format.h : sd.Height;
+    BindPassesLocked(ctx);
+    if (!m_format.nv12 || m_nv12Failed || m_sharedFailed || shared.range != m_format.range ||
+        (w & 1) || (h & 1) || w > nd.Width || h > nd.Height)
+        return PrepareLocked(ctx, slot, src);
+
+    if (w == nd.Width && h == nd.Height) {
+        if (!EnsureSlotTexture(slot, shared.tex.Get(), true))
+            return false;
+        ctx->CopyResource(slot.tex.Get(), shared.tex.Get());
+        return true;
+    }
+
+    FrameScaler* scaler = ScalerLocked(ctx);
+    if (!scaler)
+        return PrepareLocked(ctx, slot, src);
+    if (!EnsureSlotTexture(slot, shared.tex.Get(), true, w, h))
+        return false;
+    if (scaler->ScaleNv12(shared.tex.Get(), slot.tex.Get(), m_format.filter))
+        return true;
+
+    m_sharedFailed = true;
+    Log("FrameCaptureRing: no NV12 scale pass, renditions convert the frame themselves");
+    return PrepareLocked(ctx, slot, src);
+}
+
+FrameCaptureRing::Prepared FrameCaptureRing::LastPrepared(int64_t ts100ns)
+{
+    std::lock_guard<std::mutex> lk(m_mx);
+    return m_last.ts100ns == ts100ns ? m_last : Prepared();
+}
+
+void FrameCaptureRing::FreeCompletedLocked()
+{
+    for (Slot& slot : m_slots) {
+        if (slot.state == SlotState::Encoding && slot.frameIdx < m_completed)
+            slot.state = SlotState::Free;
+    }
+}
+
+bool FrameCaptureRing::Capture(ID3D11DeviceContext* ctx, ID3D11Texture2D* src, int64_t ts100ns,
+                               FrameCaptureRing* shared)
+{
+    if (!ctx || !src)
+        return false;
+
+    // Берётся до своей блокировки: кольца друг друга под мьютексом не ждут.
+    Prepared from;
+    if (shared && shared != this)
+        from = shared->LastPrepared(ts100ns);
+
+    std::lock_guard<std::mutex> lk(m_mx);
+
+    // Кадр засчитывается, если до очередного срока осталось меньше четверти
+    // периода: так дрожание кадров Unity не сдвигает поток на целый кадр.
+    if (m_nextDue100ns && ts100ns < m_nextDue100ns - m_interval100ns / 4)
+        return false;
+    m_nextDue100ns = (m_nextDue100ns && ts100ns - m_nextDue100ns < m_interval100ns)
+                         ? m_nextDue100ns + m_interval100ns
+                         : ts100ns + m_interval100ns;
+
+    FreeCompletedLocked();
+
+    // Свободный слот, иначе перезаписываем ещё не взятый готовый кадр.
+    Slot* target = nullptr;
+    for (Slot& slot : m_slots) {
+        if (slot.state == SlotState::Free) {
+            target = &slot;
+            break;
+        }
+    }
+    if (!target) {
+        for (Slot& slot : m_slots) {
+            if (slot.state == SlotState::Ready && (!target || slot.ts100ns < target->ts100ns))
+                target = &slot;
+        }
+        if (target)
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!target) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Готовый кадр в этом слоте уже перезаписан - слот свободен.
+    const bool ok = from.tex ? PrepareSharedLocked(ctx, *target, src, from)
+                             : PrepareLocked(ctx, *target, src);
+    if (!ok) {
+        target->state = SlotState::Free;
+        return false;
+    }
+    target->state = SlotState::Ready;
+    target->ts100ns = ts100ns;
+
+    m_last = Prepared();
+    if (target->fmt == (int)DXGI_FORMAT_NV12) {
+        m_last.tex = target->tex;
+        m_last.ts100ns = ts100ns;
+        m_last.range = m_format.range;
+    }
+
+    m_active.store(true, std::memory_order_release);
+    m_cv.notify_one();
+    return true;
+}
+
+bool FrameCaptureRing::AcquireLatest(CapturedFrame& out, std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lk(m_mx);
+
+    auto hasReady = [this] {
+        for (const Slot& slot : m_slots) {
+            if (slot.state == SlotState::Ready)
+                return true;
+        }
+        return false;
+    };
+
+    if (!m_cv.wait_for(lk, timeout, [&] { return m_wake || hasReady(); }))
+        return false;
+    m_wake = false;
+
+    int latest = -1;
+    for (size_t i = 0; i < m_slots.size(); ++i) {
+        if (m_slots[i].state != SlotState::Ready)
+            continue;
+        if (latest < 0 || m_slots[i].ts100ns > m_slots[latest].ts100ns)
+            latest = (int)i;
+    }
+    if (latest < 0)
+        return false;
+
+    for (size_t i = 0; i < m_slots.size(); ++i) {
+        if ((int)i != latest && m_slots[i].state == SlotState::Ready) {
+            m_slots[i].state = SlotState::Free;
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    Slot& slot = m_slots[latest];
+    slot.state = SlotState::Encoding;
+    slot.frameIdx = UINT64_MAX;   // номер станет известен в MarkSubmitted
+
+    out.slot = latest;
+    out.tex = slot.tex.Get();
+    out.ts100ns = slot.ts100ns;
+    return true;
+}
+
+void FrameCaptureRing::MarkSubmitted(int slot, uint64_t frameIdx)
+{
+    std::lock_guard<std::mutex> lk(m_mx);
+    if (slot >= 0 && slot < (int)m_slots.size())
+        m_slots[slot].frameIdx = frameIdx;
+}
+
+void FrameCaptureRing::Release(int slot)
+{
+    std::lock_guard<std::mutex> lk(m_mx);
+    if (slot >= 0 && slot < (int)m_slots.size())
+        m_slots[slot].state = SlotState::Free;
+}
+
+void FrameCaptureRing::SetCompletedFrames(uint64_t completed)
+{
+    std::lock_guard<std::mutex> lk(m_mx);
+    m_completed = completed;
+    FreeCompletedLocked();
+}
+
+void FrameCaptureRing::Reset()
+{
+    std::lock_guard<std::mutex> lk(m_mx);
+    for (Slot& slot : m_slots)
+        slot.state = SlotState::Free;
+    m_completed = 0;
+    m_nextDue100ns = 0;
+    m_last = Prepared();
+    m_wake = false;
+    m_active.store(false, std::memory_order_release);
+}
+
+void FrameCaptureRing::SetFrameRate(uint32_t fpsNum, uint32_t fpsDen)
+{
+    if (!fpsNum || !fpsDen)
+        return;
+    std::lock_guard<std::mutex> lk(m_mx);
+    m_interval100ns = 10000000LL * fpsDen / fpsNum;
+}
+
+void FrameCaptureRing::SetFormat(const CaptureFormat& format)
+{
+    std::lock_guard<std::mutex> lk(m_mx);
+    m_format = format;
+}
+
+void FrameCaptureRing::Wake()
+{
+    std::lock_guard<std::mutex> lk(m_mx);
+    m_wake = true;
+    m_cv.notify_all();
+}
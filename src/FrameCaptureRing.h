@@ -0,0 +1,152 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#include <wrl/client.h>
+#else
+#include "FakeD3D11.h"
+#endif
+
+#include "ColorConvert.h"
+#include "Resize.h"
+
+struct ID3D11Device;
+struct ID3D11DeviceContext;
+struct ID3D11Texture2D;
+class FrameScaler;
+class Nv12Converter;
+
+// Кадр, снятый на render thread Unity.
+struct CapturedFrame
+{
+    int slot = -1;
+    ID3D11Texture2D* tex = nullptr;
+    int64_t ts100ns = 0;
+};
+
+// Во что render thread готовит кадр для энкодера.
+struct CaptureFormat
+{
+    uint32_t w = 0;             // 0 - размер источника, без масштабирования
+    uint32_t h = 0;
+    bool nv12 = false;          // проход RGB -> NV12 (стороны должны быть чётные)
+    Nv12Range range = Nv12Range::Limited;
+    ScaleFilter filter = ScaleFilter::Bilinear;
+};
+
+// Небольшое кольцо GPU-текстур между render thread Unity и потоком кодирования.
+// Render thread в момент конца кадра готовит RenderTexture в свободный слот
+// (на своём immediate context): масштабирует и переводит в NV12 по
+// CaptureFormat или просто копирует. Поток кодирования забирает самый свежий
+// кадр и отдаёт текстуру слота прямо в NVENC, сам immediate context не трогая.
+// Слот освобождается, когда NVENC дочитал кадр (см. SetCompletedFrames).
+class FrameCaptureRing
+{
+public:
+    FrameCaptureRing(ID3D11Device* dev, uint32_t slots, uint32_t fps);
+    ~FrameCaptureRing();
+
+    // Render thread. Готовит src в свободный слот; false - кадр пропущен
+    // (рано по частоте стрима, все слоты заняты или ошибка прохода).
+    // shared - кольцо основного стрима симулкаста: если оно только что
+    // подготовило этот же кадр (тот же ts100ns) в NV12 нужного диапазона,
+    // ступень масштабирует его NV12, а не переводит src заново. Иначе -
+    // обычный путь от src. Вызывать после Capture кольца shared.
+    bool Capture(ID3D11DeviceContext* ctx, ID3D11Texture2D* src, int64_t ts100ns,
+                 FrameCaptureRing* shared = nullptr);
+
+    // Поток кодирования. Ждёт до timeout самый свежий готовый кадр; более
+    // старые готовые кадры отбрасываются, чтобы не копить задержку.
+    bool AcquireLatest(CapturedFrame& out, std::chrono::milliseconds timeout);
+
+    // Кадр из слота отправлен в NVENC под номером frameIdx.
+    void MarkSubmitted(int slot, uint64_t frameIdx);
+    // Кадр не удалось отправить - слот сразу свободен.
+    void Release(int slot);
+    // NVENC отдал все кадры с номерами < completed; их слоты свободны.
+    void SetCompletedFrames(uint64_t completed);
+
+    // Стрим перезапущен с новым энкодером: номера его кадров начинаются
+    // с нуля. Все слоты свободны, кадры до остановки отброшены; до первого
+    // захвата поток кодирования снова работает по таймеру.
+    void Reset();
+
+    // Новая частота стрима для прореживания (fpsDen/fpsNum секунды на кадр).
+    void SetFrameRate(uint32_t fpsNum, uint32_t fpsDen);
+
+    // Формат кадров, начиная со следующего захвата.
+    void SetFormat(const CaptureFormat& format);
+
+    // Был ли хоть один захват: до этого поток кодирования работает по таймеру.
+    bool Active() const { return m_active.load(std::memory_order_acquire); }
+
+    uint64_t DroppedFrames() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    // Будит ждущий AcquireLatest (например, при остановке).
+    void Wake();
+
+private:
+    enum class SlotState { Free, Ready, Encoding };
+
+    struct Slot {
+        Microsoft::WRL::ComPtr<ID3D11Texture2D> tex;
+        uint32_t w = 0;
+        uint32_t h = 0;
+        int fmt = 0;            // DXGI_FORMAT, у кадра после прохода NV12 - NV12
+        SlotState state = SlotState::Free;
+        int64_t ts100ns = 0;
+        uint64_t frameIdx = 0;
+    };
+
+    // Последний подготовленный кадр в NV12 - источник для ступеней симулкаста.
+    struct Prepared {
+        Microsoft::WRL::ComPtr<ID3D11Texture2D> tex;
+        int64_t ts100ns = 0;
+        Nv12Range range = Nv12Range::Limited;
+    };
+
+    // w, h - размер слота, если он не совпадает с src (масштаб NV12 -> NV12).
+    bool EnsureSlotTexture(Slot& slot, ID3D11Texture2D* src, bool nv12,
+                           uint32_t w = 0, uint32_t h = 0);
+    bool PrepareLocked(ID3D11DeviceContext* ctx, Slot& slot, ID3D11Texture2D* src);
+    bool PrepareSharedLocked(ID3D11DeviceContext* ctx, Slot& slot, ID3D11Texture2D* src,
+                             const Prepared& shared);
+    void BindPassesLocked(ID3D11DeviceContext* ctx);
+    FrameScaler* ScalerLocked(ID3D11DeviceContext* ctx);
+    bool WantsNv12Locked(ID3D11Texture2D* src) const;
+    Prepared LastPrepared(int64_t ts100ns);
+    void FreeCompletedLocked();
+
+    ID3D11Device* m_dev = nullptr;
+
+    // Проходы на контексте render thread; создаются при первом кадре,
+    // которому они нужны. Не удалось создать - кадры идут как есть.
+    CaptureFormat m_format;
+    ID3D11DeviceContext* m_passCtx = nullptr;
+    std::unique_ptr<FrameScaler> m_scaler;
+    std::unique_ptr<Nv12Converter> m_nv12;
+    bool m_scalerFailed = false;
+    bool m_nv12Failed = false;
+    bool m_sharedFailed = false;
+
+    std::mutex m_mx;
+    std::condition_variable m_cv;
+    std::vector<Slot> m_slots;
+    uint64_t m_completed = 0;
+    Prepared m_last;
+
+    // Прореживание: Unity может рендерить чаще, чем частота стрима.
+    int64_t m_interval100ns = 0;
+    int64_t m_nextDue100ns = 0;
+
+    std::atomic<bool> m_active{false};
+    std::atomic<uint64_t> m_dropped{0};
+    bool m_wake = false;
+};
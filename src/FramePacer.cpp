@@ -0,0 +1,171 @@
+#include "FramePacer.h"
+
+#include <chrono>
+#include <thread>
+
+static const int64_t kNsPerSec = 1000000000LL;
+
+int64_t SteadyPacerClock::NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+void SteadyPacerClock::SleepUntilNs(int64_t deadlineNs)
+{
+    std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::nanoseconds(deadlineNs))));
+}
+
+FramePacer::FramePacer(uint32_t fpsNum, uint32_t fpsDen, PacerPolicy policy, PacerClock* clock)
+    : m_clock(clock ? clock : &m_steady)
+    , m_num(fpsNum ? fpsNum : 30)
+    , m_den(fpsDen ? fpsDen : 1)
+    , m_policy(policy)
+{
+}
+
+void FramePacer::Reset()
+{
+    m_epochNs = m_clock->NowNs();
+    m_epochFrame = 0;
+    m_next = 0;
+    m_burst = 0;
+    m_started = true;
+
+    m_ticks = m_skipped = 0;
+    m_lateSumNs = m_lateMaxNs = 0;
+    m_intervals = 0;
+    m_jitterSumNs = m_jitterMaxNs = 0;
+}
+
+void FramePacer::SetRate(uint32_t fpsNum, uint32_t fpsDen)
+{
+    if (!fpsNum || !fpsDen)
+        return;
+    if (m_started && m_next > m_epochFrame) {
+        m_epochNs = DueNs(m_next - 1);
+        m_epochFrame = m_next - 1;
+    }
+    m_num = fpsNum;
+    m_den = fpsDen;
+}
+
+// Срок тика: epoch + k * den / num секунд. Целая и дробная части считаются
+// отдельно, чтобы k * den * 1e9 не переполнялось на долгих сессиях.
+int64_t FramePacer::DueNs(uint64_t frame) const
+{
+    uint64_t k = frame - m_epochFrame;
+    int64_t whole = (int64_t)(k / m_num) * m_den * kNsPerSec;
+    int64_t frac = (int64_t)((k % m_num) * m_den * (uint64_t)kNsPerSec / m_num);
+    return m_epochNs + whole + frac;
+}
+
+int64_t FramePacer::NominalPeriodNs() const
+{
+    return (int64_t)m_den * kNsPerSec / m_num;
+}
+
+int64_t FramePacer::TimeUntilNextNs()
+{
+    if (!m_started)
+        return 0;
+    int64_t left = DueNs(m_next) - m_clock->NowNs();
+    return left > 0 ? left : 0;
+}
+
+int64_t FramePacer::NextDueNs()
+{
+    if (!m_started)
+        Reset();
+    return DueNs(m_next);
+}
+
+PacerTick FramePacer::WaitNext()
+{
+    if (!m_started)
+        Reset();
+
+    int64_t now = m_clock->NowNs();
+    int64_t due = DueNs(m_next);
+
+    PacerTick tick;
+
+    if (now < due) {
+        m_clock->SleepUntilNs(due);
+        now = m_clock->NowNs();
+        m_burst = 0;
+    }
+    else if (DueNs(m_next + 1) <= now) {
+        // Отстали больше чем на период: есть ещё хотя бы один просроченный тик.
+        if (m_policy == PacerPolicy::CatchUp && m_burst < m_maxBurst) {
+            ++m_burst;
+        }
+        else {
+            // Последний тик со сроком <= now; от оценки делением доводим точно.
+            uint64_t k = now > m_epochNs ? (uint64_t)(now - m_epochNs) : 0;
+            uint64_t secs = k / kNsPerSec;
+            uint64_t latest = m_epochFrame + secs / m_den * m_num
+                            + ((secs % m_den) * kNsPerSec + k % kNsPerSec) * m_num
+                                  / ((uint64_t)m_den * kNsPerSec);
+            if (latest < m_next)
+                latest = m_next;
+            while (DueNs(latest + 1) <= now)
+                ++latest;
+            while (latest > m_next && DueNs(latest) > now)
+                --latest;
+
+            tick.skipped = (uint32_t)(latest - m_next);
+            m_skipped += tick.skipped;
+            m_next = latest;
+            due = DueNs(m_next);
+            m_burst = 0;
+        }
+    }
+    else {
+        m_burst = 0;
+    }
+
+    tick.frame = m_next;
+    tick.dueNs = due;
+    tick.lateNs = now > due ? now - due : 0;
+
+    m_lateSumNs += tick.lateNs;
+    if (tick.lateNs > m_lateMaxNs)
+        m_lateMaxNs = tick.lateNs;
+
+    if (m_ticks > 0) {
+        // Прошлый тик не раньше эпохи: DueNs считает от неё беззнаково, а
+        // после SetRate срок до эпохи по новой частоте и не определён.
+        uint64_t prev = m_next - 1 - tick.skipped;
+        if (prev < m_epochFrame)
+            prev = m_epochFrame;
+        int64_t expected = due - DueNs(prev);
+        int64_t dev = (now - m_lastTickNs) - expected;
+        if (dev < 0)
+            dev = -dev;
+        m_jitterSumNs += dev;
+        if (dev > m_jitterMaxNs)
+            m_jitterMaxNs = dev;
+        ++m_intervals;
+    }
+
+    m_lastTickNs = now;
+    ++m_ticks;
+    ++m_next;
+    return tick;
+}
+
+PacerStats FramePacer::Stats() const
+{
+    PacerStats st;
+    st.ticks = m_ticks;
+    st.skipped = m_skipped;
+    st.lateAvgNs = m_ticks ? m_lateSumNs / (int64_t)m_ticks : 0;
+    st.lateMaxNs = m_lateMaxNs;
+    st.jitterAvgNs = m_intervals ? m_jitterSumNs / (int64_t)m_intervals : 0;
+    st.jitterMaxNs = m_jitterMaxNs;
+    return st;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+
+// Источник времени для FramePacer. Настоящий - steady_clock; в отладке можно
+// подставить свой (ручные часы), чтобы прогонять пейсер без реального ожидания.
+class PacerClock
+{
+public:
+    virtual ~PacerClock() = default;
+    virtual int64_t NowNs() = 0;
+    virtual void SleepUntilNs(int64_t deadlineNs) = 0;
+};
+
+class SteadyPacerClock : public PacerClock
+{
+public:
+    int64_t NowNs() override;
+    void SleepUntilNs(int64_t deadlineNs) override;
+};
+
+// Что делать, если тик пропущен (поток проспал/кодирование затянулось).
+enum class PacerPolicy
+{
+    // Выдать пропущенные тики подряд без ожидания (не больше maxBurst),
+    // чтобы средняя частота осталась точной.
+    CatchUp,
+    // Перескочить на ближайший будущий тик, пропущенные кадры не выдаются.
+    Skip,
+};
+
+struct PacerTick
+{
+    uint64_t frame = 0;     // номер тика с момента Reset
+    int64_t  dueNs = 0;     // когда тик должен был случиться (часы пейсера)
+    int64_t  lateNs = 0;    // насколько позже срока он выдан
+    uint32_t skipped = 0;   // сколько тиков перед ним пропущено
+};
+
+struct PacerStats
+{
+    uint64_t ticks = 0;
+    uint64_t skipped = 0;
+    int64_t  lateAvgNs = 0;
+    int64_t  lateMaxNs = 0;
+    // Среднее отклонение интервала между тиками от номинального периода.
+    int64_t  jitterAvgNs = 0;
+    int64_t  jitterMaxNs = 0;
+};
+
+// Тактирует кадры с точным рациональным периодом fpsDen/fpsNum секунды
+// (например, 30000/1001). Срок n-го тика считается от старта целочисленно,
+// а не накоплением округлённого периода, поэтому частота не уплывает.
+class FramePacer
+{
+public:
+    // clock == nullptr - steady_clock. Часы должны жить дольше пейсера.
+    FramePacer(uint32_t fpsNum, uint32_t fpsDen = 1,
+               PacerPolicy policy = PacerPolicy::Skip, PacerClock* clock = nullptr);
+
+    // Начать отсчёт с текущего момента: тик 0 выдаётся сразу.
+    void Reset();
+
+    // Смена частоты без разрыва: следующий тик - через новый период от предыдущего.
+    void SetRate(uint32_t fpsNum, uint32_t fpsDen);
+
+    // Ждёт следующего тика (или выдаёт его сразу, если срок прошёл).
+    PacerTick WaitNext();
+
+    // Сколько осталось до следующего тика (0, если уже пора).
+    int64_t TimeUntilNextNs();
+
+    // Срок следующего тика по часам пейсера (для внешнего планировщика,
+    // который сам ждёт срока и вызывает WaitNext уже без сна).
+    int64_t NextDueNs();
+
+    int64_t DueNs(uint64_t frame) const;
+    int64_t NominalPeriodNs() const;
+
+    void SetMaxBurst(uint32_t n) { m_maxBurst = n ? n : 1; }
+
+    PacerStats Stats() const;
+
+private:
+    PacerClock* m_clock;
+    SteadyPacerClock m_steady;
+
+    uint32_t m_num;
+    uint32_t m_den;
+    PacerPolicy m_policy;
+    uint32_t m_maxBurst = 4;
+
+    // Отсчёт идёт от эпохи (m_epochNs, m_epochFrame): при SetRate эпоха
+    // переносится на последний тик, остальная арифметика не меняется.
+    int64_t  m_epochNs = 0;
+    uint64_t m_epochFrame = 0;
+    uint64_t m_next = 0;
+    bool     m_started = false;
+
+    uint32_t m_burst = 0;
+    int64_t  m_lastTickNs = 0;
+
+    uint64_t m_ticks = 0;
+    uint64_t m_skipped = 0;
+    int64_t  m_lateSumNs = 0;
+    int64_t  m_lateMaxNs = 0;
+    uint64_t m_intervals = 0;
+    int64_t  m_jitterSumNs = 0;
+    int64_t  m_jitterMaxNs = 0;
+};
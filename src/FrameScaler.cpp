@@ -0,0 +1,413 @@
+#include "FrameScaler.h"
+
+#include "Nv12Converter.h"
+
+#ifdef _WIN32
+#include <d3dcompiler.h>
+#endif
+
+// Объявление логгера из NvencRtspPlugin.cpp
+void Log(const char* msg);
+
+#ifdef _WIN32
+
+namespace {
+
+// Поток на точку приёмника. Те же целые шаги, что в ScaleRgba (Resize.cpp):
+// строка с остатком 7 бит, затем столбец, сдвиг на 21 с насыщением.
+// PIXEL/IPIXEL/CHANNELS задают вид точки: RGBA, яркость NV12 или пара UV.
+const char kShaderSource[] = R"(
+Texture2D<float4>         Src   : register(t0);
+StructuredBuffer<int>     TapsX : register(t1);
+StructuredBuffer<int>     TapsY : register(t2);
+RWTexture2D<unorm PIXEL>  Dst   : register(u0);
+
+cbuffer Params : register(b0)
+{
+    uint4 Size;    // xy - источник, zw - приёмник
+    uint4 Taps;    // x, y - отсчётов на ось
+};
+
+IPIXEL LoadPixel(int x, int y)
+{
+    int2 p = clamp(int2(x, y), int2(0, 0), int2(Size.xy) - 1);
+    return int4(round(Src.Load(int3(p, 0)) * 255.0)).CHANNELS;
+}
+
+[numthreads(8, 8, 1)]
+void main(uint3 id : SV_DispatchThreadID)
+{
+    if (id.x >= Size.z || id.y >= Size.w)
+        return;
+
+    int tx = (int)Taps.x;
+    int ty = (int)Taps.y;
+    int bx = (int)id.x * (tx + 1);
+    int by = (int)id.y * (ty + 1);
+    int x0 = TapsX[bx];
+    int y0 = TapsY[by];
+
+    IPIXEL acc = 0;
+    for (int ky = 0; ky < ty; ++ky) {
+        IPIXEL row = 0;
+        for (int kx = 0; kx < tx; ++kx)
+            row += TapsX[bx + 1 + kx] * LoadPixel(x0 + kx, y0 + ky);
+        acc += TapsY[by + 1 + ky] * ((row + 64) >> 7);
+    }
+    Dst[id.xy] = clamp((acc + (1 << 20)) >> 21, 0, 255) / 255.0;
+}
+)";
+
+struct ShaderParams
+{
+    uint32_t size[4];
+    uint32_t taps[4];
+};
+
+static const UINT kGroupSize = 8;
+
+bool CreateTapBuffer(ID3D11Device* dev, const ScaleTaps& taps,
+                     Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& view)
+{
+    D3D11_BUFFER_DESC bd = {};
+    bd.ByteWidth = (UINT)(taps.table.size() * sizeof(int32_t));
+    bd.Usage = D3D11_USAGE_IMMUTABLE;
+    bd.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    bd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+    bd.StructureByteStride = sizeof(int32_t);
+
+    D3D11_SUBRESOURCE_DATA init = {};
+    init.pSysMem = taps.table.data();
+
+    Microsoft::WRL::ComPtr<ID3D11Buffer> buf;
+    if (FAILED(dev->CreateBuffer(&bd, &init, buf.GetAddressOf())))
+        return false;
+    view.Reset();
+    return SUCCEEDED(dev->CreateShaderResourceView(buf.Get(), nullptr, view.GetAddressOf()));
+}
+
+} // namespace
+
+#endif
+
+FrameScaler::FrameScaler(ID3D11Device* dev, ID3D11DeviceContext* ctx)
+    : m_dev(dev)
+    , m_ctx(ctx)
+{
+}
+
+FrameScaler::~FrameScaler() = default;
+
+bool FrameScaler::EnsureTarget(uint32_t w, uint32_t h)
+{
+    if (m_out && m_outW == w && m_outH == h)
+        return true;
+
+    D3D11_TEXTURE2D_DESC desc = {};
+    desc.Width = w;
+    desc.Height = h;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    desc.SampleDesc.Count = 1;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    // SRV - для прохода NV12, который читает уже уменьшенный кадр.
+    desc.BindFlags = D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_SHADER_RESOURCE;
+
+    m_out.Reset();
+    m_outW = m_outH = 0;
+    if (FAILED(m_dev->CreateTexture2D(&desc, nullptr, m_out.GetAddressOf()))) {
+        Log("Scale pass: CreateTexture2D (target) failed");
+        return false;
+    }
+#ifdef _WIN32
+    m_outView.Reset();
+    if (FAILED(m_dev->CreateUnorderedAccessView(m_out.Get(), nullptr, m_outView.GetAddressOf()))) {
+        Log("Scale pass: CreateUnorderedAccessView failed");
+        m_out.Reset();
+        return false;
+    }
+#endif
+    m_outW = w;
+    m_outH = h;
+    return true;
+}
+
+#ifdef _WIN32
+
+bool FrameScaler::CreatePass(Pass& pass, const char* pixel, const char* ipixel, const char* channels)
+{
+    const D3D_SHADER_MACRO defines[] = {
+        { "PIXEL", pixel },
+        { "IPIXEL", ipixel },
+        { "CHANNELS", channels },
+        { nullptr, nullptr },
+    };
+
+    Microsoft::WRL::ComPtr<ID3DBlob> code;
+    Microsoft::WRL::ComPtr<ID3DBlob> errors;
+    HRESULT hr = D3DCompile(kShaderSource, sizeof(kShaderSource) - 1, "FrameScaler",
+                            defines, nullptr, "main", "cs_5_0",
+                            D3DCOMPILE_OPTIMIZATION_LEVEL3, 0,
+                            code.GetAddressOf(), errors.GetAddressOf());
+    if (FAILED(hr)) {
+        Log(errors ? (const char*)errors->GetBufferPointer() : "Scale pass: D3DCompile failed");
+        return false;
+    }
+
+    hr = m_dev->CreateComputeShader(code->GetBufferPointer(), code->GetBufferSize(),
+                                    nullptr, pass.cs.GetAddressOf());
+    if (FAILED(hr)) {
+        Log("Scale pass: CreateComputeShader failed");
+        return false;
+    }
+
+    D3D11_BUFFER_DESC bd = {};
+    bd.ByteWidth = sizeof(ShaderParams);
+    bd.Usage = D3D11_USAGE_DEFAULT;
+    bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    if (FAILED(m_dev->CreateBuffer(&bd, nullptr, pass.params.GetAddressOf()))) {
+        Log("Scale pass: CreateBuffer (constants) failed");
+        return false;
+    }
+    return true;
+}
+
+bool FrameScaler::Initialize()
+{
+    if (!CreatePass(m_rgba, "float4", "int4", "rgba") ||
+        !CreatePass(m_luma, "float", "int", "r") ||
+        !CreatePass(m_chroma, "float2", "int2", "rg"))
+        return false;
+
+    // Плоскости NV12 видны шейдеру только через представления D3D11.3;
+    // без них ScaleNv12 недоступен, RGBA-проход работает.
+    m_dev->QueryInterface(IID_PPV_ARGS(m_dev3.GetAddressOf()));
+    return true;
+}
+
+bool FrameScaler::UpdateTaps(Pass& pass, uint32_t sw, uint32_t sh, uint32_t w, uint32_t h,
+                             ScaleFilter filter)
+{
+    if (pass.tapsX && sw == pass.srcW && sh == pass.srcH &&
+        w == pass.dstW && h == pass.dstH && filter == pass.filter)
+        return true;
+
+    ScaleTaps tx = BuildScaleTaps(sw, w, filter);
+    ScaleTaps ty = BuildScaleTaps(sh, h, filter);
+    pass.tapsX.Reset();
+    if (!CreateTapBuffer(m_dev, tx, pass.tapsX) || !CreateTapBuffer(m_dev, ty, pass.tapsY)) {
+        pass.tapsX.Reset();
+        return false;
+    }
+
+    ShaderParams p = {};
+    p.size[0] = sw;
+    p.size[1] = sh;
+    p.size[2] = w;
+    p.size[3] = h;
+    p.taps[0] = tx.taps;
+    p.taps[1] = ty.taps;
+    m_ctx->UpdateSubresource(pass.params.Get(), 0, nullptr, &p, 0, 0);
+
+    pass.srcW = sw;
+    pass.srcH = sh;
+    pass.dstW = w;
+    pass.dstH = h;
+    pass.filter = filter;
+    return true;
+}
+
+void FrameScaler::Run(Pass& pass, ID3D11ShaderResourceView* src, ID3D11UnorderedAccessView* dst)
+{
+    ID3D11ShaderResourceView* srvs[3] = { src, pass.tapsX.Get(), pass.tapsY.Get() };
+    ID3D11Buffer* cb = pass.params.Get();
+
+    m_ctx->CSSetShader(pass.cs.Get(), nullptr, 0);
+    m_ctx->CSSetShaderResources(0, 3, srvs);
+    m_ctx->CSSetUnorderedAccessViews(0, 1, &dst, nullptr);
+    m_ctx->CSSetConstantBuffers(0, 1, &cb);
+    m_ctx->Dispatch((pass.dstW + kGroupSize - 1) / kGroupSize,
+                    (pass.dstH + kGroupSize - 1) / kGroupSize, 1);
+
+    // Отвязываем всё: источник - RenderTexture Unity, приёмник читают дальше.
+    ID3D11ShaderResourceView* nullSrvs[3] = {};
+    ID3D11UnorderedAccessView* nullUav = nullptr;
+    ID3D11Buffer* nullCb = nullptr;
+    m_ctx->CSSetShaderResources(0, 3, nullSrvs);
+    m_ctx->CSSetUnorderedAccessViews(0, 1, &nullUav, nullptr);
+    m_ctx->CSSetConstantBuffers(0, 1, &nullCb);
+    m_ctx->CSSetShader(nullptr, nullptr, 0);
+}
+
+ID3D11ShaderResourceView* FrameScaler::SourceView(ID3D11Texture2D* src)
+{
+    auto it = m_sources.find(src);
+    if (it != m_sources.end())
+        return it->second.Get();
+
+    D3D11_TEXTURE2D_DESC desc = {};
+    src->GetDesc(&desc);
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC sd = {};
+    if (!Nv12Converter::SourceViewFormat(desc.Format, sd.Format))
+        return nullptr;
+    sd.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+    sd.Texture2D.MipLevels = 1;
+
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+    if (FAILED(m_dev->CreateShaderResourceView(src, &sd, srv.GetAddressOf()))) {
+        Log("Scale pass: CreateShaderResourceView failed (no BIND_SHADER_RESOURCE?)");
+        return nullptr;
+    }
+
+    if (m_sources.size() >= kMaxSources)
+        m_sources.clear();
+    return (m_sources[src] = srv).Get();
+}
+
+FrameScaler::Planes* FrameScaler::PlaneViews(ID3D11Texture2D* tex, bool target)
+{
+    auto it = m_planes.find(tex);
+    if (it == m_planes.end()) {
+        if (m_planes.size() >= kMaxSources)
+            m_planes.clear();
+        it = m_planes.emplace(tex, Planes()).first;
+    }
+    Planes& p = it->second;
+
+    // Плоскость 0 - R8 во весь кадр, плоскость 1 - R8G8 вдвое меньше.
+    if (target && !p.dstY) {
+        D3D11_UNORDERED_ACCESS_VIEW_DESC1 ud = {};
+        ud.ViewDimension = D3D11_UAV_DIMENSION_TEXTURE2D;
+        ud.Format = DXGI_FORMAT_R8_UNORM;
+        ud.Texture2D.PlaneSlice = 0;
+        if (FAILED(m_dev3->CreateUnorderedAccessView1(tex, &ud, p.dstY.GetAddressOf())))
+            return nullptr;
+        ud.Format = DXGI_FORMAT_R8G8_UNORM;
+        ud.Texture2D.PlaneSlice = 1;
+        if (FAILED(m_dev3->CreateUnorderedAccessView1(tex, &ud, p.dstUV.GetAddressOf()))) {
+            p.dstY.Reset();
+            return nullptr;
+        }
+    }
+    if (!target && !p.srcY) {
+        D3D11_SHADER_RESOURCE_VIEW_DESC1 sd = {};
+        sd.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+        sd.Texture2D.MipLevels = 1;
+        sd.Format = DXGI_FORMAT_R8_UNORM;
+        sd.Texture2D.PlaneSlice = 0;
+        if (FAILED(m_dev3->CreateShaderResourceView1(tex, &sd, p.srcY.GetAddressOf())))
+            return nullptr;
+        sd.Format = DXGI_FORMAT_R8G8_UNORM;
+        sd.Texture2D.PlaneSlice = 1;
+        if (FAILED(m_dev3->CreateShaderResourceView1(tex, &sd, p.srcUV.GetAddressOf()))) {
+            p.srcY.Reset();
+            return nullptr;
+        }
+    }
+    return &p;
+}
+
+ID3D11Texture2D* FrameScaler::Scale(ID3D11Texture2D* src, uint32_t w, uint32_t h, ScaleFilter filter)
+{
+    if (!m_rgba.cs || !src || !w || !h)
+        return nullptr;
+
+    D3D11_TEXTURE2D_DESC desc = {};
+    src->GetDesc(&desc);
+
+    ID3D11ShaderResourceView* srv = SourceView(src);
+    if (!srv || !EnsureTarget(w, h) || !UpdateTaps(m_rgba, desc.Width, desc.Height, w, h, filter)) {
+        Log("Scale pass: cannot prepare views for the frame");
+        return nullptr;
+    }
+
+    Run(m_rgba, srv, m_outView.Get());
+    return m_out.Get();
+}
+
+bool FrameScaler::ScaleNv12(ID3D11Texture2D* src, ID3D11Texture2D* dst, ScaleFilter filter)
+{
+    if (!m_luma.cs || !m_dev3 || !src || !dst)
+        return false;
+
+    D3D11_TEXTURE2D_DESC sd = {};
+    D3D11_TEXTURE2D_DESC dd = {};
+    src->GetDesc(&sd);
+    dst->GetDesc(&dd);
+    if (sd.Format != DXGI_FORMAT_NV12 || dd.Format != DXGI_FORMAT_NV12) {
+        Log("Scale pass: NV12 source/target expected");
+        return false;
+    }
+
+    // Источник и приёмник - разные текстуры: у одной в кэше только SRV,
+    // у другой только UAV.
+    Planes* in = PlaneViews(src, false);
+    Planes* out = in ? PlaneViews(dst, true) : nullptr;
+    if (!in || !out ||
+        !UpdateTaps(m_luma, sd.Width, sd.Height, dd.Width, dd.Height, filter) ||
+        !UpdateTaps(m_chroma, sd.Width / 2, sd.Height / 2, dd.Width / 2, dd.Height / 2, filter))
+    {
+        Log("Scale pass: cannot prepare NV12 plane views");
+        return false;
+    }
+
+    Run(m_luma, in->srcY.Get(), out->dstY.Get());
+    Run(m_chroma, in->srcUV.Get(), out->dstUV.Get());
+    return true;
+}
+
+#else
+
+bool FrameScaler::Initialize()
+{
+    return true;
+}
+
+ID3D11Texture2D* FrameScaler::Scale(ID3D11Texture2D* src, uint32_t w, uint32_t h, ScaleFilter filter)
+{
+    if (!src || !w || !h)
+        return nullptr;
+
+    D3D11_TEXTURE2D_DESC desc = {};
+    src->GetDesc(&desc);
+
+    DXGI_FORMAT view;
+    if (!Nv12Converter::SourceViewFormat(desc.Format, view)) {
+        Log("Scale pass: unsupported source format");
+        return nullptr;
+    }
+    if (!EnsureTarget(w, h))
+        return nullptr;
+
+    FakeContextCall call(m_ctx);
+    ScaleRgba(src->Data(), src->RowPitch(), view == DXGI_FORMAT_B8G8R8A8_UNORM,
+              desc.Width, desc.Height, m_out->Data(), m_out->RowPitch(), w, h, filter);
+    return m_out.Get();
+}
+
+bool FrameScaler::ScaleNv12(ID3D11Texture2D* src, ID3D11Texture2D* dst, ScaleFilter filter)
+{
+    if (!src || !dst)
+        return false;
+
+    D3D11_TEXTURE2D_DESC sd = {};
+    D3D11_TEXTURE2D_DESC dd = {};
+    src->GetDesc(&sd);
+    dst->GetDesc(&dd);
+    if (sd.Format != DXGI_FORMAT_NV12 || dd.Format != DXGI_FORMAT_NV12) {
+        Log("Scale pass: NV12 source/target expected");
+        return false;
+    }
+
+    FakeContextCall call(m_ctx);
+    const uint8_t* y = src->Data();
+    uint8_t* dy = dst->Data();
+    ::ScaleNv12(y, y + (size_t)src->RowPitch() * sd.Height, src->RowPitch(), sd.Width, sd.Height,
+                dy, dy + (size_t)dst->RowPitch() * dd.Height, dst->RowPitch(), dd.Width, dd.Height,
+                filter);
+    return true;
+}
+
+#endif
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+
+#include "D3D11Compat.h"
+#include "Resize.h"
+
+// Масштабирование кадра под размер кодирования на GPU: рендер в 1080p,
+// стрим в 720p/540p без второй камеры в Unity. Результат - своя текстура
+// R8G8B8A8_UNORM нужного размера; дальше она идёт в энкодер как обычный
+// кадр (копия в слот или проход NV12).
+//
+// Ступени симулкаста берут уже готовый NV12 основного стрима: ScaleNv12
+// масштабирует плоскости яркости и UV прямо в NV12-слот, без второго
+// прохода RGB -> NV12.
+//
+// На Windows - compute shader, один проход на плоскость, веса из
+// BuildScaleTaps; вне Windows - CPU-эталоны ScaleRgba/ScaleNv12 над памятью
+// фейковых текстур.
+class FrameScaler
+{
+public:
+    FrameScaler(ID3D11Device* dev, ID3D11DeviceContext* ctx);
+    ~FrameScaler();
+
+    // Компилирует шейдер. false - прохода нет (причина в логе).
+    bool Initialize();
+
+    // Масштабирует src (RGBA/BGRA 8 бит UNORM или typeless) в w x h.
+    // Возвращает свою текстуру, действительную до следующего вызова;
+    // nullptr - ошибка (в логе). Вызывать с потока, владеющего ctx.
+    ID3D11Texture2D* Scale(ID3D11Texture2D* src, uint32_t w, uint32_t h, ScaleFilter filter);
+
+    // src и dst - NV12 по Nv12Converter::TargetDesc (стороны чётные), размер
+    // dst - размер кодирования. false - ошибка или нет прохода по плоскостям
+    // (в логе). Вызывать с потока, владеющего ctx.
+    bool ScaleNv12(ID3D11Texture2D* src, ID3D11Texture2D* dst, ScaleFilter filter);
+
+private:
+    bool EnsureTarget(uint32_t w, uint32_t h);
+
+    ID3D11Device*        m_dev;
+    ID3D11DeviceContext* m_ctx;
+
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> m_out;
+    uint32_t m_outW = 0;
+    uint32_t m_outH = 0;
+
+#ifdef _WIN32
+    // Шейдер одного вида точек (RGBA, яркость, пара UV) и его таблицы весов;
+    // таблицы пересобираются при смене размеров или фильтра.
+    struct Pass
+    {
+        Microsoft::WRL::ComPtr<ID3D11ComputeShader> cs;
+        Microsoft::WRL::ComPtr<ID3D11Buffer> params;
+        Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> tapsX;
+        Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> tapsY;
+        uint32_t srcW = 0;
+        uint32_t srcH = 0;
+        uint32_t dstW = 0;
+        uint32_t dstH = 0;
+        ScaleFilter filter = ScaleFilter::Bilinear;
+    };
+
+    // Представления плоскостей NV12: SRV у источника, UAV у приёмника.
+    struct Planes
+    {
+        Microsoft::WRL::ComPtr<ID3D11ShaderResourceView1> srcY;
+        Microsoft::WRL::ComPtr<ID3D11ShaderResourceView1> srcUV;
+        Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView1> dstY;
+        Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView1> dstUV;
+    };
+
+    bool CreatePass(Pass& pass, const char* pixel, const char* ipixel, const char* channels);
+    bool UpdateTaps(Pass& pass, uint32_t sw, uint32_t sh, uint32_t w, uint32_t h, ScaleFilter filter);
+    void Run(Pass& pass, ID3D11ShaderResourceView* src, ID3D11UnorderedAccessView* dst);
+    ID3D11ShaderResourceView* SourceView(ID3D11Texture2D* src);
+    Planes* PlaneViews(ID3D11Texture2D* tex, bool target);
+
+    Pass m_rgba;
+    Pass m_luma;
+    Pass m_chroma;
+    Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> m_outView;
+    Microsoft::WRL::ComPtr<ID3D11Device3> m_dev3;
+
+    // Как в Nv12Converter: источников немного, кэш сбрасывается целиком.
+    // Плоскости NV12 - слоты колец FrameCaptureRing, их тоже немного.
+    static const size_t kMaxSources = 8;
+    std::unordered_map<ID3D11Texture2D*, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> m_sources;
+    std::unordered_map<ID3D11Texture2D*, Planes> m_planes;
+#endif
+};
@@ -0,0 +1,76 @@
+#include "GopCache.h"
+
+GopCache::GopCache(size_t maxBytes)
+    : m_maxBytes(maxBytes)
+{
+}
+
+void GopCache::Push(const NvEncPacket& pkt)
+{
+    std::lock_guard<std::mutex> lk(m_mx);
+
+    if (pkt.keyframe) {
+        // Вектор не освобождаем: его ёмкость - примерно длина GOP.
+        ClearLocked();
+        m_waitIdr = false;
+    }
+    else if (m_waitIdr) {
+        return;
+    }
+
+    size_t bytes = m_bytes.load(std::memory_order_relaxed) + pkt.data.size();
+    if (bytes > m_maxBytes) {
+        ClearLocked();
+        m_waitIdr = true;
+        m_overflows.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    m_frames.push_back(pkt);
+    m_bytes.store(bytes, std::memory_order_relaxed);
+    m_count.store((uint32_t)m_frames.size(), std::memory_order_relaxed);
+}
+
+void GopCache::Clear()
+{
+    std::lock_guard<std::mutex> lk(m_mx);
+    ClearLocked();
+    m_waitIdr = true;
+}
+
+void GopCache::ClearLocked()
+{
+    // Последние ссылки возвращают блоки в пул энкодера.
+    m_frames.clear();
+    m_bytes.store(0, std::memory_order_relaxed);
+    m_count.store(0, std::memory_order_relaxed);
+}
+
+void GopCache::Snapshot(std::vector<NvEncPacket>& out) const
+{
+    std::lock_guard<std::mutex> lk(m_mx);
+    out = m_frames;
+}
+
+void PacketizeGopBurst(RtpPacketizer& pk, const std::vector<NvEncPacket>& gop,
+                       const std::vector<uint32_t>& rtpTs, RtpPacketBatch& out,
+                       std::vector<NvEncPacketRef>& frames)
+{
+    out.Clear();
+    frames.clear();
+    if (gop.empty())
+        return;
+
+    const uint16_t liveSeq = pk.NextSeq();
+    size_t n = 0;
+    for (const NvEncPacket& p : gop)
+        n += pk.CountPackets(p.data.data(), p.data.nals());
+
+    pk.SetNextSeq((uint16_t)(liveSeq - n));
+    for (size_t i = 0; i < gop.size(); ++i) {
+        pk.Append(gop[i].data.data(), gop[i].data.nals(), rtpTs[i], out);
+        frames.push_back(gop[i].data);
+    }
+    out.keyframe = true;
+    pk.SetNextSeq(liveSeq);
+}
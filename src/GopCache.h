@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "NvencEncoder.h"
+#include "RtpPacketizer.h"
+
+// Последний GOP стрима: кадры от самого свежего IDR до текущего. Кадры
+// держатся по ссылке на блоки пула NVENC, без копий. Новый подписчик
+// (клиент встроенного сервера, новое push-соединение) сначала получает их
+// и может начать декодирование сразу, а не ждать следующего IDR.
+//
+// Кэш ограничен по байтам: если GOP в него не влез, кэш пуст до следующего
+// IDR (неполный GOP без начала бесполезен).
+class GopCache
+{
+public:
+    explicit GopCache(size_t maxBytes);
+
+    // Поток стрима, каждый закодированный кадр по порядку.
+    void Push(const NvEncPacket& pkt);
+    void Clear();
+
+    // Копия ссылок на кадры кэша (первый - IDR); out очищается.
+    void Snapshot(std::vector<NvEncPacket>& out) const;
+
+    // Для статистики, с любого потока.
+    size_t Bytes() const { return m_bytes.load(std::memory_order_relaxed); }
+    uint32_t Frames() const { return m_count.load(std::memory_order_relaxed); }
+    uint64_t Overflows() const { return m_overflows.load(std::memory_order_relaxed); }
+
+private:
+    void ClearLocked();
+
+    const size_t m_maxBytes;
+
+    mutable std::mutex m_mx;
+    std::vector<NvEncPacket> m_frames;
+    bool m_waitIdr = true;
+
+    std::atomic<size_t> m_bytes{0};
+    std::atomic<uint32_t> m_count{0};
+    std::atomic<uint64_t> m_overflows{0};
+};
+
+// Кадры gop (снимок кэша, первый - IDR) одним batch для клиентов, только что
+// начавших PLAY (RtspServer::SendToJoiners). Пакеты нумеруются так, что
+// последний идёт прямо перед следующим живым пакетом pk: клиент видит
+// непрерывную последовательность от IDR. NextSeq у pk не меняется.
+// rtpTs - RTP-время каждого кадра gop; в frames - их блоки для SendToJoiners.
+void PacketizeGopBurst(RtpPacketizer& pk, const std::vector<NvEncPacket>& gop,
+                       const std::vector<uint32_t>& rtpTs, RtpPacketBatch& out,
+                       std::vector<NvEncPacketRef>& frames);
@@ -0,0 +1,276 @@
+#include "NetSocket.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+bool NetInit()
+{
+#ifdef _WIN32
+    static std::once_flag once;
+    static bool ok = false;
+    std::call_once(once, [] {
+        WSADATA wsa;
+        ok = WSAStartup(MAKEWORD(2, 2), &wsa) == 0;
+    });
+    return ok;
+#else
+    return true;
+#endif
+}
+
+void NetClose(net_socket_t s)
+{
+    if (s == NET_INVALID_SOCKET)
+        return;
+#ifdef _WIN32
+    closesocket(s);
+#else
+    close(s);
+#endif
+}
+
+bool NetSetNonBlocking(net_socket_t s, bool nonBlocking)
+{
+#ifdef _WIN32
+    u_long mode = nonBlocking ? 1 : 0;
+    return ioctlsocket(s, FIONBIO, &mode) == 0;
+#else
+    int flags = fcntl(s, F_GETFL, 0);
+    if (flags < 0)
+        return false;
+    flags = nonBlocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    return fcntl(s, F_SETFL, flags) == 0;
+#endif
+}
+
+bool NetWouldBlock()
+{
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EWOULDBLOCK || errno == EAGAIN;
+#endif
+}
+
+#ifdef _WIN32
+
+static DWORD FillBufs(WSABUF* out, const NetBuf* bufs, size_t count)
+{
+    if (count > kNetMaxBufs)
+        count = kNetMaxBufs;
+    for (size_t i = 0; i < count; ++i) {
+        out[i].buf = (CHAR*)bufs[i].data;
+        out[i].len = (ULONG)bufs[i].size;
+    }
+    return (DWORD)count;
+}
+
+int64_t NetSendv(net_socket_t s, const NetBuf* bufs, size_t count)
+{
+    WSABUF wb[kNetMaxBufs];
+    DWORD n = FillBufs(wb, bufs, count);
+    DWORD sent = 0;
+    if (WSASend(s, wb, n, &sent, 0, nullptr, nullptr) != 0)
+        return -1;
+    return (int64_t)sent;
+}
+
+int64_t NetSendvTo(net_socket_t s, const NetBuf* bufs, size_t count, const sockaddr_in& to)
+{
+    WSABUF wb[kNetMaxBufs];
+    DWORD n = FillBufs(wb, bufs, count);
+    DWORD sent = 0;
+    if (WSASendTo(s, wb, n, &sent, 0, (const sockaddr*)&to, sizeof(to), nullptr, nullptr) != 0)
+        return -1;
+    return (int64_t)sent;
+}
+
+#else
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+static int64_t SendMsg(net_socket_t s, const NetBuf* bufs, size_t count, const sockaddr_in* to)
+{
+    iovec iov[kNetMaxBufs];
+    if (count > kNetMaxBufs)
+        count = kNetMaxBufs;
+    for (size_t i = 0; i < count; ++i) {
+        iov[i].iov_base = const_cast<void*>(bufs[i].data);
+        iov[i].iov_len = bufs[i].size;
+    }
+
+    msghdr msg = {};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+    if (to) {
+        msg.msg_name = const_cast<sockaddr_in*>(to);
+        msg.msg_namelen = sizeof(*to);
+    }
+    ssize_t n = sendmsg(s, &msg, MSG_NOSIGNAL);
+    return n < 0 ? -1 : (int64_t)n;
+}
+
+int64_t NetSendv(net_socket_t s, const NetBuf* bufs, size_t count)
+{
+    return SendMsg(s, bufs, count, nullptr);
+}
+
+int64_t NetSendvTo(net_socket_t s, const NetBuf* bufs, size_t count, const sockaddr_in& to)
+{
+    return SendMsg(s, bufs, count, &to);
+}
+
+#endif
+
+net_socket_t NetListenTcp(const std::string& addr, uint16_t port)
+{
+    net_socket_t s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == NET_INVALID_SOCKET)
+        return NET_INVALID_SOCKET;
+
+    int yes = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&yes, sizeof(yes));
+
+    sockaddr_in sa = {};
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+    if (addr.empty() || inet_pton(AF_INET, addr.c_str(), &sa.sin_addr) != 1)
+        sa.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (bind(s, (const sockaddr*)&sa, sizeof(sa)) != 0 || listen(s, 16) != 0) {
+        NetClose(s);
+        return NET_INVALID_SOCKET;
+    }
+    return s;
+}
+
+net_socket_t NetBindUdp(uint16_t port)
+{
+    net_socket_t s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s == NET_INVALID_SOCKET)
+        return NET_INVALID_SOCKET;
+
+    sockaddr_in sa = {};
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+    sa.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(s, (const sockaddr*)&sa, sizeof(sa)) != 0) {
+        NetClose(s);
+        return NET_INVALID_SOCKET;
+    }
+    return s;
+}
+
+net_socket_t NetMulticastSender(const std::string& iface, int ttl)
+{
+    net_socket_t s = NetBindUdp(0);
+    if (s == NET_INVALID_SOCKET)
+        return NET_INVALID_SOCKET;
+
+#ifdef _WIN32
+    DWORD ttlOpt = (DWORD)ttl;
+    DWORD loop = 1;
+#else
+    unsigned char ttlOpt = (unsigned char)ttl;
+    unsigned char loop = 1;
+#endif
+    bool ok = setsockopt(s, IPPROTO_IP, IP_MULTICAST_TTL, (const char*)&ttlOpt, sizeof(ttlOpt)) == 0 &&
+              setsockopt(s, IPPROTO_IP, IP_MULTICAST_LOOP, (const char*)&loop, sizeof(loop)) == 0;
+
+    if (ok && !iface.empty()) {
+        in_addr addr = {};
+        ok = inet_pton(AF_INET, iface.c_str(), &addr) == 1 &&
+             setsockopt(s, IPPROTO_IP, IP_MULTICAST_IF, (const char*)&addr, sizeof(addr)) == 0;
+    }
+    if (!ok) {
+        NetClose(s);
+        return NET_INVALID_SOCKET;
+    }
+    return s;
+}
+
+net_socket_t NetMulticastReceiver(const std::string& group, uint16_t port, const std::string& iface)
+{
+    ip_mreq mreq = {};
+    if (inet_pton(AF_INET, group.c_str(), &mreq.imr_multiaddr) != 1)
+        return NET_INVALID_SOCKET;
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (!iface.empty() && inet_pton(AF_INET, iface.c_str(), &mreq.imr_interface) != 1)
+        return NET_INVALID_SOCKET;
+
+    net_socket_t s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s == NET_INVALID_SOCKET)
+        return NET_INVALID_SOCKET;
+
+    // Windows не привязывает сокет к адресу группы - слушаем все адреса порта.
+    int yes = 1;
+    sockaddr_in sa = {};
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+    sa.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&yes, sizeof(yes)) != 0 ||
+        bind(s, (const sockaddr*)&sa, sizeof(sa)) != 0 ||
+        setsockopt(s, IPPROTO_IP, IP_ADD_MEMBERSHIP, (const char*)&mreq, sizeof(mreq)) != 0) {
+        NetClose(s);
+        return NET_INVALID_SOCKET;
+    }
+    return s;
+}
+
+bool NetParseIpv4(const std::string& addr, uint16_t port, sockaddr_in& out)
+{
+    out = sockaddr_in();
+    out.sin_family = AF_INET;
+    out.sin_port = htons(port);
+    return inet_pton(AF_INET, addr.c_str(), &out.sin_addr) == 1;
+}
+
+bool NetIsMulticast(const sockaddr_in& addr)
+{
+    return (ntohl(addr.sin_addr.s_addr) & 0xF0000000u) == 0xE0000000u;
+}
+
+uint16_t NetLocalPort(net_socket_t s)
+{
+    sockaddr_in sa = {};
+    socklen_t len = sizeof(sa);
+    if (getsockname(s, (sockaddr*)&sa, &len) != 0)
+        return 0;
+    return ntohs(sa.sin_port);
+}
+
+bool NetParseRtspUrl(const std::string& url, std::string& host, uint16_t& port, std::string& path)
+{
+    static const char kScheme[] = "rtsp://";
+    if (url.compare(0, sizeof(kScheme) - 1, kScheme) != 0)
+        return false;
+
+    size_t hostStart = sizeof(kScheme) - 1;
+    size_t pathStart = url.find('/', hostStart);
+    std::string hostPort = url.substr(hostStart, pathStart == std::string::npos
+                                                     ? std::string::npos
+                                                     : pathStart - hostStart);
+    path = pathStart == std::string::npos ? "/" : url.substr(pathStart);
+
+    // user:pass@host - учётные данные здесь не нужны.
+    size_t at = hostPort.rfind('@');
+    if (at != std::string::npos)
+        hostPort = hostPort.substr(at + 1);
+
+    port = 554;
+    size_t colon = hostPort.rfind(':');
+    if (colon != std::string::npos) {
+        int p = std::atoi(hostPort.c_str() + colon + 1);
+        if (p <= 0 || p > 65535)
+            return false;
+        port = (uint16_t)p;
+        host = hostPort.substr(0, colon);
+    }
+    else {
+        host = hostPort;
+    }
+    return !host.empty();
+}
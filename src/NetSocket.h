@@ -0,0 +1,83 @@
+#pragma once
+
+// Минимальная обёртка над сокетами: Winsock на Windows, BSD-сокеты иначе.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#ifdef _WIN32
+  #ifndef WIN32_LEAN_AND_MEAN
+    #define WIN32_LEAN_AND_MEAN
+  #endif
+  #include <winsock2.h>
+  #include <ws2tcpip.h>
+  typedef SOCKET net_socket_t;
+  #define NET_INVALID_SOCKET INVALID_SOCKET
+#else
+  #include <arpa/inet.h>
+  #include <fcntl.h>
+  #include <netinet/in.h>
+  #include <netinet/tcp.h>
+  #include <sys/select.h>
+  #include <sys/socket.h>
+  #include <sys/types.h>
+  #include <sys/uio.h>
+  #include <unistd.h>
+  #include <cerrno>
+  typedef int net_socket_t;
+  #define NET_INVALID_SOCKET (-1)
+#endif
+
+// Инициализация сетевого стека (WSAStartup); можно вызывать много раз.
+bool NetInit();
+
+void NetClose(net_socket_t s);
+bool NetSetNonBlocking(net_socket_t s, bool nonBlocking);
+
+// Последняя ошибка - "операция заблокировалась бы" (EWOULDBLOCK/EAGAIN).
+bool NetWouldBlock();
+
+// Кусок данных для отправки одним системным вызовом (scatter/gather).
+struct NetBuf
+{
+    const void* data;
+    size_t size;
+};
+
+// Не больше стольких кусков за один NetSendv / NetSendvTo.
+static const size_t kNetMaxBufs = 64;
+
+// Куски подряд одним sendmsg / WSASend; на POSIX без SIGPIPE. Возвращает
+// число отправленных байт или -1 (причина - NetWouldBlock и errno/WSAGetLastError).
+int64_t NetSendv(net_socket_t s, const NetBuf* bufs, size_t count);
+
+// Одна датаграмма из кусков (sendmsg / WSASendTo).
+int64_t NetSendvTo(net_socket_t s, const NetBuf* bufs, size_t count, const sockaddr_in& to);
+
+// TCP-сокет, слушающий addr:port (addr пустой или "0.0.0.0" - все интерфейсы).
+net_socket_t NetListenTcp(const std::string& addr, uint16_t port);
+
+// UDP-сокет, привязанный к порту (0 - любой свободный).
+net_socket_t NetBindUdp(uint16_t port);
+
+// UDP-сокет для отправки в multicast-группу: TTL 1..255, iface - IPv4-адрес
+// исходящего интерфейса (пустой - по таблице маршрутов). Петля на свой хост
+// включена: приёмник на той же машине тоже получает поток.
+net_socket_t NetMulticastSender(const std::string& iface, int ttl);
+
+// UDP-сокет, принимающий группу group:port на интерфейсе iface (пустой -
+// по выбору системы). SO_REUSEADDR: на том же порту могут слушать и другие
+// приёмники группы на этой машине.
+net_socket_t NetMulticastReceiver(const std::string& group, uint16_t port, const std::string& iface);
+
+// IPv4-адрес (точечная запись) и порт в sockaddr_in.
+bool NetParseIpv4(const std::string& addr, uint16_t port, sockaddr_in& out);
+// Адрес из 224.0.0.0/4.
+bool NetIsMulticast(const sockaddr_in& addr);
+
+// Локальный порт привязанного сокета, 0 при ошибке.
+uint16_t NetLocalPort(net_socket_t s);
+
+// Разбирает rtsp://host:port/path. Порт по умолчанию - 554.
+bool NetParseRtspUrl(const std::string& url, std::string& host, uint16_t& port, std::string& path);
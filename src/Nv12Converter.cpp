@@ -0,0 +1,316 @@
+#include "Nv12Converter.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <d3dcompiler.h>
+#endif
+
+// Объявление логгера из NvencRtspPlugin.cpp
+void Log(const char* msg);
+
+#ifdef _WIN32
+
+namespace {
+
+// Поток на блок 2x2: четыре значения Y и одна пара UV. Коэффициенты и
+// округление - те же, что в ConvertRgbaToNv12 (ColorConvert.cpp).
+const char kShaderSource[] = R"(
+Texture2D<float4>         Src   : register(t0);
+RWTexture2D<unorm float>  DstY  : register(u0);
+RWTexture2D<unorm float2> DstUV : register(u1);
+
+cbuffer Params : register(b0)
+{
+    int4  CoefY;   // r, g, b, смещение
+    int4  CoefU;
+    int4  CoefV;
+    uint4 Size;    // xy - размер кадра
+};
+
+int3 LoadRgb(uint2 p)
+{
+    return int3(round(Src.Load(int3(p, 0)).rgb * 255.0));
+}
+
+int Apply(int4 c, int3 rgb)
+{
+    return clamp(((c.x * rgb.r + c.y * rgb.g + c.z * rgb.b + 128) >> 8) + c.w, 0, 255);
+}
+
+[numthreads(8, 8, 1)]
+void main(uint3 id : SV_DispatchThreadID)
+{
+    uint2 p = id.xy * 2;
+    if (p.x >= Size.x || p.y >= Size.y)
+        return;
+
+    int3 c00 = LoadRgb(p);
+    int3 c10 = LoadRgb(p + uint2(1, 0));
+    int3 c01 = LoadRgb(p + uint2(0, 1));
+    int3 c11 = LoadRgb(p + uint2(1, 1));
+
+    DstY[p]               = Apply(CoefY, c00) / 255.0;
+    DstY[p + uint2(1, 0)] = Apply(CoefY, c10) / 255.0;
+    DstY[p + uint2(0, 1)] = Apply(CoefY, c01) / 255.0;
+    DstY[p + uint2(1, 1)] = Apply(CoefY, c11) / 255.0;
+
+    int3 avg = (c00 + c10 + c01 + c11 + 2) >> 2;
+    DstUV[id.xy] = float2(Apply(CoefU, avg), Apply(CoefV, avg)) / 255.0;
+}
+)";
+
+struct ShaderParams
+{
+    int32_t coefY[4];
+    int32_t coefU[4];
+    int32_t coefV[4];
+    uint32_t size[4];
+};
+
+static const UINT kGroupPixels = 16;   // numthreads(8, 8) по блокам 2x2
+
+} // namespace
+
+#endif
+
+Nv12Converter::Nv12Converter(ID3D11Device* dev, ID3D11DeviceContext* ctx)
+    : m_dev(dev)
+    , m_ctx(ctx)
+{
+}
+
+Nv12Converter::~Nv12Converter() = default;
+
+// Источник читается как сырые 8-битные значения: sRGB-представление
+// линеаризовало бы цвет, а NVENC без прохода берёт байты как есть.
+bool Nv12Converter::SourceViewFormat(DXGI_FORMAT in, DXGI_FORMAT& view)
+{
+    switch (in) {
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+    case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+        view = DXGI_FORMAT_R8G8B8A8_UNORM;
+        return true;
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+    case DXGI_FORMAT_B8G8R8A8_TYPELESS:
+        view = DXGI_FORMAT_B8G8R8A8_UNORM;
+        return true;
+    default:
+        return false;
+    }
+}
+
+D3D11_TEXTURE2D_DESC Nv12Converter::TargetDesc(uint32_t w, uint32_t h)
+{
+    D3D11_TEXTURE2D_DESC desc = {};
+    desc.Width = w;
+    desc.Height = h;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = DXGI_FORMAT_NV12;
+    desc.SampleDesc.Count = 1;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    // SRV - для FrameScaler::ScaleNv12: ступени симулкаста читают готовый
+    // NV12 основного стрима.
+    desc.BindFlags = D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_SHADER_RESOURCE;
+    return desc;
+}
+
+#ifdef _WIN32
+
+bool Nv12Converter::Initialize()
+{
+    if (FAILED(m_dev->QueryInterface(IID_PPV_ARGS(m_dev3.GetAddressOf())))) {
+        Log("NV12 pass: ID3D11Device3 is not available (needs Windows 10)");
+        return false;
+    }
+
+    D3D11_FEATURE_DATA_FORMAT_SUPPORT2 fs = {};
+    fs.InFormat = DXGI_FORMAT_NV12;
+    if (FAILED(m_dev->CheckFeatureSupport(D3D11_FEATURE_FORMAT_SUPPORT2, &fs, sizeof(fs))) ||
+        !(fs.OutFormatSupport2 & D3D11_FORMAT_SUPPORT2_UAV_TYPED_STORE))
+    {
+        Log("NV12 pass: GPU has no typed UAV stores to NV12");
+        return false;
+    }
+
+    Microsoft::WRL::ComPtr<ID3DBlob> code;
+    Microsoft::WRL::ComPtr<ID3DBlob> errors;
+    HRESULT hr = D3DCompile(kShaderSource, sizeof(kShaderSource) - 1, "Nv12Converter",
+                            nullptr, nullptr, "main", "cs_5_0",
+                            D3DCOMPILE_OPTIMIZATION_LEVEL3, 0,
+                            code.GetAddressOf(), errors.GetAddressOf());
+    if (FAILED(hr)) {
+        Log(errors ? (const char*)errors->GetBufferPointer() : "NV12 pass: D3DCompile failed");
+        return false;
+    }
+
+    hr = m_dev->CreateComputeShader(code->GetBufferPointer(), code->GetBufferSize(),
+                                    nullptr, m_cs.GetAddressOf());
+    if (FAILED(hr)) {
+        Log("NV12 pass: CreateComputeShader failed");
+        return false;
+    }
+
+    D3D11_BUFFER_DESC bd = {};
+    bd.ByteWidth = sizeof(ShaderParams);
+    bd.Usage = D3D11_USAGE_DEFAULT;
+    bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    if (FAILED(m_dev->CreateBuffer(&bd, nullptr, m_params.GetAddressOf()))) {
+        Log("NV12 pass: CreateBuffer (constants) failed");
+        return false;
+    }
+    return true;
+}
+
+void Nv12Converter::UpdateParams(uint32_t w, uint32_t h, Nv12Range range)
+{
+    if (w == m_paramW && h == m_paramH && range == m_paramRange)
+        return;
+
+    const YuvCoeffs& c = Bt709Coeffs(range);
+    ShaderParams p = {};
+    memcpy(p.coefY, c.y, sizeof(p.coefY));
+    memcpy(p.coefU, c.u, sizeof(p.coefU));
+    memcpy(p.coefV, c.v, sizeof(p.coefV));
+    p.size[0] = w;
+    p.size[1] = h;
+    m_ctx->UpdateSubresource(m_params.Get(), 0, nullptr, &p, 0, 0);
+
+    m_paramW = w;
+    m_paramH = h;
+    m_paramRange = range;
+}
+
+ID3D11ShaderResourceView* Nv12Converter::SourceView(ID3D11Texture2D* src)
+{
+    auto it = m_sources.find(src);
+    if (it != m_sources.end())
+        return it->second.Get();
+
+    D3D11_TEXTURE2D_DESC desc = {};
+    src->GetDesc(&desc);
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC sd = {};
+    if (!SourceViewFormat(desc.Format, sd.Format))
+        return nullptr;
+    sd.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+    sd.Texture2D.MipLevels = 1;
+
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+    if (FAILED(m_dev->CreateShaderResourceView(src, &sd, srv.GetAddressOf()))) {
+        Log("NV12 pass: CreateShaderResourceView failed (no BIND_SHADER_RESOURCE?)");
+        return nullptr;
+    }
+
+    if (m_sources.size() >= kMaxSources)
+        m_sources.clear();
+    return (m_sources[src] = srv).Get();
+}
+
+Nv12Converter::Target* Nv12Converter::TargetViews(ID3D11Texture2D* dst)
+{
+    auto it = m_targets.find(dst);
+    if (it != m_targets.end())
+        return &it->second;
+
+    Target t;
+    D3D11_UNORDERED_ACCESS_VIEW_DESC1 ud = {};
+    ud.ViewDimension = D3D11_UAV_DIMENSION_TEXTURE2D;
+    ud.Texture2D.MipSlice = 0;
+
+    ud.Format = DXGI_FORMAT_R8_UNORM;
+    ud.Texture2D.PlaneSlice = 0;
+    if (FAILED(m_dev3->CreateUnorderedAccessView1(dst, &ud, t.y.GetAddressOf())))
+        return nullptr;
+
+    ud.Format = DXGI_FORMAT_R8G8_UNORM;
+    ud.Texture2D.PlaneSlice = 1;
+    if (FAILED(m_dev3->CreateUnorderedAccessView1(dst, &ud, t.uv.GetAddressOf())))
+        return nullptr;
+
+    return &(m_targets[dst] = t);
+}
+
+bool Nv12Converter::Convert(ID3D11Texture2D* src, ID3D11Texture2D* dst, Nv12Range range)
+{
+    if (!m_cs || !src || !dst)
+        return false;
+
+    D3D11_TEXTURE2D_DESC desc = {};
+    dst->GetDesc(&desc);
+
+    ID3D11ShaderResourceView* srv = SourceView(src);
+    Target* t = TargetViews(dst);
+    if (!srv || !t) {
+        Log("NV12 pass: cannot create views for the frame");
+        return false;
+    }
+    UpdateParams(desc.Width, desc.Height, range);
+
+    ID3D11UnorderedAccessView* uavs[2] = { t->y.Get(), t->uv.Get() };
+    ID3D11Buffer* cb = m_params.Get();
+
+    m_ctx->CSSetShader(m_cs.Get(), nullptr, 0);
+    m_ctx->CSSetShaderResources(0, 1, &srv);
+    m_ctx->CSSetUnorderedAccessViews(0, 2, uavs, nullptr);
+    m_ctx->CSSetConstantBuffers(0, 1, &cb);
+    m_ctx->Dispatch((desc.Width + kGroupPixels - 1) / kGroupPixels,
+                    (desc.Height + kGroupPixels - 1) / kGroupPixels, 1);
+
+    // Отвязываем всё: источник - RenderTexture Unity, приёмник читает NVENC.
+    ID3D11ShaderResourceView* nullSrv = nullptr;
+    ID3D11UnorderedAccessView* nullUavs[2] = {};
+    ID3D11Buffer* nullCb = nullptr;
+    m_ctx->CSSetShaderResources(0, 1, &nullSrv);
+    m_ctx->CSSetUnorderedAccessViews(0, 2, nullUavs, nullptr);
+    m_ctx->CSSetConstantBuffers(0, 1, &nullCb);
+    m_ctx->CSSetShader(nullptr, nullptr, 0);
+    return true;
+}
+
+void Nv12Converter::Forget(ID3D11Texture2D* dst)
+{
+    m_targets.erase(dst);
+}
+
+#else
+
+bool Nv12Converter::Initialize()
+{
+    return true;
+}
+
+bool Nv12Converter::Convert(ID3D11Texture2D* src, ID3D11Texture2D* dst, Nv12Range range)
+{
+    if (!src || !dst)
+        return false;
+
+    D3D11_TEXTURE2D_DESC sd = {};
+    D3D11_TEXTURE2D_DESC dd = {};
+    src->GetDesc(&sd);
+    dst->GetDesc(&dd);
+
+    DXGI_FORMAT view;
+    if (!SourceViewFormat(sd.Format, view) || dd.Format != DXGI_FORMAT_NV12 ||
+        sd.Width != dd.Width || sd.Height != dd.Height)
+    {
+        Log("NV12 pass: source/target mismatch");
+        return false;
+    }
+
+    // Проход шейдера идёт через immediate context - и его блокировку.
+    FakeContextCall call(m_ctx);
+    uint8_t* y = dst->Data();
+    uint8_t* uv = y + (size_t)dst->RowPitch() * dd.Height;
+    const bool bgra = view == DXGI_FORMAT_B8G8R8A8_UNORM;
+    ConvertRgbaToNv12(src->Data(), src->RowPitch(), bgra, dd.Width, dd.Height,
+                      y, dst->RowPitch(), uv, dst->RowPitch(), range);
+    return true;
+}
+
+void Nv12Converter::Forget(ID3D11Texture2D*)
+{
+}
+
+#endif
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+
+#include "D3D11Compat.h"
+#include "ColorConvert.h"
+
+// Проход RGB -> NV12 (BT.709) на GPU перед NVENC. Кадр RenderTexture
+// читается шейдером напрямую (без CopyResource) и пишется сразу в NV12-слот
+// энкодера: NVENC регистрирует и читает 1.5 байта на пиксель вместо 4 и не
+// делает собственного преобразования цвета.
+//
+// На Windows - compute shader с UAV на плоскости NV12 (нужен D3D11.3);
+// вне Windows - CPU-эталон ConvertRgbaToNv12 над памятью фейковых текстур.
+class Nv12Converter
+{
+public:
+    Nv12Converter(ID3D11Device* dev, ID3D11DeviceContext* ctx);
+    ~Nv12Converter();
+
+    // Компилирует шейдер и проверяет поддержку. false - прохода на этом
+    // GPU/ОС нет (причина в логе), кадры идут в NVENC как RGB.
+    bool Initialize();
+
+    // Описание NV12-текстуры приёмника (w, h чётные).
+    static D3D11_TEXTURE2D_DESC TargetDesc(uint32_t w, uint32_t h);
+
+    // src - RGBA/BGRA 8 бит UNORM или typeless, того же размера, что dst;
+    // dst создан по TargetDesc. Вызывать с потока, владеющего ctx.
+    bool Convert(ID3D11Texture2D* src, ID3D11Texture2D* dst, Nv12Range range);
+
+    // dst пересоздаётся или больше не нужен: отпустить его представления.
+    void Forget(ID3D11Texture2D* dst);
+
+    // Формат SRV, которым шейдеры (и этот проход, и FrameScaler) читают
+    // кадр: 8-битные RGBA/BGRA UNORM и typeless; sRGB - нет.
+    static bool SourceViewFormat(DXGI_FORMAT in, DXGI_FORMAT& view);
+
+private:
+    ID3D11Device*        m_dev;
+    ID3D11DeviceContext* m_ctx;
+
+#ifdef _WIN32
+    struct Target
+    {
+        Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView1> y;
+        Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView1> uv;
+    };
+
+    void UpdateParams(uint32_t w, uint32_t h, Nv12Range range);
+    ID3D11ShaderResourceView* SourceView(ID3D11Texture2D* src);
+    Target* TargetViews(ID3D11Texture2D* dst);
+
+    Microsoft::WRL::ComPtr<ID3D11Device3> m_dev3;
+    Microsoft::WRL::ComPtr<ID3D11ComputeShader> m_cs;
+    Microsoft::WRL::ComPtr<ID3D11Buffer> m_params;
+
+    // Представления держат ссылку на текстуру, поэтому указатель в ключе не
+    // может достаться новой текстуре, пока запись жива. Источников немного
+    // (RenderTexture или слоты FrameCaptureRing); кэш сбрасывается целиком,
+    // если их стало больше kMaxSources.
+    static const size_t kMaxSources = 8;
+    std::unordered_map<ID3D11Texture2D*, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> m_sources;
+    std::unordered_map<ID3D11Texture2D*, Target> m_targets;
+
+    uint32_t m_paramW = 0;
+    uint32_t m_paramH = 0;
+    Nv12Range m_paramRange = Nv12Range::Limited;
+#endif
+};
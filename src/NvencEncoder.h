@@ -1,24 +1,53 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 #include <memory>
 #include <unordered_map>
 #include <vector>
 
+#ifdef _WIN32
 #include <wrl/client.h>
+#else
+#include "FakeD3D11.h"
+#endif
 
-#include <Windows.h>
+#include "Platform.h"
 #include "nvEncodeAPI.h"
 
 struct ID3D11Device;
 struct ID3D11DeviceContext;
 struct ID3D11Texture2D;
+class Nv12Converter;
+class FrameScaler;
 
 extern "C" {
 #include <libavcodec/avcodec.h>
 }
 
 #include "NvencRtspPlugin.h"
+#include "NvencPacketPool.h"
+#include "StreamStats.h"
+
+// Один закодированный access unit (Annex-B, для AV1 - temporal unit из OBU)
+// и его временная метка.
+// Данные лежат в блоке пула и передаются дальше по ссылке, без копий.
+struct NvEncPacket
+{
+    NvEncPacketRef data;
+    int64_t ts100ns = 0;
+    bool keyframe = false;
+};
+
+// Настройки, которые меняются после создания энкодера (NVRTSP_Set*). При
+// перезапуске стрима энкодер создаётся заново, и они переносятся в новый.
+struct NvEncSettings
+{
+    NvrtspColorConversion color = NVRTSP_COLOR_NVENC;
+    NvrtspScaleFilter scaleFilter = NVRTSP_SCALE_BILINEAR;
+    uint32_t gopLength = 0;       // 0 - как при создании
+    uint32_t intraRefresh = 0;    // период intra refresh, 0 - выключен
+};
 
 // Обёртка над NVENC для Direct3D11. Базовый класс реализует всю общую
 // работу с NVENC, а конкретные кодеки переопределяют детали конфигурации.
@@ -26,28 +55,153 @@ class NvEncoderD3D11Base
 {
 public:
     NvEncoderD3D11Base(ID3D11Device* dev, ID3D11DeviceContext* ctx,
-                       uint32_t w, uint32_t h, uint32_t fps, uint32_t bitrateKbps);
+                       uint32_t w, uint32_t h, uint32_t fpsNum, uint32_t fpsDen,
+                       uint32_t bitrateKbps);
     virtual ~NvEncoderD3D11Base();
 
-    bool Initialize();
+    // api - подменённая таблица функций NVENC (например, фейковая в тестах),
+    // nullptr - загрузить настоящую через NvEncodeAPICreateInstance.
+    bool Initialize(const NV_ENCODE_API_FUNCTION_LIST* api = nullptr);
+
+    // Копирует текстуру в свободный слот кольца и ставит её в очередь NVENC,
+    // не дожидаясь результата. В outPackets попадают уже готовые кадры
+    // (предыдущие), поэтому пустой outPackets при true - это нормально.
     bool EncodeTexture(ID3D11Texture2D* tex, int64_t ts100ns,
-                       std::vector<std::vector<uint8_t>>& outPackets);
-    void Flush(std::vector<std::vector<uint8_t>>& outPackets);
+                       std::vector<NvEncPacket>& outPackets);
+
+    // То же без копии: текстура (например, слот FrameCaptureRing) сразу идёт
+    // в NVENC. Её нельзя менять, пока CompletedFrames() не превысит *frameIdx.
+    // NV12 размера кодирования (готовит render thread) регистрируется как есть;
+    // RGB другого размера или под проход NV12 - через слот на m_ctx.
+    bool EncodeTextureNoCopy(ID3D11Texture2D* tex, int64_t ts100ns,
+                             std::vector<NvEncPacket>& outPackets, uint64_t* frameIdx);
+
+    // Ждёт готовности самого старого кадра в очереди не дольше timeoutMs
+    // (INFINITE - без срока) и забирает все готовые кадры.
+    void WaitForPackets(std::vector<NvEncPacket>& outPackets, uint32_t timeoutMs);
+
+    // Дожидается всех кадров в очереди и отправляет EOS.
+    void Flush(std::vector<NvEncPacket>& outPackets);
+
+    uint32_t PendingFrames() const { return (uint32_t)(m_iToSend - m_iGot); }
+    // Сколько кадров NVENC уже отдал (номера кадров < CompletedFrames() готовы).
+    uint64_t CompletedFrames() const { return m_iGot; }
+    // Кадров, которые NVENC не отдал (ошибка nvEncLockBitstream); после
+    // каждого следующий кадр - IDR.
+    uint64_t LostFrames() const { return m_lostFrames.load(std::memory_order_relaxed); }
+
+    // Текстур, зарегистрированных в NVENC сейчас, и снятых кэшем регистраций
+    // (простой, вытеснение). Можно читать с любого потока.
+    uint32_t RegisteredTextures() const { return m_texRegCount.load(std::memory_order_relaxed); }
+    uint64_t EvictedRegistrations() const { return m_texRegEvicted.load(std::memory_order_relaxed); }
+
+    // Смена параметров без пересоздания сессии (nvEncReconfigureEncoder).
+    // 0 - оставить как есть. Битрейт и частота меняются между кадрами без IDR;
+    // смена длины GOP требует сброса энкодера и начинается с IDR.
+    // Вызывать с того же потока, что и EncodeTexture.
+    bool Reconfigure(uint32_t bitrateKbps, uint32_t fpsNum, uint32_t fpsDen, uint32_t gopLength);
+
+    // Запросить IDR на ближайшем кадре (NV_ENC_PIC_FLAG_FORCEIDR); можно с
+    // любого потока. Запросы склеиваются: сколько бы их ни пришло до кадра,
+    // будет один IDR. Принудительные IDR не чаще kMinForcedIdrIntervalNs:
+    // запрос внутри окна откладывается до его конца, а не теряется.
+    void RequestKeyframe();
+    uint64_t KeyframeRequests() const { return m_idrRequests.load(std::memory_order_relaxed); }
+    uint64_t ForcedKeyframes() const { return m_idrForced.load(std::memory_order_relaxed); }
+
+    // Постепенное обновление intra вместо периодических IDR: раз в
+    // periodFrames кадров полоса intra-блоков проходит по кадру за
+    // periodFrames - 1 кадров, GOP бесконечный, в поток пишется SEI recovery
+    // point. Размер кадров ровный, без всплесков IDR. 0 - обычный режим с IDR
+    // по GOP. Переключение - сброс энкодера и IDR; false - GPU не умеет
+    // intra refresh или NVENC отказал (режим не меняется).
+    // Вызывать с того же потока, что и EncodeTexture.
+    bool SetIntraRefresh(uint32_t periodFrames);
+    uint32_t IntraRefreshPeriod() const { return m_irPeriod; }
+
+    // Неопорные P-кадры (rcParams.enableNonRefP): NVENC сам вставляет
+    // кадры, на которые никто не ссылается (H.264 nal_ref_idc = 0, HEVC
+    // TRAIL_N). Их можно выбросить из очереди отправки, не ломая
+    // декодирование, - без них политике DROP_NONREF при frameIntervalP = 1
+    // выбрасывать нечего. Без сброса энкодера; false - NVENC отказал.
+    // Вызывать с того же потока, что и EncodeTexture.
+    bool SetNonRefP(bool enable);
+    bool NonRefP() const { return m_cfg.rcParams.enableNonRefP != 0; }
+
+    // Свой проход RGB -> NV12 перед NVENC (Nv12Converter) или RGB в NVENC.
+    // Меняет и VUI потока, поэтому переключение - сброс энкодера и IDR;
+    // false - проход на этом GPU недоступен (режим не меняется).
+    // Вызывать с того же потока, что и EncodeTexture.
+    bool SetColorConversion(NvrtspColorConversion mode);
+    NvrtspColorConversion ColorConversion() const { return m_color; }
+
+    // Текстура другого размера, чем кодирование, масштабируется на GPU
+    // (FrameScaler) этим фильтром. Вызывать с потока EncodeTexture.
+    void SetScaleFilter(NvrtspScaleFilter filter) { m_scaleFilter = filter; }
+
+    uint32_t BitrateKbps() const { return m_bitrate; }
+    // Длина GOP режима с IDR (в режиме intra refresh хранится до его выключения).
+    uint32_t GopLength() const { return m_idrGop; }
+
+    // Текущие настройки и их перенос в только что созданный энкодер (до
+    // первого кадра). false - что-то не применилось, остальное применено.
+    NvEncSettings Settings() const;
+    bool ApplySettings(const NvEncSettings& settings);
+
+    // Задержка от nvEncEncodePicture до успешного nvEncLockBitstream.
+    const LatencyHistogram& EncodeLatency() const { return m_encodeLatency; }
 
     AVCodecID GetCodecId() const { return GetAvCodecId(); }
-    bool PacketHasIdr(const uint8_t* p, size_t n) const { return PacketHasIdrImpl(p, n); }
+
+    // SPS/PPS (и VPS для HEVC) из последнего IDR в Annex-B виде, для AV1 -
+    // OBU sequence header; пусто до первого кадра.
+    const std::vector<uint8_t>& GetParameterSets() const { return m_paramSets; }
 
 protected:
     virtual GUID CodecGuid() const = 0;
     virtual void ConfigureCodec(NV_ENC_CONFIG& cfg, uint32_t fps, uint32_t bitrateKbps) = 0;
+    virtual void SetIdrPeriod(NV_ENC_CONFIG& cfg, uint32_t frames) = 0;
+    // periodFrames == 0 - выключить intra refresh.
+    virtual void ConfigureIntraRefresh(NV_ENC_CONFIG& cfg, uint32_t periodFrames) = 0;
+    // Цветовое пространство входа в параметрах потока (VUI / color config).
+    virtual void ConfigureColor(NV_ENC_CONFIG& cfg, NvrtspColorConversion mode) = 0;
+    // VUI H.264/HEVC (у HEVC та же структура).
+    static void SetVuiColor(NV_ENC_CONFIG_H264_VUI_PARAMETERS& vui, NvrtspColorConversion mode);
     virtual AVCodecID GetAvCodecId() const = 0;
-    virtual bool PacketHasIdrImpl(const uint8_t* p, size_t n) const = 0;
+    virtual NalCodec GetNalCodec() const = 0;
+    // Индекс юнитов кадра (pkt.data.nals()) и признак ключевого кадра;
+    // true, если из кадра извлечены параметры потока в paramSets.
+    // По умолчанию - разбор Annex-B по GetNalCodec().
+    virtual bool IndexPacket(NvEncPacket& pkt, std::vector<uint8_t>& paramSets);
 
 private:
-    bool LoadApi();
+    struct EncSlot;
+
+    bool LoadApi(const NV_ENCODE_API_FUNCTION_LIST* api);
     bool OpenSession();
-    bool InitEncoder(uint32_t w, uint32_t h, uint32_t fps, uint32_t bitrateKbps);
-    bool EnsureTypedTexture(ID3D11Texture2D* src);
+    bool InitEncoder(uint32_t w, uint32_t h, uint32_t fpsNum, uint32_t fpsDen,
+                     uint32_t bitrateKbps);
+    static void ApplyBitrate(NV_ENC_CONFIG& cfg, uint32_t bitrateKbps);
+    bool QueryCap(NV_ENC_CAPS cap, int& value);
+    bool CommitConfig(NV_ENC_CONFIG& cfg, NV_ENC_RECONFIGURE_PARAMS& rp);
+    bool CreateSlots();
+    void DestroySlots();
+    bool EnsureSlotTexture(EncSlot& slot, ID3D11Texture2D* src);
+    // Кадр пойдёт через проход RGB -> NV12 (режим включён, формат и размер подходят).
+    bool UsesNv12Pass(ID3D11Texture2D* src) const;
+    // Кадр размером m_w x m_h: src или его уменьшенная копия; nullptr - ошибка.
+    ID3D11Texture2D* ScaledSource(ID3D11Texture2D* src);
+    NV_ENC_REGISTERED_PTR RegisterTexture(ID3D11Texture2D* tex, uint32_t w, uint32_t h);
+    void UnregisterTexture(ID3D11Texture2D* tex);
+    void UnregisterAllTextures();
+    // Снимает простаивающие регистрации и, если кэш полон, самую старую.
+    void EvictTexRegs();
+    void WaitForFreeSlot(std::vector<NvEncPacket>& outPackets);
+    bool SubmitFrame(EncSlot& slot, NV_ENC_REGISTERED_PTR reg, uint32_t w, uint32_t h,
+                     int64_t ts100ns, std::vector<NvEncPacket>& outPackets);
+    // Забирает готовые кадры по порядку до первого незавершённого;
+    // самый старый кадр ждёт не дольше waitMs.
+    void CollectPackets(std::vector<NvEncPacket>& outPackets, uint32_t waitMs);
 
 protected:
     ID3D11Device*        m_dev  = nullptr;
@@ -59,31 +213,92 @@ private:
 
     NV_ENC_BUFFER_FORMAT m_bufFmt = NV_ENC_BUFFER_FORMAT_ABGR;
 
+    // Текущие параметры сессии: база для nvEncReconfigureEncoder.
+    // m_init.encodeConfig указывает на m_cfg.
+    NV_ENC_CONFIG m_cfg = {};
+    NV_ENC_INITIALIZE_PARAMS m_init = {};
+
+    // Регистрация держит ссылку на текстуру: пока запись жива, её адрес не
+    // достанется новой текстуре (Unity пересоздала RenderTexture), и поиск
+    // по указателю не вернёт чужую регистрацию.
     struct TexReg {
+        Microsoft::WRL::ComPtr<ID3D11Texture2D> tex;
         NV_ENC_REGISTERED_PTR reg = nullptr;
+        uint32_t w = 0;
+        uint32_t h = 0;
+        NV_ENC_BUFFER_FORMAT fmt = NV_ENC_BUFFER_FORMAT_UNDEFINED;
+        uint64_t lastFrame = 0;   // номер последнего кадра с этой текстурой
     };
 
+    // Слоты энкодера и кольцо захвата - меньше десятка текстур; старые
+    // (после пересоздания RT или смены размера) уходят по простою.
+    static const size_t kMaxTexRegs = 16;
+    static const uint64_t kTexRegIdleFrames = 300;
+
     std::unordered_map<ID3D11Texture2D*, TexReg> m_texReg;
+    uint64_t m_texRegSweepFrame = 0;
+    std::atomic<uint32_t> m_texRegCount{0};
+    std::atomic<uint64_t> m_texRegEvicted{0};
 
-    NV_ENC_OUTPUT_PTR m_bsBuf = nullptr;
+    // Слот кольца: своя копия входной текстуры, мэппинг входа
+    // и выходной bitstream-буфер. Пока кадр в слоте кодируется, следующий
+    // кадр уже можно отправлять в другой слот.
+    struct EncSlot {
+        Microsoft::WRL::ComPtr<ID3D11Texture2D> tex;
+        uint32_t texW = 0;
+        uint32_t texH = 0;
+        NV_ENC_INPUT_PTR mapped = nullptr;
+        NV_ENC_OUTPUT_PTR bs = nullptr;
+        void* event = nullptr;
+        int64_t submitNs = 0;
+    };
+
+    static const uint32_t kNumSlots = 3;
+
+    std::vector<EncSlot> m_slots;
+    uint64_t m_iToSend = 0;   // сколько кадров отправлено в NVENC
+    uint64_t m_iGot = 0;      // сколько кадров забрано из NVENC
+    std::atomic<uint64_t> m_lostFrames{0};
+    bool m_async = false;
+
+    std::shared_ptr<NvEncPacketPool> m_packetPool = std::make_shared<NvEncPacketPool>();
 
-    Microsoft::WRL::ComPtr<ID3D11Texture2D> m_typedTex;
-    uint32_t m_typedW = 0;
-    uint32_t m_typedH = 0;
+    std::vector<uint8_t> m_paramSets;
+    std::vector<uint8_t> m_paramSetsScratch;
 
     bool m_firstFrame = true;
 
+    // Запросы IDR (RequestKeyframe) и когда последний раз ставили FORCEIDR.
+    static const int64_t kMinForcedIdrIntervalNs = 250000000;
+    std::atomic<bool> m_idrPending{false};
+    std::atomic<uint64_t> m_idrRequests{0};
+    std::atomic<uint64_t> m_idrForced{0};
+    int64_t m_lastForcedIdrNs = 0;
+
+    LatencyHistogram m_encodeLatency;
+
+    // Проход RGB -> NV12; создаётся при первом включении.
+    std::unique_ptr<Nv12Converter> m_nv12;
+    NvrtspColorConversion m_color = NVRTSP_COLOR_NVENC;
+
+    // Масштабирование под m_w x m_h; создаётся по первому кадру другого размера.
+    std::unique_ptr<FrameScaler> m_scaler;
+    NvrtspScaleFilter m_scaleFilter = NVRTSP_SCALE_BILINEAR;
+
     uint32_t m_w = 0;
     uint32_t m_h = 0;
-    uint32_t m_fps = 0;
+    uint32_t m_fps = 0;        // числитель частоты кадров
+    uint32_t m_fpsDen = 1;
     uint32_t m_bitrate = 0;
+    uint32_t m_idrGop = 0;     // GOP режима с IDR
+    uint32_t m_irPeriod = 0;   // 0 - intra refresh выключен
 };
 
 std::unique_ptr<NvEncoderD3D11Base> CreateNvEncoder(
     NvrtspCodec codec,
     ID3D11Device* dev,
     ID3D11DeviceContext* ctx,
-    uint32_t w, uint32_t h, uint32_t fps, uint32_t bitrateKbps);
+    uint32_t w, uint32_t h, uint32_t fpsNum, uint32_t fpsDen, uint32_t bitrateKbps);
 
 // Объявление логгера из NvencRtspPlugin.cpp
 void Log(const char* msg);
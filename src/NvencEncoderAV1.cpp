@@ -0,0 +1,66 @@
+#include "NvencEncoderAV1.h"
+
+#include "Av1Obu.h"
+
+GUID NvEncoderD3D11_AV1::CodecGuid() const
+{
+    return NV_ENC_CODEC_AV1_GUID;
+}
+
+void NvEncoderD3D11_AV1::ConfigureCodec(NV_ENC_CONFIG& cfg, uint32_t fps, uint32_t bitrateKbps)
+{
+    cfg.encodeCodecConfig.av1Config.idrPeriod = fps;
+    // Low-overhead формат (OBU с полем длины): его ждут RTP-пакетизатор и FFmpeg.
+    cfg.encodeCodecConfig.av1Config.outputAnnexBFormat = 0;
+    cfg.encodeCodecConfig.av1Config.repeatSeqHdr = 1;
+    cfg.encodeCodecConfig.av1Config.disableSeqHdr = 0;
+    cfg.encodeCodecConfig.av1Config.chromaFormatIDC = 1;
+    cfg.encodeCodecConfig.av1Config.inputBitDepth  = NV_ENC_BIT_DEPTH_8;
+    cfg.encodeCodecConfig.av1Config.outputBitDepth = NV_ENC_BIT_DEPTH_8;
+    cfg.encodeCodecConfig.av1Config.enableIntraRefresh = 0;
+    cfg.encodeCodecConfig.av1Config.maxNumRefFramesInDPB = 1;
+    cfg.encodeCodecConfig.av1Config.useBFramesAsRef = NV_ENC_BFRAME_REF_MODE_DISABLED;
+}
+
+void NvEncoderD3D11_AV1::SetIdrPeriod(NV_ENC_CONFIG& cfg, uint32_t frames)
+{
+    cfg.encodeCodecConfig.av1Config.idrPeriod = frames;
+}
+
+void NvEncoderD3D11_AV1::ConfigureIntraRefresh(NV_ENC_CONFIG& cfg, uint32_t periodFrames)
+{
+    // Аналога SEI recovery point у AV1 нет, остальное - как у H.264/HEVC.
+    cfg.encodeCodecConfig.av1Config.enableIntraRefresh = periodFrames ? 1 : 0;
+    cfg.encodeCodecConfig.av1Config.intraRefreshPeriod = periodFrames;
+    cfg.encodeCodecConfig.av1Config.intraRefreshCnt = periodFrames ? periodFrames - 1 : 0;
+}
+
+void NvEncoderD3D11_AV1::ConfigureColor(NV_ENC_CONFIG& cfg, NvrtspColorConversion mode)
+{
+    // Те же значения H.273, что в VUI H.264/HEVC, - в color config заголовка.
+    NV_ENC_CONFIG_AV1& av1 = cfg.encodeCodecConfig.av1Config;
+    bool bt709 = mode != NVRTSP_COLOR_NVENC;
+    av1.colorPrimaries = bt709 ? NV_ENC_VUI_COLOR_PRIMARIES_BT709 : NV_ENC_VUI_COLOR_PRIMARIES_UNSPECIFIED;
+    av1.transferCharacteristics = bt709 ? NV_ENC_VUI_TRANSFER_CHARACTERISTIC_BT709
+                                        : NV_ENC_VUI_TRANSFER_CHARACTERISTIC_UNSPECIFIED;
+    av1.matrixCoefficients = bt709 ? NV_ENC_VUI_MATRIX_COEFFS_BT709 : NV_ENC_VUI_MATRIX_COEFFS_UNSPECIFIED;
+    av1.colorRange = mode == NVRTSP_COLOR_NV12_FULL ? 1 : 0;
+}
+
+AVCodecID NvEncoderD3D11_AV1::GetAvCodecId() const
+{
+    return AV_CODEC_ID_AV1;
+}
+
+NalCodec NvEncoderD3D11_AV1::GetNalCodec() const
+{
+    return NalCodec::AV1;
+}
+
+bool NvEncoderD3D11_AV1::IndexPacket(NvEncPacket& pkt, std::vector<uint8_t>& paramSets)
+{
+    BuildObuIndex(pkt.data.data(), pkt.data.size(), pkt.data.nals());
+    pkt.keyframe = ObuIndexHasKeyFrame(pkt.data.data(), pkt.data.nals());
+    return pkt.keyframe &&
+           ExtractSequenceHeader(pkt.data.data(), pkt.data.nals(), paramSets);
+}
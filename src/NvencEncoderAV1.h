@@ -0,0 +1,26 @@
+#pragma once
+
+#include "NvencEncoder.h"
+
+// AV1 (NVENC на Ada и новее). Выход - low-overhead поток OBU, поэтому кадры
+// индексируются по OBU, а ключевой кадр определяется по заголовку кадра.
+class NvEncoderD3D11_AV1 : public NvEncoderD3D11Base
+{
+public:
+    NvEncoderD3D11_AV1(ID3D11Device* dev, ID3D11DeviceContext* ctx,
+                       uint32_t w, uint32_t h, uint32_t fpsNum, uint32_t fpsDen,
+                       uint32_t bitrateKbps)
+        : NvEncoderD3D11Base(dev, ctx, w, h, fpsNum, fpsDen, bitrateKbps)
+    {
+    }
+
+protected:
+    GUID CodecGuid() const override;
+    void ConfigureCodec(NV_ENC_CONFIG& cfg, uint32_t fps, uint32_t bitrateKbps) override;
+    void SetIdrPeriod(NV_ENC_CONFIG& cfg, uint32_t frames) override;
+    void ConfigureIntraRefresh(NV_ENC_CONFIG& cfg, uint32_t periodFrames) override;
+    void ConfigureColor(NV_ENC_CONFIG& cfg, NvrtspColorConversion mode) override;
+    AVCodecID GetAvCodecId() const override;
+    NalCodec GetNalCodec() const override;
+    bool IndexPacket(NvEncPacket& pkt, std::vector<uint8_t>& paramSets) override;
+};
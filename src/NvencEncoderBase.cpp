@@ -3,17 +3,31 @@
 #include <chrono>
 #include <cstdio>
 #include <string>
+#include <thread>
 
-#include <d3d11.h>
-#include <d3d11_4.h>
+#include "D3D11Compat.h"
+#include "FrameScaler.h"
+#include "Nv12Converter.h"
+
+static int64_t SteadyNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+// Шаг опроса nvEncLockBitstream при конечном ожидании в синхронном режиме.
+static const int64_t kSyncPollUs = 250;
 
 NvEncoderD3D11Base::NvEncoderD3D11Base(ID3D11Device* dev, ID3D11DeviceContext* ctx,
-                                       uint32_t w, uint32_t h, uint32_t fps, uint32_t bitrateKbps)
+                                       uint32_t w, uint32_t h, uint32_t fpsNum, uint32_t fpsDen,
+                                       uint32_t bitrateKbps)
     : m_dev(dev)
     , m_ctx(ctx)
     , m_w(w)
     , m_h(h)
-    , m_fps(fps)
+    , m_fps(fpsNum)
+    , m_fpsDen(fpsDen ? fpsDen : 1)
     , m_bitrate(bitrateKbps)
 {
     ZeroMemory(&m_fn, sizeof(m_fn));
@@ -22,7 +36,8 @@ NvEncoderD3D11Base::NvEncoderD3D11Base(ID3D11Device* dev, ID3D11DeviceContext* c
 
 NvEncoderD3D11Base::~NvEncoderD3D11Base()
 {
-    m_texReg.clear();
+    DestroySlots();
+    UnregisterAllTextures();
 
     if (m_hEncoder && m_fn.nvEncDestroyEncoder) {
         m_fn.nvEncDestroyEncoder(m_hEncoder);
@@ -30,14 +45,25 @@ NvEncoderD3D11Base::~NvEncoderD3D11Base()
     }
 }
 
-bool NvEncoderD3D11Base::LoadApi()
+bool NvEncoderD3D11Base::LoadApi(const NV_ENCODE_API_FUNCTION_LIST* api)
 {
+    if (api) {
+        m_fn = *api;
+        return true;
+    }
+
+#ifdef NVRTSP_FAKE_NVENC
+    // Сборка с программным NVENC: настоящая библиотека не линкуется.
+    Log("NVENC runtime is not linked (NVRTSP_FAKE_NVENC build)");
+    return false;
+#else
     NVENCSTATUS status = NvEncodeAPICreateInstance(&m_fn);
     if (status != NV_ENC_SUCCESS) {
         Log("NvEncodeAPICreateInstance failed");
         return false;
     }
     return true;
+#endif
 }
 
 bool NvEncoderD3D11Base::OpenSession()
@@ -57,8 +83,14 @@ bool NvEncoderD3D11Base::OpenSession()
     return true;
 }
 
-bool NvEncoderD3D11Base::InitEncoder(uint32_t w, uint32_t h, uint32_t fps, uint32_t bitrateKbps)
+bool NvEncoderD3D11Base::InitEncoder(uint32_t w, uint32_t h, uint32_t fpsNum, uint32_t fpsDen,
+                                     uint32_t bitrateKbps)
 {
+    // GOP - около секунды в целых кадрах; частота уходит в NVENC точной дробью.
+    uint32_t fps = (fpsNum + fpsDen / 2) / fpsDen;
+    if (!fps)
+        fps = 1;
+
     NV_ENC_PRESET_CONFIG presetCfg = { NV_ENC_PRESET_CONFIG_VER };
     presetCfg.presetCfg.version = NV_ENC_CONFIG_VER;
 
@@ -73,19 +105,20 @@ bool NvEncoderD3D11Base::InitEncoder(uint32_t w, uint32_t h, uint32_t fps, uint3
         return false;
     }
 
-    NV_ENC_CONFIG cfg = presetCfg.presetCfg;
+    m_cfg = presetCfg.presetCfg;
+    NV_ENC_CONFIG& cfg = m_cfg;
 
     cfg.gopLength = fps;
+    m_idrGop = fps;
+    m_irPeriod = 0;
     cfg.frameIntervalP = 1;
     cfg.rcParams.rateControlMode = NV_ENC_PARAMS_RC_CBR;
-    cfg.rcParams.averageBitRate  = bitrateKbps * 1000;
-    cfg.rcParams.maxBitRate      = bitrateKbps * 1000;
-    cfg.rcParams.vbvBufferSize   = bitrateKbps * 1000;
-    cfg.rcParams.vbvInitialDelay = bitrateKbps * 500;
+    ApplyBitrate(cfg, bitrateKbps);
 
     ConfigureCodec(cfg, fps, bitrateKbps);
 
-    NV_ENC_INITIALIZE_PARAMS init = { NV_ENC_INITIALIZE_PARAMS_VER };
+    m_init = { NV_ENC_INITIALIZE_PARAMS_VER };
+    NV_ENC_INITIALIZE_PARAMS& init = m_init;
     init.encodeGUID = CodecGuid();
     init.presetGUID = NV_ENC_PRESET_P1_GUID;
     init.tuningInfo = NV_ENC_TUNING_INFO_LOW_LATENCY;
@@ -93,37 +126,393 @@ bool NvEncoderD3D11Base::InitEncoder(uint32_t w, uint32_t h, uint32_t fps, uint3
     init.encodeHeight = h;
     init.darWidth     = w;
     init.darHeight    = h;
-    init.frameRateNum = fps;
-    init.frameRateDen = 1;
+    init.frameRateNum = fpsNum;
+    init.frameRateDen = fpsDen;
     init.enablePTD    = 1;
     init.encodeConfig = &cfg;
 
+    // Асинхронный режим (события завершения) есть только на Windows и не на
+    // всех GPU; без него кольцо работает через неблокирующий nvEncLockBitstream.
+    int asyncSupported = 0;
+    if (QueryCap(NV_ENC_CAPS_ASYNC_ENCODE_SUPPORT, asyncSupported))
+        m_async = asyncSupported != 0;
+    init.enableEncodeAsync = m_async ? 1 : 0;
+
     st = m_fn.nvEncInitializeEncoder(m_hEncoder, &init);
     if (st != NV_ENC_SUCCESS) {
         Log("nvEncInitializeEncoder failed");
         return false;
     }
 
-    NV_ENC_CREATE_BITSTREAM_BUFFER cbb = { NV_ENC_CREATE_BITSTREAM_BUFFER_VER };
-    st = m_fn.nvEncCreateBitstreamBuffer(m_hEncoder, &cbb);
+    return CreateSlots();
+}
+
+void NvEncoderD3D11Base::ApplyBitrate(NV_ENC_CONFIG& cfg, uint32_t bitrateKbps)
+{
+    cfg.rcParams.averageBitRate  = bitrateKbps * 1000;
+    cfg.rcParams.maxBitRate      = bitrateKbps * 1000;
+    cfg.rcParams.vbvBufferSize   = bitrateKbps * 1000;
+    cfg.rcParams.vbvInitialDelay = bitrateKbps * 500;
+}
+
+bool NvEncoderD3D11Base::QueryCap(NV_ENC_CAPS cap, int& value)
+{
+    if (!m_fn.nvEncGetEncodeCaps)
+        return false;
+
+    NV_ENC_CAPS_PARAM caps = { NV_ENC_CAPS_PARAM_VER };
+    caps.capsToQuery = cap;
+    return m_fn.nvEncGetEncodeCaps(m_hEncoder, CodecGuid(), &caps, &value) == NV_ENC_SUCCESS;
+}
+
+// Применяет копию параметров; только при успехе она становится текущей.
+bool NvEncoderD3D11Base::CommitConfig(NV_ENC_CONFIG& cfg, NV_ENC_RECONFIGURE_PARAMS& rp)
+{
+    rp.reInitEncodeParams.encodeConfig = &cfg;
+
+    NVENCSTATUS st = m_fn.nvEncReconfigureEncoder(m_hEncoder, &rp);
     if (st != NV_ENC_SUCCESS) {
-        Log("nvEncCreateBitstreamBuffer failed");
+        char buf[128];
+        sprintf_s(buf, "nvEncReconfigureEncoder failed: %d", (int)st);
+        Log(buf);
+        return false;
+    }
+
+    m_cfg = cfg;
+    m_init = rp.reInitEncodeParams;
+    m_init.encodeConfig = &m_cfg;
+    return true;
+}
+
+bool NvEncoderD3D11Base::Reconfigure(uint32_t bitrateKbps, uint32_t fpsNum, uint32_t fpsDen,
+                                     uint32_t gopLength)
+{
+    if (!m_hEncoder || !m_fn.nvEncReconfigureEncoder)
+        return false;
+
+    // Меняем копии: при ошибке NVENC продолжает работать со старыми.
+    NV_ENC_CONFIG cfg = m_cfg;
+    NV_ENC_RECONFIGURE_PARAMS rp = { NV_ENC_RECONFIGURE_PARAMS_VER };
+    rp.reInitEncodeParams = m_init;
+
+    if (bitrateKbps)
+        ApplyBitrate(cfg, bitrateKbps);
+
+    if (fpsNum && fpsDen) {
+        rp.reInitEncodeParams.frameRateNum = fpsNum;
+        rp.reInitEncodeParams.frameRateDen = fpsDen;
+    }
+
+    // Новая структура GOP не применяется к уже идущему GOP: нужен сброс и IDR.
+    // В режиме intra refresh GOP бесконечный: длину только запоминаем.
+    bool gopChanged = gopLength && gopLength != m_idrGop;
+    if (gopChanged && !m_irPeriod) {
+        cfg.gopLength = gopLength;
+        SetIdrPeriod(cfg, gopLength);
+        rp.resetEncoder = 1;
+        rp.forceIDR = 1;
+    }
+
+    if (!CommitConfig(cfg, rp))
+        return false;
+
+    if (gopChanged)
+        m_idrGop = gopLength;
+    if (bitrateKbps)
+        m_bitrate = bitrateKbps;
+    if (fpsNum && fpsDen) {
+        m_fps = fpsNum;
+        m_fpsDen = fpsDen;
+    }
+
+    char buf[160];
+    sprintf_s(buf, "NVENC reconfigured: %u kbps, %u/%u fps, GOP %u%s",
+        m_bitrate, m_fps, m_fpsDen, m_idrGop, rp.forceIDR ? " (IDR)" : "");
+    Log(buf);
+    return true;
+}
+
+bool NvEncoderD3D11Base::SetIntraRefresh(uint32_t periodFrames)
+{
+    if (!m_hEncoder || !m_fn.nvEncReconfigureEncoder)
+        return false;
+
+    // Полоса обновления проходит кадр за periodFrames - 1 кадров.
+    if (periodFrames == 1)
+        periodFrames = 2;
+    if (periodFrames == m_irPeriod)
+        return true;
+
+    int supported = 0;
+    if (periodFrames &&
+        (!QueryCap(NV_ENC_CAPS_SUPPORT_INTRA_REFRESH, supported) || !supported))
+    {
+        Log("NVENC: intra refresh is not supported by this GPU/codec");
+        return false;
+    }
+
+    NV_ENC_CONFIG cfg = m_cfg;
+    NV_ENC_RECONFIGURE_PARAMS rp = { NV_ENC_RECONFIGURE_PARAMS_VER };
+    rp.reInitEncodeParams = m_init;
+
+    // Периодические IDR и intra refresh не совмещаем: иначе всплески
+    // размера кадров, от которых режим и избавляет, остаются.
+    uint32_t gop = periodFrames ? NVENC_INFINITE_GOPLENGTH : m_idrGop;
+    cfg.gopLength = gop;
+    SetIdrPeriod(cfg, gop);
+    ConfigureIntraRefresh(cfg, periodFrames);
+    rp.resetEncoder = 1;
+    rp.forceIDR = 1;
+
+    if (!CommitConfig(cfg, rp))
         return false;
+
+    m_irPeriod = periodFrames;
+
+    char buf[128];
+    if (periodFrames)
+        sprintf_s(buf, "NVENC intra refresh: period %u frames, infinite GOP", periodFrames);
+    else
+        sprintf_s(buf, "NVENC intra refresh off, GOP %u", m_idrGop);
+    Log(buf);
+    return true;
+}
+
+void NvEncoderD3D11Base::SetVuiColor(NV_ENC_CONFIG_H264_VUI_PARAMETERS& vui,
+                                     NvrtspColorConversion mode)
+{
+    if (mode == NVRTSP_COLOR_NVENC) {
+        // Как было до прохода: VUI не пишется, цвет - на совести NVENC.
+        vui.videoSignalTypePresentFlag = 0;
+        vui.videoFullRangeFlag = 0;
+        vui.colourDescriptionPresentFlag = 0;
+        return;
     }
-    m_bsBuf = cbb.bitstreamBuffer;
+    vui.videoSignalTypePresentFlag = 1;
+    vui.videoFormat = NV_ENC_VUI_VIDEO_FORMAT_UNSPECIFIED;
+    vui.videoFullRangeFlag = mode == NVRTSP_COLOR_NV12_FULL ? 1 : 0;
+    vui.colourDescriptionPresentFlag = 1;
+    vui.colourPrimaries = NV_ENC_VUI_COLOR_PRIMARIES_BT709;
+    vui.transferCharacteristics = NV_ENC_VUI_TRANSFER_CHARACTERISTIC_BT709;
+    vui.colourMatrix = NV_ENC_VUI_MATRIX_COEFFS_BT709;
+}
 
+bool NvEncoderD3D11Base::SetNonRefP(bool enable)
+{
+    if (!m_hEncoder || !m_fn.nvEncReconfigureEncoder)
+        return false;
+    if (NonRefP() == enable)
+        return true;
+
+    NV_ENC_CONFIG cfg = m_cfg;
+    NV_ENC_RECONFIGURE_PARAMS rp = { NV_ENC_RECONFIGURE_PARAMS_VER };
+    rp.reInitEncodeParams = m_init;
+    cfg.rcParams.enableNonRefP = enable ? 1 : 0;
+
+    if (!CommitConfig(cfg, rp))
+        return false;
+
+    Log(enable ? "NVENC non-reference P frames on" : "NVENC non-reference P frames off");
     return true;
 }
 
-bool NvEncoderD3D11Base::Initialize()
+bool NvEncoderD3D11Base::SetColorConversion(NvrtspColorConversion mode)
 {
-    if (!LoadApi()) return false;
+    if (!m_hEncoder || !m_fn.nvEncReconfigureEncoder)
+        return false;
+    if (mode != NVRTSP_COLOR_NVENC && mode != NVRTSP_COLOR_NV12_LIMITED &&
+        mode != NVRTSP_COLOR_NV12_FULL)
+        return false;
+    if (mode == m_color)
+        return true;
+
+    if (mode != NVRTSP_COLOR_NVENC && !m_nv12) {
+        std::unique_ptr<Nv12Converter> conv(new Nv12Converter(m_dev, m_ctx));
+        if (!conv->Initialize())
+            return false;
+        m_nv12 = std::move(conv);
+    }
+
+    NV_ENC_CONFIG cfg = m_cfg;
+    NV_ENC_RECONFIGURE_PARAMS rp = { NV_ENC_RECONFIGURE_PARAMS_VER };
+    rp.reInitEncodeParams = m_init;
+
+    // Параметры цвета живут в заголовках последовательности: меняем с IDR.
+    ConfigureColor(cfg, mode);
+    rp.resetEncoder = 1;
+    rp.forceIDR = 1;
+
+    if (!CommitConfig(cfg, rp))
+        return false;
+
+    m_color = mode;
+
+    static const char* const kNames[] = { "RGB into NVENC", "NV12 BT.709 limited", "NV12 BT.709 full" };
+    char buf[128];
+    sprintf_s(buf, "NVENC color conversion: %s", kNames[mode]);
+    Log(buf);
+    return true;
+}
+
+NvEncSettings NvEncoderD3D11Base::Settings() const
+{
+    NvEncSettings st;
+    st.color = m_color;
+    st.scaleFilter = m_scaleFilter;
+    st.gopLength = m_idrGop;
+    st.intraRefresh = m_irPeriod;
+    return st;
+}
+
+bool NvEncoderD3D11Base::ApplySettings(const NvEncSettings& settings)
+{
+    m_scaleFilter = settings.scaleFilter;
+    bool ok = SetColorConversion(settings.color);
+    // Длина GOP - до intra refresh: в его режиме она только запоминается.
+    if (settings.gopLength && settings.gopLength != m_idrGop)
+        ok = Reconfigure(0, 0, 0, settings.gopLength) && ok;
+    return SetIntraRefresh(settings.intraRefresh) && ok;
+}
+
+void NvEncoderD3D11Base::RequestKeyframe()
+{
+    m_idrRequests.fetch_add(1, std::memory_order_relaxed);
+    m_idrPending.store(true, std::memory_order_relaxed);
+}
+
+bool NvEncoderD3D11Base::CreateSlots()
+{
+    m_slots.resize(kNumSlots);
+
+    for (EncSlot& slot : m_slots) {
+        NV_ENC_CREATE_BITSTREAM_BUFFER cbb = { NV_ENC_CREATE_BITSTREAM_BUFFER_VER };
+        NVENCSTATUS st = m_fn.nvEncCreateBitstreamBuffer(m_hEncoder, &cbb);
+        if (st != NV_ENC_SUCCESS) {
+            Log("nvEncCreateBitstreamBuffer failed");
+            return false;
+        }
+        slot.bs = cbb.bitstreamBuffer;
+
+        if (m_async) {
+            // Событие с ручным сбросом: проверка готовности его не сбрасывает,
+            // сбрасываем сами перед каждой отправкой кадра в слот.
+            slot.event = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+            NV_ENC_EVENT_PARAMS ev = { NV_ENC_EVENT_PARAMS_VER };
+            ev.completionEvent = slot.event;
+            st = m_fn.nvEncRegisterAsyncEvent(m_hEncoder, &ev);
+            if (st != NV_ENC_SUCCESS) {
+                Log("nvEncRegisterAsyncEvent failed");
+                return false;
+            }
+        }
+    }
+
+    char buf[128];
+    sprintf_s(buf, "NVENC: %u encode slots, %s mode",
+        (unsigned)m_slots.size(), m_async ? "async" : "sync");
+    Log(buf);
+    return true;
+}
+
+void NvEncoderD3D11Base::DestroySlots()
+{
+    if (!m_hEncoder) {
+        m_slots.clear();
+        return;
+    }
+
+    for (EncSlot& slot : m_slots) {
+        if (slot.mapped) {
+            m_fn.nvEncUnmapInputResource(m_hEncoder, slot.mapped);
+            slot.mapped = nullptr;
+        }
+        if (slot.bs) {
+            m_fn.nvEncDestroyBitstreamBuffer(m_hEncoder, slot.bs);
+            slot.bs = nullptr;
+        }
+        if (slot.event) {
+            NV_ENC_EVENT_PARAMS ev = { NV_ENC_EVENT_PARAMS_VER };
+            ev.completionEvent = slot.event;
+            m_fn.nvEncUnregisterAsyncEvent(m_hEncoder, &ev);
+            CloseHandle(slot.event);
+            slot.event = nullptr;
+        }
+    }
+    m_slots.clear();
+}
+
+bool NvEncoderD3D11Base::Initialize(const NV_ENCODE_API_FUNCTION_LIST* api)
+{
+    if (!LoadApi(api)) return false;
     if (!OpenSession()) return false;
-    if (!InitEncoder(m_w, m_h, m_fps, m_bitrate)) return false;
+    if (!InitEncoder(m_w, m_h, m_fps, m_fpsDen, m_bitrate)) return false;
     return true;
 }
 
-bool NvEncoderD3D11Base::EnsureTypedTexture(ID3D11Texture2D* src)
+// Typeless-форматы Unity заменяются типизированными UNORM, которые понимает
+// NVENC; bufFmt - соответствующий формат входа NVENC.
+static bool MapInputFormat(DXGI_FORMAT in, DXGI_FORMAT& typed, NV_ENC_BUFFER_FORMAT& bufFmt)
+{
+    typed = in;
+    if (typed == DXGI_FORMAT_R8G8B8A8_TYPELESS)
+        typed = DXGI_FORMAT_R8G8B8A8_UNORM;
+    else if (typed == DXGI_FORMAT_B8G8R8A8_TYPELESS)
+        typed = DXGI_FORMAT_B8G8R8A8_UNORM;
+
+    if (typed == DXGI_FORMAT_R8G8B8A8_UNORM ||
+        typed == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB)
+    {
+        bufFmt = NV_ENC_BUFFER_FORMAT_ABGR;
+        return true;
+    }
+    if (typed == DXGI_FORMAT_B8G8R8A8_UNORM ||
+        typed == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB)
+    {
+        bufFmt = NV_ENC_BUFFER_FORMAT_ARGB;
+        return true;
+    }
+    return false;
+}
+
+bool NvEncoderD3D11Base::UsesNv12Pass(ID3D11Texture2D* src) const
+{
+    if (!m_nv12 || m_color == NVRTSP_COLOR_NVENC || !src)
+        return false;
+
+    D3D11_TEXTURE2D_DESC desc = {};
+    src->GetDesc(&desc);
+
+    // sRGB-текстуру шейдер прочитал бы линеаризованной - такие кадры идут
+    // в NVENC как RGB; у NV12 стороны только чётные. Кадр другого размера
+    // к проходу приходит уже масштабированным до m_w x m_h.
+    DXGI_FORMAT typed;
+    NV_ENC_BUFFER_FORMAT bufFmt;
+    return MapInputFormat(desc.Format, typed, bufFmt) &&
+           typed != DXGI_FORMAT_R8G8B8A8_UNORM_SRGB &&
+           typed != DXGI_FORMAT_B8G8R8A8_UNORM_SRGB &&
+           desc.SampleDesc.Count == 1 && desc.ArraySize == 1 && desc.MipLevels == 1 &&
+           (m_w & 1) == 0 && (m_h & 1) == 0;
+}
+
+ID3D11Texture2D* NvEncoderD3D11Base::ScaledSource(ID3D11Texture2D* src)
+{
+    if (!m_scaler) {
+        std::unique_ptr<FrameScaler> scaler(new FrameScaler(m_dev, m_ctx));
+        if (!scaler->Initialize())
+            return nullptr;
+        m_scaler = std::move(scaler);
+
+        char buf[128];
+        sprintf_s(buf, "Texture size differs from %ux%u: scaling on GPU", m_w, m_h);
+        Log(buf);
+    }
+
+    ScaleFilter filter = m_scaleFilter == NVRTSP_SCALE_LANCZOS ? ScaleFilter::Lanczos
+                                                               : ScaleFilter::Bilinear;
+    return m_scaler->Scale(src, m_w, m_h, filter);
+}
+
+bool NvEncoderD3D11Base::EnsureSlotTexture(EncSlot& slot, ID3D11Texture2D* src)
 {
     if (!src) return false;
 
@@ -143,102 +532,284 @@ bool NvEncoderD3D11Base::EnsureTypedTexture(ID3D11Texture2D* src)
         return false;
     }
 
-    ID3D11Texture2D* srcTex = src;
+    DXGI_FORMAT fmt;
+    NV_ENC_BUFFER_FORMAT bufFmt;
+    if (!MapInputFormat(desc.Format, fmt, bufFmt)) {
+        Log("Unsupported DXGI format even after typeless fix");
+        return false;
+    }
 
-    if (desc.Format == DXGI_FORMAT_R8G8B8A8_TYPELESS)
+    // Размер не совпал с кодированием - дальше идёт масштабированная копия.
+    if (desc.Width != m_w || desc.Height != m_h) {
+        src = ScaledSource(src);
+        if (!src) return false;
+        src->GetDesc(&desc);
+        MapInputFormat(desc.Format, fmt, bufFmt);
+    }
+
+    const bool nv12 = UsesNv12Pass(src);
+    if (nv12) {
+        fmt = DXGI_FORMAT_NV12;
+        bufFmt = NV_ENC_BUFFER_FORMAT_NV12;
+    }
+
+    D3D11_TEXTURE2D_DESC cur = {};
+    if (slot.tex)
+        slot.tex->GetDesc(&cur);
+
+    if (!slot.tex || slot.texW != desc.Width || slot.texH != desc.Height || cur.Format != fmt)
     {
-        if (!m_typedTex || m_typedW != desc.Width || m_typedH != desc.Height)
-        {
-            char buf[256];
-            sprintf_s(buf, "Tex desc: W=%u H=%u Format=%d SampleCount=%u ArraySize=%u MipLevels=%u",
-                desc.Width, desc.Height, (int)desc.Format,
-                desc.SampleDesc.Count, desc.ArraySize, desc.MipLevels);
-            Log(buf);
+        char buf[256];
+        sprintf_s(buf, "Tex desc: W=%u H=%u Format=%d SampleCount=%u ArraySize=%u MipLevels=%u",
+            desc.Width, desc.Height, (int)desc.Format,
+            desc.SampleDesc.Count, desc.ArraySize, desc.MipLevels);
+        Log(buf);
 
-            D3D11_TEXTURE2D_DESC tdesc = desc;
-            tdesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        D3D11_TEXTURE2D_DESC tdesc = desc;
+        if (nv12) {
+            tdesc = Nv12Converter::TargetDesc(desc.Width, desc.Height);
+        } else {
+            tdesc.Format = fmt;
+            tdesc.Usage = D3D11_USAGE_DEFAULT;
             tdesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+            tdesc.CPUAccessFlags = 0;
             tdesc.MipLevels = 1;
             tdesc.ArraySize = 1;
             tdesc.SampleDesc.Count = 1;
             tdesc.MiscFlags = 0;
+        }
 
-            m_typedTex.Reset();
-            HRESULT hr = m_dev->CreateTexture2D(&tdesc, nullptr, m_typedTex.GetAddressOf());
-            if (FAILED(hr)) {
-                Log("CreateTexture2D (typedTex) failed");
-                return false;
-            }
-            m_typedW = desc.Width;
-            m_typedH = desc.Height;
-
-            Log("Created typed texture DXGI_FORMAT_R8G8B8A8_UNORM");
+        if (slot.tex) {
+            UnregisterTexture(slot.tex.Get());
+            if (m_nv12)
+                m_nv12->Forget(slot.tex.Get());
         }
+        slot.tex.Reset();
+        HRESULT hr = m_dev->CreateTexture2D(&tdesc, nullptr, slot.tex.GetAddressOf());
+        if (FAILED(hr)) {
+            Log("CreateTexture2D (slot texture) failed");
+            return false;
+        }
+        slot.texW = desc.Width;
+        slot.texH = desc.Height;
+    }
 
-        m_ctx->CopyResource(m_typedTex.Get(), src);
-        srcTex = m_typedTex.Get();
+    m_bufFmt = bufFmt;
+    if (nv12) {
+        Nv12Range range = m_color == NVRTSP_COLOR_NV12_FULL ? Nv12Range::Full : Nv12Range::Limited;
+        return m_nv12->Convert(src, slot.tex.Get(), range);
+    }
+    m_ctx->CopyResource(slot.tex.Get(), src);
+    return true;
+}
 
-        srcTex->GetDesc(&desc);
+NV_ENC_REGISTERED_PTR NvEncoderD3D11Base::RegisterTexture(ID3D11Texture2D* tex,
+                                                          uint32_t w, uint32_t h)
+{
+    if (m_iToSend - m_texRegSweepFrame >= kTexRegIdleFrames)
+        EvictTexRegs();
+
+    auto it = m_texReg.find(tex);
+    if (it != m_texReg.end()) {
+        TexReg& r = it->second;
+        if (r.w == w && r.h == h && r.fmt == m_bufFmt) {
+            r.lastFrame = m_iToSend;
+            return r.reg;
+        }
+        // Та же текстура, но другой формат входа NVENC - регистрация устарела.
+        UnregisterTexture(tex);
+    }
+    if (m_texReg.size() >= kMaxTexRegs)
+        EvictTexRegs();
+
+    NV_ENC_REGISTER_RESOURCE rr = { NV_ENC_REGISTER_RESOURCE_VER };
+    rr.resourceType       = NV_ENC_INPUT_RESOURCE_TYPE_DIRECTX;
+    rr.width              = w;
+    rr.height             = h;
+    rr.pitch              = 0;
+    rr.subResourceIndex   = 0;
+    rr.bufferFormat       = m_bufFmt;
+    rr.bufferUsage        = NV_ENC_INPUT_IMAGE;
+    rr.resourceToRegister = tex;
+
+    NVENCSTATUS st = m_fn.nvEncRegisterResource(m_hEncoder, &rr);
+    if (st != NV_ENC_SUCCESS) {
+        char buf[256];
+        sprintf_s(buf, "nvEncRegisterResource failed: %d", (int)st);
+        Log(buf);
+        return nullptr;
     }
 
-    if (desc.Format == DXGI_FORMAT_R8G8B8A8_UNORM ||
-        desc.Format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB)
-    {
-        m_bufFmt = NV_ENC_BUFFER_FORMAT_ABGR;
+    TexReg r;
+    r.tex = tex;
+    r.reg = rr.registeredResource;
+    r.w = w;
+    r.h = h;
+    r.fmt = m_bufFmt;
+    r.lastFrame = m_iToSend;
+    m_texReg[tex] = r;
+    m_texRegCount.store((uint32_t)m_texReg.size(), std::memory_order_relaxed);
+    return r.reg;
+}
+
+void NvEncoderD3D11Base::UnregisterTexture(ID3D11Texture2D* tex)
+{
+    auto it = m_texReg.find(tex);
+    if (it == m_texReg.end())
+        return;
+    if (m_hEncoder && it->second.reg)
+        m_fn.nvEncUnregisterResource(m_hEncoder, it->second.reg);
+    m_texReg.erase(it);
+    m_texRegCount.store((uint32_t)m_texReg.size(), std::memory_order_relaxed);
+}
+
+void NvEncoderD3D11Base::UnregisterAllTextures()
+{
+    for (auto& kv : m_texReg) {
+        if (m_hEncoder && kv.second.reg)
+            m_fn.nvEncUnregisterResource(m_hEncoder, kv.second.reg);
     }
-    else if (desc.Format == DXGI_FORMAT_B8G8R8A8_UNORM ||
-             desc.Format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB)
-    {
-        m_bufFmt = NV_ENC_BUFFER_FORMAT_ARGB;
+    m_texReg.clear();
+    m_texRegCount.store(0, std::memory_order_relaxed);
+}
+
+void NvEncoderD3D11Base::EvictTexRegs()
+{
+    m_texRegSweepFrame = m_iToSend;
+
+    // Снимать можно только записи, чьи кадры NVENC уже отдал: вход ещё
+    // не закодированного кадра замэплен.
+    size_t idle = 0;
+    for (auto it = m_texReg.begin(); it != m_texReg.end();) {
+        const TexReg& r = it->second;
+        if (r.lastFrame < m_iGot && m_iToSend - r.lastFrame > kTexRegIdleFrames) {
+            if (m_hEncoder && r.reg)
+                m_fn.nvEncUnregisterResource(m_hEncoder, r.reg);
+            it = m_texReg.erase(it);
+            ++idle;
+        }
+        else {
+            ++it;
+        }
     }
-    else {
-        Log("Unsupported DXGI format even after typeless fix");
-        return false;
+
+    // Кэш всё ещё полон (много разных текстур подряд) - уходит самая старая.
+    size_t evicted = idle;
+    while (m_texReg.size() >= kMaxTexRegs) {
+        auto oldest = m_texReg.end();
+        for (auto it = m_texReg.begin(); it != m_texReg.end(); ++it) {
+            if (it->second.lastFrame < m_iGot &&
+                (oldest == m_texReg.end() || it->second.lastFrame < oldest->second.lastFrame))
+                oldest = it;
+        }
+        if (oldest == m_texReg.end())
+            break;
+        if (m_hEncoder && oldest->second.reg)
+            m_fn.nvEncUnregisterResource(m_hEncoder, oldest->second.reg);
+        m_texReg.erase(oldest);
+        ++evicted;
     }
 
-    return true;
+    if (!evicted)
+        return;
+    m_texRegCount.store((uint32_t)m_texReg.size(), std::memory_order_relaxed);
+    m_texRegEvicted.fetch_add(evicted, std::memory_order_relaxed);
+
+    // Вытеснение по размеру может идти каждый кадр - в лог только простой.
+    if (idle) {
+        char buf[128];
+        sprintf_s(buf, "NVENC: unregistered %u idle textures, %u registered",
+            (unsigned)idle, (unsigned)m_texReg.size());
+        Log(buf);
+    }
 }
 
-bool NvEncoderD3D11Base::EncodeTexture(ID3D11Texture2D* tex, int64_t ts100ns,
-                                       std::vector<std::vector<uint8_t>>& outPackets)
+void NvEncoderD3D11Base::CollectPackets(std::vector<NvEncPacket>& outPackets, uint32_t waitMs)
 {
-    outPackets.clear();
-    if (!m_hEncoder) return false;
-    if (!EnsureTypedTexture(tex)) return false;
+    // Синхронный NVENC умеет ждать только без срока, поэтому конечное
+    // ожидание - опрос с doNotWait до дедлайна.
+    const int64_t deadlineNs = SteadyNowNs() + (int64_t)waitMs * 1000000;
+
+    while (m_iGot < m_iToSend) {
+        EncSlot& slot = m_slots[m_iGot % m_slots.size()];
+
+        if (m_async && WaitForSingleObject(slot.event, waitMs) != WAIT_OBJECT_0)
+            break;
+
+        NV_ENC_LOCK_BITSTREAM lock = { NV_ENC_LOCK_BITSTREAM_VER };
+        lock.outputBitstream = slot.bs;
+        lock.doNotWait = (m_async || waitMs == INFINITE) ? 0 : 1;
+        NVENCSTATUS st = m_fn.nvEncLockBitstream(m_hEncoder, &lock);
+        if (st == NV_ENC_ERR_LOCK_BUSY) {
+            if (waitMs == 0 || SteadyNowNs() >= deadlineNs)
+                break;
+            std::this_thread::sleep_for(std::chrono::microseconds(kSyncPollUs));
+            continue;
+        }
 
-    ID3D11Texture2D* srcTex = tex;
-    if (m_typedTex)
-        srcTex = m_typedTex.Get();
+        if (st == NV_ENC_SUCCESS) {
+            m_encodeLatency.Record(SteadyNowNs() - slot.submitNs);
 
-    D3D11_TEXTURE2D_DESC desc = {};
-    srcTex->GetDesc(&desc);
-
-    NV_ENC_REGISTERED_PTR reg = nullptr;
-    auto it = m_texReg.find(srcTex);
-    if (it == m_texReg.end()) {
-        NV_ENC_REGISTER_RESOURCE rr = { NV_ENC_REGISTER_RESOURCE_VER };
-        rr.resourceType       = NV_ENC_INPUT_RESOURCE_TYPE_DIRECTX;
-        rr.width              = desc.Width;
-        rr.height             = desc.Height;
-        rr.pitch              = 0;
-        rr.subResourceIndex   = 0;
-        rr.bufferFormat       = m_bufFmt;
-        rr.bufferUsage        = NV_ENC_INPUT_IMAGE;
-        rr.resourceToRegister = srcTex;
-
-        NVENCSTATUS st = m_fn.nvEncRegisterResource(m_hEncoder, &rr);
-        if (st != NV_ENC_SUCCESS) {
-            char buf[256];
-            sprintf_s(buf, "nvEncRegisterResource failed: %d", (int)st);
+            uint8_t* ptr = (uint8_t*)lock.bitstreamBufferPtr;
+            uint32_t sz  = lock.bitstreamSizeInBytes;
+            if (sz > 0) {
+                // Единственная копия: из bitstream-буфера NVENC в блок пула,
+                // после чего буфер слота можно сразу переиспользовать.
+                NvEncPacket pkt;
+                pkt.data = m_packetPool->Copy(ptr, sz);
+                pkt.ts100ns = (int64_t)lock.outputTimeStamp;
+
+                // Индекс NAL/OBU строится один раз и дальше едет вместе с пакетом.
+                if (IndexPacket(pkt, m_paramSetsScratch) && m_paramSetsScratch != m_paramSets)
+                    m_paramSets.swap(m_paramSetsScratch);
+
+                outPackets.push_back(std::move(pkt));
+            }
+            m_fn.nvEncUnlockBitstream(m_hEncoder, slot.bs);
+        }
+        else {
+            // Кадр потерян, а следующие на него ссылаются: без IDR декодер
+            // покажет мусор до конца GOP. Лимит частоты IDR тут не действует.
+            char buf[96];
+            sprintf_s(buf, "nvEncLockBitstream failed (%d), frame %llu dropped, forcing IDR",
+                      (int)st, (unsigned long long)m_iGot);
             Log(buf);
-            return false;
+            m_lostFrames.fetch_add(1, std::memory_order_relaxed);
+            m_idrPending.store(true, std::memory_order_relaxed);
+            m_lastForcedIdrNs = 0;
+        }
+
+        if (slot.mapped) {
+            m_fn.nvEncUnmapInputResource(m_hEncoder, slot.mapped);
+            slot.mapped = nullptr;
         }
-        reg = rr.registeredResource;
-        m_texReg.emplace(srcTex, TexReg{reg});
-    } else {
-        reg = it->second.reg;
+        ++m_iGot;
+
+        // Ждём только самый старый кадр, остальные забираем, если уже готовы.
+        waitMs = 0;
     }
+}
 
+bool NvEncoderD3D11Base::IndexPacket(NvEncPacket& pkt, std::vector<uint8_t>& paramSets)
+{
+    const NalCodec nc = GetNalCodec();
+    BuildNalIndex(pkt.data.data(), pkt.data.size(), nc, pkt.data.nals());
+    pkt.keyframe = NalIndexHasIdr(pkt.data.nals(), nc);
+    return pkt.keyframe &&
+           ExtractParameterSets(pkt.data.data(), pkt.data.nals(), nc, paramSets);
+}
+
+void NvEncoderD3D11Base::WaitForFreeSlot(std::vector<NvEncPacket>& outPackets)
+{
+    // Кольцо заполнено - ждём самый старый кадр, чтобы освободить его слот.
+    while (m_iToSend - m_iGot >= m_slots.size())
+        CollectPackets(outPackets, INFINITE);
+}
+
+bool NvEncoderD3D11Base::SubmitFrame(EncSlot& slot, NV_ENC_REGISTERED_PTR reg,
+                                     uint32_t w, uint32_t h, int64_t ts100ns,
+                                     std::vector<NvEncPacket>& outPackets)
+{
     NV_ENC_MAP_INPUT_RESOURCE map = { NV_ENC_MAP_INPUT_RESOURCE_VER };
     map.registeredResource = reg;
     NVENCSTATUS st = m_fn.nvEncMapInputResource(m_hEncoder, &map);
@@ -246,74 +817,136 @@ bool NvEncoderD3D11Base::EncodeTexture(ID3D11Texture2D* tex, int64_t ts100ns,
         Log("nvEncMapInputResource failed");
         return false;
     }
+    slot.mapped = map.mappedResource;
 
     NV_ENC_PIC_PARAMS pic = { NV_ENC_PIC_PARAMS_VER };
-    pic.inputBuffer      = map.mappedResource;
+    pic.inputBuffer      = slot.mapped;
     pic.bufferFmt        = m_bufFmt;
-    pic.inputWidth       = desc.Width;
-    pic.inputHeight      = desc.Height;
+    pic.inputWidth       = w;
+    pic.inputHeight      = h;
     pic.pictureStruct    = NV_ENC_PIC_STRUCT_FRAME;
-    pic.outputBitstream  = m_bsBuf;
+    pic.outputBitstream  = slot.bs;
+    pic.completionEvent  = slot.event;
     pic.inputTimeStamp   = (uint64_t)ts100ns;
-    if (m_firstFrame) {
+
+    const int64_t nowNs = SteadyNowNs();
+    bool requestedIdr = false;
+    if (!m_firstFrame && nowNs - m_lastForcedIdrNs >= kMinForcedIdrIntervalNs)
+        requestedIdr = m_idrPending.exchange(false, std::memory_order_relaxed);
+    if (m_firstFrame || requestedIdr) {
         pic.encodePicFlags |= NV_ENC_PIC_FLAG_FORCEIDR;
-        m_firstFrame = false;
+        m_lastForcedIdrNs = nowNs;
     }
+    // Первый кадр и так IDR: запросы, пришедшие до него, им и выполнены,
+    // иначе через 250 мс вышел бы лишний IDR.
+    if (m_firstFrame)
+        m_idrPending.store(false, std::memory_order_relaxed);
+
+    if (slot.event)
+        ResetEvent(slot.event);
+    slot.submitNs = nowNs;
 
     st = m_fn.nvEncEncodePicture(m_hEncoder, &pic);
     if (st != NV_ENC_SUCCESS) {
         Log("nvEncEncodePicture failed");
-        m_fn.nvEncUnmapInputResource(m_hEncoder, &map);
+        // Кадр не ушёл - запрос IDR переходит на следующий.
+        if (requestedIdr)
+            m_idrPending.store(true, std::memory_order_relaxed);
+        m_fn.nvEncUnmapInputResource(m_hEncoder, slot.mapped);
+        slot.mapped = nullptr;
         return false;
     }
+    ++m_iToSend;
+    m_firstFrame = false;
+    if (requestedIdr)
+        m_idrForced.fetch_add(1, std::memory_order_relaxed);
 
-    NV_ENC_LOCK_BITSTREAM lock = { NV_ENC_LOCK_BITSTREAM_VER };
-    lock.outputBitstream = m_bsBuf;
-    lock.doNotWait = 0;
-    st = m_fn.nvEncLockBitstream(m_hEncoder, &lock);
-    if (st != NV_ENC_SUCCESS) {
-        Log("nvEncLockBitstream failed");
-        m_fn.nvEncUnmapInputResource(m_hEncoder, &map);
+    CollectPackets(outPackets, 0);
+    return true;
+}
+
+bool NvEncoderD3D11Base::EncodeTexture(ID3D11Texture2D* tex, int64_t ts100ns,
+                                       std::vector<NvEncPacket>& outPackets)
+{
+    outPackets.clear();
+    if (!m_hEncoder || m_slots.empty()) return false;
+
+    WaitForFreeSlot(outPackets);
+    EncSlot& slot = m_slots[m_iToSend % m_slots.size()];
+
+    if (!EnsureSlotTexture(slot, tex)) return false;
+    NV_ENC_REGISTERED_PTR reg = RegisterTexture(slot.tex.Get(), slot.texW, slot.texH);
+    if (!reg) return false;
+
+    return SubmitFrame(slot, reg, slot.texW, slot.texH, ts100ns, outPackets);
+}
+
+bool NvEncoderD3D11Base::EncodeTextureNoCopy(ID3D11Texture2D* tex, int64_t ts100ns,
+                                             std::vector<NvEncPacket>& outPackets,
+                                             uint64_t* frameIdx)
+{
+    outPackets.clear();
+    if (!m_hEncoder || m_slots.empty() || !tex) return false;
+
+    WaitForFreeSlot(outPackets);
+    EncSlot& slot = m_slots[m_iToSend % m_slots.size()];
+
+    D3D11_TEXTURE2D_DESC desc = {};
+    tex->GetDesc(&desc);
+
+    // Кадр уже в NV12 (проход на render thread) - только проверить размер.
+    const bool nv12 = desc.Format == DXGI_FORMAT_NV12;
+    if (nv12 && (desc.Width != m_w || desc.Height != m_h)) {
+        Log("EncodeTextureNoCopy: NV12 frame size differs from the encoder");
         return false;
     }
 
-    uint8_t* ptr = (uint8_t*)lock.bitstreamBufferPtr;
-    uint32_t sz  = lock.bitstreamSizeInBytes;
+    // Масштабирование и проход NV12 и так читают кадр напрямую и пишут
+    // в слот энкодера - лишней копии нет.
+    if (!nv12 && (desc.Width != m_w || desc.Height != m_h || UsesNv12Pass(tex))) {
+        if (!EnsureSlotTexture(slot, tex)) return false;
+        NV_ENC_REGISTERED_PTR reg = RegisterTexture(slot.tex.Get(), slot.texW, slot.texH);
+        if (!reg) return false;
 
-    if (sz > 0) {
-        std::vector<uint8_t> buf(ptr, ptr + sz);
-        outPackets.push_back(std::move(buf));
+        if (frameIdx)
+            *frameIdx = m_iToSend;
+        return SubmitFrame(slot, reg, slot.texW, slot.texH, ts100ns, outPackets);
     }
 
-    m_fn.nvEncUnlockBitstream(m_hEncoder, m_bsBuf);
-    m_fn.nvEncUnmapInputResource(m_hEncoder, &map);
+    DXGI_FORMAT typed;
+    NV_ENC_BUFFER_FORMAT bufFmt = NV_ENC_BUFFER_FORMAT_NV12;
+    if (!nv12 && (!MapInputFormat(desc.Format, typed, bufFmt) || typed != desc.Format)) {
+        Log("EncodeTextureNoCopy: texture format is not NVENC-compatible");
+        return false;
+    }
+    m_bufFmt = bufFmt;
 
-    return !outPackets.empty();
+    NV_ENC_REGISTERED_PTR reg = RegisterTexture(tex, desc.Width, desc.Height);
+    if (!reg) return false;
+
+    if (frameIdx)
+        *frameIdx = m_iToSend;
+    return SubmitFrame(slot, reg, desc.Width, desc.Height, ts100ns, outPackets);
 }
 
-void NvEncoderD3D11Base::Flush(std::vector<std::vector<uint8_t>>& outPackets)
+void NvEncoderD3D11Base::WaitForPackets(std::vector<NvEncPacket>& outPackets, uint32_t timeoutMs)
 {
     outPackets.clear();
-    if (!m_hEncoder) return;
+    if (!m_hEncoder || m_slots.empty()) return;
 
-    NV_ENC_PIC_PARAMS pic = { NV_ENC_PIC_PARAMS_VER };
-    pic.encodePicFlags = NV_ENC_PIC_FLAG_EOS;
-    pic.outputBitstream = m_bsBuf;
-    NVENCSTATUS st = m_fn.nvEncEncodePicture(m_hEncoder, &pic);
-    if (st != NV_ENC_SUCCESS) return;
+    CollectPackets(outPackets, timeoutMs);
+}
 
-    NV_ENC_LOCK_BITSTREAM lock = { NV_ENC_LOCK_BITSTREAM_VER };
-    lock.outputBitstream = m_bsBuf;
-    lock.doNotWait = 0;
-    st = m_fn.nvEncLockBitstream(m_hEncoder, &lock);
-    if (st != NV_ENC_SUCCESS) return;
+void NvEncoderD3D11Base::Flush(std::vector<NvEncPacket>& outPackets)
+{
+    outPackets.clear();
+    if (!m_hEncoder || m_slots.empty()) return;
 
-    uint8_t* ptr = (uint8_t*)lock.bitstreamBufferPtr;
-    uint32_t sz  = lock.bitstreamSizeInBytes;
-    if (sz > 0) {
-        std::vector<uint8_t> buf(ptr, ptr + sz);
-        outPackets.push_back(std::move(buf));
-    }
+    while (m_iGot < m_iToSend)
+        CollectPackets(outPackets, INFINITE);
 
-    m_fn.nvEncUnlockBitstream(m_hEncoder, m_bsBuf);
+    NV_ENC_PIC_PARAMS pic = { NV_ENC_PIC_PARAMS_VER };
+    pic.encodePicFlags = NV_ENC_PIC_FLAG_EOS;
+    pic.completionEvent = m_slots[m_iToSend % m_slots.size()].event;
+    m_fn.nvEncEncodePicture(m_hEncoder, &pic);
 }
@@ -17,42 +17,30 @@ void NvEncoderD3D11_H264::ConfigureCodec(NV_ENC_CONFIG& cfg, uint32_t fps, uint3
     cfg.encodeCodecConfig.h264Config.useBFramesAsRef = NV_ENC_BFRAME_REF_MODE_DISABLED;
 }
 
-AVCodecID NvEncoderD3D11_H264::GetAvCodecId() const
+void NvEncoderD3D11_H264::SetIdrPeriod(NV_ENC_CONFIG& cfg, uint32_t frames)
 {
-    return AV_CODEC_ID_H264;
+    cfg.encodeCodecConfig.h264Config.idrPeriod = frames;
 }
 
-bool NvEncoderD3D11_H264::PacketHasIdrImpl(const uint8_t* p, size_t n) const
+void NvEncoderD3D11_H264::ConfigureIntraRefresh(NV_ENC_CONFIG& cfg, uint32_t periodFrames)
 {
-    auto is_start = [&](size_t pos) -> bool {
-        if (pos + 3 >= n) return false;
-        if (p[pos] == 0 && p[pos+1] == 0 && p[pos+2] == 1)
-            return true;
-        if (pos + 4 <= n && p[pos] == 0 && p[pos+1] == 0 && p[pos+2] == 0 && p[pos+3] == 1)
-            return true;
-        return false;
-    };
-
-    size_t i = 0;
-    while (i + 4 < n) {
-        while (i + 4 < n && !is_start(i))
-            ++i;
-        if (!is_start(i)) break;
-
-        size_t nalStart = 0;
-        if (p[i] == 0 && p[i+1] == 0 && p[i+2] == 1)
-            nalStart = i + 3;
-        else
-            nalStart = i + 4;
+    cfg.encodeCodecConfig.h264Config.enableIntraRefresh = periodFrames ? 1 : 0;
+    cfg.encodeCodecConfig.h264Config.intraRefreshPeriod = periodFrames;
+    cfg.encodeCodecConfig.h264Config.intraRefreshCnt = periodFrames ? periodFrames - 1 : 0;
+    cfg.encodeCodecConfig.h264Config.outputRecoveryPointSEI = periodFrames ? 1 : 0;
+}
 
-        if (nalStart >= n)
-            break;
+void NvEncoderD3D11_H264::ConfigureColor(NV_ENC_CONFIG& cfg, NvrtspColorConversion mode)
+{
+    SetVuiColor(cfg.encodeCodecConfig.h264Config.h264VUIParameters, mode);
+}
 
-        uint8_t nal = p[nalStart] & 0x1F;
-        if (nal == 5)
-            return true;
+AVCodecID NvEncoderD3D11_H264::GetAvCodecId() const
+{
+    return AV_CODEC_ID_H264;
+}
 
-        i = nalStart + 1;
-    }
-    return false;
+NalCodec NvEncoderD3D11_H264::GetNalCodec() const
+{
+    return NalCodec::H264;
 }
@@ -6,14 +6,18 @@ class NvEncoderD3D11_H264 : public NvEncoderD3D11Base
 {
 public:
     NvEncoderD3D11_H264(ID3D11Device* dev, ID3D11DeviceContext* ctx,
-                        uint32_t w, uint32_t h, uint32_t fps, uint32_t bitrateKbps)
-        : NvEncoderD3D11Base(dev, ctx, w, h, fps, bitrateKbps)
+                        uint32_t w, uint32_t h, uint32_t fpsNum, uint32_t fpsDen,
+                        uint32_t bitrateKbps)
+        : NvEncoderD3D11Base(dev, ctx, w, h, fpsNum, fpsDen, bitrateKbps)
     {
     }
 
 protected:
     GUID CodecGuid() const override;
     void ConfigureCodec(NV_ENC_CONFIG& cfg, uint32_t fps, uint32_t bitrateKbps) override;
+    void SetIdrPeriod(NV_ENC_CONFIG& cfg, uint32_t frames) override;
+    void ConfigureIntraRefresh(NV_ENC_CONFIG& cfg, uint32_t periodFrames) override;
+    void ConfigureColor(NV_ENC_CONFIG& cfg, NvrtspColorConversion mode) override;
     AVCodecID GetAvCodecId() const override;
-    bool PacketHasIdrImpl(const uint8_t* p, size_t n) const override;
+    NalCodec GetNalCodec() const override;
 };
@@ -16,37 +16,30 @@ void NvEncoderD3D11_H265::ConfigureCodec(NV_ENC_CONFIG& cfg, uint32_t fps, uint3
     cfg.encodeCodecConfig.hevcConfig.useBFramesAsRef = NV_ENC_BFRAME_REF_MODE_DISABLED;
 }
 
-AVCodecID NvEncoderD3D11_H265::GetAvCodecId() const
+void NvEncoderD3D11_H265::SetIdrPeriod(NV_ENC_CONFIG& cfg, uint32_t frames)
 {
-    return AV_CODEC_ID_HEVC;
+    cfg.encodeCodecConfig.hevcConfig.idrPeriod = frames;
 }
 
-bool NvEncoderD3D11_H265::PacketHasIdrImpl(const uint8_t* p, size_t n) const
+void NvEncoderD3D11_H265::ConfigureIntraRefresh(NV_ENC_CONFIG& cfg, uint32_t periodFrames)
 {
-    auto is_start = [&](size_t pos) -> bool {
-        if (pos + 3 >= n) return false;
-        if (p[pos] == 0 && p[pos+1] == 0 && p[pos+2] == 1)
-            return true;
-        if (pos + 4 <= n && p[pos] == 0 && p[pos+1] == 0 && p[pos+2] == 0 && p[pos+3] == 1)
-            return true;
-        return false;
-    };
-
-    size_t i = 0;
-    while (i + 4 < n) {
-        while (i + 4 < n && !is_start(i))
-            ++i;
-        if (!is_start(i)) break;
+    cfg.encodeCodecConfig.hevcConfig.enableIntraRefresh = periodFrames ? 1 : 0;
+    cfg.encodeCodecConfig.hevcConfig.intraRefreshPeriod = periodFrames;
+    cfg.encodeCodecConfig.hevcConfig.intraRefreshCnt = periodFrames ? periodFrames - 1 : 0;
+    cfg.encodeCodecConfig.hevcConfig.outputRecoveryPointSEI = periodFrames ? 1 : 0;
+}
 
-        size_t nalStart = (p[i] == 0 && p[i+1] == 0 && p[i+2] == 1) ? i + 3 : i + 4;
-        if (nalStart + 1 >= n)
-            break;
+void NvEncoderD3D11_H265::ConfigureColor(NV_ENC_CONFIG& cfg, NvrtspColorConversion mode)
+{
+    SetVuiColor(cfg.encodeCodecConfig.hevcConfig.hevcVUIParameters, mode);
+}
 
-        uint8_t nalType = (p[nalStart] & 0x7E) >> 1;
-        if (nalType == 19 || nalType == 20)
-            return true;
+AVCodecID NvEncoderD3D11_H265::GetAvCodecId() const
+{
+    return AV_CODEC_ID_HEVC;
+}
 
-        i = nalStart + 1;
-    }
-    return false;
+NalCodec NvEncoderD3D11_H265::GetNalCodec() const
+{
+    return NalCodec::H265;
 }
@@ -0,0 +1,141 @@
+#include "NvencPacketPool.h"
+
+#include <cstring>
+#include <utility>
+
+NvEncPacketRef::NvEncPacketRef(NvEncPacketBlock* b)
+    : m_b(b)
+{
+    if (m_b)
+        m_b->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+NvEncPacketRef::NvEncPacketRef(const NvEncPacketRef& o)
+    : m_b(o.m_b)
+{
+    if (m_b)
+        m_b->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+NvEncPacketRef::NvEncPacketRef(NvEncPacketRef&& o) noexcept
+    : m_b(o.m_b)
+{
+    o.m_b = nullptr;
+}
+
+NvEncPacketRef& NvEncPacketRef::operator=(const NvEncPacketRef& o)
+{
+    if (this != &o) {
+        NvEncPacketRef tmp(o);
+        std::swap(m_b, tmp.m_b);
+    }
+    return *this;
+}
+
+NvEncPacketRef& NvEncPacketRef::operator=(NvEncPacketRef&& o) noexcept
+{
+    if (this != &o) {
+        Reset();
+        m_b = o.m_b;
+        o.m_b = nullptr;
+    }
+    return *this;
+}
+
+NvEncPacketRef::~NvEncPacketRef()
+{
+    Reset();
+}
+
+void NvEncPacketRef::Reset()
+{
+    NvEncPacketBlock* b = m_b;
+    m_b = nullptr;
+    if (!b)
+        return;
+
+    if (b->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        // Пул может умереть вместе с этой ссылкой, поэтому забираем её
+        // в локальную переменную и отпускаем уже после возврата блока.
+        std::shared_ptr<NvEncPacketPool> pool = std::move(b->owner);
+        pool->Release(b);
+    }
+}
+
+const std::vector<NalUnit>& NvEncPacketRef::nals() const
+{
+    static const std::vector<NalUnit> empty;
+    return m_b ? m_b->nals : empty;
+}
+
+std::vector<NalUnit>& NvEncPacketRef::nals()
+{
+    if (m_b)
+        return m_b->nals;
+    static thread_local std::vector<NalUnit> scratch;
+    scratch.clear();
+    return scratch;
+}
+
+NvEncPacketPool::~NvEncPacketPool()
+{
+    // Сюда попадаем только когда все блоки вернулись: выданные держат owner.
+    m_free.clear();
+    m_blocks.clear();
+}
+
+NvEncPacketRef NvEncPacketPool::Copy(const uint8_t* data, size_t size)
+{
+    NvEncPacketBlock* b = nullptr;
+    {
+        std::lock_guard<std::mutex> lk(m_mx);
+
+        // Ищем свободный блок, в который кадр влезает без перевыделения;
+        // если такого нет - берём самый большой и растим его.
+        size_t best = m_free.size();
+        for (size_t i = 0; i < m_free.size(); ++i) {
+            if (m_free[i]->storage.size() >= size) {
+                best = i;
+                break;
+            }
+            if (best == m_free.size() || m_free[i]->storage.size() > m_free[best]->storage.size())
+                best = i;
+        }
+
+        if (best < m_free.size()) {
+            b = m_free[best];
+            m_free[best] = m_free.back();
+            m_free.pop_back();
+        }
+        else {
+            m_blocks.push_back(std::make_unique<NvEncPacketBlock>());
+            b = m_blocks.back().get();
+            // Свободный список должен вместить все блоки без перевыделения при возврате.
+            m_free.reserve(m_blocks.size());
+        }
+    }
+
+    // storage хранит ёмкость, реальный размер кадра - в size; запас в полтора
+    // раза, чтобы колебания размера P-кадров не вызывали перевыделений.
+    if (b->storage.size() < size)
+        b->storage.resize(size + size / 2);
+
+    if (size)
+        std::memcpy(b->storage.data(), data, size);
+    b->size = size;
+    b->owner = shared_from_this();
+
+    return NvEncPacketRef(b);
+}
+
+size_t NvEncPacketPool::BlockCount() const
+{
+    std::lock_guard<std::mutex> lk(m_mx);
+    return m_blocks.size();
+}
+
+void NvEncPacketPool::Release(NvEncPacketBlock* b)
+{
+    std::lock_guard<std::mutex> lk(m_mx);
+    m_free.push_back(b);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "AnnexB.h"
+
+class NvEncPacketPool;
+
+// Блок памяти под один закодированный кадр. Живёт в пуле и переиспользуется,
+// ёмкость storage после прогрева не меняется, поэтому в установившемся режиме
+// на кадр нет ни одной аллокации.
+struct NvEncPacketBlock
+{
+    std::vector<uint8_t> storage;
+    size_t size = 0;
+    // Индекс NAL-юнитов кадра; строится один раз энкодером.
+    std::vector<NalUnit> nals;
+    std::atomic<int> refs{0};
+    // Держит пул живым, пока блок выдан наружу; у свободного блока пусто,
+    // чтобы не было цикла пул -> блок -> пул.
+    std::shared_ptr<NvEncPacketPool> owner;
+};
+
+// Ссылка на блок со счётчиком ссылок. Копирование - только атомарный инкремент,
+// последняя ссылка возвращает блок в пул.
+class NvEncPacketRef
+{
+public:
+    NvEncPacketRef() = default;
+    explicit NvEncPacketRef(NvEncPacketBlock* b);
+    NvEncPacketRef(const NvEncPacketRef& o);
+    NvEncPacketRef(NvEncPacketRef&& o) noexcept;
+    NvEncPacketRef& operator=(const NvEncPacketRef& o);
+    NvEncPacketRef& operator=(NvEncPacketRef&& o) noexcept;
+    ~NvEncPacketRef();
+
+    void Reset();
+
+    const uint8_t* data() const { return m_b ? m_b->storage.data() : nullptr; }
+    uint8_t* data() { return m_b ? m_b->storage.data() : nullptr; }
+    size_t size() const { return m_b ? m_b->size : 0; }
+    bool empty() const { return size() == 0; }
+
+    // У пустой ссылки индекс пуст; записанное в него через неконстантную
+    // версию никуда не попадает.
+    const std::vector<NalUnit>& nals() const;
+    std::vector<NalUnit>& nals();
+
+private:
+    NvEncPacketBlock* m_b = nullptr;
+};
+
+// Пул блоков под закодированные кадры. Создаётся через std::make_shared:
+// выданные блоки продлевают жизнь пула до возврата последней ссылки.
+class NvEncPacketPool : public std::enable_shared_from_this<NvEncPacketPool>
+{
+public:
+    NvEncPacketPool() = default;
+    ~NvEncPacketPool();
+
+    NvEncPacketPool(const NvEncPacketPool&) = delete;
+    NvEncPacketPool& operator=(const NvEncPacketPool&) = delete;
+
+    // Копирует данные в свободный блок (или заводит новый, если свободных нет).
+    NvEncPacketRef Copy(const uint8_t* data, size_t size);
+
+    // Сколько блоков заведено всего (свободных и выданных).
+    size_t BlockCount() const;
+
+private:
+    friend class NvEncPacketRef;
+    void Release(NvEncPacketBlock* b);
+
+    mutable std::mutex m_mx;
+    std::vector<std::unique_ptr<NvEncPacketBlock>> m_blocks;
+    std::vector<NvEncPacketBlock*> m_free;
+};
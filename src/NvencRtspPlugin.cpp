@@ -7,22 +7,36 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <cstring>
 
-#include <Windows.h>
-#include <d3d11.h>
-#include <d3d11_4.h>        // для ID3D11Multithread
-#include <wrl/client.h>
+#include "D3D11Compat.h"
 
 #include "IUnityInterface.h"
 #include "IUnityGraphics.h"
+#ifdef _WIN32
 #include "IUnityGraphicsD3D11.h"
+#endif
+
+#ifdef NVRTSP_FAKE_NVENC
+#include "FakeNvenc.h"
+#endif
 
 #include "NvencEncoder.h"
+#include "FrameCaptureRing.h"
+#include "FramePacer.h"
+#include "GopCache.h"
+#include "NetSocket.h"
+#include "PushSender.h"
+#include "StreamScheduler.h"
+#include "StreamStats.h"
+#include "RtspConnector.h"
+#include "RtcpRateControl.h"
+#include "RtspServer.h"
 
 extern "C" {
 #include <libavformat/avformat.h>
-#include <libavutil/opt.h>
 #include <libavutil/error.h>
+#include <libavutil/random_seed.h>
 }
 
 // -----------------------------------------------------------------------------
@@ -31,10 +45,12 @@ extern "C" {
 
 static IUnityInterfaces*                    g_unity         = nullptr;
 static IUnityGraphics*                      g_ugraphics     = nullptr;
+#ifdef _WIN32
 static IUnityGraphicsD3D11*                 g_ugraphicsD3D11= nullptr;
+static Microsoft::WRL::ComPtr<ID3D11Multithread>   g_multithread;
+#endif
 static Microsoft::WRL::ComPtr<ID3D11Device>        g_device;
 static Microsoft::WRL::ComPtr<ID3D11DeviceContext> g_context;
-static Microsoft::WRL::ComPtr<ID3D11Multithread>   g_multithread;
 
 static NvrtspLogCallback g_logCb = nullptr;
 
@@ -52,220 +68,872 @@ void Log(const char* msg)
 // FFmpeg / RTSP, состояние одного стрима (handle)
 // -----------------------------------------------------------------------------
 
-struct RtspState
+// Предел кэша GOP. Меньше лимита очереди TCP-клиента сервера, чтобы весь
+// кэш гарантированно уходил новому клиенту одним burst'ом.
+static const size_t kGopCacheMaxBytes = 4 * 1024 * 1024;
+
+// PUSH: бюджет задержки очереди на отправку по умолчанию и жёсткие пределы
+// очереди, общие для всех политик (NvrtspBackpressurePolicy).
+static const int64_t  kDefaultLatencyBudgetNs = 500000000;
+static const int64_t  kHardBudgetFactor = 4;
+static const uint32_t kSendQueueMaxFrames = 256;
+static const uint64_t kSendQueueMaxBytes = 16 * 1024 * 1024;
+
+struct RtspState : ScheduledStream
 {
     std::mutex mx;
     std::atomic<bool> running{false};
-    std::thread worker;
+
+    // Шаги стрима выполняет общий пул (g_scheduler), а не свой поток.
+    int schedId = -1;
+    // Счётчики пула прошлых запусков (под mx): пул забывает стрим в Remove.
+    StreamSchedStats schedDone;
+    std::unique_ptr<FramePacer> pacer;
+    // Вектор живёт весь стрим: после прогрева clear() не освобождает память.
+    std::vector<NvEncPacket> packets;
+
+    StreamStep RunStep(int64_t nowNs) override;
 
     ID3D11Texture2D* srcTex = nullptr;
     uint32_t w = 0, h = 0, fps = 30, bitrate = 4000;
+    // Точная частота (30000/1001): с ней пейсер пересоздаётся в NVRTSP_Start.
+    uint32_t fpsNum = 30, fpsDen = 1;
+
+    // Изменения из NVRTSP_SetBitrate/SetFramerate/SetGopLength: применяются
+    // шагом стрима между кадрами (NVENC перенастраивается с потока кодирования).
+    // 0 - без изменений; частота упакована как (num << 32) | den.
+    std::atomic<uint32_t> pendingBitrate{0};
+    std::atomic<uint64_t> pendingFps{0};
+    std::atomic<uint32_t> pendingGop{0};
+    // NVRTSP_RequestKeyframe: передаётся энкодеру тем же шагом.
+    std::atomic<bool> pendingKeyframe{false};
+    // NVRTSP_SetIntraRefresh: период в кадрах, 0 - выключить, -1 - без изменений.
+    std::atomic<int32_t> pendingIntraRefresh{-1};
+    // NVRTSP_SetColorConversion: NvrtspColorConversion, -1 - без изменений.
+    std::atomic<int32_t> pendingColor{-1};
+    // NVRTSP_SetScaleFilter: NvrtspScaleFilter, -1 - без изменений.
+    std::atomic<int32_t> pendingScaleFilter{-1};
+    // NVRTSP_SetBackpressurePolicy: (policy << 32) | бюджет в мс, 0 - без изменений.
+    std::atomic<uint64_t> pendingBackpressure{0};
+    // NVRTSP_SetRtpMtu: 0 - без изменений.
+    std::atomic<uint32_t> pendingMtu{0};
+    // NVRTSP_SetRtpPacing: (1 << 63) | (доля в тысячных << 32) | ведро в байтах,
+    // 0 - без изменений.
+    std::atomic<uint64_t> pendingPacing{0};
+    // NVRTSP_SetAdaptiveBitrate: (1 << 63) | (вкл << 32) | минимум в кбит/с,
+    // 0 - без изменений.
+    std::atomic<uint64_t> pendingAdaptive{0};
+
+    // Счётчики для NVRTSP_GetStats; в горячем пути только атомики.
+    StreamStats stats;
+
+    // Последний GOP: отдаётся новым клиентам сервера и новому push-соединению.
+    GopCache gopCache{kGopCacheMaxBytes};
+    std::vector<NvEncPacket> gopScratch;
 
     NvrtspCodec codec = NVRTSP_CODEC_H264;
+    NvrtspOutputMode outputMode = NVRTSP_OUTPUT_PUSH;
 
     std::wstring rtspUrlW;
 
     std::unique_ptr<NvEncoderD3D11Base> encoder;
-
+    // NVRTSP_Stop закрывает сессию NVENC, NVRTSP_Start создаёт новую с
+    // текущими битрейтом и частотой; остальные настройки - отсюда.
+    NvEncSettings encSettings;
+
+    // Кадры, снятые на render thread Unity (NVRTSP_GetRenderEventFunc), уже
+    // в размере и формате энкодера. Пока захватов не было, стрим сам копирует
+    // srcTex по таймеру. У ступени своё кольцо: её кадр готовит тот же
+    // render-событие ladder.
+    std::unique_ptr<FrameCaptureRing> capture;
+    int renderEventId = -1;
+    // NVRTSP_SetScaleFilter: фильтр масштабирования на render thread.
+    NvrtspScaleFilter scaleFilter = NVRTSP_SCALE_BILINEAR;
+
+    // PUSH: FFmpeg-мультиплексор rtsp; подключается в фоне, пока его нет,
+    // кадры кодируются и отбрасываются. Пишет в oc поток sender'а, шаг
+    // только ставит кадры в его очередь.
+    std::unique_ptr<RtspConnector> connector;
+    std::unique_ptr<PushSender>    sender;
     AVFormatContext* oc = nullptr;
     AVStream*        vst = nullptr;
     bool headerWritten = false;
+
+    // Реакция на отставание сети; состояние меняет только шаг стрима.
+    NvrtspBackpressurePolicy bpPolicy = NVRTSP_BACKPRESSURE_DROP_NONREF;
+    int64_t  bpBudgetNs = kDefaultLatencyBudgetNs;
+    bool     bpSkipping = false;    // SKIP_ENCODE: тики пропускаются
+    uint32_t bpKbps = 0;            // сниженный битрейт (LOWER_BITRATE, RTCP), 0 - заданный
+    int64_t  bpChangeNs = 0;        // когда битрейт меняли последний раз
+    int64_t  bpCalmNs = 0;          // с какого момента очередь почти пуста
+
+    // SERVER: встроенный сервер и пакетизатор; кадр пакетизируется один раз
+    std::unique_ptr<RtspServer>    server;
+    std::unique_ptr<RtpPacketizer> packetizer;
+    RtpPacketBatch rtpBatch;
+    RtpPacketBatch rtpBurst;    // кэш GOP для подключившихся клиентов
+    std::vector<NvEncPacketRef> rtpBurstFrames;     // блоки кадров rtpBurst
+    std::vector<uint32_t> gopRtpTs;                 // RTP-время кадров rtpBurst
+    uint32_t rtpTsOffset = 0;
+    int64_t rtpTsBase100ns = -1;    // метка первого кадра, от неё идёт RTP-время
+    uint32_t rtpMtu = RtpPacketizer::kRtpDefaultMtu;
+    RtpPacingConfig rtpPacing;
+    // NVRTSP_SetAdaptiveBitrate: битрейт по RTCP-отчётам клиентов.
+    bool rtcpAdaptive = false;
+    RtcpRateControl rtcpRate;
+    // NVRTSP_SetMulticast (под mx): применяется к серверу и при каждом его старте.
+    RtpMulticastConfig multicast;
+    std::vector<uint8_t> sdpParamSets;
+
+    // Simulcast (NVRTSP_AddRendition). У ступени ladder - стрим, на шаге
+    // которого она кодирует; своего захвата, pacer'а и места в пуле нет.
+    RtspState* ladder = nullptr;
+    // У ladder - его ступени. Шаг держит renditionsMx, пока кодирует их,
+    // поэтому Stop/Destroy ступени не застанут её посреди кадра.
+    std::mutex renditionsMx;
+    std::vector<RtspState*> renditions;
+    // Тот же список меняется ещё и под captureMx: render thread берёт только
+    // его и не ждёт, пока шаг кодирует ступени.
+    std::mutex captureMx;
 };
 
-static AVRational g_tb = {1, 90000};
+// Render-события Unity: eventId -> handle. Под g_handlesMx, чтобы
+// NVRTSP_Destroy не удалил состояние посреди захвата на render thread.
+static const int kMaxRenderEvents = 64;
+static int g_renderEventBase = 0x4E565200;   // 'NVR\0', если Unity не выдал диапазон
+static std::mutex g_handlesMx;
+static std::vector<RtspState*> g_handles;
+
+// Общий пул потоков всех стримов; создаётся при первом NVRTSP_Start.
+// Не статический объект: потоки нельзя join'ить из деструкторов при выгрузке DLL.
+static std::mutex g_schedMx;
+static StreamScheduler* g_scheduler = nullptr;
+static uint32_t g_workerThreads = 0;   // 0 - по числу ядер, не больше 4
+
+static int64_t now_ts100ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count() / 100;
+}
+
+static std::string narrow_url(const std::wstring& w)
+{
+    char url[1024] = {};
+    std::wcstombs(url, w.c_str(), sizeof(url) - 1);
+    return url;
+}
+
+// Порт, на котором слушает встроенный сервер стрима; 0 - не SERVER или
+// адрес не разобран (тогда ошибку покажет сам старт сервера).
+static uint16_t server_port(const RtspState& s)
+{
+    std::string host, path;
+    uint16_t port = 0;
+    if (s.outputMode != NVRTSP_OUTPUT_SERVER ||
+        !NetParseRtspUrl(narrow_url(s.rtspUrlW), host, port, path))
+        return 0;
+    return port;
+}
+
+static NalCodec nal_codec(NvrtspCodec codec)
+{
+    switch (codec) {
+    case NVRTSP_CODEC_H265: return NalCodec::H265;
+    case NVRTSP_CODEC_AV1:  return NalCodec::AV1;
+    default:                return NalCodec::H264;
+    }
+}
 
 static void close_rtsp_locked(RtspState& s)
 {
     if (s.oc) {
-        if (s.headerWritten) {
-            av_write_trailer(s.oc);
-        }
-        avformat_free_context(s.oc);
+        if (s.headerWritten)
+            RtspConnector::CloseOutput(s.oc);
+        else
+            avformat_free_context(s.oc);
     }
     s.oc = nullptr;
     s.vst = nullptr;
     s.headerWritten = false;
 }
 
-static bool open_rtsp_output_locked(RtspState& s)
+static RtspPushParams push_params(RtspState& s)
 {
-    close_rtsp_locked(s);
+    RtspPushParams p;
+    p.url = narrow_url(s.rtspUrlW);
+    p.codecId = s.encoder ? s.encoder->GetCodecId() : AV_CODEC_ID_NONE;
+    p.w = s.w;
+    p.h = s.h;
+    if (s.encoder)
+        p.extradata = s.encoder->GetParameterSets();
+    return p;
+}
 
-    char url[1024] = {};
-    std::wcstombs(url, s.rtspUrlW.c_str(), sizeof(url) - 1);
+// Запись кадра в мультиплексор; на потоке PushSender или, после его
+// остановки, при дописывании хвоста энкодера.
+static bool write_annexb_packet(AVFormatContext* oc, int streamIndex, const NvEncPacket& p)
+{
+    AVPacket pkt;
+    av_init_packet(&pkt);
+    pkt.data = const_cast<uint8_t*>(p.data.data());
+    pkt.size = (int)p.data.size();
+    pkt.stream_index = streamIndex;
+
+    if (p.ts100ns > 0) {
+        int64_t pts90k = (p.ts100ns * 9) / 1000;
+        pkt.pts = pkt.dts = pts90k;
+    }
 
-    avformat_network_init();
+    if (p.keyframe)
+        pkt.flags |= AV_PKT_FLAG_KEY;
 
-    const AVOutputFormat* ofmt = av_guess_format("rtsp", nullptr, nullptr);
-    if (!ofmt) {
-        Log("av_guess_format(rtsp) failed");
+    // Поток один, интерлив не нужен; в отличие от av_interleaved_write_frame,
+    // av_write_frame не копирует данные не-refcounted пакета.
+    int ret = av_write_frame(oc, &pkt);
+    if (ret < 0) {
+        char err[256];
+        av_strerror(ret, err, sizeof(err));
+        Log(err);
         return false;
     }
+    return true;
+}
+
+static bool send_annexb_packet_locked(RtspState& s, const NvEncPacket& p)
+{
+    if (!s.oc || !s.vst || !s.headerWritten)
+        return false;
 
-    if (avformat_alloc_output_context2(&s.oc, ofmt, "rtsp", url) < 0) {
-        Log("avformat_alloc_output_context2 failed");
+    int64_t t0 = StreamScheduler::NowNs();
+    bool ok = write_annexb_packet(s.oc, s.vst->index, p);
+    s.stats.muxLatency.Record(StreamScheduler::NowNs() - t0);
+    if (!ok)
         return false;
+
+    s.stats.framesSent.fetch_add(1, std::memory_order_relaxed);
+    s.stats.bytesOut.fetch_add(p.data.size(), std::memory_order_relaxed);
+    return true;
+}
+
+// Кадры в очередь отправки. Пока соединения нет, PushSender их отбрасывает
+// (framesDropped), кодирование идёт.
+static void send_packets_locked(RtspState& s, const std::vector<NvEncPacket>& packets)
+{
+    if (!s.sender) {
+        s.stats.framesDropped.fetch_add(packets.size(), std::memory_order_relaxed);
+        return;
     }
 
-    av_opt_set(s.oc->priv_data, "rtsp_transport", "tcp", 0);
-    av_opt_set(s.oc->priv_data, "muxdelay",      "0",   0);
-    av_opt_set(s.oc->priv_data, "muxpreload",    "0",   0);
+    for (const NvEncPacket& p : packets)
+        s.sender->Enqueue(p);
+}
 
-    s.vst = avformat_new_stream(s.oc, nullptr);
-    if (!s.vst) {
-        Log("avformat_new_stream failed");
-        close_rtsp_locked(s);
-        return false;
+// Забирает готовое соединение у коннектора или просит подключиться;
+// оборванное отдаёт на переподключение.
+static void poll_push_connection(RtspState& s)
+{
+    if (s.oc) {
+        if (!s.sender->TakeFailed())
+            return;
+
+        Log("RTSP stream: av_write_frame failed, reconnecting in background");
+        s.stats.reconnects.fetch_add(1, std::memory_order_relaxed);
+        // Поток отправки соединение больше не трогает; закрытие мёртвого
+        // соединения тоже может ждать таймаут - в фоне.
+        s.connector->Reconnect(s.oc, push_params(s));
+        s.oc = nullptr;
+        s.vst = nullptr;
+        s.headerWritten = false;
+        return;
     }
 
-    AVCodecID codecId = s.encoder ? s.encoder->GetCodecId() : AV_CODEC_ID_NONE;
-    if (codecId == AV_CODEC_ID_NONE) {
-        Log("RTSP: no encoder for stream");
-        close_rtsp_locked(s);
+    if (AVFormatContext* oc = s.connector->TakeConnected()) {
+        s.oc = oc;
+        s.vst = oc->streams[0];
+        s.headerWritten = true;
+        Log("RTSP stream: RTSP opened");
+
+        const int streamIndex = s.vst->index;
+        s.sender->Activate([oc, streamIndex](const NvEncPacket& p) {
+            return write_annexb_packet(oc, streamIndex, p);
+        });
+
+        // Сервер-ретранслятор сразу получает декодируемый поток: последний
+        // GOP уходит до живых кадров, а свежий IDR приходит следом.
+        s.gopCache.Snapshot(s.gopScratch);
+        if (!s.gopScratch.empty())
+            send_packets_locked(s, s.gopScratch);
+        s.gopScratch.clear();
+        if (s.encoder)
+            s.encoder->RequestKeyframe();
+    }
+    else if (!s.connector->Connecting()) {
+        if (!s.encoder || s.encoder->GetCodecId() == AV_CODEC_ID_NONE) {
+            Log("RTSP: no encoder for stream");
+            return;
+        }
+        s.connector->Connect(push_params(s));
+    }
+}
+
+static bool start_server_locked(RtspState& s)
+{
+    s.server.reset(new RtspServer());
+    if (!s.server->Start(narrow_url(s.rtspUrlW))) {
+        s.server.reset();
         return false;
     }
 
-    s.vst->id = 0;
-    s.vst->time_base = g_tb;
-    s.vst->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
-    s.vst->codecpar->codec_id   = codecId;
-    s.vst->codecpar->format     = AV_PIX_FMT_YUV420P;
-    s.vst->codecpar->width      = s.w;
-    s.vst->codecpar->height     = s.h;
+    s.packetizer.reset(new RtpPacketizer(
+        nal_codec(s.codec), 96, av_get_random_seed(), (uint16_t)av_get_random_seed(), s.rtpMtu));
+    s.rtpTsOffset = av_get_random_seed();
+    s.rtpTsBase100ns = -1;
+    s.sdpParamSets.clear();
 
-    AVDictionary* opts = nullptr;
-    av_dict_set(&opts, "rtsp_transport", "tcp",     0);
-    av_dict_set(&opts, "muxdelay",       "0",       0);
-    av_dict_set(&opts, "muxpreload",     "0",       0);
-    av_dict_set(&opts, "stimeout",       "2000000", 0); // 2s
-    av_dict_set(&opts, "timeout",        "2000000", 0);
+    SdpVideoDesc desc;
+    desc.codec = nal_codec(s.codec);
+    s.server->SetVideoDesc(desc);
 
-    int ret = avformat_write_header(s.oc, &opts);
-    av_dict_free(&opts);
+    // Без группы сервер всё равно работает для клиентов RTSP.
+    if (!s.multicast.group.empty())
+        s.server->SetMulticast(s.multicast);
+    return true;
+}
 
-    if (ret < 0) {
-        char err[256];
-        av_strerror(ret, err, sizeof(err));
-        Log(err);
-        close_rtsp_locked(s);
-        return false;
+static void stop_server_locked(RtspState& s)
+{
+    if (s.server)
+        s.server->Stop();
+    s.server.reset();
+    s.packetizer.reset();
+}
+
+// RTP-время (90 кГц) кадра. Считается от первого кадра с округлением:
+// метки пейсера на сетке num/den дают ровный шаг (3003 при 30000/1001),
+// а усечение абсолютной метки чередовало бы 3002 и 3003.
+static uint32_t rtp_timestamp(RtspState& s, int64_t ts100ns)
+{
+    if (s.rtpTsBase100ns < 0)
+        s.rtpTsBase100ns = ts100ns;
+    const int64_t d = (ts100ns - s.rtpTsBase100ns) * 9;
+    return (uint32_t)((d >= 0 ? d + 500 : d - 500) / 1000) + s.rtpTsOffset;
+}
+
+// Кэш GOP для клиентов, только что начавших PLAY: остальные клиенты эти
+// пакеты не получают.
+static void serve_gop_to_joiners(RtspState& s)
+{
+    s.gopCache.Snapshot(s.gopScratch);
+    s.gopRtpTs.clear();
+    for (const NvEncPacket& p : s.gopScratch)
+        s.gopRtpTs.push_back(rtp_timestamp(s, p.ts100ns));
+    PacketizeGopBurst(*s.packetizer, s.gopScratch, s.gopRtpTs, s.rtpBurst, s.rtpBurstFrames);
+
+    s.server->SendToJoiners(s.rtpBurst, s.rtpBurstFrames);
+    s.gopScratch.clear();
+    s.rtpBurstFrames.clear();
+}
+
+// SERVER: битрейт по отчётам клиентов о приёме (RtcpRateControl). Снижает
+// тот же bpKbps, что LOWER_BITRATE в PUSH; заданный битрейт - потолок.
+static void adapt_bitrate_rtcp(RtspState& s)
+{
+    if (uint64_t adaptive = s.pendingAdaptive.exchange(0)) {
+        s.rtcpAdaptive = ((adaptive >> 32) & 1) != 0;
+        s.rtcpRate.Reset(s.bitrate, (uint32_t)adaptive);
+        // Отчёты, накопленные до включения, описывают прошлое.
+        RtcpReceiverReport stale;
+        s.server->TakeReceiverReport(stale);
+        if (s.bpKbps && s.encoder->Reconfigure(s.bitrate, 0, 0, 0))
+            s.bpKbps = 0;
     }
+    if (!s.rtcpAdaptive)
+        return;
 
-    s.headerWritten = true;
-    Log("RTSP: avformat_write_header OK");
-    return true;
+    // NVRTSP_SetBitrate: новый потолок, начинаем с него.
+    if (s.rtcpRate.MaxKbps() != s.bitrate)
+        s.rtcpRate.Reset(s.bitrate, s.rtcpRate.MinKbps());
+
+    RtcpReceiverReport r;
+    if (!s.server->TakeReceiverReport(r))
+        return;
+
+    const uint32_t cur = s.bpKbps ? s.bpKbps : s.bitrate;
+    const uint32_t next = s.rtcpRate.OnReport(r, StreamScheduler::NowNs());
+    if (next == cur || !s.encoder->Reconfigure(next, 0, 0, 0))
+        return;
+    s.bpKbps = next == s.bitrate ? 0 : next;
+
+    if (next < cur) {
+        char buf[160];
+        sprintf_s(buf, "RTSP server: receiver loss %.1f%%, rtt %.0f ms, bitrate %u -> %u kbps",
+                  r.lossFraction * 100.0, r.rttMs, cur, next);
+        Log(buf);
+    }
 }
 
-static bool send_annexb_packet_locked(RtspState& s,
-                                      const uint8_t* data, size_t len, int64_t ts100ns)
+// Пакетизирует кадры один раз и раздаёт всем клиентам встроенного сервера.
+static void serve_packets(RtspState& s, const std::vector<NvEncPacket>& packets)
 {
-    if (!s.oc || !s.vst || !s.headerWritten)
-        return false;
+    if (!s.server || !s.packetizer)
+        return;
 
-    bool keyframe = s.encoder ? s.encoder->PacketHasIdr(data, len) : false;
+    // Новый размер пакета - с этого кадра; переживает и перезапуск сервера.
+    if (uint32_t mtu = s.pendingMtu.exchange(0)) {
+        s.rtpMtu = mtu;
+        s.packetizer->SetMtu(mtu);
+    }
 
-    AVPacket pkt;
-    av_init_packet(&pkt);
-    pkt.data = const_cast<uint8_t*>(data);
-    pkt.size = (int)len;
-    pkt.stream_index = s.vst->index;
+    adapt_bitrate_rtcp(s);
 
-    if (ts100ns > 0) {
-        int64_t pts90k = (ts100ns * 9) / 1000;
-        pkt.pts = pkt.dts = pts90k;
+    // Пейсинг идёт за текущими fps и битрейтом (в том числе сниженным).
+    if (uint64_t pacing = s.pendingPacing.exchange(0)) {
+        s.rtpPacing.fraction = (double)((pacing >> 32) & 0x7FFFFFFF) / 1000.0;
+        s.rtpPacing.burstBytes = (uint32_t)pacing;
+    }
+    s.rtpPacing.frameIntervalNs = s.fpsNum ? 1000000000LL * s.fpsDen / s.fpsNum : 0;
+    s.rtpPacing.bitrateKbps = s.bpKbps ? s.bpKbps : s.bitrate;
+    s.server->SetPacing(s.rtpPacing);
+
+    // Новые SPS/PPS попадают в SDP для следующих DESCRIBE.
+    const std::vector<uint8_t>& ps = s.encoder->GetParameterSets();
+    if (ps != s.sdpParamSets) {
+        s.sdpParamSets = ps;
+        SdpVideoDesc desc;
+        desc.codec = nal_codec(s.codec);
+        desc.parameterSets = ps;
+        s.server->SetVideoDesc(desc);
     }
 
-    if (keyframe)
-        pkt.flags |= AV_PKT_FLAG_KEY;
+    // RTCP PLI/FIR от клиента: он потерял опорный кадр.
+    if (s.server->TakeKeyframeRequest())
+        s.encoder->RequestKeyframe();
+
+    // Новые клиенты: если кадр и так ключевой, начнут с него. Короткий GOP
+    // отдаём из кэша; длинный (больше секунды) клиент проигрывал бы с
+    // заметной задержкой - тогда он ждёт IDR, запрошенный ради него.
+    if (s.server->HasPendingJoins() && !packets.empty() && !packets[0].keyframe) {
+        uint32_t cached = s.gopCache.Frames();
+        if (cached && cached <= s.fps) {
+            serve_gop_to_joiners(s);
+        }
+        else {
+            s.encoder->RequestKeyframe();
+            s.rtpBurst.Clear();
+            s.server->SendToJoiners(s.rtpBurst);
+        }
+    }
 
-    int ret = av_interleaved_write_frame(s.oc, &pkt);
-    if (ret < 0) {
-        char err[256];
-        av_strerror(ret, err, sizeof(err));
-        Log(err);
-        return false;
+    for (const NvEncPacket& p : packets) {
+        int64_t t0 = StreamScheduler::NowNs();
+        uint32_t rtpTs = rtp_timestamp(s, p.ts100ns);
+        s.packetizer->Packetize(p.data.data(), p.data.nals(), rtpTs, p.keyframe, s.rtpBatch);
+        s.server->Broadcast(s.rtpBatch, p.data);
+        s.stats.muxLatency.Record(StreamScheduler::NowNs() - t0);
+
+        s.stats.framesSent.fetch_add(1, std::memory_order_relaxed);
+        s.stats.bytesOut.fetch_add(p.data.size(), std::memory_order_relaxed);
     }
+}
 
-    return true;
+// Отдаёт пакеты в выбранный выход.
+static void deliver_packets(RtspState& s, const std::vector<NvEncPacket>& packets)
+{
+    s.stats.framesEncoded.fetch_add(packets.size(), std::memory_order_relaxed);
+    if (s.outputMode == NVRTSP_OUTPUT_SERVER)
+        serve_packets(s, packets);
+    else
+        send_packets_locked(s, packets);
+
+    for (const NvEncPacket& p : packets) {
+        s.stats.frameBytes.Record((int64_t)p.data.size());
+        s.gopCache.Push(p);
+    }
 }
 
-// worker одного handle
-static void rtsp_worker_thread(RtspState* s)
+// Дочитывание кадров, уже отправленных в NVENC: шаг пула не ждёт энкодер,
+// а заглядывает снова через kCollectPollNs.
+static const int64_t kCollectPollNs = 1000000;
+
+// Кадр из FrameCaptureRing: текстура слота уходит в NVENC без копии, слот
+// освобождается, когда NVENC отдаст этот кадр.
+static void encode_captured_frame(RtspState& s, NvEncoderD3D11Base* enc, const CapturedFrame& frame)
 {
-    Log("RTSP worker thread started");
-    const double frameDurMs = 1000.0 / (s->fps ? s->fps : 30);
-    auto nextTime = std::chrono::steady_clock::now();
+    uint64_t frameIdx = 0;
+    if (!enc->EncodeTextureNoCopy(frame.tex, frame.ts100ns, s.packets, &frameIdx)) {
+        s.capture->Release(frame.slot);
+        return;
+    }
+    s.capture->MarkSubmitted(frame.slot, frameIdx);
+    deliver_packets(s, s.packets);
+}
 
-    bool rtspReady = false;
+// Размер кодирования и проход NV12 для кадров, которые готовит render thread.
+static void update_capture_format(RtspState& s, NvEncoderD3D11Base* enc)
+{
+    if (!s.capture)
+        return;
+    CaptureFormat f;
+    f.w = s.w;
+    f.h = s.h;
+    f.nv12 = enc->ColorConversion() != NVRTSP_COLOR_NVENC;
+    f.range = enc->ColorConversion() == NVRTSP_COLOR_NV12_FULL ? Nv12Range::Full
+                                                                : Nv12Range::Limited;
+    f.filter = s.scaleFilter == NVRTSP_SCALE_LANCZOS ? ScaleFilter::Lanczos
+                                                     : ScaleFilter::Bilinear;
+    s.capture->SetFormat(f);
+}
 
-    while (s->running) {
-        nextTime += std::chrono::milliseconds((int)frameDurMs);
+// Перенастройка энкодера и темпа стрима по запросам NVRTSP_Set*.
+static void apply_pending_config(RtspState& s, NvEncoderD3D11Base* enc)
+{
+    if (s.pendingKeyframe.exchange(false))
+        enc->RequestKeyframe();
+
+    int32_t irPeriod = s.pendingIntraRefresh.exchange(-1);
+    if (irPeriod >= 0)
+        enc->SetIntraRefresh((uint32_t)irPeriod);
+
+    int32_t color = s.pendingColor.exchange(-1);
+    int32_t filter = s.pendingScaleFilter.exchange(-1);
+    if (color >= 0)
+        enc->SetColorConversion((NvrtspColorConversion)color);
+    if (filter >= 0) {
+        enc->SetScaleFilter((NvrtspScaleFilter)filter);
+        s.scaleFilter = (NvrtspScaleFilter)filter;
+    }
+    if (color >= 0 || filter >= 0)
+        update_capture_format(s, enc);
+
+    uint32_t kbps = s.pendingBitrate.exchange(0);
+    uint64_t fps = s.pendingFps.exchange(0);
+    uint32_t gop = s.pendingGop.exchange(0);
+    if (!kbps && !fps && !gop)
+        return;
 
-        // --- минимальный критический участок: просто читаем состояние ---
-        ID3D11Texture2D* tex = nullptr;
-        std::unique_ptr<NvEncoderD3D11Base>* encPtr = nullptr;
+    uint32_t fpsNum = (uint32_t)(fps >> 32);
+    uint32_t fpsDen = (uint32_t)fps;
+
+    if (!enc->Reconfigure(kbps, fpsNum, fpsDen, gop))
+        return;
+
+    // Заданный битрейт заменяет и сниженный по LOWER_BITRATE.
+    if (kbps) {
+        s.bitrate = kbps;
+        s.bpKbps = 0;
+    }
+
+    if (fps) {
+        s.fps = (fpsNum + fpsDen / 2) / fpsDen;
+        s.fpsNum = fpsNum;
+        s.fpsDen = fpsDen;
+        // Ступени кодируют кадры ladder: их rate control идёт за его fps.
         {
-            std::lock_guard<std::mutex> lk(s->mx);
+            std::lock_guard<std::mutex> lk(s.renditionsMx);
+            for (RtspState* r : s.renditions)
+                r->pendingFps = fps;
+        }
+        if (s.capture)
+            s.capture->SetFrameRate(fpsNum, fpsDen);
+        if (!s.pacer)
+            return;
+        s.pacer->SetRate(fpsNum, fpsDen);
+
+        std::lock_guard<std::mutex> lk(g_schedMx);
+        if (g_scheduler && s.schedId >= 0)
+            g_scheduler->SetPeriod(s.schedId, s.pacer->NominalPeriodNs());
+    }
+}
 
-            if (!s->running)
-                break;
+// Очередь отправки старше бюджета: всё до свежего ключевого кадра вон,
+// а если его в очереди нет - ждём новый IDR.
+static void flush_send_queue(RtspState& s, NvEncoderD3D11Base* enc, int64_t nowNs)
+{
+    bool needKeyframe = false;
+    size_t n = s.sender->DropToKeyframe(nowNs - s.bpBudgetNs, needKeyframe);
+    if (needKeyframe)
+        enc->RequestKeyframe();
+
+    char buf[128];
+    sprintf_s(buf, "RTSP stream: send queue over budget, %zu frames dropped%s",
+              n, needKeyframe ? ", waiting for IDR" : "");
+    Log(buf);
+}
+
+// LOWER_BITRATE: очередь старше бюджета - битрейт x0.7, но только когда до
+// головы очереди дошли кадры после прошлого снижения (иначе оно ещё не
+// сказалось); очередь почти пуста 2 с - +10%, пока не вернёмся к заданному.
+static const uint32_t kBitrateFloorKbps = 250;
+static const int64_t  kBitrateRaiseDelayNs = 2000000000;
+
+static void adapt_bitrate(RtspState& s, NvEncoderD3D11Base* enc, int64_t age, int64_t nowNs)
+{
+    const uint32_t cur = s.bpKbps ? s.bpKbps : s.bitrate;
+    uint32_t next = cur;
+
+    if (age > s.bpBudgetNs) {
+        if (nowNs - age < s.bpChangeNs)
+            return;
+        const uint32_t floor = s.bitrate < kBitrateFloorKbps ? s.bitrate : kBitrateFloorKbps;
+        next = cur * 7 / 10;
+        if (next < floor)
+            next = floor;
+    }
+    else if (age >= s.bpBudgetNs / 4) {
+        s.bpCalmNs = nowNs;
+        return;
+    }
+    else if (s.bpKbps) {
+        if (nowNs - s.bpCalmNs < kBitrateRaiseDelayNs || nowNs - s.bpChangeNs < kBitrateRaiseDelayNs)
+            return;
+        next = cur + cur / 10 + 1;
+        if (next > s.bitrate)
+            next = s.bitrate;
+    }
+
+    if (next == cur || !enc->Reconfigure(next, 0, 0, 0))
+        return;
+
+    s.bpKbps = next == s.bitrate ? 0 : next;
+    s.bpChangeNs = nowNs;
+    s.bpCalmNs = nowNs;
+
+    if (next < cur) {
+        char buf[128];
+        sprintf_s(buf, "RTSP stream: send queue over budget, bitrate %u -> %u kbps", cur, next);
+        Log(buf);
+    }
+}
+
+// Политика при отставании PUSH-соединения - по возрасту самого старого
+// кадра в очереди отправки. true - этот тик не кодировать (SKIP_ENCODE).
+static bool apply_backpressure(RtspState& s, NvEncoderD3D11Base* enc)
+{
+    uint64_t bp = s.pendingBackpressure.exchange(0);
+    if (bp) {
+        s.bpPolicy = (NvrtspBackpressurePolicy)(bp >> 32);
+        s.bpBudgetNs = (int64_t)(uint32_t)bp * 1000000;
+        s.bpSkipping = false;
+        if (s.sender)
+            enc->SetNonRefP(s.bpPolicy == NVRTSP_BACKPRESSURE_DROP_NONREF);
+        // Сниженный битрейт остался от прошлой политики (по RTCP - не её).
+        if (s.bpKbps && !s.rtcpAdaptive && s.bpPolicy != NVRTSP_BACKPRESSURE_LOWER_BITRATE &&
+            enc->Reconfigure(s.bitrate, 0, 0, 0))
+            s.bpKbps = 0;
+    }
 
-            tex = s->srcTex;
-            encPtr = &s->encoder;
+    bool skip = false;
+    if (s.sender) {
+        const int64_t now = StreamScheduler::NowNs();
+        int64_t age = s.sender->OldestAgeNs(now);
+
+        // Жёсткий предел для любой политики: такая задержка хуже пропуска.
+        if (age > s.bpBudgetNs * kHardBudgetFactor ||
+            s.sender->QueuedFrames() > kSendQueueMaxFrames ||
+            s.sender->QueuedBytes() > kSendQueueMaxBytes) {
+            flush_send_queue(s, enc, now);
+            age = s.sender->OldestAgeNs(now);
         }
 
-        if (!tex || !encPtr || !encPtr->get()) {
-            Log("RTSP worker: no srcTex or encoder, exiting");
-            s->running = false;
+        switch (s.bpPolicy) {
+        case NVRTSP_BACKPRESSURE_DROP_NONREF:
+            if (age > s.bpBudgetNs) {
+                s.sender->DropDisposable(nal_codec(s.codec));
+                if (s.sender->OldestAgeNs(now) > s.bpBudgetNs)
+                    flush_send_queue(s, enc, now);
+            }
+            break;
+        case NVRTSP_BACKPRESSURE_SKIP_ENCODE:
+            // Гистерезис: возобновляем, когда очередь ужалась вдвое.
+            if (age > s.bpBudgetNs)
+                s.bpSkipping = true;
+            else if (age < s.bpBudgetNs / 2)
+                s.bpSkipping = false;
+            skip = s.bpSkipping;
+            break;
+        case NVRTSP_BACKPRESSURE_LOWER_BITRATE:
+            adapt_bitrate(s, enc, age, now);
             break;
         }
+    }
 
-        NvEncoderD3D11Base* enc = encPtr->get();
+    s.stats.targetKbps.store(s.bpKbps ? s.bpKbps : s.bitrate, std::memory_order_relaxed);
+    return skip;
+}
 
-        // --- открытие RTSP без мьютекса ---
-        if (!rtspReady) {
-            Log("RTSP worker: trying to open RTSP output...");
-            if (open_rtsp_output_locked(*s)) {
-                rtspReady = true;
-                Log("RTSP worker: RTSP opened");
-            }
-            else {
-                Log("RTSP worker: open_rtsp_output failed, will retry...");
-                std::this_thread::sleep_until(nextTime);
-                if (!s->running)
-                    break;
-                continue; // следующий тик, новая попытка
-            }
-        }
+static void skip_tick(RtspState& s)
+{
+    s.stats.ticksSkippedBackpressure.fetch_add(1, std::memory_order_relaxed);
+    s.stats.framesDropped.fetch_add(1, std::memory_order_relaxed);
+}
 
-        // --- Encode + send, тоже без мьютекса ---
-        int64_t ts100ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
-            std::chrono::steady_clock::now().time_since_epoch()
-        ).count() / 100;
-
-        std::vector<std::vector<uint8_t>> packets;
-        if (enc->EncodeTexture(tex, ts100ns, packets)) {
-            for (auto& p : packets) {
-                if (!send_annexb_packet_locked(*s, p.data(), p.size(), ts100ns)) {
-                    Log("RTSP worker: send_annexb_packet failed, closing RTSP and retrying later");
-                    close_rtsp_locked(*s);
-                    rtspReady = false;
-                    break;
+// Ступени лесенки на шаге ladder: подключение, настройки, готовые кадры и
+// новый кадр - из своего кольца захвата (captured) или frame по таймеру.
+// true - какая-то ступень ещё ждёт NVENC.
+static bool step_renditions(RtspState& s, bool captured, ID3D11Texture2D* frame, int64_t ts100ns)
+{
+    std::lock_guard<std::mutex> lk(s.renditionsMx);
+    bool pending = false;
+    for (RtspState* r : s.renditions) {
+        NvEncoderD3D11Base* enc = r->encoder.get();
+        if (!r->running || !enc)
+            continue;
+
+        if (r->outputMode == NVRTSP_OUTPUT_PUSH)
+            poll_push_connection(*r);
+        apply_pending_config(*r, enc);
+        bool skip = apply_backpressure(*r, enc);
+
+        if (enc->PendingFrames()) {
+            enc->WaitForPackets(r->packets, 0);
+            deliver_packets(*r, r->packets);
+        }
+        // Кадр ступени render thread уже масштабировал в её кольцо; по
+        // таймеру - через слот своего энкодера на immediate context.
+        if (captured && r->capture) {
+            CapturedFrame rf;
+            if (r->capture->AcquireLatest(rf, std::chrono::milliseconds(0))) {
+                if (skip) {
+                    r->capture->Release(rf.slot);
+                    skip_tick(*r);
                 }
+                else
+                    encode_captured_frame(*r, enc, rf);
             }
+            r->capture->SetCompletedFrames(enc->CompletedFrames());
         }
+        else if (frame && skip)
+            skip_tick(*r);
+        else if (frame && enc->EncodeTexture(frame, ts100ns, r->packets))
+            deliver_packets(*r, r->packets);
 
-        std::this_thread::sleep_until(nextTime);
-        if (!s->running)
-            break;
+        if (enc->PendingFrames())
+            pending = true;
     }
+    return pending;
+}
 
+// Один шаг стрима на потоке пула: дочитать готовые кадры, по сроку
+// отправить новый и сказать пулу, когда вызвать снова.
+static StreamStep rtsp_stream_step(RtspState& s)
+{
+    StreamStep stop;
+    if (!s.running)
+        return stop;
+
+    // --- минимальный критический участок: просто читаем состояние ---
+    ID3D11Texture2D* tex = nullptr;
+    NvEncoderD3D11Base* enc = nullptr;
     {
-        std::lock_guard<std::mutex> lk(s->mx);
-        close_rtsp_locked(*s);
+        std::lock_guard<std::mutex> lk(s.mx);
+        tex = s.srcTex;
+        enc = s.encoder.get();
+    }
+
+    if (!tex || !enc || !s.pacer) {
+        Log("RTSP stream: no srcTex or encoder, stopping");
+        s.running = false;
+        return stop;
+    }
+
+    // В push-модели темп задаёт render thread Unity (он будит стрим через
+    // g_scheduler->Wake), а не таймер.
+    bool captured = s.capture && s.capture->Active();
+
+    // --- RTSP подключается в фоне; кодирование от этого не зависит ---
+    if (s.outputMode == NVRTSP_OUTPUT_PUSH)
+        poll_push_connection(s);
+
+    // --- новые битрейт/частота/GOP - до следующего кадра ---
+    apply_pending_config(s, enc);
+
+    // --- отставание сети: чистка очереди, битрейт или пропуск тика ---
+    bool skip = apply_backpressure(s, enc);
+
+    // --- готовые кадры прошлых шагов ---
+    if (enc->PendingFrames()) {
+        enc->WaitForPackets(s.packets, 0);
+        deliver_packets(s, s.packets);
+    }
+
+    StreamStep next;
+    bool renditionsPending = false;
+    if (captured) {
+        CapturedFrame frame;
+        bool haveFrame = s.capture->AcquireLatest(frame, std::chrono::milliseconds(0));
+
+        renditionsPending = step_renditions(s, true, nullptr, 0);
+        if (haveFrame && skip) {
+            s.capture->Release(frame.slot);
+            skip_tick(s);
+        }
+        else if (haveFrame) {
+            encode_captured_frame(s, enc, frame);
+        }
+        s.capture->SetCompletedFrames(enc->CompletedFrames());
+
+        // Свежий кадр разбудит Wake; период - страховка на случай тишины.
+        next.dueNs = StreamScheduler::NowNs() + s.pacer->NominalPeriodNs();
+        next.frameDeadline = false;
+    }
+    else {
+        ID3D11Texture2D* frameTex = nullptr;
+        int64_t frameTs = 0;
+        if (s.pacer->NextDueNs() <= StreamScheduler::NowNs()) {
+            PacerTick tick = s.pacer->WaitNext();
+            s.stats.pacingJitter.Record(tick.lateNs);
+            if (tick.skipped)
+                s.stats.framesDropped.fetch_add(tick.skipped, std::memory_order_relaxed);
+
+            // EncodeTexture только ставит кадр в очередь NVENC и отдаёт уже
+            // готовые; метка времени - срок тика, а не момент пробуждения.
+            if (skip)
+                skip_tick(s);
+            else if (enc->EncodeTexture(tex, tick.dueNs / 100, s.packets))
+                deliver_packets(s, s.packets);
+            frameTex = tex;
+            frameTs = tick.dueNs / 100;
+        }
+        renditionsPending = step_renditions(s, false, frameTex, frameTs);
+        next.dueNs = s.pacer->NextDueNs();
+        next.frameDeadline = true;
     }
 
-    Log("RTSP worker thread finished");
+    // Пока NVENC не отдал кадр, заглядываем чаще, но не позже следующего срока.
+    if (enc->PendingFrames() || renditionsPending) {
+        int64_t poll = StreamScheduler::NowNs() + kCollectPollNs;
+        if (poll < next.dueNs) {
+            next.dueNs = poll;
+            next.frameDeadline = false;
+        }
+    }
+
+    return next;
+}
+
+StreamStep RtspState::RunStep(int64_t)
+{
+    return rtsp_stream_step(*this);
+}
+
+static StreamScheduler* acquire_scheduler()
+{
+    std::lock_guard<std::mutex> lk(g_schedMx);
+    if (!g_scheduler) {
+        uint32_t n = g_workerThreads;
+        if (n == 0) {
+            n = std::thread::hardware_concurrency();
+            if (n > 4) n = 4;
+            if (n < 2) n = 2;
+        }
+        g_scheduler = new StreamScheduler(n);
+
+        char buf[128];
+        sprintf_s(buf, "Stream scheduler started with %u threads", n);
+        Log(buf);
+    }
+    return g_scheduler;
 }
 
 
@@ -273,11 +941,30 @@ static void rtsp_worker_thread(RtspState* s)
 // Unity plugin entrypoints
 // -----------------------------------------------------------------------------
 
+#ifndef _WIN32
+// Вне Windows настоящего D3D11 нет: плагин работает на программном
+// устройстве (FakeD3D11.h). Текстуры для NVRTSP_Create можно создавать на
+// любом фейковом устройстве - копия между ними обычный memcpy.
+static bool create_fake_device()
+{
+    if (g_device)
+        return true;
+    if (FAILED(FakeD3D11CreateDevice(g_device.GetAddressOf(), g_context.GetAddressOf()))) {
+        Log("FakeD3D11CreateDevice failed");
+        return false;
+    }
+    Log("Using software D3D11 device");
+    return true;
+}
+#endif
+
 extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
 UnityPluginLoad(IUnityInterfaces* unityInterfaces)
 {
     g_unity = unityInterfaces;
     g_ugraphics = g_unity->Get<IUnityGraphics>();
+
+#ifdef _WIN32
     g_ugraphicsD3D11 = g_unity->Get<IUnityGraphicsD3D11>();
 
     if (!g_ugraphicsD3D11) {
@@ -303,6 +990,9 @@ UnityPluginLoad(IUnityInterfaces* unityInterfaces)
         return;
     }
 
+    // Захват по render-событию работает на контексте render thread, поток
+    // кодирования его не трогает. Защита нужна резервному пути по таймеру
+    // (render-событий нет): там копия, масштаб и NV12 идут с потоков пула.
     ID3D11Multithread* mtRaw = nullptr;
     if (SUCCEEDED(g_context->QueryInterface(__uuidof(ID3D11Multithread),
                                             (void**)&mtRaw)))
@@ -311,13 +1001,58 @@ UnityPluginLoad(IUnityInterfaces* unityInterfaces)
         g_multithread->SetMultithreadProtected(TRUE);
         Log("D3D11 multithread protection enabled");
     }
+#else
+    if (!create_fake_device())
+        return;
+#endif
+
+    if (g_ugraphics && g_ugraphics->ReserveEventIDRange)
+        g_renderEventBase = g_ugraphics->ReserveEventIDRange(kMaxRenderEvents);
 
     Log("UnityPluginLoad OK");
 }
 
+// Вызывается Unity на render thread (GL.IssuePluginEvent /
+// CommandBuffer.IssuePluginEvent) после того, как кадр отрендерен.
+static void UNITY_INTERFACE_API OnRenderEvent(int eventId)
+{
+    int idx = eventId - g_renderEventBase;
+    if (idx < 0 || idx >= kMaxRenderEvents)
+        return;
+
+    std::lock_guard<std::mutex> lk(g_handlesMx);
+    if (idx >= (int)g_handles.size() || !g_handles[idx])
+        return;
+
+    RtspState* s = g_handles[idx];
+    if (!s->running || !s->capture || !s->srcTex)
+        return;
+
+    // Ступени берут NV12, который ladder только что подготовил из того же
+    // кадра: RGB -> NV12 считается один раз на всю лесенку.
+    const int64_t ts = now_ts100ns();
+    bool captured = s->capture->Capture(g_context.Get(), s->srcTex, ts);
+    {
+        std::lock_guard<std::mutex> clk(s->captureMx);
+        for (RtspState* r : s->renditions) {
+            if (r->running && r->capture)
+                captured = r->capture->Capture(g_context.Get(), s->srcTex, ts, s->capture.get()) ||
+                           captured;
+        }
+    }
+    if (captured && s->schedId >= 0) {
+        std::lock_guard<std::mutex> slk(g_schedMx);
+        if (g_scheduler)
+            g_scheduler->Wake(s->schedId);
+    }
+}
+
 extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API
 UnityPluginUnload()
 {
+    std::lock_guard<std::mutex> lk(g_schedMx);
+    delete g_scheduler;
+    g_scheduler = nullptr;
 }
 
 // -----------------------------------------------------------------------------
@@ -329,13 +1064,43 @@ NVRTSP_EXPORT void NVRTSP_SetLogCallback(NvrtspLogCallback cb)
     g_logCb = cb;
 }
 
+NVRTSP_EXPORT void NVRTSP_SetWorkerThreads(int threads)
+{
+    std::lock_guard<std::mutex> lk(g_schedMx);
+    if (g_scheduler) {
+        Log("NVRTSP_SetWorkerThreads: scheduler already running, ignored");
+        return;
+    }
+    g_workerThreads = threads > 0 ? (uint32_t)threads : 0;
+}
+
+static bool create_encoder(RtspState& s)
+{
+    s.encoder = CreateNvEncoder(
+        s.codec,
+        g_device.Get(), g_context.Get(),
+        s.w, s.h, s.fpsNum, s.fpsDen, s.bitrate
+    );
+#ifdef NVRTSP_FAKE_NVENC
+    const NV_ENCODE_API_FUNCTION_LIST* nvencApi = FakeNvencFunctionList();
+#else
+    const NV_ENCODE_API_FUNCTION_LIST* nvencApi = nullptr;
+#endif
+    return s.encoder && s.encoder->Initialize(nvencApi);
+}
+
 NVRTSP_EXPORT NvrtspHandle NVRTSP_Create(
     void* texPtr,
     int width, int height, int fps,
     int bitrateKbps,
     NvrtspCodec codec,
-    const wchar_t* rtspUrl)
+    const wchar_t* rtspUrl,
+    NvrtspOutputMode outputMode)
 {
+#ifndef _WIN32
+    // Без Unity (тесты, бенчмарки) UnityPluginLoad не вызывается.
+    create_fake_device();
+#endif
     if (!g_device || !g_context) {
         Log("NVRTSP_Create: no D3D11 device/context");
         return nullptr;
@@ -350,34 +1115,179 @@ NVRTSP_EXPORT NvrtspHandle NVRTSP_Create(
     s->w       = (uint32_t)width;
     s->h       = (uint32_t)height;
     s->fps     = (uint32_t)fps;
+    s->fpsNum  = s->fps ? s->fps : 30;
+    s->fpsDen  = 1;
     s->bitrate = (uint32_t)bitrateKbps;
     s->codec   = codec;
+    s->outputMode = outputMode;
     if (rtspUrl)
         s->rtspUrlW = rtspUrl;
     else
         s->rtspUrlW = L"";
 
-    s->encoder = CreateNvEncoder(
-        codec,
-        g_device.Get(), g_context.Get(),
-        s->w, s->h, s->fps, s->bitrate
-    );
-    if (!s->encoder || !s->encoder->Initialize()) {
+    if (!create_encoder(*s)) {
         Log("NVRTSP_Create: NvEncoder init failed");
         delete s;
         return nullptr;
     }
 
+    s->capture.reset(new FrameCaptureRing(g_device.Get(), 4, s->fps));
+    update_capture_format(*s, s->encoder.get());
+
+    {
+        std::lock_guard<std::mutex> lk(g_handlesMx);
+        for (size_t i = 0; i < g_handles.size(); ++i) {
+            if (!g_handles[i]) {
+                s->renderEventId = (int)i;
+                break;
+            }
+        }
+        if (s->renderEventId < 0 && g_handles.size() < (size_t)kMaxRenderEvents) {
+            s->renderEventId = (int)g_handles.size();
+            g_handles.push_back(nullptr);
+        }
+        if (s->renderEventId >= 0)
+            g_handles[s->renderEventId] = s;
+        else
+            Log("NVRTSP_Create: too many handles, render-thread capture disabled");
+    }
+
     Log("NVRTSP_Create OK");
     return (NvrtspHandle)s;
 }
 
+// Энкодер для NVRTSP_Start: после NVRTSP_Stop его нет, создаётся новый с
+// текущими параметрами стрима и прежними настройками. Кольцо захвата
+// начинает заново - номера кадров нового энкодера идут с нуля.
+static bool prepare_encoder_locked(RtspState& s)
+{
+    if (s.encoder)
+        return true;
+    if (!create_encoder(s)) {
+        s.encoder.reset();
+        return false;
+    }
+    if (!s.encoder->ApplySettings(s.encSettings))
+        Log("NvEncoder: some settings were not restored after restart");
+    s.bpKbps = 0;
+    if (s.capture) {
+        s.capture->Reset();
+        s.capture->SetFrameRate(s.fpsNum, s.fpsDen);
+        update_capture_format(s, s.encoder.get());
+    }
+    return true;
+}
+
+// Выход стрима: встроенный сервер или фоновое подключение к ретранслятору.
+static bool start_outputs_locked(RtspState& s)
+{
+    if (s.outputMode == NVRTSP_OUTPUT_SERVER && !start_server_locked(s)) {
+        Log("RTSP server start failed");
+        return false;
+    }
+
+    // PUSH: подключение сразу уходит в фон, первые кадры кодируются не дожидаясь.
+    if (s.outputMode == NVRTSP_OUTPUT_PUSH) {
+        s.sender.reset(new PushSender(s.stats));
+        s.connector.reset(new RtspConnector());
+        s.connector->Connect(push_params(s));
+        // DROP_NONREF выбрасывает только неопорные кадры: при frameIntervalP = 1
+        // их делает лишь NVENC с enableNonRefP.
+        if (s.encoder)
+            s.encoder->SetNonRefP(s.bpPolicy == NVRTSP_BACKPRESSURE_DROP_NONREF);
+    }
+    return true;
+}
+
+NVRTSP_EXPORT NvrtspHandle NVRTSP_AddRendition(
+    NvrtspHandle ladder,
+    int width, int height,
+    int bitrateKbps,
+    const wchar_t* rtspUrl)
+{
+    if (!ladder || width <= 0 || height <= 0 || bitrateKbps <= 0)
+        return nullptr;
+
+    RtspState* parent = (RtspState*)ladder;
+    if (parent->ladder) {
+        Log("NVRTSP_AddRendition: handle is a rendition itself");
+        return nullptr;
+    }
+
+    RtspState* r = new RtspState();
+    r->ladder  = parent;
+    r->w       = (uint32_t)width;
+    r->h       = (uint32_t)height;
+    r->fps     = parent->fps;
+    r->fpsNum  = parent->fpsNum;
+    r->fpsDen  = parent->fpsDen;
+    r->bitrate = (uint32_t)bitrateKbps;
+    r->codec   = parent->codec;
+    r->outputMode = parent->outputMode;
+    if (rtspUrl)
+        r->rtspUrlW = rtspUrl;
+
+    // Сервер ступени слушает свой сокет: на порту ladder или соседней
+    // ступени он упал бы только на старте лесенки - отказываем сразу.
+    if (uint16_t port = server_port(*r)) {
+        bool taken = server_port(*parent) == port;
+        {
+            std::lock_guard<std::mutex> rlk(parent->renditionsMx);
+            for (RtspState* o : parent->renditions)
+                taken = taken || server_port(*o) == port;
+        }
+        if (taken) {
+            char buf[192];
+            sprintf_s(buf, "NVRTSP_AddRendition: port %u is already used by this ladder; "
+                           "each rendition in SERVER mode needs its own port", (unsigned)port);
+            Log(buf);
+            delete r;
+            return nullptr;
+        }
+    }
+
+    if (!create_encoder(*r)) {
+        Log("NVRTSP_AddRendition: NvEncoder init failed");
+        delete r;
+        return nullptr;
+    }
+    r->capture.reset(new FrameCaptureRing(g_device.Get(), 4, r->fps));
+    r->capture->SetFrameRate(r->fpsNum, r->fpsDen);
+    update_capture_format(*r, r->encoder.get());
+
+    {
+        std::lock_guard<std::mutex> rlk(parent->renditionsMx);
+        // Лесенка уже работает - ступень сразу выходит в сеть.
+        if (parent->running) {
+            std::lock_guard<std::mutex> lk(r->mx);
+            if (!start_outputs_locked(*r)) {
+                Log("NVRTSP_AddRendition: output start failed");
+                delete r;
+                return nullptr;
+            }
+            r->running = true;
+        }
+        std::lock_guard<std::mutex> clk(parent->captureMx);
+        parent->renditions.push_back(r);
+    }
+
+    char buf[128];
+    sprintf_s(buf, "NVRTSP_AddRendition OK: %ux%u, %u kbps", r->w, r->h, r->bitrate);
+    Log(buf);
+    return (NvrtspHandle)r;
+}
+
 NVRTSP_EXPORT bool NVRTSP_Start(NvrtspHandle handle)
 {
     if (!handle)
         return false;
 
     RtspState* s = (RtspState*)handle;
+    if (s->ladder) {
+        Log("NVRTSP_Start: renditions start with their ladder");
+        return false;
+    }
+
     std::lock_guard<std::mutex> lk(s->mx);
 
     if (s->running) {
@@ -385,13 +1295,99 @@ NVRTSP_EXPORT bool NVRTSP_Start(NvrtspHandle handle)
         return false;
     }
 
+    if (!prepare_encoder_locked(*s)) {
+        Log("NVRTSP_Start: NvEncoder init failed");
+        return false;
+    }
+
+    if (!start_outputs_locked(*s)) {
+        Log("NVRTSP_Start: output start failed");
+        return false;
+    }
+
+    // NVRTSP_Stop закрыл и энкодеры ступеней: каждой нужен новый, иначе шаг
+    // её пропускает. Ступень, которой не хватило энкодера или выхода,
+    // остаётся остановленной, остальные лесенка кодирует.
+    {
+        std::lock_guard<std::mutex> rlk(s->renditionsMx);
+        for (RtspState* r : s->renditions) {
+            std::lock_guard<std::mutex> rl(r->mx);
+            if (!prepare_encoder_locked(*r))
+                Log("NVRTSP_Start: rendition NvEncoder init failed");
+            else if (start_outputs_locked(*r))
+                r->running = true;
+            else
+                Log("NVRTSP_Start: rendition output start failed");
+        }
+    }
+
+    // Срок каждого тика считается от старта точно, без накопления округлений;
+    // если кодирование затянулось, пропущенные тики не догоняются пачкой.
+    s->pacer.reset(new FramePacer(s->fpsNum, s->fpsDen, PacerPolicy::Skip));
+
     s->running = true;
-    s->worker = std::thread(rtsp_worker_thread, s);
+    s->schedId = acquire_scheduler()->Add(s, s->pacer->NominalPeriodNs());
 
     Log("NVRTSP_Start OK");
     return true;
 }
 
+// Счётчики пула за несколько запусков: сумма, максимум, средневзвешенное.
+static void merge_sched_stats(StreamSchedStats& into, const StreamSchedStats& add)
+{
+    const uint64_t steps = into.steps + add.steps;
+    if (steps)
+        into.lateAvgNs = (int64_t)(((double)into.lateAvgNs * into.steps +
+                                    (double)add.lateAvgNs * add.steps) / steps);
+    into.steps = steps;
+    into.deadlineMisses += add.deadlineMisses;
+    if (add.lateMaxNs > into.lateMaxNs)
+        into.lateMaxNs = add.lateMaxNs;
+}
+
+// Сколько NVRTSP_Stop ждёт, пока очередь отправки допишется.
+static const int64_t kDrainOnStopNs = 200000000;
+
+// Останавливает выход и энкодер стрима, уже снятого с пула (или ступени,
+// которую шаг ladder больше не трогает).
+static void shutdown_stream(RtspState& s)
+{
+    // Очередь отправки дописывается недолго; висящую запись прерываем
+    bool drained = true;
+    if (s.sender) {
+        s.sender->Drain(kDrainOnStopNs);
+        if (s.connector)
+            s.connector->Interrupt();
+        drained = s.sender->Stop();
+    }
+
+    // Прерываем незавершённое подключение (закрытия, отданные в фон, он доделает)
+    if (s.connector)
+        s.connector->Stop();
+
+    // Теперь никто не трогает s, можно спокойно чистить под мьютексом
+    std::lock_guard<std::mutex> lk(s.mx);
+
+    if (s.encoder) {
+        std::vector<NvEncPacket> tail;
+        s.encoder->Flush(tail);
+        // Хвост без выброшенных перед ним кадров не декодируется.
+        for (auto& p : tail) {
+            if (drained)
+                send_annexb_packet_locked(s, p);
+        }
+        serve_packets(s, tail);
+        s.encSettings = s.encoder->Settings();
+        s.encoder.reset();
+    }
+    s.gopCache.Clear();
+
+    close_rtsp_locked(s);
+    s.connector.reset();
+    s.sender.reset();
+    stop_server_locked(s);
+}
+
 NVRTSP_EXPORT void NVRTSP_Stop(NvrtspHandle handle)
 {
     if (!handle)
@@ -399,32 +1395,57 @@ NVRTSP_EXPORT void NVRTSP_Stop(NvrtspHandle handle)
 
     RtspState* s = (RtspState*)handle;
 
-    // 1) Атомарно выключаем running без мьютекса
-    bool expected = true;
-    if (!s->running.compare_exchange_strong(expected, false)) {
-        // уже остановлен
+    // Ступень: под renditionsMx шаг ladder её не кодирует.
+    if (s->ladder) {
+        std::lock_guard<std::mutex> rlk(s->ladder->renditionsMx);
+        if (s->running.exchange(false))
+            shutdown_stream(*s);
+        Log("NVRTSP_Stop done (rendition)");
         return;
     }
 
-    // 2) Ждём worker
-    if (s->worker.joinable())
-        s->worker.join();
+    // 1) Атомарно выключаем running без мьютекса. Стрим мог остановиться
+    //    и сам (ошибка в шаге) - тогда его всё равно надо снять с пула.
+    bool wasRunning = s->running.exchange(false);
+    if (!wasRunning && s->schedId < 0) {
+        // уже остановлен
+        return;
+    }
 
-    // 3) Теперь worker гарантированно не трогает s,
-    //    можно спокойно чистить под мьютексом
-    std::lock_guard<std::mutex> lk(s->mx);
+    // 2) Снимаем стрим с пула; Remove дожидается шага, если он идёт
+    if (s->schedId >= 0) {
+        // g_scheduler живёт до UnityPluginUnload; мьютекс не держим на время
+        // Remove, чтобы не тормозить render thread других стримов.
+        StreamScheduler* sched = nullptr;
+        {
+            std::lock_guard<std::mutex> slk(g_schedMx);
+            sched = g_scheduler;
+        }
+        StreamSchedStats st;
+        if (sched) {
+            sched->Remove(s->schedId, &st);
+            char buf[192];
+            sprintf_s(buf, "RTSP stream: %llu frame deadlines, %llu missed, max late %.1f ms",
+                      (unsigned long long)st.steps, (unsigned long long)st.deadlineMisses,
+                      st.lateMaxNs / 1e6);
+            Log(buf);
+        }
+        std::lock_guard<std::mutex> lk(s->mx);
+        merge_sched_stats(s->schedDone, st);
+        s->schedId = -1;
+    }
 
-    if (s->encoder) {
-        std::vector<std::vector<uint8_t>> tail;
-        s->encoder->Flush(tail);
-        for (auto& p : tail) {
-            send_annexb_packet_locked(*s, p.data(), p.size(), 0);
+    // 3) Шагов больше нет: ступени лесенки останавливаются вместе со стримом
+    {
+        std::lock_guard<std::mutex> rlk(s->renditionsMx);
+        for (RtspState* r : s->renditions) {
+            if (r->running.exchange(false))
+                shutdown_stream(*r);
         }
-        s->encoder.reset();
     }
 
-    close_rtsp_locked(*s);
-    s->srcTex = nullptr;
+    // 4) Выход и энкодер самого стрима
+    shutdown_stream(*s);
 
     Log("NVRTSP_Stop done");
 }
@@ -439,6 +1460,342 @@ NVRTSP_EXPORT void NVRTSP_Destroy(NvrtspHandle handle)
 
     NVRTSP_Stop(handle);
 
+    if (s->ladder) {
+        std::lock_guard<std::mutex> rlk(s->ladder->renditionsMx);
+        std::lock_guard<std::mutex> clk(s->ladder->captureMx);
+        std::vector<RtspState*>& v = s->ladder->renditions;
+        for (size_t i = 0; i < v.size(); ++i) {
+            if (v[i] == s) {
+                v.erase(v.begin() + i);
+                break;
+            }
+        }
+    }
+    else {
+        std::lock_guard<std::mutex> lk(g_handlesMx);
+        if (s->renderEventId >= 0 && s->renderEventId < (int)g_handles.size())
+            g_handles[s->renderEventId] = nullptr;
+    }
+
+    // Ступени уже остановлены вместе с ladder, шаг их больше не видит.
+    for (RtspState* r : s->renditions)
+        delete r;
     delete s;
     Log("NVRTSP_Destroy done");
 }
+
+NVRTSP_EXPORT bool NVRTSP_SetBitrate(NvrtspHandle handle, int bitrateKbps)
+{
+    if (!handle || bitrateKbps <= 0)
+        return false;
+
+    RtspState* s = (RtspState*)handle;
+    s->pendingBitrate = (uint32_t)bitrateKbps;
+    return true;
+}
+
+NVRTSP_EXPORT bool NVRTSP_SetFramerate(NvrtspHandle handle, int fpsNum, int fpsDen)
+{
+    if (!handle || fpsNum <= 0 || fpsDen <= 0)
+        return false;
+
+    RtspState* s = (RtspState*)handle;
+    if (s->ladder) {
+        Log("NVRTSP_SetFramerate: renditions follow the ladder frame rate");
+        return false;
+    }
+    s->pendingFps = ((uint64_t)(uint32_t)fpsNum << 32) | (uint32_t)fpsDen;
+    return true;
+}
+
+NVRTSP_EXPORT bool NVRTSP_SetGopLength(NvrtspHandle handle, int frames)
+{
+    if (!handle || frames <= 0)
+        return false;
+
+    RtspState* s = (RtspState*)handle;
+    s->pendingGop = (uint32_t)frames;
+    return true;
+}
+
+NVRTSP_EXPORT bool NVRTSP_RequestKeyframe(NvrtspHandle handle)
+{
+    if (!handle)
+        return false;
+
+    RtspState* s = (RtspState*)handle;
+    s->pendingKeyframe = true;
+    return true;
+}
+
+NVRTSP_EXPORT bool NVRTSP_SetIntraRefresh(NvrtspHandle handle, int periodFrames)
+{
+    if (!handle || periodFrames < 0)
+        return false;
+
+    RtspState* s = (RtspState*)handle;
+    s->pendingIntraRefresh = periodFrames;
+    return true;
+}
+
+NVRTSP_EXPORT bool NVRTSP_SetColorConversion(NvrtspHandle handle, NvrtspColorConversion mode)
+{
+    if (!handle)
+        return false;
+    if (mode != NVRTSP_COLOR_NVENC && mode != NVRTSP_COLOR_NV12_LIMITED &&
+        mode != NVRTSP_COLOR_NV12_FULL)
+        return false;
+
+    RtspState* s = (RtspState*)handle;
+    s->pendingColor = (int32_t)mode;
+    return true;
+}
+
+NVRTSP_EXPORT bool NVRTSP_SetScaleFilter(NvrtspHandle handle, NvrtspScaleFilter filter)
+{
+    if (!handle)
+        return false;
+    if (filter != NVRTSP_SCALE_BILINEAR && filter != NVRTSP_SCALE_LANCZOS)
+        return false;
+
+    RtspState* s = (RtspState*)handle;
+    s->pendingScaleFilter = (int32_t)filter;
+    return true;
+}
+
+NVRTSP_EXPORT bool NVRTSP_SetRtpMtu(NvrtspHandle handle, int mtuBytes)
+{
+    if (!handle || mtuBytes < (int)RtpPacketizer::kRtpMinMtu || mtuBytes > (int)RtpPacketizer::kRtpMaxMtu)
+        return false;
+
+    RtspState* s = (RtspState*)handle;
+    s->pendingMtu = (uint32_t)mtuBytes;
+    return true;
+}
+
+NVRTSP_EXPORT bool NVRTSP_SetRtpPacing(NvrtspHandle handle, float fraction, int burstBytes)
+{
+    if (!handle || !(fraction >= 0.0f && fraction <= 1.0f) || burstBytes < 0)
+        return false;
+
+    RtspState* s = (RtspState*)handle;
+    uint64_t permille = (uint64_t)(fraction * 1000.0f + 0.5f);
+    uint32_t burst = burstBytes ? (uint32_t)burstBytes : RtpPacingConfig().burstBytes;
+    s->pendingPacing = (1ULL << 63) | (permille << 32) | burst;
+    return true;
+}
+
+NVRTSP_EXPORT bool NVRTSP_SetAdaptiveBitrate(NvrtspHandle handle, bool enabled, int minKbps)
+{
+    if (!handle || minKbps < 0)
+        return false;
+
+    RtspState* s = (RtspState*)handle;
+    if (s->outputMode != NVRTSP_OUTPUT_SERVER) {
+        Log("NVRTSP_SetAdaptiveBitrate: SERVER mode only (PUSH adapts via LOWER_BITRATE)");
+        return false;
+    }
+    uint64_t floor = minKbps ? (uint32_t)minKbps : kBitrateFloorKbps;
+    s->pendingAdaptive = (1ULL << 63) | ((uint64_t)(enabled ? 1 : 0) << 32) | floor;
+    return true;
+}
+
+NVRTSP_EXPORT bool NVRTSP_SetMulticast(NvrtspHandle handle, const wchar_t* group, int port,
+                                       int ttl, const wchar_t* iface)
+{
+    if (!handle)
+        return false;
+
+    RtspState* s = (RtspState*)handle;
+    if (s->outputMode != NVRTSP_OUTPUT_SERVER) {
+        Log("NVRTSP_SetMulticast: only for SERVER output");
+        return false;
+    }
+
+    RtpMulticastConfig cfg;
+    if (group && *group) {
+        if (port <= 0 || port >= 65535 || ttl < 1 || ttl > 255)
+            return false;
+        cfg.group = narrow_url(group);
+        cfg.port = (uint16_t)port;
+        cfg.ttl = ttl;
+        cfg.iface = iface ? narrow_url(iface) : std::string();
+        if (!RtspServer::ValidMulticast(cfg)) {
+            Log("NVRTSP_SetMulticast: group is not an IPv4 multicast address");
+            return false;
+        }
+    }
+
+    std::lock_guard<std::mutex> lk(s->mx);
+    if (s->server && !s->server->SetMulticast(cfg))
+        return false;
+    s->multicast = cfg;
+    return true;
+}
+
+NVRTSP_EXPORT int NVRTSP_GetSdp(NvrtspHandle handle, char* buf, int bufSize)
+{
+    if (!handle)
+        return -1;
+
+    RtspState* s = (RtspState*)handle;
+    std::string sdp;
+    {
+        std::lock_guard<std::mutex> lk(s->mx);
+        if (!s->server)
+            return -1;
+        sdp = s->server->BuildSdp();
+    }
+    if (buf && bufSize > 0) {
+        size_t n = std::min(sdp.size(), (size_t)bufSize - 1);
+        memcpy(buf, sdp.data(), n);
+        buf[n] = '\0';
+    }
+    return (int)sdp.size();
+}
+
+NVRTSP_EXPORT bool NVRTSP_SetBackpressurePolicy(NvrtspHandle handle,
+                                                NvrtspBackpressurePolicy policy,
+                                                int latencyBudgetMs)
+{
+    if (!handle || latencyBudgetMs <= 0)
+        return false;
+    if (policy != NVRTSP_BACKPRESSURE_DROP_NONREF && policy != NVRTSP_BACKPRESSURE_SKIP_ENCODE &&
+        policy != NVRTSP_BACKPRESSURE_LOWER_BITRATE)
+        return false;
+
+    RtspState* s = (RtspState*)handle;
+    s->pendingBackpressure = ((uint64_t)policy << 32) | (uint32_t)latencyBudgetMs;
+    return true;
+}
+
+static void fill_latency(NvrtspLatency& out, const LatencyHistogram& h)
+{
+    LatencySummary sum = h.Summarize();
+    out.count = sum.count;
+    out.p50Ms = sum.p50Ns / 1e6;
+    out.p99Ms = sum.p99Ns / 1e6;
+    out.maxMs = sum.maxNs / 1e6;
+}
+
+NVRTSP_EXPORT bool NVRTSP_GetStats(NvrtspHandle handle, NvrtspStats* out)
+{
+    if (!handle || !out)
+        return false;
+
+    RtspState* s = (RtspState*)handle;
+    StreamStats& st = s->stats;
+    memset(out, 0, sizeof(*out));
+
+    out->framesEncoded = st.framesEncoded.load(std::memory_order_relaxed);
+    out->framesDropped = st.framesDropped.load(std::memory_order_relaxed);
+    out->framesSent    = st.framesSent.load(std::memory_order_relaxed);
+    out->bytesOut      = st.bytesOut.load(std::memory_order_relaxed);
+    out->reconnects    = st.reconnects.load(std::memory_order_relaxed);
+    out->framesDroppedBackpressure = st.framesDroppedBackpressure.load(std::memory_order_relaxed);
+    out->ticksSkippedBackpressure  = st.ticksSkippedBackpressure.load(std::memory_order_relaxed);
+    out->targetBitrateKbps         = st.targetKbps.load(std::memory_order_relaxed);
+    out->gopCacheBytes  = s->gopCache.Bytes();
+    out->gopCacheFrames = s->gopCache.Frames();
+
+    fill_latency(out->muxLatency, st.muxLatency);
+    fill_latency(out->pacingJitter, st.pacingJitter);
+
+    LatencySummary frameBytes = st.frameBytes.Summarize();
+    out->frameBytesP50 = (uint64_t)frameBytes.p50Ns;
+    out->frameBytesP99 = (uint64_t)frameBytes.p99Ns;
+    out->frameBytesMax = (uint64_t)frameBytes.maxNs;
+
+    // Мгновенный битрейт - по разнице с прошлым вызовом; при частом опросе
+    // окно не короче 250 мс, чтобы не скакать от кадра к кадру.
+    {
+        std::lock_guard<std::mutex> lk(st.rateMx);
+        int64_t now = StreamScheduler::NowNs();
+        if (st.lastNs == 0) {
+            st.lastNs = now;
+            st.lastBytes = out->bytesOut;
+        }
+        else if (now - st.lastNs >= 250000000) {
+            st.lastKbps = (double)(out->bytesOut - st.lastBytes) * 8.0 * 1e6 / (double)(now - st.lastNs);
+            st.lastNs = now;
+            st.lastBytes = out->bytesOut;
+        }
+        out->bitrateKbps = st.lastKbps;
+    }
+
+    // Пул: прошлые запуски плюс текущий, если стрим на пуле. Ступень
+    // кодирует на шагах ladder - её счётчики те же.
+    {
+        RtspState* owner = s->ladder ? s->ladder : s;
+        StreamSchedStats sched;
+        int schedId;
+        {
+            std::lock_guard<std::mutex> lk(owner->mx);
+            sched = owner->schedDone;
+            schedId = owner->schedId;
+        }
+        StreamSchedStats live;
+        if (schedId >= 0) {
+            std::lock_guard<std::mutex> lk(g_schedMx);
+            if (g_scheduler && g_scheduler->GetStats(schedId, live))
+                merge_sched_stats(sched, live);
+        }
+        out->schedSteps          = sched.steps;
+        out->schedDeadlineMisses = sched.deadlineMisses;
+        out->schedLateAvgMs      = sched.lateAvgNs / 1e6;
+        out->schedLateMaxMs      = sched.lateMaxNs / 1e6;
+    }
+
+    // Энкодер, захват и сервер разбираются в NVRTSP_Stop под s->mx.
+    std::lock_guard<std::mutex> lk(s->mx);
+    if (s->encoder) {
+        fill_latency(out->encodeLatency, s->encoder->EncodeLatency());
+        out->keyframeRequests = s->encoder->KeyframeRequests();
+        out->keyframesForced  = s->encoder->ForcedKeyframes();
+        out->nvencRegistrations        = s->encoder->RegisteredTextures();
+        out->nvencRegistrationsEvicted = s->encoder->EvictedRegistrations();
+    }
+    if (s->capture)
+        out->framesDropped += s->capture->DroppedFrames();
+    if (s->server) {
+        out->clients = (uint32_t)s->server->ClientCount();
+        s->server->GetUdpCounters(out->udpDatagrams, out->udpSendCalls);
+        fill_latency(out->rtpPacingDelay, s->server->PacingDelay());
+        LatencySummary burst = s->server->BurstBytes().Summarize();
+        out->rtpBurstBytesP50 = (uint64_t)burst.p50Ns;
+        out->rtpBurstBytesP99 = (uint64_t)burst.p99Ns;
+        out->rtpBurstBytesMax = (uint64_t)burst.maxNs;
+        RtcpCounters rtcp;
+        s->server->GetRtcpCounters(rtcp);
+        out->rtcpSenderReports   = rtcp.senderReports;
+        out->rtcpReceiverReports = rtcp.receiverReports;
+        out->rtcpNackedPackets   = rtcp.nackedPackets;
+        out->receiverLossPercent = rtcp.last.lossFraction * 100.0;
+        out->receiverJitterMs    = rtcp.last.jitterMs;
+        out->receiverRttMs       = rtcp.last.rttMs;
+    }
+    if (s->sender) {
+        out->sendQueueFrames = s->sender->QueuedFrames();
+        out->sendQueueBytes  = s->sender->QueuedBytes();
+        out->sendQueueMs     = s->sender->OldestAgeNs(StreamScheduler::NowNs()) / 1e6;
+    }
+    return true;
+}
+
+NVRTSP_EXPORT void* NVRTSP_GetRenderEventFunc()
+{
+    return (void*)OnRenderEvent;
+}
+
+NVRTSP_EXPORT int NVRTSP_GetRenderEventId(NvrtspHandle handle)
+{
+    if (!handle)
+        return -1;
+
+    RtspState* s = (RtspState*)handle;
+    if (s->ladder)
+        s = s->ladder;
+    if (s->renderEventId < 0)
+        return -1;
+    return g_renderEventBase + s->renderEventId;
+}
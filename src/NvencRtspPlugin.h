@@ -18,28 +18,285 @@ typedef enum NvrtspCodec
 {
     NVRTSP_CODEC_H264 = 0,
     NVRTSP_CODEC_H265 = 1,
+    // NVENC AV1 (Ada и новее): при том же качестве битрейт примерно на треть
+    // ниже HEVC. RTP по спецификации AOM "RTP Payload Format for AV1".
+    NVRTSP_CODEC_AV1  = 2,
 } NvrtspCodec;
 
+// Где RGB кадра превращается в YUV для кодека
+typedef enum NvrtspColorConversion
+{
+    // RGB уходит в NVENC как есть, преобразование - внутри NVENC
+    NVRTSP_COLOR_NVENC        = 0,
+    // свой проход на GPU: NV12 BT.709, Y 16..235 (в потоке - VUI BT.709)
+    NVRTSP_COLOR_NV12_LIMITED = 1,
+    // то же, полный диапазон 0..255
+    NVRTSP_COLOR_NV12_FULL    = 2,
+} NvrtspColorConversion;
+
+// Фильтр, которым кадр приводится к размеру кодирования (NVRTSP_Create
+// width/height), если RenderTexture другого размера.
+typedef enum NvrtspScaleFilter
+{
+    NVRTSP_SCALE_BILINEAR = 0,
+    NVRTSP_SCALE_LANCZOS  = 1,   // резче, дороже на GPU
+} NvrtspScaleFilter;
+
+// Куда отдаётся поток
+typedef enum NvrtspOutputMode
+{
+    // публикация на внешний RTSP-сервер (ANNOUNCE/RECORD через FFmpeg)
+    NVRTSP_OUTPUT_PUSH   = 0,
+    // встроенный RTSP-сервер: клиенты подключаются к плагину напрямую
+    NVRTSP_OUTPUT_SERVER = 1,
+} NvrtspOutputMode;
+
+// Что делать, если PUSH-соединение не успевает за кодированием и кадры в
+// очереди на отправку ждут дольше бюджета задержки (NVRTSP_SetBackpressurePolicy).
+// При любой политике очередь, переросшая 4 бюджета, 256 кадров или 16 МБ,
+// сбрасывается до ключевого кадра.
+typedef enum NvrtspBackpressurePolicy
+{
+    // выбросить из очереди неопорные кадры; не хватило - всё до следующего
+    // IDR (он запрашивается сразу)
+    NVRTSP_BACKPRESSURE_DROP_NONREF   = 0,
+    // не кодировать новые кадры, пока очередь не уменьшится вдвое от бюджета
+    NVRTSP_BACKPRESSURE_SKIP_ENCODE   = 1,
+    // снижать битрейт ступенями по 30%, пока очередь не уложится в бюджет;
+    // когда канал разгрузится, битрейт понемногу возвращается к заданному
+    NVRTSP_BACKPRESSURE_LOWER_BITRATE = 2,
+} NvrtspBackpressurePolicy;
+
+// Перцентили задержки одной стадии, мс.
+typedef struct NvrtspLatency
+{
+    uint64_t count;
+    double p50Ms;
+    double p99Ms;
+    double maxMs;
+} NvrtspLatency;
+
+// Статистика стрима (NVRTSP_GetStats). Счётчики - с момента NVRTSP_Create.
+typedef struct NvrtspStats
+{
+    uint64_t framesEncoded;   // кадров получено от NVENC
+    uint64_t framesDropped;   // пропущенные тики, перезаписанные захваты, кадры без соединения и по backpressure
+    uint64_t framesSent;      // кадров отдано в выход (PUSH - записано, SERVER - разослано)
+    uint64_t bytesOut;        // байт закодированного видео, отданных в выход
+    double   bitrateKbps;     // по bytesOut с прошлого вызова (окно не короче 250 мс)
+
+    NvrtspLatency encodeLatency;  // nvEncEncodePicture -> nvEncLockBitstream
+    NvrtspLatency muxLatency;     // av_write_frame / пакетизация и рассылка кадра
+    NvrtspLatency pacingJitter;   // опоздание тика кадра относительно срока
+
+    uint32_t reconnects;      // PUSH: обрывов соединения с переподключением
+    uint32_t clients;         // SERVER: подключённых клиентов
+
+    uint64_t gopCacheBytes;   // память кэша последнего GOP (байт кадров)
+    uint32_t gopCacheFrames;  // кадров в нём, от последнего IDR
+
+    uint64_t keyframeRequests; // запросов IDR: API, переподключение, новые клиенты, PLI/FIR
+    uint64_t keyframesForced;  // IDR, поставленных по ним (после склейки запросов)
+
+    // Размер закодированного кадра, байт: p99/max против p50 - всплески IDR.
+    uint64_t frameBytesP50;
+    uint64_t frameBytesP99;
+    uint64_t frameBytesMax;
+
+    // Регистрации текстур в NVENC: сейчас и снятых по простою/вытеснению.
+    // Растущее nvencRegistrations - утечка (текстуры пересоздаются без конца).
+    uint32_t nvencRegistrations;
+    uint64_t nvencRegistrationsEvicted;
+
+    // PUSH: очередь на отправку (кадры, байты, возраст самого старого кадра)
+    uint32_t sendQueueFrames;
+    uint64_t sendQueueBytes;
+    double   sendQueueMs;
+    // Реакция на отставание сети: кадров выброшено из очереди / не принято
+    // до IDR, тиков без кодирования (SKIP_ENCODE); оба входят в framesDropped.
+    uint64_t framesDroppedBackpressure;
+    uint64_t ticksSkippedBackpressure;
+    // Битрейт, с которым кодирует NVENC сейчас (ниже заданного при LOWER_BITRATE).
+    uint32_t targetBitrateKbps;
+
+    // SERVER, RTP/UDP: датаграмм отправлено и системных вызовов на них
+    // (sendmmsg с GSO - обычно один на кадр и клиента).
+    uint64_t udpDatagrams;
+    uint64_t udpSendCalls;
+
+    // SERVER, пейсинг RTP: байт, ушедших подряд без паузы (без пейсинга -
+    // кадр целиком), и задержка кадра в очереди пейсера.
+    uint64_t rtpBurstBytesP50;
+    uint64_t rtpBurstBytesP99;
+    uint64_t rtpBurstBytesMax;
+    NvrtspLatency rtpPacingDelay;
+
+    // SERVER, RTCP: SR отправлено, блоков отчёта о приёме и пакетов в NACK
+    // получено; потери, джиттер и RTT - из последнего отчёта (RTT -1 -
+    // клиент ещё не получил SR).
+    uint64_t rtcpSenderReports;
+    uint64_t rtcpReceiverReports;
+    uint64_t rtcpNackedPackets;
+    double   receiverLossPercent;
+    double   receiverJitterMs;
+    double   receiverRttMs;
+
+    // Пул потоков: шагов стрима по сроку кадра, из них начатых позже срока
+    // больше чем на четверть периода, и опоздание начала шага. У ступени -
+    // шаги её ladder (она кодирует на них).
+    uint64_t schedSteps;
+    uint64_t schedDeadlineMisses;
+    double   schedLateAvgMs;
+    double   schedLateMaxMs;
+} NvrtspStats;
+
 // Установить callback логирования
 NVRTSP_EXPORT void NVRTSP_SetLogCallback(NvrtspLogCallback cb);
 
+// Число потоков общего пула, на котором работают все стримы (0 - авто).
+// Действует, только если вызвать до первого NVRTSP_Start.
+NVRTSP_EXPORT void NVRTSP_SetWorkerThreads(int threads);
+
 // Создать инстанс стримера.
 // texPtr      - ID3D11Texture2D* (RenderTexture.GetNativeTexturePtr())
-// width/height, fps, bitrateKbps - параметры кодирования
-// codec       - выбор кодека (H264/H265)
-// rtspUrl     - L"rtsp://127.0.0.1:8554/camXX"
+// width/height, fps, bitrateKbps - параметры кодирования; если текстура
+//               другого размера, кадр масштабируется на GPU (NVRTSP_SetScaleFilter)
+// codec       - выбор кодека (H264/H265/AV1). AV1 кодирует только NVENC
+//               на Ada и новее: на более старых GPU NVRTSP_Create вернёт
+//               nullptr (причина - в логе)
+// rtspUrl     - PUSH:   L"rtsp://127.0.0.1:8554/camXX" (куда публиковать)
+//               SERVER: L"rtsp://0.0.0.0:8554/camXX"   (где слушать)
+// outputMode  - PUSH или SERVER
 NVRTSP_EXPORT NvrtspHandle NVRTSP_Create(
     void* texPtr,
     int width, int height, int fps,
     int bitrateKbps,
     NvrtspCodec codec,
+    const wchar_t* rtspUrl,
+    NvrtspOutputMode outputMode);
+
+// Simulcast: ещё одна ступень лесенки стрима ladder (например, 720p/2.5 Мбит
+// к 1080p/6 Мбит). Кадр снимается и переводится в NV12 один раз, ступени
+// масштабируют этот NV12 под свой размер на GPU, кодируют в своём битрейте
+// на том же шаге пула, что и ladder, и отдают в свой rtspUrl. Кодек, режим
+// выхода и fps - как у ladder; в режиме SERVER каждой ступени нужен свой
+// порт (занятый ladder или другой ступенью - nullptr, причина в логе).
+// Возвращает handle ступени: к нему применимы NVRTSP_SetBitrate,
+// SetGopLength, RequestKeyframe, SetIntraRefresh, SetColorConversion,
+// SetScaleFilter и GetStats. Ступень запускается и останавливается вместе
+// с ladder: NVRTSP_Start ladder открывает и ей новую сессию NVENC (в том
+// числе после NVRTSP_Stop самой ступени). NVRTSP_Destroy ступени убирает
+// её из лесенки, NVRTSP_Destroy ladder уничтожает и все ступени (их handle
+// становятся недействительны).
+NVRTSP_EXPORT NvrtspHandle NVRTSP_AddRendition(
+    NvrtspHandle ladder,
+    int width, int height,
+    int bitrateKbps,
     const wchar_t* rtspUrl);
 
-// Запустить фоновой поток стриминга.
+// Запустить стриминг (стрим встаёт в расписание общего пула потоков).
 NVRTSP_EXPORT bool NVRTSP_Start(NvrtspHandle handle);
 
-// Остановить стриминг (останавливает фоновой поток, но handle ещё жив).
+// Остановить стриминг (стрим снимается с пула, но handle ещё жив).
+// Сессия NVENC закрывается; повторный NVRTSP_Start открывает новую с
+// текущими битрейтом, частотой (в том числе 30000/1001) и настройками
+// NVRTSP_Set*, поток начинается с IDR. Текстура из NVRTSP_Create нужна
+// до NVRTSP_Destroy.
 NVRTSP_EXPORT void NVRTSP_Stop(NvrtspHandle handle);
 
 // Уничтожить handle, освободить все ресурсы.
 NVRTSP_EXPORT void NVRTSP_Destroy(NvrtspHandle handle);
+
+// Снимок статистики стрима; дёшево, можно звать каждый кадр.
+NVRTSP_EXPORT bool NVRTSP_GetStats(NvrtspHandle handle, NvrtspStats* out);
+
+// Смена параметров на лету, без пересоздания handle и разрыва RTSP-сессии.
+// Применяются между кадрами (nvEncReconfigureEncoder). Битрейт и частота
+// меняются без IDR; новая длина GOP начинается с IDR.
+NVRTSP_EXPORT bool NVRTSP_SetBitrate(NvrtspHandle handle, int bitrateKbps);
+// fpsNum/fpsDen - например, 30/1 или 30000/1001.
+NVRTSP_EXPORT bool NVRTSP_SetFramerate(NvrtspHandle handle, int fpsNum, int fpsDen);
+NVRTSP_EXPORT bool NVRTSP_SetGopLength(NvrtspHandle handle, int frames);
+
+// IDR на ближайшем кадре - например, после потерь у получателя. Запросы
+// склеиваются (пачка запросов - один IDR, не чаще 4 раз в секунду), поэтому
+// можно работать с длинным GOP, не теряя в скорости подключения.
+NVRTSP_EXPORT bool NVRTSP_RequestKeyframe(NvrtspHandle handle);
+
+// Постепенное обновление intra вместо периодических IDR (для низкой задержки
+// на узком канале): за periodFrames кадров по кадру проходит полоса
+// intra-блоков, GOP бесконечный, в поток пишется SEI recovery point. Кадры
+// ровного размера, без всплесков IDR. 0 - вернуть IDR по длине GOP.
+// Новые клиенты и PLI/FIR по-прежнему получают IDR (по запросу, см. выше).
+// Включение и выключение начинается с IDR. Если GPU не умеет intra refresh,
+// режим не меняется (сообщение в лог).
+NVRTSP_EXPORT bool NVRTSP_SetIntraRefresh(NvrtspHandle handle, int periodFrames);
+
+// Преобразование RGB -> NV12 своим проходом на GPU перед NVENC: NVENC читает
+// 1.5 байта на пиксель вместо 4, цветовое пространство (BT.709, диапазон)
+// известно точно и пишется в VUI. Смена режима начинается с IDR. Нужны
+// Windows 10 и GPU с записью в NV12 из compute shader; иначе режим не
+// меняется (сообщение в лог). Кадры с нечётной стороной и sRGB-текстуры
+// (не typeless) по-прежнему идут в NVENC как RGB.
+NVRTSP_EXPORT bool NVRTSP_SetColorConversion(NvrtspHandle handle, NvrtspColorConversion mode);
+
+// Фильтр масштабирования для текстуры, чей размер не совпадает с размером
+// кодирования (по умолчанию билинейный). Действует со следующего кадра.
+NVRTSP_EXPORT bool NVRTSP_SetScaleFilter(NvrtspHandle handle, NvrtspScaleFilter filter);
+
+// SERVER: предельный размер RTP-пакета (заголовок RTP + нагрузка), 256..9000
+// байт, по умолчанию 1400. Меньше - для туннелей и VPN с узким MTU, больше -
+// для jumbo-кадров в локальной сети. Действует со следующего кадра. В PUSH
+// пакетизирует FFmpeg (RTP поверх TCP), там размер не настраивается.
+NVRTSP_EXPORT bool NVRTSP_SetRtpMtu(NvrtspHandle handle, int mtuBytes);
+
+// SERVER: multicast-выход. Каждый кадр уходит в группу (IPv4 224.0.0.0/4,
+// RTP на port, RTCP - port + 1) один раз, поэтому CPU и трафик не растут с
+// числом приёмников. ttl 1..255 (1 - своя подсеть), iface - IPv4-адрес
+// исходящего интерфейса (nullptr или пусто - по маршруту). Клиенты RTSP,
+// запросившие multicast в SETUP, получают эту группу; остальные - unicast,
+// как раньше. Приёмникам без RTSP нужен SDP из NVRTSP_GetSdp. Их RTCP на
+// port + 1 сервер тоже принимает: отчёты о приёме и PLI из группы
+// учитываются наравне с клиентскими. group nullptr
+// или пусто - выключить. Можно вызывать и до NVRTSP_Start.
+NVRTSP_EXPORT bool NVRTSP_SetMulticast(NvrtspHandle handle, const wchar_t* group, int port,
+                                       int ttl, const wchar_t* iface);
+
+// SERVER: SDP потока (при multicast - с группой, портом и TTL; иначе - как
+// на DESCRIBE). Пишет в buf не больше bufSize - 1 символов и нуль; возвращает
+// полную длину SDP (больше bufSize - 1 - строка обрезана) или -1, если сервер
+// не запущен. SPS/PPS в SDP появляются после первого кадра.
+NVRTSP_EXPORT int NVRTSP_GetSdp(NvrtspHandle handle, char* buf, int bufSize);
+
+// SERVER: пейсинг RTP. Пакеты кадра уходят не разом, а за fraction интервала
+// кадра (0..1, 0 - выключено, по умолчанию), со скоростью не ниже битрейт /
+// fraction; подряд без паузы - не больше burstBytes (0 - 16 КБ). IDR в сотни
+// КБ, выписанный одним куском, теряется в буферах коммутатора и на Wi-Fi;
+// цена - до fraction кадра задержки. Действует со следующего кадра.
+NVRTSP_EXPORT bool NVRTSP_SetRtpPacing(NvrtspHandle handle, float fraction, int burstBytes);
+
+// SERVER: битрейт по RTCP-отчётам клиентов (и приёмников multicast-группы) о
+// приёме. Потери больше 10% -
+// снижение пропорционально потерям, меньше 2% - +5% в секунду до битрейта из
+// NVRTSP_SetBitrate, рост RTT на 100 мс - снижение ещё до потерь. Битрейт
+// общий для всех клиентов и равняется на худшего; не ниже minKbps (0 - 250).
+// По умолчанию выключено. NACK только считаются: повторной отправки нет.
+NVRTSP_EXPORT bool NVRTSP_SetAdaptiveBitrate(NvrtspHandle handle, bool enabled, int minKbps);
+
+// PUSH: политика при отставании сети и бюджет задержки очереди на отправку
+// (по умолчанию DROP_NONREF и 500 мс). Кодирование и запись в соединение
+// идут на разных потоках; медленный TCP больше не останавливает стрим.
+NVRTSP_EXPORT bool NVRTSP_SetBackpressurePolicy(NvrtspHandle handle,
+                                                NvrtspBackpressurePolicy policy,
+                                                int latencyBudgetMs);
+
+// Push-модель: кадр снимается на render thread Unity сразу после рендера,
+// а не по таймеру стрима. Из C#:
+//   GL.IssuePluginEvent(NVRTSP_GetRenderEventFunc(), NVRTSP_GetRenderEventId(h));
+// (или CommandBuffer.IssuePluginEvent) в конце кадра. После первого такого
+// события стрим кодирует только снятые кадры, прореживая их до fps стрима.
+NVRTSP_EXPORT void* NVRTSP_GetRenderEventFunc();
+
+// eventId для handle (у ступени лесенки - eventId ladder); -1 - захват
+// на render thread недоступен.
+NVRTSP_EXPORT int NVRTSP_GetRenderEventId(NvrtspHandle handle);
@@ -0,0 +1,80 @@
+#include "Platform.h"
+
+#ifndef _WIN32
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace {
+
+struct PlatformEvent
+{
+    std::mutex mx;
+    std::condition_variable cv;
+    bool signaled = false;
+    bool manualReset = false;
+};
+
+}
+
+HANDLE CreateEvent(void*, BOOL manualReset, BOOL initialState, const char*)
+{
+    PlatformEvent* ev = new PlatformEvent();
+    ev->manualReset = manualReset != FALSE;
+    ev->signaled = initialState != FALSE;
+    return ev;
+}
+
+BOOL SetEvent(HANDLE h)
+{
+    PlatformEvent* ev = (PlatformEvent*)h;
+    if (!ev)
+        return FALSE;
+    {
+        std::lock_guard<std::mutex> lk(ev->mx);
+        ev->signaled = true;
+    }
+    if (ev->manualReset)
+        ev->cv.notify_all();
+    else
+        ev->cv.notify_one();
+    return TRUE;
+}
+
+BOOL ResetEvent(HANDLE h)
+{
+    PlatformEvent* ev = (PlatformEvent*)h;
+    if (!ev)
+        return FALSE;
+    std::lock_guard<std::mutex> lk(ev->mx);
+    ev->signaled = false;
+    return TRUE;
+}
+
+DWORD WaitForSingleObject(HANDLE h, DWORD timeoutMs)
+{
+    PlatformEvent* ev = (PlatformEvent*)h;
+    if (!ev)
+        return WAIT_FAILED;
+
+    std::unique_lock<std::mutex> lk(ev->mx);
+    auto ready = [ev] { return ev->signaled; };
+    if (timeoutMs == INFINITE)
+        ev->cv.wait(lk, ready);
+    else if (!ev->cv.wait_for(lk, std::chrono::milliseconds(timeoutMs), ready))
+        return WAIT_TIMEOUT;
+
+    // Событие с автосбросом пропускает одного ожидающего.
+    if (!ev->manualReset)
+        ev->signaled = false;
+    return WAIT_OBJECT_0;
+}
+
+BOOL CloseHandle(HANDLE h)
+{
+    delete (PlatformEvent*)h;
+    return TRUE;
+}
+
+#endif
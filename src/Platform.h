@@ -0,0 +1,67 @@
+#pragma once
+
+// Минимальная прослойка над Win32 для сборки вне Windows (CI, бенчмарки с
+// фейковым бэкендом): события, коды ожидания, sprintf_s. На Windows это
+// просто <Windows.h>.
+
+#ifdef _WIN32
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+
+#else
+
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+typedef long          HRESULT;
+typedef int           BOOL;
+typedef unsigned int  UINT;
+typedef unsigned long DWORD;
+typedef void*         HANDLE;
+
+#define TRUE  1
+#define FALSE 0
+
+#define S_OK          ((HRESULT)0)
+#define E_FAIL        ((HRESULT)0x80004005L)
+#define E_INVALIDARG  ((HRESULT)0x80070057L)
+#define E_OUTOFMEMORY ((HRESULT)0x8007000EL)
+
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr)    (((HRESULT)(hr)) < 0)
+
+#define INFINITE      0xFFFFFFFFu
+#define WAIT_OBJECT_0 0x00000000u
+#define WAIT_TIMEOUT  0x00000102u
+#define WAIT_FAILED   0xFFFFFFFFu
+
+#define ZeroMemory(dst, len) memset((dst), 0, (len))
+
+template <size_t N>
+inline int sprintf_s(char (&buf)[N], const char* fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, N, fmt, ap);
+    va_end(ap);
+    return n;
+}
+
+inline void OutputDebugStringA(const char* msg)
+{
+    fputs(msg, stderr);
+}
+
+// События Win32 поверх mutex + condition_variable (Platform.cpp).
+HANDLE CreateEvent(void* attrs, BOOL manualReset, BOOL initialState, const char* name);
+BOOL   SetEvent(HANDLE ev);
+BOOL   ResetEvent(HANDLE ev);
+DWORD  WaitForSingleObject(HANDLE ev, DWORD timeoutMs);
+BOOL   CloseHandle(HANDLE ev);
+
+#endif
@@ -0,0 +1,209 @@
+#include "PushSender.h"
+
+#include <chrono>
+
+#include "StreamScheduler.h"
+
+PushSender::PushSender(StreamStats& stats)
+    : m_stats(stats)
+{
+    m_thread = std::thread(&PushSender::ThreadMain, this);
+}
+
+PushSender::~PushSender()
+{
+    Stop();
+}
+
+void PushSender::Activate(WriteFn write)
+{
+    std::lock_guard<std::mutex> lk(m_mx);
+    if (m_active || m_stop)
+        return;
+    m_write = std::move(write);
+    m_active = true;
+    m_failed = false;
+    m_waitKey = false;
+}
+
+bool PushSender::Enqueue(const NvEncPacket& p)
+{
+    std::lock_guard<std::mutex> lk(m_mx);
+    if (m_waitKey && p.keyframe)
+        m_waitKey = false;
+
+    if (!m_active || m_waitKey) {
+        m_stats.framesDropped.fetch_add(1, std::memory_order_relaxed);
+        if (m_active)
+            m_stats.framesDroppedBackpressure.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    Item it;
+    it.pkt = p;
+    it.queuedNs = StreamScheduler::NowNs();
+    m_bytes += p.data.size();
+    m_queue.push_back(std::move(it));
+    m_cv.notify_all();
+    return true;
+}
+
+bool PushSender::TakeFailed()
+{
+    std::lock_guard<std::mutex> lk(m_mx);
+    bool failed = m_failed;
+    m_failed = false;
+    return failed;
+}
+
+void PushSender::DropLocked(std::deque<Item>::iterator first, std::deque<Item>::iterator last)
+{
+    uint64_t n = 0;
+    for (auto it = first; it != last; ++it) {
+        m_bytes -= it->pkt.data.size();
+        ++n;
+    }
+    m_queue.erase(first, last);
+    m_stats.framesDropped.fetch_add(n, std::memory_order_relaxed);
+    m_stats.framesDroppedBackpressure.fetch_add(n, std::memory_order_relaxed);
+}
+
+size_t PushSender::DropDisposable(NalCodec codec)
+{
+    if (codec == NalCodec::AV1)
+        return 0;
+
+    std::lock_guard<std::mutex> lk(m_mx);
+    size_t before = m_queue.size();
+    auto keep = m_queue.begin();
+    for (auto it = m_queue.begin(); it != m_queue.end(); ++it) {
+        const NvEncPacketRef& d = it->pkt.data;
+        if (!it->pkt.keyframe && NalIndexIsDisposable(d.data(), d.nals(), codec)) {
+            m_bytes -= d.size();
+            continue;
+        }
+        if (keep != it)
+            *keep = std::move(*it);
+        ++keep;
+    }
+    m_queue.erase(keep, m_queue.end());
+
+    size_t n = before - m_queue.size();
+    m_stats.framesDropped.fetch_add(n, std::memory_order_relaxed);
+    m_stats.framesDroppedBackpressure.fetch_add(n, std::memory_order_relaxed);
+    return n;
+}
+
+size_t PushSender::DropToKeyframe(int64_t minQueuedNs, bool& needKeyframe)
+{
+    std::lock_guard<std::mutex> lk(m_mx);
+    needKeyframe = false;
+
+    // Свежий IDR уже в очереди: всё перед ним не нужно декодеру.
+    for (size_t i = m_queue.size(); i-- > 0 && m_queue[i].queuedNs >= minQueuedNs;) {
+        if (m_queue[i].pkt.keyframe) {
+            DropLocked(m_queue.begin(), m_queue.begin() + i);
+            return i;
+        }
+    }
+
+    size_t n = m_queue.size();
+    DropLocked(m_queue.begin(), m_queue.end());
+    if (m_active) {
+        m_waitKey = true;
+        needKeyframe = true;
+    }
+    return n;
+}
+
+void PushSender::ClearLocked()
+{
+    m_stats.framesDropped.fetch_add(m_queue.size(), std::memory_order_relaxed);
+    m_queue.clear();
+    m_bytes = 0;
+}
+
+bool PushSender::Drain(int64_t timeoutNs)
+{
+    std::unique_lock<std::mutex> lk(m_mx);
+    return m_cv.wait_for(lk, std::chrono::nanoseconds(timeoutNs), [&] {
+        return !m_active || (m_queue.empty() && !m_writing);
+    }) && m_active;
+}
+
+bool PushSender::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lk(m_mx);
+        m_stop = true;
+        m_cv.notify_all();
+    }
+    if (m_thread.joinable())
+        m_thread.join();
+
+    std::lock_guard<std::mutex> lk(m_mx);
+    bool clean = m_active && !m_failed && !m_waitKey && m_queue.empty();
+    ClearLocked();
+    m_active = false;
+    m_write = nullptr;
+    return clean;
+}
+
+uint32_t PushSender::QueuedFrames() const
+{
+    std::lock_guard<std::mutex> lk(m_mx);
+    return (uint32_t)m_queue.size();
+}
+
+uint64_t PushSender::QueuedBytes() const
+{
+    std::lock_guard<std::mutex> lk(m_mx);
+    return m_bytes;
+}
+
+int64_t PushSender::OldestAgeNs(int64_t nowNs) const
+{
+    std::lock_guard<std::mutex> lk(m_mx);
+    return m_queue.empty() ? 0 : nowNs - m_queue.front().queuedNs;
+}
+
+void PushSender::ThreadMain()
+{
+    std::unique_lock<std::mutex> lk(m_mx);
+
+    while (true) {
+        m_cv.wait(lk, [&] { return m_stop || (m_active && !m_queue.empty()); });
+        if (m_stop)
+            break;
+
+        Item it = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_bytes -= it.pkt.data.size();
+        m_writing = true;
+        lk.unlock();
+
+        int64_t t0 = StreamScheduler::NowNs();
+        bool ok = m_write(it.pkt);
+        m_stats.muxLatency.Record(StreamScheduler::NowNs() - t0);
+        if (ok) {
+            m_stats.framesSent.fetch_add(1, std::memory_order_relaxed);
+            m_stats.bytesOut.fetch_add(it.pkt.data.size(), std::memory_order_relaxed);
+        }
+
+        // Ссылку на блок пула отпускаем без мьютекса.
+        it.pkt.data.Reset();
+        lk.lock();
+        m_writing = false;
+
+        if (!ok) {
+            // Соединение отдаётся на переподключение; что было в очереди,
+            // всё равно относится к нему.
+            m_active = false;
+            m_failed = true;
+            ClearLocked();
+        }
+        // Drain ждёт пустой очереди.
+        if (m_queue.empty())
+            m_cv.notify_all();
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "AnnexB.h"
+#include "NvencEncoder.h"
+#include "StreamStats.h"
+
+// Очередь кадров PUSH-выхода и поток, который пишет их в соединение.
+// av_write_frame на медленном TCP блокируется; раньше вместе с ним стоял
+// шаг пула и кодирование. Теперь шаг только ставит кадр в очередь, а что
+// делать, если очередь растёт, решает политика стрима (NvrtspBackpressurePolicy)
+// по возрасту самого старого кадра.
+//
+// Куда писать, задаёт WriteFn (в плагине - av_write_frame в AVFormatContext;
+// для проверки подходит любой сокет с искусственно узким каналом).
+class PushSender
+{
+public:
+    // Запись одного кадра на потоке отправки; false - соединение потеряно.
+    using WriteFn = std::function<bool(const NvEncPacket&)>;
+
+    explicit PushSender(StreamStats& stats);
+    ~PushSender();
+
+    PushSender(const PushSender&) = delete;
+    PushSender& operator=(const PushSender&) = delete;
+
+    // Соединение готово: поток начинает отдавать кадры в write. До этого
+    // (и после ошибки записи) кадры отбрасываются, как без соединения.
+    void Activate(WriteFn write);
+
+    // Кадр в очередь. false - отброшен (нет соединения или ждём IDR
+    // после DropToKeyframe).
+    bool Enqueue(const NvEncPacket& p);
+
+    // Запись не удалась: поток отправки больше не трогает соединение,
+    // очередь сброшена. true - один раз на обрыв.
+    bool TakeFailed();
+
+    // Выбросить из очереди кадры без опорных срезов (H.264/HEVC).
+    size_t DropDisposable(NalCodec codec);
+
+    // Выбросить всё до самого свежего ключевого кадра, поставленного в
+    // очередь не раньше minQueuedNs; если такого нет - всё, и дальше
+    // отбрасывать кадры до ключевого (needKeyframe - его надо запросить).
+    size_t DropToKeyframe(int64_t minQueuedNs, bool& needKeyframe);
+
+    // Подождать, пока очередь допишется, но не дольше timeoutNs.
+    // true - очередь пуста и поток ничего не пишет.
+    bool Drain(int64_t timeoutNs);
+
+    // Остановить поток, недописанное отбросить. Если поток висит в записи,
+    // её должен прервать владелец соединения (RtspConnector::Interrupt).
+    // true - все кадры записаны без ошибок.
+    bool Stop();
+
+    // Состояние очереди (без кадра, который пишется сейчас); с любого потока.
+    uint32_t QueuedFrames() const;
+    uint64_t QueuedBytes() const;
+    // Сколько ждёт самый старый кадр очереди, 0 - очередь пуста.
+    int64_t OldestAgeNs(int64_t nowNs) const;
+
+private:
+    struct Item
+    {
+        NvEncPacket pkt;
+        int64_t queuedNs = 0;
+    };
+
+    void ThreadMain();
+    void DropLocked(std::deque<Item>::iterator first, std::deque<Item>::iterator last);
+    void ClearLocked();
+
+    StreamStats& m_stats;
+
+    mutable std::mutex m_mx;
+    std::condition_variable m_cv;
+    std::thread m_thread;
+
+    std::deque<Item> m_queue;
+    uint64_t m_bytes = 0;
+    bool m_writing = false;
+
+    // m_write меняется только при !m_active, а пишет поток только при m_active.
+    WriteFn m_write;
+    bool m_active = false;
+    bool m_failed = false;
+    bool m_waitKey = false;
+    bool m_stop = false;
+};
@@ -0,0 +1,148 @@
+#include "Resize.h"
+
+#include <cmath>
+
+namespace {
+
+const int32_t kWeightBits = 14;
+// Больше отсчётов шейдер не читает: при сильном уменьшении ядро перестаёт
+// растягиваться (немного алиасинга вместо сотен чтений на пиксель).
+const uint32_t kMaxTaps = 24;
+const double kPi = 3.14159265358979323846;
+
+double Radius(ScaleFilter filter)
+{
+    return filter == ScaleFilter::Lanczos ? 3.0 : 1.0;
+}
+
+double Kernel(ScaleFilter filter, double x)
+{
+    x = std::fabs(x);
+    if (filter == ScaleFilter::Bilinear)
+        return x < 1.0 ? 1.0 - x : 0.0;
+
+    if (x < 1e-9)
+        return 1.0;
+    if (x >= 3.0)
+        return 0.0;
+    double px = kPi * x;
+    return 3.0 * std::sin(px) * std::sin(px / 3.0) / (px * px);
+}
+
+inline int32_t ClampIndex(int32_t i, uint32_t size)
+{
+    return i < 0 ? 0 : i >= (int32_t)size ? (int32_t)size - 1 : i;
+}
+
+} // namespace
+
+ScaleTaps BuildScaleTaps(uint32_t srcSize, uint32_t dstSize, ScaleFilter filter)
+{
+    ScaleTaps t;
+    if (!srcSize || !dstSize)
+        return t;
+
+    // При уменьшении ядро растягивается на шаг приёмника, иначе - алиасинг.
+    const double scale = (double)srcSize / dstSize;
+    const double radius = Radius(filter);
+    double stretch = scale > 1.0 ? scale : 1.0;
+    if (2.0 * radius * stretch > kMaxTaps)
+        stretch = kMaxTaps / (2.0 * radius);
+    const double support = radius * stretch;
+
+    t.taps = (uint32_t)std::ceil(2.0 * support);
+    const uint32_t stride = t.taps + 1;
+    t.table.assign((size_t)dstSize * stride, 0);
+
+    double w[kMaxTaps];
+    for (uint32_t i = 0; i < dstSize; ++i) {
+        const double center = (i + 0.5) * scale - 0.5;
+        const int32_t start = (int32_t)std::floor(center - support) + 1;
+        int32_t* row = &t.table[(size_t)i * stride];
+        row[0] = start;
+
+        double sum = 0.0;
+        for (uint32_t k = 0; k < t.taps; ++k) {
+            w[k] = Kernel(filter, (start + (int32_t)k - center) / stretch);
+            sum += w[k];
+        }
+
+        // Остаток округления - самому большому весу, чтобы сумма была точной.
+        int32_t total = 0;
+        uint32_t peak = 0;
+        for (uint32_t k = 0; k < t.taps; ++k) {
+            row[1 + k] = (int32_t)std::lround(w[k] / sum * (1 << kWeightBits));
+            total += row[1 + k];
+            if (row[1 + k] > row[1 + peak])
+                peak = k;
+        }
+        row[1 + peak] += (1 << kWeightBits) - total;
+    }
+    return t;
+}
+
+namespace {
+
+// Общий проход эталона: channels байт на точку, order - из какого байта
+// источника берётся канал приёмника.
+void ScaleChannels(const uint8_t* src, size_t srcPitch, int channels, const int* order,
+                   uint32_t sw, uint32_t sh, uint8_t* dst, size_t dstPitch,
+                   uint32_t dw, uint32_t dh, ScaleFilter filter)
+{
+    const ScaleTaps hx = BuildScaleTaps(sw, dw, filter);
+    const ScaleTaps hy = BuildScaleTaps(sh, dh, filter);
+    if (hx.table.empty() || hy.table.empty())
+        return;
+
+    // Проход по строкам: каждая строка источника -> dw точек, 7 бит дроби.
+    const size_t rowLen = (size_t)dw * channels;
+    std::vector<int32_t> rows((size_t)sh * rowLen);
+    for (uint32_t y = 0; y < sh; ++y) {
+        const uint8_t* in = src + (size_t)y * srcPitch;
+        int32_t* out = &rows[(size_t)y * rowLen];
+
+        for (uint32_t x = 0; x < dw; ++x) {
+            const int32_t* tx = &hx.table[(size_t)x * (hx.taps + 1)];
+            for (int c = 0; c < channels; ++c) {
+                int32_t acc = 0;
+                for (uint32_t k = 0; k < hx.taps; ++k)
+                    acc += tx[1 + k] * in[ClampIndex(tx[0] + (int32_t)k, sw) * channels + order[c]];
+                out[x * channels + c] = (acc + (1 << 6)) >> 7;
+            }
+        }
+    }
+
+    // Проход по столбцам: 14 + 7 бит дроби -> 8 бит с насыщением.
+    for (uint32_t y = 0; y < dh; ++y) {
+        const int32_t* ty = &hy.table[(size_t)y * (hy.taps + 1)];
+        uint8_t* out = dst + (size_t)y * dstPitch;
+
+        for (size_t x = 0; x < rowLen; ++x) {
+            int32_t acc = 0;
+            for (uint32_t k = 0; k < hy.taps; ++k)
+                acc += ty[1 + k] * rows[(size_t)ClampIndex(ty[0] + (int32_t)k, sh) * rowLen + x];
+            int32_t v = (acc + (1 << 20)) >> 21;
+            out[x] = (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v);
+        }
+    }
+}
+
+} // namespace
+
+void ScaleRgba(const uint8_t* src, size_t srcPitch, bool bgra, uint32_t sw, uint32_t sh,
+               uint8_t* dst, size_t dstPitch, uint32_t dw, uint32_t dh,
+               ScaleFilter filter)
+{
+    // Каналы приёмника всегда в порядке RGBA.
+    const int order[4] = { bgra ? 2 : 0, 1, bgra ? 0 : 2, 3 };
+    ScaleChannels(src, srcPitch, 4, order, sw, sh, dst, dstPitch, dw, dh, filter);
+}
+
+void ScaleNv12(const uint8_t* srcY, const uint8_t* srcUV, size_t srcPitch, uint32_t sw, uint32_t sh,
+               uint8_t* dstY, uint8_t* dstUV, size_t dstPitch, uint32_t dw, uint32_t dh,
+               ScaleFilter filter)
+{
+    const int order[2] = { 0, 1 };
+    ScaleChannels(srcY, srcPitch, 1, order, sw, sh, dstY, dstPitch, dw, dh, filter);
+    ScaleChannels(srcUV, srcPitch, 2, order, sw / 2, sh / 2, dstUV, dstPitch, dw / 2, dh / 2, filter);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Фильтр масштабирования кадра под размер кодирования.
+enum class ScaleFilter
+{
+    Bilinear,   // 2 отсчёта на ось при увеличении, больше - при уменьшении
+    Lanczos,    // Lanczos-3: резче, но в полтора-три раза больше отсчётов
+};
+
+// Веса разделимого фильтра для одной оси, 14 бит (сумма по точке - 1 << 14).
+// Для точки приёмника i: table[i * (taps + 1)] - первый отсчёт источника,
+// дальше taps весов подряд; индексы за краем кадра прижимаются к краю.
+// Одна и та же таблица уходит в шейдер FrameScaler и в CPU-эталон.
+struct ScaleTaps
+{
+    uint32_t taps = 0;
+    std::vector<int32_t> table;
+};
+
+ScaleTaps BuildScaleTaps(uint32_t srcSize, uint32_t dstSize, ScaleFilter filter);
+
+// CPU-эталон прохода FrameScaler: RGBA/BGRA 8 бит sw x sh -> RGBA 8 бит
+// dw x dh. Сначала строка (остаток 7 бит), потом столбец - в целых числах,
+// как в шейдере, поэтому результат совпадает бит в бит.
+void ScaleRgba(const uint8_t* src, size_t srcPitch, bool bgra, uint32_t sw, uint32_t sh,
+               uint8_t* dst, size_t dstPitch, uint32_t dw, uint32_t dh,
+               ScaleFilter filter);
+
+// То же для кадра NV12 (стороны чётные): яркость sw x sh -> dw x dh, пары UV
+// вдвое меньшей плоскости - отдельно теми же фильтрами. Так ступени
+// симулкаста масштабируют уже готовый NV12 основного стрима, не повторяя
+// проход RGB -> NV12. Шаг строки у обеих плоскостей общий, как в D3D11.
+void ScaleNv12(const uint8_t* srcY, const uint8_t* srcUV, size_t srcPitch, uint32_t sw, uint32_t sh,
+               uint8_t* dstY, uint8_t* dstUV, size_t dstPitch, uint32_t dw, uint32_t dh,
+               ScaleFilter filter);
@@ -0,0 +1,143 @@
+#include "Rtcp.h"
+
+#include <chrono>
+
+namespace {
+
+// Секунд от 1900 (эпоха NTP) до 1970 (эпоха system_clock).
+const uint64_t kNtpUnixOffset = 2208988800ULL;
+
+const uint8_t kPtSr    = 200;
+const uint8_t kPtRr    = 201;
+const uint8_t kPtSdes  = 202;
+const uint8_t kPtRtpfb = 205;
+const uint8_t kPtPsfb  = 206;
+
+const size_t kReportBlockSize = 24;
+const size_t kSenderInfoSize = 20;
+
+uint32_t Read32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+void Put32(std::vector<uint8_t>& out, uint32_t v)
+{
+    out.push_back((uint8_t)(v >> 24));
+    out.push_back((uint8_t)(v >> 16));
+    out.push_back((uint8_t)(v >> 8));
+    out.push_back((uint8_t)v);
+}
+
+void ReadReportBlocks(const uint8_t* p, size_t n, size_t count, RtcpFeedback& fb)
+{
+    for (size_t i = 0; i < count && n >= kReportBlockSize; ++i) {
+        RtcpReportBlock b;
+        b.ssrc = Read32(p);
+        b.fractionLost = p[4];
+        // 24 бита со знаком.
+        uint32_t lost = ((uint32_t)p[5] << 16) | ((uint32_t)p[6] << 8) | p[7];
+        b.cumulativeLost = (lost & 0x800000) ? (int32_t)(lost | 0xFF000000) : (int32_t)lost;
+        b.highestSeq = Read32(p + 8);
+        b.jitter = Read32(p + 12);
+        b.lsr = Read32(p + 16);
+        b.dlsr = Read32(p + 20);
+        fb.reports.push_back(b);
+        p += kReportBlockSize;
+        n -= kReportBlockSize;
+    }
+}
+
+} // namespace
+
+bool ParseRtcp(const uint8_t* p, size_t n, RtcpFeedback& fb)
+{
+    if (n < 4)
+        return false;
+    while (n >= 4) {
+        if ((p[0] >> 6) != 2)
+            return false;
+        const uint8_t count = p[0] & 0x1F;     // RC или FMT
+        const uint8_t pt = p[1];
+        const size_t len = (((size_t)p[2] << 8) | p[3]) * 4 + 4;
+        if (len > n)
+            return false;
+
+        if (pt == kPtSr && len >= 8 + kSenderInfoSize)
+            ReadReportBlocks(p + 8 + kSenderInfoSize, len - 8 - kSenderInfoSize, count, fb);
+        else if (pt == kPtRr && len >= 8)
+            ReadReportBlocks(p + 8, len - 8, count, fb);
+        else if (pt == kPtRtpfb && count == 1) {
+            // Generic NACK: PID и маска BLP ещё 16 пакетов за ним.
+            for (size_t off = 12; off + 4 <= len; off += 4) {
+                uint16_t blp = (uint16_t)((p[off + 2] << 8) | p[off + 3]);
+                uint32_t lost = 1;
+                for (; blp; blp &= (uint16_t)(blp - 1))
+                    ++lost;
+                fb.nackedPackets += lost;
+            }
+        }
+        else if (pt == kPtPsfb && (count == 1 || count == 4))
+            fb.keyframeRequest = true;
+
+        p += len;
+        n -= len;
+    }
+    return true;
+}
+
+void BuildRtcpSr(const RtcpSenderInfo& info, const std::string& cname, std::vector<uint8_t>& out)
+{
+    out.clear();
+
+    // SR без блоков отчёта: 6 слов после заголовка.
+    out.push_back(0x80);
+    out.push_back(kPtSr);
+    out.push_back(0);
+    out.push_back(6);
+    Put32(out, info.ssrc);
+    Put32(out, (uint32_t)(info.ntp >> 32));
+    Put32(out, (uint32_t)info.ntp);
+    Put32(out, info.rtpTs);
+    Put32(out, info.packets);
+    Put32(out, info.octets);
+
+    // SDES с одним CNAME: составной пакет без него по RFC 3550 неполон.
+    const size_t nameLen = cname.size() < 255 ? cname.size() : 255;
+    const size_t start = out.size();
+    out.push_back(0x81);
+    out.push_back(kPtSdes);
+    out.push_back(0);
+    out.push_back(0);
+    Put32(out, info.ssrc);
+    out.push_back(1);   // CNAME
+    out.push_back((uint8_t)nameLen);
+    out.insert(out.end(), cname.begin(), cname.begin() + nameLen);
+    // Конец списка - нулевой байт, затем добивка до слова.
+    do
+        out.push_back(0);
+    while ((out.size() - start) % 4);
+    const size_t words = (out.size() - start) / 4 - 1;
+    out[start + 2] = (uint8_t)(words >> 8);
+    out[start + 3] = (uint8_t)words;
+}
+
+uint64_t RtcpNtpNow()
+{
+    using namespace std::chrono;
+    const int64_t us = duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+    const uint64_t sec = (uint64_t)(us / 1000000) + kNtpUnixOffset;
+    const uint64_t frac = ((uint64_t)(us % 1000000) << 32) / 1000000;
+    return (sec << 32) | frac;
+}
+
+double RtcpRttMs(const RtcpReportBlock& b, uint32_t nowMid32)
+{
+    if (!b.lsr)
+        return -1.0;
+    // Всё в 1/65536 с; разность по модулю 2^32 переживает переполнение.
+    const uint32_t rtt = nowMid32 - b.lsr - b.dlsr;
+    if (rtt & 0x80000000u)
+        return -1.0;
+    return (double)rtt * 1000.0 / 65536.0;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// RTCP (RFC 3550, обратная связь - RFC 4585/5104): разбор того, что шлют
+// клиенты (RR, NACK, PLI/FIR), и сборка отчёта отправителя (SR).
+
+// Блок отчёта о приёме (RR или SR клиента), RFC 3550 6.4.1.
+struct RtcpReportBlock
+{
+    uint32_t ssrc = 0;          // о каком источнике отчёт
+    uint8_t  fractionLost = 0;  // доля потерь с прошлого отчёта, /256
+    int32_t  cumulativeLost = 0;
+    uint32_t highestSeq = 0;
+    uint32_t jitter = 0;        // в тиках часов RTP
+    uint32_t lsr = 0;           // средние 32 бита NTP нашего последнего SR, 0 - SR не было
+    uint32_t dlsr = 0;          // от того SR до этого отчёта, 1/65536 с
+};
+
+// Всё полезное из одного составного RTCP-пакета.
+struct RtcpFeedback
+{
+    std::vector<RtcpReportBlock> reports;
+    uint32_t nackedPackets = 0;     // RTPFB NACK: сколько пакетов просили повторить
+    bool keyframeRequest = false;   // PSFB PLI или FIR
+};
+
+// Разбирает составной пакет, дописывая в fb. false - не RTCP или обрезан;
+// то, что разобрано до ошибки, остаётся в fb.
+bool ParseRtcp(const uint8_t* p, size_t n, RtcpFeedback& fb);
+
+// Сводка отчётов о приёме за интервал - худшее по клиентам.
+struct RtcpReceiverReport
+{
+    uint32_t blocks = 0;            // блоков отчёта о нашем SSRC
+    uint32_t nackedPackets = 0;
+    double   lossFraction = 0.0;    // 0..1
+    double   jitterMs = 0.0;
+    double   rttMs = -1.0;          // -1 - не измерен (клиент не видел SR)
+};
+
+// Что отправитель знает о потоке к моменту SR.
+struct RtcpSenderInfo
+{
+    uint32_t ssrc = 0;
+    uint64_t ntp = 0;       // 32.32 с от 1900 года
+    uint32_t rtpTs = 0;     // тот же момент на часах RTP
+    uint32_t packets = 0;
+    uint32_t octets = 0;    // байт полезной нагрузки, без заголовков RTP
+};
+
+// Составной пакет SR (без блоков отчёта: мы только шлём) + SDES CNAME.
+void BuildRtcpSr(const RtcpSenderInfo& info, const std::string& cname, std::vector<uint8_t>& out);
+
+// Текущее время NTP по системным часам.
+uint64_t RtcpNtpNow();
+
+// Средние 32 бита NTP - в этом виде SR возвращается клиентом в LSR.
+inline uint32_t RtcpNtpMid32(uint64_t ntp) { return (uint32_t)(ntp >> 16); }
+
+// RTT по блоку отчёта в мс на момент nowMid32; -1 - клиент ещё не видел SR.
+double RtcpRttMs(const RtcpReportBlock& b, uint32_t nowMid32);
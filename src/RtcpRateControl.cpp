@@ -0,0 +1,68 @@
+#include "RtcpRateControl.h"
+
+namespace {
+
+const double  kLossHigh = 0.10;
+const double  kLossLow = 0.02;
+const double  kIncreaseFactor = 1.05;
+const double  kRttOveruseMs = 100.0;
+const double  kRttDecreaseFactor = 0.85;
+const int64_t kAdjustIntervalNs = 1000000000;
+
+} // namespace
+
+void RtcpRateControl::Reset(uint32_t maxKbps, uint32_t minKbps)
+{
+    m_maxKbps = maxKbps;
+    m_minKbps = minKbps < maxKbps ? minKbps : maxKbps;
+    m_kbps = maxKbps;
+    m_minRttMs = -1.0;
+    m_decreaseNs = 0;
+    m_increaseNs = 0;
+}
+
+uint32_t RtcpRateControl::OnReport(const RtcpReceiverReport& r, int64_t nowNs)
+{
+    if (!r.blocks)
+        return m_kbps;
+
+    // Минимальный RTT - путь без очереди; он и точка отсчёта роста.
+    bool rttOveruse = false;
+    if (r.rttMs >= 0.0) {
+        if (m_minRttMs < 0.0 || r.rttMs < m_minRttMs)
+            m_minRttMs = r.rttMs;
+        rttOveruse = r.rttMs > m_minRttMs + kRttOveruseMs;
+    }
+
+    const bool canDecrease = !m_decreaseNs || nowNs - m_decreaseNs >= kAdjustIntervalNs;
+    double next = m_kbps;
+    if (r.lossFraction > kLossHigh) {
+        if (!canDecrease)
+            return m_kbps;
+        next = m_kbps * (1.0 - 0.5 * r.lossFraction);
+    }
+    else if (rttOveruse) {
+        if (!canDecrease)
+            return m_kbps;
+        next = m_kbps * kRttDecreaseFactor;
+    }
+    else if (r.lossFraction < kLossLow) {
+        if (m_kbps >= m_maxKbps || !canDecrease ||
+            (m_increaseNs && nowNs - m_increaseNs < kAdjustIntervalNs))
+            return m_kbps;
+        // +1: на малых битрейтах 5% округлились бы в ноль.
+        next = m_kbps * kIncreaseFactor + 1.0;
+        m_increaseNs = nowNs;
+    }
+    else
+        return m_kbps;
+
+    if (next < m_kbps)
+        m_decreaseNs = nowNs;
+    if (next > m_maxKbps)
+        next = m_maxKbps;
+    if (next < m_minKbps)
+        next = m_minKbps;
+    m_kbps = (uint32_t)next;
+    return m_kbps;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Rtcp.h"
+
+// Битрейт по отчётам о приёме (NVRTSP_SetAdaptiveBitrate), по образцу
+// контроллера по потерям из GCC (draft-ietf-rmcat-gcc, раздел 6):
+//   потери > 10%  - битрейт * (1 - потери / 2);
+//   потери < 2%   - +5% не чаще раза в секунду, до заданного;
+//   между ними    - держим.
+// Детектора задержки GCC по времени прихода пакетов нет (нужна TWCC-обратная
+// связь); его место занимает RTT из RR: рост на 100 мс над минимумом -
+// очередь у узкого места растёт, битрейт * 0.85 ещё до потерь.
+//
+// Снижения не чаще раза в секунду: отчёт описывает пакеты, ушедшие ещё по
+// старому битрейту, и сразу после снижения тот же избыток посчитался бы
+// дважды. Время передаётся снаружи, поэтому поведение проверяется на
+// подставных отчётах без сети и ожидания.
+class RtcpRateControl
+{
+public:
+    // Битрейт от заданного (maxKbps) вниз, не ниже minKbps.
+    void Reset(uint32_t maxKbps, uint32_t minKbps);
+
+    // Отчёт за интервал в момент nowNs; новый битрейт (или прежний).
+    uint32_t OnReport(const RtcpReceiverReport& r, int64_t nowNs);
+
+    uint32_t Kbps() const { return m_kbps; }
+    uint32_t MaxKbps() const { return m_maxKbps; }
+    uint32_t MinKbps() const { return m_minKbps; }
+
+private:
+    uint32_t m_maxKbps = 0;
+    uint32_t m_minKbps = 0;
+    uint32_t m_kbps = 0;
+    double   m_minRttMs = -1.0;
+    int64_t  m_decreaseNs = 0;      // 0 - ещё не снижали
+    int64_t  m_increaseNs = 0;
+};
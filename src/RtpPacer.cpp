@@ -0,0 +1,68 @@
+#include "RtpPacer.h"
+
+#include <algorithm>
+#include <cmath>
+
+RtpPacer::RtpPacer(PacerClock* clock)
+    : m_clock(clock ? clock : &m_steady)
+{
+    m_tokens = m_cfg.burstBytes;
+    m_lastNs = m_clock->NowNs();
+}
+
+void RtpPacer::SetConfig(const RtpPacingConfig& cfg)
+{
+    m_cfg = cfg;
+    m_cfg.fraction = std::min(std::max(cfg.fraction, 0.0), 1.0);
+}
+
+bool RtpPacer::Enabled() const
+{
+    return m_cfg.fraction > 0.0 && m_cfg.frameIntervalNs > 0;
+}
+
+void RtpPacer::Refill(int64_t nowNs)
+{
+    if (nowNs > m_lastNs)
+        m_tokens += (double)(nowNs - m_lastNs) * m_rate;
+    m_lastNs = nowNs;
+}
+
+void RtpPacer::OnFrame(size_t frameBytes, size_t queuedBytes)
+{
+    Refill(m_clock->NowNs());
+    // Очередь была пуста: за простой копится не больше ведра.
+    if (queuedBytes <= frameBytes)
+        m_tokens = std::min(m_tokens, (double)m_cfg.burstBytes);
+
+    if (!Enabled()) {
+        m_rate = 0.0;
+        return;
+    }
+
+    const double window = m_cfg.fraction * (double)m_cfg.frameIntervalNs;
+    // кбит/с -> байт/нс: * 1000 / 8 / 1e9.
+    const double byBitrate = (double)m_cfg.bitrateKbps / 8e6 / m_cfg.fraction;
+    const double byQueue = (double)queuedBytes / window;
+    m_rate = std::max(byBitrate, byQueue);
+}
+
+int64_t RtpPacer::WaitNs(size_t size)
+{
+    if (!Enabled() || m_rate <= 0.0)
+        return 0;
+
+    Refill(m_clock->NowNs());
+    // Пакет больше ведра всё равно должен уйти: ждём только полного ведра.
+    const double need = std::min((double)size, (double)std::max<uint32_t>(m_cfg.burstBytes, 1));
+    if (m_tokens >= need)
+        return 0;
+    return (int64_t)std::ceil((need - m_tokens) / m_rate);
+}
+
+void RtpPacer::Consume(size_t size)
+{
+    // Без пейсинга ведро не пополняется - и не расходуется.
+    if (Enabled())
+        m_tokens -= (double)size;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "FramePacer.h"
+
+// Настройки пейсинга RTP (NVRTSP_SetRtpPacing).
+struct RtpPacingConfig
+{
+    // Доля интервала кадра, за которую уходит кадр; 0 - без пейсинга.
+    double fraction = 0.0;
+    // Глубина ведра: столько байт может уйти подряд без паузы.
+    uint32_t burstBytes = 16 * 1024;
+    int64_t frameIntervalNs = 0;
+    uint32_t bitrateKbps = 0;
+};
+
+// Ведро токенов для RTP-пакетов кадра. IDR в 200 КБ, выписанный разом,
+// переполняет буферы коммутатора и теряется на Wi-Fi; пейсер растягивает
+// кадр на fraction интервала кадра.
+//
+// Скорость пересчитывается на каждом кадре: заданный битрейт / fraction
+// (средний кадр занимает долю интервала), но не меньше, чем нужно, чтобы
+// всё, что в очереди, ушло за fraction интервала. Пока очередь пуста,
+// токены копятся не больше burstBytes; пока она не пуста - без предела,
+// чтобы опоздавший поток (грубый таймер ОС) наверстал среднюю скорость.
+//
+// Сам пейсер не ждёт и не шлёт: он говорит, сколько ждать до пакета, а
+// ждёт владелец. Часы подменяются (PacerClock), поэтому расписание
+// проверяется на ручных часах без реального ожидания.
+class RtpPacer
+{
+public:
+    // clock == nullptr - steady_clock. Часы должны жить дольше пейсера.
+    explicit RtpPacer(PacerClock* clock = nullptr);
+
+    void SetConfig(const RtpPacingConfig& cfg);
+    const RtpPacingConfig& Config() const { return m_cfg; }
+    bool Enabled() const;
+
+    int64_t NowNs() { return m_clock->NowNs(); }
+
+    // В очередь встал кадр frameBytes; queuedBytes - всё неотправленное,
+    // включая его.
+    void OnFrame(size_t frameBytes, size_t queuedBytes);
+
+    // Сколько ждать, пока можно отправить пакет size байт; 0 - уже можно.
+    int64_t WaitNs(size_t size);
+
+    // Пакет size байт отправлен.
+    void Consume(size_t size);
+
+private:
+    void Refill(int64_t nowNs);
+
+    SteadyPacerClock m_steady;
+    PacerClock* m_clock;
+    RtpPacingConfig m_cfg;
+
+    double  m_tokens = 0.0;      // байт
+    double  m_rate = 0.0;        // байт в нс
+    int64_t m_lastNs = 0;
+};
@@ -0,0 +1,385 @@
+#include "RtpPacketizer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Av1Obu.h"
+
+void WriteRtpHeader(uint8_t* p, uint8_t payloadType, bool marker,
+                    uint16_t seq, uint32_t ts, uint32_t ssrc)
+{
+    p[0]  = 0x80;   // V=2, P=0, X=0, CC=0
+    p[1]  = (uint8_t)((marker ? 0x80 : 0) | (payloadType & 0x7F));
+    p[2]  = (uint8_t)(seq >> 8);
+    p[3]  = (uint8_t)(seq);
+    p[4]  = (uint8_t)(ts >> 24);
+    p[5]  = (uint8_t)(ts >> 16);
+    p[6]  = (uint8_t)(ts >> 8);
+    p[7]  = (uint8_t)(ts);
+    p[8]  = (uint8_t)(ssrc >> 24);
+    p[9]  = (uint8_t)(ssrc >> 16);
+    p[10] = (uint8_t)(ssrc >> 8);
+    p[11] = (uint8_t)(ssrc);
+}
+
+void RtpPacketBatch::CopyPacket(size_t i, uint8_t* dst) const
+{
+    const RtpSegment* seg = PacketSegments(i);
+    for (size_t k = 0; k < PacketSegmentCount(i); ++k) {
+        memcpy(dst, SegmentData(seg[k]), seg[k].size);
+        dst += seg[k].size;
+    }
+}
+
+void RtpPacketBatch::AssignOwned(const RtpPacketBatch& src)
+{
+    size_t payload = 0;
+    for (const RtpSegment& seg : src.segments)
+        if (seg.data)
+            payload += seg.size;
+
+    headers.reserve(src.headers.size() + payload);
+    headers.assign(src.headers.begin(), src.headers.end());
+    segments = src.segments;
+    packets = src.packets;
+    rtpTs = src.rtpTs;
+    firstSeq = src.firstSeq;
+    keyframe = src.keyframe;
+
+    for (RtpSegment& seg : segments) {
+        if (!seg.data)
+            continue;
+        const uint32_t off = (uint32_t)headers.size();
+        headers.insert(headers.end(), seg.data + seg.offset, seg.data + seg.offset + seg.size);
+        seg.data = nullptr;
+        seg.offset = off;
+    }
+}
+
+static size_t MaxPayload(size_t mtu)
+{
+    return mtu - kRtpHeaderSize;
+}
+
+RtpPacketizer::RtpPacketizer(NalCodec codec, uint8_t payloadType, uint32_t ssrc,
+                             uint16_t initialSeq, size_t mtu)
+    : m_codec(codec)
+    , m_pt(payloadType)
+    , m_ssrc(ssrc)
+    , m_maxPayload(MaxPayload(kRtpDefaultMtu))
+    , m_seq(initialSeq)
+{
+    SetMtu(mtu);
+}
+
+bool RtpPacketizer::SetMtu(size_t mtu)
+{
+    if (mtu < kRtpMinMtu || mtu > kRtpMaxMtu)
+        return false;
+    m_maxPayload = MaxPayload(mtu);
+    return true;
+}
+
+uint8_t* RtpPacketizer::BeginPacket(RtpPacketBatch& out, size_t extra)
+{
+    RtpPacketDesc desc;
+    desc.firstSegment = (uint32_t)out.segments.size();
+    out.packets.push_back(desc);
+
+    uint8_t* p = AddHeader(out, kRtpHeaderSize + extra);
+    // Маркер проставляется в конце Append, когда известен последний пакет.
+    WriteRtpHeader(p, m_pt, false, m_seq++, m_ts, m_ssrc);
+    return p + kRtpHeaderSize;
+}
+
+uint8_t* RtpPacketizer::AddHeader(RtpPacketBatch& out, size_t n)
+{
+    RtpPacketDesc& pkt = out.packets.back();
+    const uint32_t offset = (uint32_t)out.headers.size();
+    out.headers.resize(offset + n);
+
+    // Продолжение предыдущего куска заголовков - тот же сегмент.
+    if (pkt.segments) {
+        RtpSegment& last = out.segments.back();
+        if (!last.data && last.offset + last.size == offset) {
+            last.size += (uint32_t)n;
+            pkt.size += (uint32_t)n;
+            return out.headers.data() + offset;
+        }
+    }
+
+    RtpSegment seg;
+    seg.offset = offset;
+    seg.size = (uint32_t)n;
+    out.segments.push_back(seg);
+    ++pkt.segments;
+    pkt.size += (uint32_t)n;
+    return out.headers.data() + offset;
+}
+
+void RtpPacketizer::AddPayload(RtpPacketBatch& out, const uint8_t* p, size_t n)
+{
+    if (!n)
+        return;
+    RtpSegment seg;
+    seg.data = p;
+    seg.size = (uint32_t)n;
+    out.segments.push_back(seg);
+
+    RtpPacketDesc& pkt = out.packets.back();
+    ++pkt.segments;
+    pkt.size += (uint32_t)n;
+}
+
+size_t RtpPacketizer::PacketizeFu(RtpPacketBatch* out, const uint8_t* nal, size_t size)
+{
+    // H.264 FU-A: indicator(1) + header(1), payload без NAL-заголовка (1 байт).
+    // HEVC FU:   payload header(2) + header(1), payload без NAL-заголовка (2 байта).
+    const bool h264 = m_codec == NalCodec::H264;
+    const size_t nalHdr = h264 ? 1 : 2;
+    const size_t fuHdr  = h264 ? 2 : 3;
+    if (size <= nalHdr)
+        return 0;
+
+    const size_t chunkMax = m_maxPayload - fuHdr;
+    size_t left = size - nalHdr;
+    if (!out)
+        return (left + chunkMax - 1) / chunkMax;
+
+    uint8_t hdr[3];
+    uint8_t type;
+    if (h264) {
+        type   = nal[0] & 0x1F;
+        hdr[0] = (uint8_t)((nal[0] & 0xE0) | 28);
+    }
+    else {
+        type   = (uint8_t)((nal[0] >> 1) & 0x3F);
+        hdr[0] = (uint8_t)((nal[0] & 0x81) | (49 << 1));
+        hdr[1] = nal[1];
+    }
+
+    const uint8_t* src = nal + nalHdr;
+    size_t packets = 0;
+    bool first = true;
+
+    while (left > 0) {
+        size_t chunk = std::min(left, chunkMax);
+        bool last = chunk == left;
+
+        uint8_t fu = type;
+        if (first) fu |= 0x80;
+        if (last)  fu |= 0x40;
+        hdr[fuHdr - 1] = fu;
+
+        memcpy(BeginPacket(*out, fuHdr), hdr, fuHdr);
+        AddPayload(*out, src, chunk);
+        ++packets;
+
+        src  += chunk;
+        left -= chunk;
+        first = false;
+    }
+    return packets;
+}
+
+void RtpPacketizer::PacketizeAggregate(RtpPacketBatch& out, const uint8_t* au,
+                                       const NalUnit* nals, size_t count)
+{
+    // H.264 STAP-A (тип 24): F - OR по NAL, NRI - наибольший.
+    // HEVC AP (тип 48): F - OR, LayerId и TID - наименьшие (без DONL).
+    uint8_t hdr[2];
+    size_t hdrSize;
+    if (m_codec == NalCodec::H264) {
+        uint8_t f = 0, nri = 0;
+        for (size_t i = 0; i < count; ++i) {
+            const uint8_t b = au[nals[i].offset];
+            f |= b & 0x80;
+            nri = std::max<uint8_t>(nri, b & 0x60);
+        }
+        hdr[0] = (uint8_t)(f | nri | 24);
+        hdrSize = 1;
+    }
+    else {
+        uint8_t f = 0, layer = 0x3F, tid = 7;
+        for (size_t i = 0; i < count; ++i) {
+            const uint8_t* b = au + nals[i].offset;
+            f |= b[0] & 0x80;
+            layer = std::min<uint8_t>(layer, (uint8_t)(((b[0] & 1) << 5) | (b[1] >> 3)));
+            tid = std::min<uint8_t>(tid, b[1] & 7);
+        }
+        hdr[0] = (uint8_t)(f | (48 << 1) | (layer >> 5));
+        hdr[1] = (uint8_t)(((layer & 0x1F) << 3) | tid);
+        hdrSize = 2;
+    }
+
+    uint8_t* p = BeginPacket(out, hdrSize + 2);
+    memcpy(p, hdr, hdrSize);
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t* len = i ? AddHeader(out, 2) : p + hdrSize;
+        len[0] = (uint8_t)(nals[i].size >> 8);
+        len[1] = (uint8_t)nals[i].size;
+        AddPayload(out, au + nals[i].offset, nals[i].size);
+    }
+}
+
+size_t RtpPacketizer::PacketizeNals(const uint8_t* au, const std::vector<NalUnit>& nals,
+                                    RtpPacketBatch* out)
+{
+    const size_t aggHdr = m_codec == NalCodec::H264 ? 1 : 2;
+    size_t packets = 0;
+
+    for (size_t i = 0; i < nals.size();) {
+        const NalUnit& u = nals[i];
+        if (u.size > m_maxPayload) {
+            packets += PacketizeFu(out, au + u.offset, u.size);
+            ++i;
+            continue;
+        }
+
+        // Сколько NAL подряд влезает в один агрегирующий пакет.
+        size_t used = aggHdr + 2 + u.size;
+        size_t end = i + 1;
+        while (end < nals.size() && used + 2 + nals[end].size <= m_maxPayload)
+            used += 2 + nals[end++].size;
+
+        if (end - i >= 2) {
+            if (out)
+                PacketizeAggregate(*out, au, &nals[i], end - i);
+        }
+        else if (out) {
+            BeginPacket(*out, 0);
+            AddPayload(*out, au + u.offset, u.size);
+        }
+        ++packets;
+        i = end;
+    }
+    return packets;
+}
+
+size_t RtpPacketizer::PacketizeAv1(const uint8_t* au, const std::vector<NalUnit>& obus,
+                                   RtpPacketBatch* out)
+{
+    // Агрегационный заголовок Z|Y|W|W|N|-|-|-: Z - первый элемент продолжает
+    // OBU из прошлого пакета, Y - последний элемент продолжится в следующем,
+    // W = 0 - у каждого элемента своя LEB128-длина, N - начало новой
+    // видеопоследовательности (кадр с sequence header).
+    bool newSequence = false;
+    for (const NalUnit& u : obus) {
+        if (u.type == kObuSequenceHeader)
+            newSequence = true;
+    }
+
+    size_t packets = 0;
+    size_t aggOffset = 0;   // агрегационный заголовок текущего пакета в out->headers
+    size_t used = 0;
+    bool open = false;
+
+    auto openPacket = [&](bool continuation) {
+        ++packets;
+        open = true;
+        used = 1;
+        if (!out)
+            return;
+        uint8_t* agg = BeginPacket(*out, 1);
+        aggOffset = (size_t)(agg - out->headers.data());
+        *agg = (uint8_t)((continuation ? 0x80 : 0) | (packets == 1 && newSequence ? 0x08 : 0));
+    };
+    auto closePacket = [&](bool fragmented) {
+        open = false;
+        if (out && fragmented)
+            out->headers[aggOffset] |= 0x40;
+    };
+
+    for (const NalUnit& u : obus) {
+        // Temporal delimiter и tile list по RTP не передаются, padding бесполезен.
+        if (u.type == kObuTemporalDelimiter || u.type == kObuTileList || u.type == kObuPadding)
+            continue;
+
+        const uint8_t* obu = au + u.offset;
+        ObuParts parts;
+        if (!SplitObu(obu, u.size, parts))
+            continue;
+
+        // Элемент - OBU без поля длины (obu_has_size_field = 0): длину
+        // несёт сам элемент. Заголовок OBU меняется, поэтому идёт в headers.
+        uint8_t hdr[2] = { (uint8_t)(obu[0] & ~0x02), parts.headerSize > 1 ? obu[1] : (uint8_t)0 };
+        const uint8_t* body = obu + parts.payloadOffset;
+        const size_t hdrSize = parts.headerSize;
+        const size_t total = hdrSize + parts.payloadSize;
+
+        size_t done = 0;
+        while (done < total) {
+            // Элементу нужен хотя бы байт длины и байт данных.
+            if (!open || m_maxPayload - used < 2) {
+                if (open)
+                    closePacket(false);
+                openPacket(false);
+            }
+
+            const size_t room = m_maxPayload - used;
+            size_t chunk = std::min(total - done, room - 1);
+            while (chunk + Leb128Size(chunk) > room)
+                --chunk;
+
+            if (out) {
+                size_t pos = done, left = chunk;
+                size_t fromHdr = pos < hdrSize ? std::min(left, hdrSize - pos) : 0;
+                uint8_t* dst = AddHeader(*out, Leb128Size(chunk) + fromHdr);
+                dst += WriteLeb128(dst, chunk);
+                if (fromHdr) {
+                    memcpy(dst, hdr + pos, fromHdr);
+                    pos += fromHdr;
+                    left -= fromHdr;
+                }
+                if (left)
+                    AddPayload(*out, body + (pos - hdrSize), left);
+            }
+            used += Leb128Size(chunk) + chunk;
+            done += chunk;
+
+            if (done < total) {
+                closePacket(true);
+                openPacket(true);
+            }
+        }
+    }
+    if (open)
+        closePacket(false);
+    return packets;
+}
+
+void RtpPacketizer::Packetize(const uint8_t* au, const std::vector<NalUnit>& nals,
+                              uint32_t rtpTs, bool keyframe, RtpPacketBatch& out)
+{
+    out.Clear();
+    out.keyframe = keyframe;
+    Append(au, nals, rtpTs, out);
+}
+
+void RtpPacketizer::Append(const uint8_t* au, const std::vector<NalUnit>& nals,
+                           uint32_t rtpTs, RtpPacketBatch& out)
+{
+    const size_t first = out.packets.size();
+    if (!first)
+        out.firstSeq = m_seq;
+    out.rtpTs = rtpTs;
+    m_ts = rtpTs;
+
+    if (m_codec == NalCodec::AV1)
+        PacketizeAv1(au, nals, &out);
+    else
+        PacketizeNals(au, nals, &out);
+
+    // Заголовок RTP - всегда начало первого сегмента пакета.
+    if (out.packets.size() > first)
+        out.headers[out.PacketSegments(out.packets.size() - 1)->offset + 1] |= 0x80;
+}
+
+size_t RtpPacketizer::CountPackets(const uint8_t* au, const std::vector<NalUnit>& nals) const
+{
+    // Без out пакетизация только считает и состояние пакетизатора не трогает.
+    RtpPacketizer* self = const_cast<RtpPacketizer*>(this);
+    if (m_codec == NalCodec::AV1)
+        return self->PacketizeAv1(au, nals, nullptr);
+    return self->PacketizeNals(au, nals, nullptr);
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "AnnexB.h"
+
+static const size_t kRtpHeaderSize = 12;
+
+// Кусок RTP-пакета. Заголовки (RTP, FU, STAP, длины агрегатов) пишутся в
+// RtpPacketBatch::headers, и тогда data == nullptr, а offset - смещение в
+// headers. Полезная нагрузка не копируется: data указывает на кадр энкодера.
+struct RtpSegment
+{
+    const uint8_t* data = nullptr;
+    uint32_t offset = 0;
+    uint32_t size = 0;
+};
+
+// RTP-пакет - segments кусков подряд, начиная с firstSegment.
+struct RtpPacketDesc
+{
+    uint32_t firstSegment = 0;
+    uint32_t segments = 0;
+    uint32_t size = 0;
+};
+
+// RTP-пакеты одного access unit в виде scatter/gather: один раз упакованный
+// кадр можно разослать любому числу получателей (sendmsg/WSASend прямо из
+// памяти энкодера). Batch ссылается на кадр и действителен, пока жив его
+// NvEncPacket. Память переиспользуется между кадрами.
+struct RtpPacketBatch
+{
+    std::vector<uint8_t> headers;
+    std::vector<RtpSegment> segments;
+    std::vector<RtpPacketDesc> packets;
+    uint32_t rtpTs = 0;
+    uint16_t firstSeq = 0;
+    bool keyframe = false;
+
+    void Clear()
+    {
+        headers.clear();
+        segments.clear();
+        packets.clear();
+        rtpTs = 0;
+        firstSeq = 0;
+        keyframe = false;
+    }
+
+    const uint8_t* SegmentData(const RtpSegment& seg) const
+    {
+        return seg.data ? seg.data + seg.offset : headers.data() + seg.offset;
+    }
+    const RtpSegment* PacketSegments(size_t i) const { return &segments[packets[i].firstSegment]; }
+    size_t PacketSegmentCount(size_t i) const { return packets[i].segments; }
+    size_t PacketSize(size_t i) const { return packets[i].size; }
+
+    // Пакет i одним куском (dst - не меньше PacketSize(i)).
+    void CopyPacket(size_t i, uint8_t* dst) const;
+
+    // Копия src, которая не ссылается на память кадра: нагрузка переезжает
+    // в headers. Для пакетов, которые уйдут позже, чем живёт кадр, когда
+    // держать ссылку на его блок нечем (пейсинг без frame у Broadcast).
+    void AssignOwned(const RtpPacketBatch& src);
+};
+
+// Пакетизатор H.264 (RFC 6184) / HEVC (RFC 7798) по индексу NAL: мелкие
+// NAL подряд (SPS/PPS/SEI перед IDR) собираются в STAP-A / AP, NAL, который
+// влезает в пакет, идёт целиком, длинный режется на FU-A / FU. AV1 (AOM RTP
+// payload): OBU подряд с LEB128-длинами за агрегационным заголовком, длинные
+// OBU режутся по пакетам. Маркер ставится на последнем пакете кадра.
+class RtpPacketizer
+{
+public:
+    // mtu - предельный размер RTP-пакета (заголовок RTP + нагрузка).
+    RtpPacketizer(NalCodec codec, uint8_t payloadType, uint32_t ssrc,
+                  uint16_t initialSeq, size_t mtu = kRtpDefaultMtu);
+
+    // Упаковывает access unit по готовому индексу NAL; out очищается.
+    void Packetize(const uint8_t* au, const std::vector<NalUnit>& nals,
+                   uint32_t rtpTs, bool keyframe, RtpPacketBatch& out);
+
+    // Дописывает пакеты кадра в конец out (маркер - на последнем пакете
+    // кадра); несколько кадров подряд в одном batch - например, кэш GOP.
+    void Append(const uint8_t* au, const std::vector<NalUnit>& nals,
+                uint32_t rtpTs, RtpPacketBatch& out);
+
+    // Сколько RTP-пакетов даст кадр, не упаковывая его.
+    size_t CountPackets(const uint8_t* au, const std::vector<NalUnit>& nals) const;
+
+    // Новый предельный размер пакета (kRtpMinMtu..kRtpMaxMtu); со следующего кадра.
+    bool SetMtu(size_t mtu);
+    size_t Mtu() const { return m_maxPayload + kRtpHeaderSize; }
+
+    uint16_t NextSeq() const { return m_seq; }
+    void SetNextSeq(uint16_t seq) { m_seq = seq; }
+    uint32_t Ssrc() const { return m_ssrc; }
+    uint8_t PayloadType() const { return m_pt; }
+
+    static const size_t kRtpDefaultMtu = 1400;
+    static const size_t kRtpMinMtu = 256;
+    static const size_t kRtpMaxMtu = 9000;
+
+private:
+    // Новый пакет: заголовок RTP и extra байт заголовков нагрузки.
+    uint8_t* BeginPacket(RtpPacketBatch& out, size_t extra);
+    // Ещё n байт заголовков в текущий пакет (соседние куски склеиваются).
+    uint8_t* AddHeader(RtpPacketBatch& out, size_t n);
+    void AddPayload(RtpPacketBatch& out, const uint8_t* p, size_t n);
+
+    // out == nullptr - только посчитать пакеты.
+    size_t PacketizeNals(const uint8_t* au, const std::vector<NalUnit>& nals,
+                         RtpPacketBatch* out);
+    size_t PacketizeFu(RtpPacketBatch* out, const uint8_t* nal, size_t size);
+    void PacketizeAggregate(RtpPacketBatch& out, const uint8_t* au,
+                            const NalUnit* nals, size_t count);
+    size_t PacketizeAv1(const uint8_t* au, const std::vector<NalUnit>& obus,
+                        RtpPacketBatch* out);
+
+    NalCodec m_codec;
+    uint8_t  m_pt;
+    uint32_t m_ssrc;
+    size_t   m_maxPayload;
+    uint16_t m_seq;
+    uint32_t m_ts = 0;
+};
+
+// Заголовок RTP (RFC 3550) фиксированного размера, без CSRC и расширений.
+void WriteRtpHeader(uint8_t* p, uint8_t payloadType, bool marker,
+                    uint16_t seq, uint32_t ts, uint32_t ssrc);
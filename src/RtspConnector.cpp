@@ -0,0 +1,277 @@
+#include "RtspConnector.h"
+
+#include <chrono>
+#include <cstring>
+
+#include "Platform.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavutil/opt.h>
+#include <libavutil/error.h>
+#include <libavutil/random_seed.h>
+}
+
+// Объявление логгера из NvencRtspPlugin.cpp
+void Log(const char* msg);
+
+static const int64_t kBackoffBaseMs = 250;
+static const int64_t kBackoffMaxMs  = 10000;
+
+static std::once_flag g_netInitOnce;
+
+RtspConnector::RtspConnector()
+    : m_rng(av_get_random_seed())
+{
+}
+
+RtspConnector::~RtspConnector()
+{
+    Stop();
+}
+
+int64_t RtspConnector::BackoffMs(uint32_t failures, uint32_t rnd)
+{
+    if (failures == 0)
+        return 0;
+
+    int64_t d = kBackoffBaseMs;
+    for (uint32_t i = 1; i < failures && d < kBackoffMaxMs; ++i)
+        d *= 2;
+    if (d > kBackoffMaxMs)
+        d = kBackoffMaxMs;
+
+    // "Equal jitter": не меньше половины задержки, остальное случайно.
+    return d / 2 + (int64_t)(rnd % (uint32_t)(d / 2 + 1));
+}
+
+void RtspConnector::EnsureThreadLocked()
+{
+    if (!m_thread.joinable()) {
+        m_stop = false;
+        m_thread = std::thread(&RtspConnector::ThreadMain, this);
+    }
+}
+
+void RtspConnector::Connect(const RtspPushParams& params)
+{
+    std::lock_guard<std::mutex> lk(m_mx);
+    m_params = params;
+    if (!m_want) {
+        m_want = true;
+        m_connecting.store(true, std::memory_order_release);
+    }
+    EnsureThreadLocked();
+    m_cv.notify_all();
+}
+
+AVFormatContext* RtspConnector::TakeConnected()
+{
+    std::lock_guard<std::mutex> lk(m_mx);
+    AVFormatContext* oc = m_ready;
+    m_ready = nullptr;
+    return oc;
+}
+
+void RtspConnector::Reconnect(AVFormatContext* oc, const RtspPushParams& params)
+{
+    std::lock_guard<std::mutex> lk(m_mx);
+    if (oc)
+        m_toClose.push_back(oc);
+    m_params = params;
+    m_want = true;
+    m_connecting.store(true, std::memory_order_release);
+    // Сервер только что оборвал соединение - первая попытка тоже с задержкой.
+    if (m_failures.load(std::memory_order_relaxed) == 0)
+        m_failures.store(1, std::memory_order_relaxed);
+    EnsureThreadLocked();
+    m_cv.notify_all();
+}
+
+void RtspConnector::Close(AVFormatContext* oc)
+{
+    if (!oc)
+        return;
+    std::lock_guard<std::mutex> lk(m_mx);
+    m_toClose.push_back(oc);
+    EnsureThreadLocked();
+    m_cv.notify_all();
+}
+
+void RtspConnector::CloseOutput(AVFormatContext* oc)
+{
+    if (!oc)
+        return;
+    av_write_trailer(oc);
+    // rtsp пишет в свои сокеты (AVFMT_NOFILE); pb бывает у других мультиплексоров.
+    if (oc->oformat && !(oc->oformat->flags & AVFMT_NOFILE))
+        avio_closep(&oc->pb);
+    avformat_free_context(oc);
+}
+
+void RtspConnector::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lk(m_mx);
+        m_stop = true;
+        m_want = false;
+        m_abort.store(true, std::memory_order_release);
+        m_cv.notify_all();
+    }
+    if (m_thread.joinable())
+        m_thread.join();
+
+    // Поток закрыл всё из m_toClose; остался разве что неотданный m_ready.
+    // Он закрывается так же (TEARDOWN): сервер не держит мёртвую сессию до
+    // таймаута. m_abort ещё взведён - ответа на TEARDOWN не ждём.
+    AVFormatContext* ready = nullptr;
+    {
+        std::lock_guard<std::mutex> lk(m_mx);
+        ready = m_ready;
+        m_ready = nullptr;
+    }
+    CloseOutput(ready);
+
+    std::lock_guard<std::mutex> lk(m_mx);
+    m_connecting.store(false, std::memory_order_release);
+    m_abort.store(false, std::memory_order_release);
+}
+
+int RtspConnector::InterruptCb(void* opaque)
+{
+    RtspConnector* self = (RtspConnector*)opaque;
+    return self->m_abort.load(std::memory_order_acquire) ? 1 : 0;
+}
+
+AVFormatContext* RtspConnector::Open(const RtspPushParams& p)
+{
+    std::call_once(g_netInitOnce, [] { avformat_network_init(); });
+
+    const AVOutputFormat* ofmt = av_guess_format("rtsp", nullptr, nullptr);
+    if (!ofmt) {
+        Log("av_guess_format(rtsp) failed");
+        return nullptr;
+    }
+
+    AVFormatContext* oc = nullptr;
+    if (avformat_alloc_output_context2(&oc, ofmt, "rtsp", p.url.c_str()) < 0) {
+        Log("avformat_alloc_output_context2 failed");
+        return nullptr;
+    }
+
+    // Stop() прерывает висящий ANNOUNCE/SETUP, не дожидаясь таймаута.
+    oc->interrupt_callback.callback = &RtspConnector::InterruptCb;
+    oc->interrupt_callback.opaque = this;
+
+    av_opt_set(oc->priv_data, "rtsp_transport", "tcp", 0);
+    av_opt_set(oc->priv_data, "muxdelay",      "0",   0);
+    av_opt_set(oc->priv_data, "muxpreload",    "0",   0);
+
+    AVStream* vst = avformat_new_stream(oc, nullptr);
+    if (!vst) {
+        Log("avformat_new_stream failed");
+        avformat_free_context(oc);
+        return nullptr;
+    }
+
+    vst->id = 0;
+    vst->time_base = AVRational{ 1, 90000 };
+    vst->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+    vst->codecpar->codec_id   = p.codecId;
+    vst->codecpar->format     = AV_PIX_FMT_YUV420P;
+    vst->codecpar->width      = p.w;
+    vst->codecpar->height     = p.h;
+
+    // Если SPS/PPS уже известны (переподключение), отдаём их в SDP
+    // (sprop-parameter-sets), чтобы клиент мог декодировать сразу.
+    if (!p.extradata.empty()) {
+        vst->codecpar->extradata = (uint8_t*)av_mallocz(p.extradata.size() + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (vst->codecpar->extradata) {
+            memcpy(vst->codecpar->extradata, p.extradata.data(), p.extradata.size());
+            vst->codecpar->extradata_size = (int)p.extradata.size();
+        }
+    }
+
+    AVDictionary* opts = nullptr;
+    av_dict_set(&opts, "rtsp_transport", "tcp",     0);
+    av_dict_set(&opts, "muxdelay",       "0",       0);
+    av_dict_set(&opts, "muxpreload",     "0",       0);
+    av_dict_set(&opts, "stimeout",       "2000000", 0); // 2s
+    av_dict_set(&opts, "timeout",        "2000000", 0);
+
+    int ret = avformat_write_header(oc, &opts);
+    av_dict_free(&opts);
+
+    if (ret < 0) {
+        char err[256];
+        av_strerror(ret, err, sizeof(err));
+        Log(err);
+        avformat_free_context(oc);
+        return nullptr;
+    }
+
+    Log("RTSP: avformat_write_header OK");
+    return oc;
+}
+
+void RtspConnector::ThreadMain()
+{
+    std::unique_lock<std::mutex> lk(m_mx);
+
+    while (true) {
+        // Закрытия - в первую очередь: старое соединение должно уйти
+        // с сервера до того, как мы анонсируем новое.
+        while (!m_toClose.empty()) {
+            std::vector<AVFormatContext*> batch;
+            batch.swap(m_toClose);
+            lk.unlock();
+            for (AVFormatContext* oc : batch)
+                CloseOutput(oc);
+            lk.lock();
+        }
+
+        if (m_stop)
+            break;
+
+        if (!m_want || m_ready) {
+            m_cv.wait(lk);
+            continue;
+        }
+
+        uint32_t failures = m_failures.load(std::memory_order_relaxed);
+        int64_t delayMs = BackoffMs(failures, (uint32_t)m_rng());
+        if (delayMs > 0) {
+            auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(delayMs);
+            m_cv.wait_until(lk, until, [&] { return m_stop || !m_toClose.empty(); });
+            if (m_stop)
+                break;
+            if (!m_toClose.empty() || std::chrono::steady_clock::now() < until)
+                continue;   // сначала закрыть, задержка пересчитается
+        }
+
+        RtspPushParams params = m_params;
+        lk.unlock();
+        AVFormatContext* oc = Open(params);
+        lk.lock();
+
+        if (!oc) {
+            uint32_t n = m_failures.fetch_add(1, std::memory_order_relaxed) + 1;
+            char buf[128];
+            sprintf_s(buf, "RTSP connector: attempt failed (%u in a row), backing off", n);
+            Log(buf);
+            continue;
+        }
+
+        if (m_stop) {
+            lk.unlock();
+            CloseOutput(oc);
+            lk.lock();
+            break;
+        }
+
+        m_failures.store(0, std::memory_order_relaxed);
+        m_ready = oc;
+        m_want = false;
+        m_connecting.store(false, std::memory_order_release);
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/codec_id.h>
+}
+
+struct AVFormatContext;
+
+// Что нужно, чтобы открыть RTSP-публикацию одного видеопотока.
+struct RtspPushParams
+{
+    std::string url;
+    AVCodecID codecId = AV_CODEC_ID_NONE;
+    uint32_t w = 0;
+    uint32_t h = 0;
+    // SPS/PPS (VPS) в Annex-B - уходят в SDP как sprop-parameter-sets;
+    // для AV1 - OBU sequence header (profile/level-idx/tier в a=fmtp).
+    std::vector<uint8_t> extradata;
+};
+
+// Подключение к внешнему RTSP-серверу на своём потоке, чтобы
+// avformat_write_header (ANNOUNCE/SETUP/RECORD с таймаутами по 2 с) не
+// останавливал кодирование. Неудачные попытки повторяются с экспоненциальной
+// задержкой со случайным разбросом, чтобы десятки стримов не ломились
+// в поднявшийся сервер одновременно. Закрытие (av_write_trailer на
+// возможно мёртвом соединении) тоже уходит на этот поток.
+class RtspConnector
+{
+public:
+    RtspConnector();
+    ~RtspConnector();
+
+    RtspConnector(const RtspConnector&) = delete;
+    RtspConnector& operator=(const RtspConnector&) = delete;
+
+    // Начать подключаться (если уже подключаемся - обновить параметры).
+    void Connect(const RtspPushParams& params);
+
+    // Готовый контекст с записанным заголовком или nullptr. Не блокирует;
+    // владение переходит вызывающему.
+    AVFormatContext* TakeConnected();
+
+    // Соединение потеряно: закрыть oc в фоне и переподключиться с задержкой.
+    void Reconnect(AVFormatContext* oc, const RtspPushParams& params);
+
+    // Закрыть oc в фоне без переподключения.
+    void Close(AVFormatContext* oc);
+
+    // Прервать текущую попытку, дождаться закрытия и остановить поток.
+    void Stop();
+
+    // Прервать I/O всех контекстов коннектора, в том числе отданных
+    // TakeConnected (запись висящего кадра на другом потоке), до Stop().
+    void Interrupt() { m_abort.store(true, std::memory_order_release); }
+
+    bool Connecting() const { return m_connecting.load(std::memory_order_acquire); }
+    uint32_t Failures() const { return m_failures.load(std::memory_order_relaxed); }
+
+    // Закрывает контекст с записанным заголовком: трейлер (TEARDOWN), pb,
+    // сам контекст. nullptr - ничего.
+    static void CloseOutput(AVFormatContext* oc);
+
+    // Задержка перед попыткой номер failures (0 - сразу): base * 2^n, не
+    // больше max, равномерно в [d/2, d].
+    static int64_t BackoffMs(uint32_t failures, uint32_t rnd);
+
+private:
+    void EnsureThreadLocked();
+    void ThreadMain();
+    AVFormatContext* Open(const RtspPushParams& p);
+    static int InterruptCb(void* opaque);
+
+    std::mutex m_mx;
+    std::condition_variable m_cv;
+    std::thread m_thread;
+
+    bool m_stop = false;
+    bool m_want = false;          // нужно соединение
+    RtspPushParams m_params;
+    AVFormatContext* m_ready = nullptr;
+    std::vector<AVFormatContext*> m_toClose;
+
+    std::atomic<bool> m_abort{false};
+    std::atomic<bool> m_connecting{false};
+    std::atomic<uint32_t> m_failures{0};
+
+    std::mt19937 m_rng;
+};
@@ -0,0 +1,1205 @@
+#include "NetSocket.h"
+#include "Platform.h"
+#include "RtspServer.h"
+#include "UdpBatchSender.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Объявление логгера из NvencRtspPlugin.cpp
+void Log(const char* msg);
+
+namespace {
+
+// Предел неотправленных данных TCP-клиента; медленный клиент, который его
+// превысил, отключается, чтобы не тормозить остальных.
+const size_t kMaxClientBacklog = 8 * 1024 * 1024;
+
+// Диапазон, в котором ищется пара UDP-портов RTP/RTCP.
+const uint16_t kUdpPortFirst = 6970;
+const uint16_t kUdpPortLast  = 7970;
+
+struct RtspRequest
+{
+    std::string method;
+    std::string url;
+    int cseq = 0;
+    std::string transport;
+    std::string session;
+};
+
+std::string HeaderValue(const std::string& head, const char* name)
+{
+    const size_t nameLen = strlen(name);
+    size_t pos = 0;
+    while (pos < head.size()) {
+        size_t eol = head.find("\r\n", pos);
+        if (eol == std::string::npos)
+            eol = head.size();
+        if (eol - pos > nameLen && head[pos + nameLen] == ':' &&
+#ifdef _WIN32
+            _strnicmp(head.c_str() + pos, name, nameLen) == 0)
+#else
+            strncasecmp(head.c_str() + pos, name, nameLen) == 0)
+#endif
+        {
+            size_t v = pos + nameLen + 1;
+            while (v < eol && head[v] == ' ')
+                ++v;
+            return head.substr(v, eol - v);
+        }
+        pos = eol + 2;
+    }
+    return std::string();
+}
+
+bool ParseRequest(const std::string& head, RtspRequest& req)
+{
+    size_t eol = head.find("\r\n");
+    std::string first = head.substr(0, eol);
+    size_t sp1 = first.find(' ');
+    size_t sp2 = first.find(' ', sp1 + 1);
+    if (sp1 == std::string::npos || sp2 == std::string::npos)
+        return false;
+
+    req.method = first.substr(0, sp1);
+    req.url = first.substr(sp1 + 1, sp2 - sp1 - 1);
+    req.cseq = atoi(HeaderValue(head, "CSeq").c_str());
+    req.transport = HeaderValue(head, "Transport");
+    req.session = HeaderValue(head, "Session");
+    size_t semi = req.session.find(';');
+    if (semi != std::string::npos)
+        req.session.resize(semi);
+    return true;
+}
+
+// Находит в Transport параметр вида key=a-b.
+bool TransportRange(const std::string& t, const char* key, int& a, int& b)
+{
+    size_t pos = t.find(key);
+    if (pos == std::string::npos)
+        return false;
+    pos += strlen(key);
+    a = atoi(t.c_str() + pos);
+    size_t dash = t.find('-', pos);
+    size_t semi = t.find(';', pos);
+    b = (dash != std::string::npos && (semi == std::string::npos || dash < semi))
+            ? atoi(t.c_str() + dash + 1)
+            : a + 1;
+    return true;
+}
+
+// Путь из URL запроса без схемы, хоста и суффикса трека.
+std::string UrlPath(const std::string& url)
+{
+    std::string host, path;
+    uint16_t port = 0;
+    if (!NetParseRtspUrl(url, host, port, path))
+        path = url;
+    while (path.size() > 1 && path.back() == '/')
+        path.pop_back();
+    return path;
+}
+
+// Период RTCP SR. RFC 3550 советует 5 с, но для видео (синхронизация,
+// RTT для битрейта) принято раз в секунду; доля трафика ничтожна.
+const int64_t kSenderReportIntervalNs = 1000000000;
+
+// Часы RTP видео - 90 кГц.
+const int64_t kRtpClockHz = 90000;
+
+int64_t SteadyNs()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+struct RtspServer::Impl
+{
+    struct Client
+    {
+        net_socket_t sock = NET_INVALID_SOCKET;
+        sockaddr_in peer = {};
+        std::string inBuf;
+        std::vector<uint8_t> outBuf;   // неотправленный хвост (ответы RTSP + interleaved RTP)
+        std::string session;
+        bool setup = false;
+        bool playing = false;
+        bool waitKeyframe = true;
+        bool joinPending = false;      // ждёт кэш GOP (SendToJoiners)
+        bool burstQueued = false;      // кэш GOP для него стоит в очереди пейсера
+        bool multicast = false;        // получает поток из группы, не свою копию
+        bool inFrame = false;          // получает кадр, который сейчас отдаёт пейсер
+        bool tcp = false;
+        uint8_t rtpChannel = 0;
+        sockaddr_in udpRtp = {};
+        sockaddr_in udpRtcp = {};      // сюда уходят SR
+        bool dead = false;
+    };
+
+    net_socket_t listenSock = NET_INVALID_SOCKET;
+    net_socket_t udpRtpSock = NET_INVALID_SOCKET;
+    net_socket_t udpRtcpSock = NET_INVALID_SOCKET;
+    uint16_t udpRtpPort = 0;
+    std::string path;
+
+    // Под mx: multicast-группа, сокет отправки в неё и сокет RTCP группы
+    // (port + 1): туда же, куда уходят SR, приёмники шлют RR, NACK и PLI.
+    RtpMulticastConfig mcast;
+    net_socket_t mcastSock = NET_INVALID_SOCKET;
+    net_socket_t mcastRtcpSock = NET_INVALID_SOCKET;
+    sockaddr_in mcastAddr = {};
+
+    std::atomic<bool> running{false};
+    std::thread thread;
+
+    mutable std::mutex mx;
+    std::vector<std::unique_ptr<Client>> clients;
+    SdpVideoDesc desc;
+    uint32_t lastRtpTs = 0;
+    std::atomic<uint32_t> pendingJoins{0};
+    std::atomic<bool> keyframeRequested{false};
+
+    // Под mx: списки кусков и заголовки interleaved для SendBatchLocked (и SR).
+    std::vector<NetBuf> bufs;
+    std::vector<uint8_t> framing;
+    // Датаграммы текущих пакетов: собираются для первого UDP-клиента,
+    // остальным уходят те же (udpReady сбрасывается на каждую отправку).
+    UdpBatchSender udp;
+    bool udpReady = false;
+
+    // Пейсинг: кадры ждут в paced, поток pacerThread отдаёт пакеты по
+    // сроку от pacer. Без пейсинга и с пустой очередью кадр уходит сразу
+    // из Broadcast.
+    struct PacedFrame
+    {
+        // Пакеты ссылаются на блоки frames; пока кадр в очереди, блоки не
+        // возвращаются в пул. Без frames нагрузка скопирована в batch.
+        RtpPacketBatch batch;
+        std::vector<NvEncPacketRef> frames;
+        size_t bytes = 0;
+        size_t next = 0;            // первый неотправленный пакет
+        int64_t queuedNs = 0;
+        bool joiners = false;       // кэш GOP: только клиентам с burstQueued
+        bool started = false;
+    };
+    RtpPacer pacer;
+    std::deque<PacedFrame> paced;
+    std::vector<RtpPacketBatch> pacedSpare;   // batch'и отданных кадров, без новых аллокаций
+    size_t pacedBytes = 0;
+    std::condition_variable pacerCv;
+    std::thread pacerThread;
+
+    // Байт подряд без паузы (с пейсингом - за одно пробуждение, без - кадр
+    // целиком) и от постановки кадра в очередь до его последнего пакета.
+    LatencyHistogram burstBytes;
+    LatencyHistogram pacingDelay;
+
+    // RTCP, под mx. SR описывает живые кадры: SSRC и счётчики - из
+    // Broadcast, момент NTP <-> RTP - последний кадр плюс прошедшее с него
+    // время по steady_clock.
+    bool haveRtp = false;
+    uint32_t rtpSsrc = 0;
+    uint32_t sentPackets = 0;
+    uint32_t sentOctets = 0;
+    int64_t lastRtpNs = 0;
+    int64_t lastSrNs = 0;
+    std::vector<uint8_t> srBuf;
+    RtcpFeedback feedback;
+    RtcpReceiverReport rtcpWindow;      // с прошлого TakeReceiverReport
+    RtcpCounters rtcpCounters;
+
+    std::mt19937 rng{std::random_device{}()};
+
+    void Run();
+    void RunPacer();
+    void Accept();
+    void ReadClient(Client& c);
+    void HandleRequest(Client& c, const std::string& head);
+    void SendLocked(Client& c, const void* data, size_t len);
+    // Пакеты [first, last) batch одному клиенту.
+    void SendBatchLocked(Client& c, const RtpPacketBatch& batch, size_t first, size_t last);
+    // Те же пакеты в multicast-группу, если она задана.
+    void SendMulticastLocked(const RtpPacketBatch& batch, size_t first, size_t last);
+    // Датаграммы пакетов [first, last) в udp, один раз на отправку.
+    void PrepareUdpLocked(const RtpPacketBatch& batch, size_t first, size_t last);
+    void EnqueuePacedLocked(const RtpPacketBatch& batch, const NvEncPacketRef* frames,
+                            size_t frameCount, bool joiners);
+    // Кому идёт кадр, решается, когда пейсер берёт его первый пакет.
+    void StartPacedLocked(PacedFrame& f);
+    // Отправляет куски подряд, пока сокет принимает; сколько байт ушло.
+    size_t SendvLocked(Client& c, const NetBuf* bufs, size_t count);
+    void FlushLocked(Client& c);
+    void Reply(Client& c, int cseq, const char* status, const std::string& headers,
+               const std::string& body = std::string());
+    bool OpenUdp();
+    // Кадр ушёл в поток: SSRC, счётчики и время для SR.
+    void CountSentLocked(const RtpPacketBatch& batch);
+    // Составной RTCP от клиента (TCP interleaved или UDP).
+    void HandleRtcpLocked(const uint8_t* p, size_t n);
+    void SendSenderReportsLocked();
+};
+
+RtspServer::RtspServer()
+    : m(new Impl())
+{
+}
+
+RtspServer::~RtspServer()
+{
+    Stop();
+}
+
+bool RtspServer::Impl::OpenUdp()
+{
+    for (uint32_t port = kUdpPortFirst; port + 1 <= kUdpPortLast; port += 2) {
+        net_socket_t rtp = NetBindUdp((uint16_t)port);
+        if (rtp == NET_INVALID_SOCKET)
+            continue;
+        net_socket_t rtcp = NetBindUdp((uint16_t)(port + 1));
+        if (rtcp == NET_INVALID_SOCKET) {
+            NetClose(rtp);
+            continue;
+        }
+        NetSetNonBlocking(rtp, true);
+        NetSetNonBlocking(rtcp, true);
+        udpRtpSock = rtp;
+        udpRtcpSock = rtcp;
+        udpRtpPort = (uint16_t)port;
+        return true;
+    }
+    return false;
+}
+
+bool RtspServer::Start(const std::string& url)
+{
+    Stop();
+
+    std::string host;
+    uint16_t port = 0;
+    if (!NetParseRtspUrl(url, host, port, m->path)) {
+        Log("RTSP server: bad listen URL");
+        return false;
+    }
+    m->path = UrlPath(url);
+
+    if (!NetInit()) {
+        Log("RTSP server: network init failed");
+        return false;
+    }
+
+    m->listenSock = NetListenTcp(host, port);
+    if (m->listenSock == NET_INVALID_SOCKET) {
+        char buf[128];
+        sprintf_s(buf, "RTSP server: cannot listen on port %u", (unsigned)port);
+        Log(buf);
+        return false;
+    }
+
+    // Без UDP сервер всё равно работает: клиентам остаётся interleaved TCP.
+    if (!m->OpenUdp())
+        Log("RTSP server: no free UDP port pair, TCP only");
+
+    m->running = true;
+    m->thread = std::thread(&Impl::Run, m.get());
+    m->pacerThread = std::thread(&Impl::RunPacer, m.get());
+
+    char buf[256];
+    sprintf_s(buf, "RTSP server: listening on port %u, path %s",
+        (unsigned)port, m->path.c_str());
+    Log(buf);
+    return true;
+}
+
+void RtspServer::Stop()
+{
+    if (m->running.exchange(false)) {
+        {
+            // Под mx: пейсер проверяет running перед ожиданием.
+            std::lock_guard<std::mutex> lk(m->mx);
+            m->pacerCv.notify_all();
+        }
+        if (m->pacerThread.joinable())
+            m->pacerThread.join();
+        if (m->thread.joinable())
+            m->thread.join();
+    }
+
+    std::lock_guard<std::mutex> lk(m->mx);
+    m->paced.clear();
+    m->pacedBytes = 0;
+    NetClose(m->mcastSock);
+    NetClose(m->mcastRtcpSock);
+    m->mcastSock = m->mcastRtcpSock = NET_INVALID_SOCKET;
+    m->mcast = RtpMulticastConfig();
+    for (auto& c : m->clients)
+        NetClose(c->sock);
+    m->clients.clear();
+
+    NetClose(m->listenSock);
+    NetClose(m->udpRtpSock);
+    NetClose(m->udpRtcpSock);
+    m->listenSock = m->udpRtpSock = m->udpRtcpSock = NET_INVALID_SOCKET;
+}
+
+void RtspServer::SetVideoDesc(const SdpVideoDesc& desc)
+{
+    std::lock_guard<std::mutex> lk(m->mx);
+    m->desc = desc;
+}
+
+bool RtspServer::ValidMulticast(const RtpMulticastConfig& cfg)
+{
+    sockaddr_in addr = {};
+    return NetParseIpv4(cfg.group, cfg.port, addr) && NetIsMulticast(addr) &&
+           cfg.port && cfg.ttl >= 1 && cfg.ttl <= 255;
+}
+
+bool RtspServer::SetMulticast(const RtpMulticastConfig& cfg)
+{
+    sockaddr_in addr = {};
+    net_socket_t sock = NET_INVALID_SOCKET;
+    net_socket_t rtcp = NET_INVALID_SOCKET;
+    if (!cfg.group.empty()) {
+        if (!ValidMulticast(cfg)) {
+            Log("RTSP server: bad multicast group, port or TTL");
+            return false;
+        }
+        NetParseIpv4(cfg.group, cfg.port, addr);
+        sock = NetMulticastSender(cfg.iface, cfg.ttl);
+        if (sock == NET_INVALID_SOCKET) {
+            Log("RTSP server: cannot open multicast socket (interface?)");
+            return false;
+        }
+        NetSetNonBlocking(sock, true);
+
+        // Без RTCP группы поток всё равно идёт, но отчёты приёмников группы
+        // не доходят до адаптивного битрейта.
+        rtcp = NetMulticastReceiver(cfg.group, (uint16_t)(cfg.port + 1), cfg.iface);
+        if (rtcp == NET_INVALID_SOCKET)
+            Log("RTSP server: cannot join multicast RTCP port, receiver reports of the group are lost");
+        else
+            NetSetNonBlocking(rtcp, true);
+    }
+
+    std::lock_guard<std::mutex> lk(m->mx);
+    NetClose(m->mcastSock);
+    NetClose(m->mcastRtcpSock);
+    m->mcastSock = sock;
+    m->mcastRtcpSock = rtcp;
+    m->mcastAddr = addr;
+    m->mcast = cfg;
+    // Клиенты RTSP в группе дальше не получают ничего: пусть переподключатся.
+    for (auto& c : m->clients)
+        if (c->multicast)
+            c->dead = true;
+
+    char buf[160];
+    if (cfg.group.empty())
+        sprintf_s(buf, "RTSP server: multicast off");
+    else
+        sprintf_s(buf, "RTSP server: multicast to %s:%u, ttl %d",
+            cfg.group.c_str(), (unsigned)cfg.port, cfg.ttl);
+    Log(buf);
+    return true;
+}
+
+std::string RtspServer::BuildSdp() const
+{
+    std::lock_guard<std::mutex> lk(m->mx);
+    if (m->mcastSock == NET_INVALID_SOCKET)
+        return BuildVideoSdp(m->desc);
+
+    SdpVideoDesc d = m->desc;
+    d.connectionAddr = m->mcast.group;
+    d.port = m->mcast.port;
+    d.ttl = m->mcast.ttl;
+    d.control.clear();
+    return BuildVideoSdp(d);
+}
+
+size_t RtspServer::ClientCount() const
+{
+    std::lock_guard<std::mutex> lk(m->mx);
+    return m->clients.size();
+}
+
+void RtspServer::GetUdpCounters(uint64_t& datagrams, uint64_t& sendCalls) const
+{
+    std::lock_guard<std::mutex> lk(m->mx);
+    datagrams = m->udp.SentDatagrams();
+    sendCalls = m->udp.SendCalls();
+}
+
+void RtspServer::Broadcast(const RtpPacketBatch& batch, const NvEncPacketRef& frame)
+{
+    std::lock_guard<std::mutex> lk(m->mx);
+    m->lastRtpTs = batch.rtpTs;
+    m->CountSentLocked(batch);
+
+    // Пока очередь не пуста, кадры встают за ней и после выключения
+    // пейсинга: иначе они обогнали бы ещё не отданные.
+    if (m->pacer.Enabled() || !m->paced.empty()) {
+        m->EnqueuePacedLocked(batch, &frame, frame.empty() ? 0 : 1, false);
+        return;
+    }
+
+    size_t bytes = 0;
+    for (size_t i = 0; i < batch.packets.size(); ++i)
+        bytes += batch.PacketSize(i);
+    m->burstBytes.Record((int64_t)bytes);
+
+    m->udpReady = false;
+    for (auto& cp : m->clients) {
+        Impl::Client& c = *cp;
+        if (!c.playing || c.dead || c.multicast)
+            continue;
+        if (c.waitKeyframe) {
+            if (!batch.keyframe)
+                continue;
+            c.waitKeyframe = false;
+        }
+        m->SendBatchLocked(c, batch, 0, batch.packets.size());
+    }
+    m->SendMulticastLocked(batch, 0, batch.packets.size());
+}
+
+void RtspServer::SetPacing(const RtpPacingConfig& cfg)
+{
+    std::lock_guard<std::mutex> lk(m->mx);
+    m->pacer.SetConfig(cfg);
+}
+
+const LatencyHistogram& RtspServer::BurstBytes() const
+{
+    return m->burstBytes;
+}
+
+const LatencyHistogram& RtspServer::PacingDelay() const
+{
+    return m->pacingDelay;
+}
+
+bool RtspServer::TakeKeyframeRequest()
+{
+    return m->keyframeRequested.exchange(false, std::memory_order_relaxed);
+}
+
+bool RtspServer::TakeReceiverReport(RtcpReceiverReport& out)
+{
+    std::lock_guard<std::mutex> lk(m->mx);
+    if (!m->rtcpWindow.blocks && !m->rtcpWindow.nackedPackets)
+        return false;
+    out = m->rtcpWindow;
+    m->rtcpWindow = RtcpReceiverReport();
+    return true;
+}
+
+void RtspServer::GetRtcpCounters(RtcpCounters& out) const
+{
+    std::lock_guard<std::mutex> lk(m->mx);
+    out = m->rtcpCounters;
+}
+
+bool RtspServer::HasPendingJoins() const
+{
+    return m->pendingJoins.load(std::memory_order_relaxed) != 0;
+}
+
+void RtspServer::SendToJoiners(const RtpPacketBatch& burst, const std::vector<NvEncPacketRef>& frames)
+{
+    std::lock_guard<std::mutex> lk(m->mx);
+    const bool queue = m->pacer.Enabled() || !m->paced.empty();
+    m->udpReady = false;
+    for (auto& cp : m->clients) {
+        Impl::Client& c = *cp;
+        if (!c.joinPending)
+            continue;
+        c.joinPending = false;
+        if (!c.playing || c.dead || burst.packets.empty())
+            continue;
+
+        if (queue) {
+            // Отдаст пейсер; до тех пор живые кадры этого клиента ждут.
+            c.burstQueued = true;
+            continue;
+        }
+        // burst начинается с IDR: дальше клиент получает все кадры подряд.
+        c.waitKeyframe = false;
+        m->SendBatchLocked(c, burst, 0, burst.packets.size());
+    }
+    m->pendingJoins.store(0, std::memory_order_relaxed);
+    if (queue && !burst.packets.empty())
+        m->EnqueuePacedLocked(burst, frames.data(), frames.size(), true);
+}
+
+void RtspServer::Impl::EnqueuePacedLocked(const RtpPacketBatch& batch, const NvEncPacketRef* frames,
+                                          size_t frameCount, bool joiners)
+{
+    if (batch.packets.empty())
+        return;
+
+    paced.emplace_back();
+    PacedFrame& f = paced.back();
+    if (!pacedSpare.empty()) {
+        f.batch = std::move(pacedSpare.back());
+        pacedSpare.pop_back();
+    }
+    // Ссылки на блоки кадра вместо копии нагрузки: копируются только
+    // заголовки и списки кусков.
+    if (frameCount) {
+        f.batch = batch;
+        f.frames.assign(frames, frames + frameCount);
+    }
+    else {
+        f.batch.AssignOwned(batch);
+    }
+    for (size_t i = 0; i < batch.packets.size(); ++i)
+        f.bytes += batch.PacketSize(i);
+    f.queuedNs = pacer.NowNs();
+    f.joiners = joiners;
+
+    pacedBytes += f.bytes;
+    pacer.OnFrame(f.bytes, pacedBytes);
+    pacerCv.notify_all();
+}
+
+void RtspServer::Impl::StartPacedLocked(PacedFrame& f)
+{
+    for (auto& cp : clients) {
+        Client& c = *cp;
+        c.inFrame = false;
+        if (f.joiners) {
+            if (!c.burstQueued)
+                continue;
+            c.burstQueued = false;
+            c.inFrame = c.playing && !c.dead;
+            if (c.inFrame)
+                c.waitKeyframe = false;
+            continue;
+        }
+        if (!c.playing || c.dead || c.burstQueued || c.multicast)
+            continue;
+        if (c.waitKeyframe) {
+            if (!f.batch.keyframe)
+                continue;
+            c.waitKeyframe = false;
+        }
+        c.inFrame = true;
+    }
+    f.started = true;
+}
+
+void RtspServer::Impl::RunPacer()
+{
+    std::unique_lock<std::mutex> lk(mx);
+    while (running) {
+        if (paced.empty()) {
+            pacerCv.wait(lk);
+            continue;
+        }
+
+        PacedFrame& f = paced.front();
+        if (!f.started)
+            StartPacedLocked(f);
+
+        // Всё, что разрешает ведро, уходит одним вызовом на клиента.
+        const size_t first = f.next;
+        size_t bytes = 0;
+        int64_t waitNs = 0;
+        while (f.next < f.batch.packets.size()) {
+            const size_t size = f.batch.PacketSize(f.next);
+            waitNs = pacer.WaitNs(size);
+            if (waitNs > 0)
+                break;
+            pacer.Consume(size);
+            bytes += size;
+            ++f.next;
+        }
+
+        if (f.next > first) {
+            udpReady = false;
+            for (auto& cp : clients) {
+                Client& c = *cp;
+                if (c.inFrame && c.playing && !c.dead)
+                    SendBatchLocked(c, f.batch, first, f.next);
+            }
+            // В группу - только живые кадры: кэш GOP нужен лишь новым клиентам RTSP.
+            if (!f.joiners)
+                SendMulticastLocked(f.batch, first, f.next);
+            burstBytes.Record((int64_t)bytes);
+            pacedBytes -= bytes;
+        }
+
+        if (f.next == f.batch.packets.size()) {
+            pacingDelay.Record(pacer.NowNs() - f.queuedNs);
+            pacedSpare.push_back(std::move(f.batch));
+            paced.pop_front();
+            continue;
+        }
+        pacerCv.wait_for(lk, std::chrono::nanoseconds(waitNs));
+    }
+}
+
+void RtspServer::Impl::SendBatchLocked(Client& c, const RtpPacketBatch& batch, size_t first, size_t last)
+{
+    if (c.tcp) {
+        // Заголовки interleaved ($, канал, длина) - в framing, пакеты - прямо
+        // из batch: кадр уходит одним sendmsg без сборки в буфере.
+        framing.resize((last - first) * 4);
+        bufs.clear();
+        for (size_t i = first; i < last; ++i) {
+            const size_t len = batch.PacketSize(i);
+            uint8_t* hdr = &framing[(i - first) * 4];
+            hdr[0] = '$';
+            hdr[1] = c.rtpChannel;
+            hdr[2] = (uint8_t)(len >> 8);
+            hdr[3] = (uint8_t)len;
+            bufs.push_back(NetBuf{ hdr, 4 });
+
+            const RtpSegment* seg = batch.PacketSegments(i);
+            for (size_t k = 0; k < batch.PacketSegmentCount(i); ++k)
+                bufs.push_back(NetBuf{ batch.SegmentData(seg[k]), seg[k].size });
+        }
+
+        // Если хвост прошлых кадров ещё не ушёл, кадр встаёт за ним.
+        const bool queued = !c.outBuf.empty();
+        size_t skip = queued ? 0 : SendvLocked(c, bufs.data(), bufs.size());
+
+        // Неотправленное копируется: batch живёт только до конца вызова.
+        for (const NetBuf& b : bufs) {
+            if (skip >= b.size) {
+                skip -= b.size;
+                continue;
+            }
+            const uint8_t* p = (const uint8_t*)b.data;
+            c.outBuf.insert(c.outBuf.end(), p + skip, p + b.size);
+            skip = 0;
+        }
+        if (queued)
+            FlushLocked(c);
+
+        if (c.outBuf.size() > kMaxClientBacklog) {
+            Log("RTSP server: client too slow, disconnecting");
+            c.dead = true;
+        }
+    }
+    else if (udpRtpSock != NET_INVALID_SOCKET) {
+        PrepareUdpLocked(batch, first, last);
+        // Все пакеты клиенту - один sendmmsg (с GSO - несколько сообщений в нём).
+        udp.Send(udpRtpSock, c.udpRtp);
+    }
+}
+
+void RtspServer::Impl::SendMulticastLocked(const RtpPacketBatch& batch, size_t first, size_t last)
+{
+    if (mcastSock == NET_INVALID_SOCKET)
+        return;
+    PrepareUdpLocked(batch, first, last);
+    udp.Send(mcastSock, mcastAddr);
+}
+
+void RtspServer::Impl::PrepareUdpLocked(const RtpPacketBatch& batch, size_t first, size_t last)
+{
+    if (udpReady)
+        return;
+    udp.Clear();
+    for (size_t i = first; i < last; ++i) {
+        const RtpSegment* seg = batch.PacketSegments(i);
+        bufs.clear();
+        for (size_t k = 0; k < batch.PacketSegmentCount(i); ++k)
+            bufs.push_back(NetBuf{ batch.SegmentData(seg[k]), seg[k].size });
+        udp.Add(bufs.data(), bufs.size());
+    }
+    udpReady = true;
+}
+
+void RtspServer::Impl::CountSentLocked(const RtpPacketBatch& batch)
+{
+    if (batch.packets.empty() || batch.PacketSegments(0)[0].size < kRtpHeaderSize)
+        return;
+    const uint8_t* h = batch.SegmentData(batch.PacketSegments(0)[0]);
+    rtpSsrc = ((uint32_t)h[8] << 24) | ((uint32_t)h[9] << 16) | ((uint32_t)h[10] << 8) | h[11];
+    haveRtp = true;
+    sentPackets += (uint32_t)batch.packets.size();
+    for (size_t i = 0; i < batch.packets.size(); ++i)
+        sentOctets += (uint32_t)(batch.PacketSize(i) - kRtpHeaderSize);
+    lastRtpNs = SteadyNs();
+}
+
+void RtspServer::Impl::HandleRtcpLocked(const uint8_t* p, size_t n)
+{
+    feedback.reports.clear();
+    feedback.nackedPackets = 0;
+    feedback.keyframeRequest = false;
+    ParseRtcp(p, n, feedback);
+
+    if (feedback.keyframeRequest)
+        keyframeRequested.store(true, std::memory_order_relaxed);
+    rtcpWindow.nackedPackets += feedback.nackedPackets;
+    rtcpCounters.nackedPackets += feedback.nackedPackets;
+
+    const uint32_t nowMid32 = RtcpNtpMid32(RtcpNtpNow());
+    for (const RtcpReportBlock& b : feedback.reports) {
+        // Клиент может отчитываться и о чужих источниках.
+        if (!haveRtp || b.ssrc != rtpSsrc)
+            continue;
+        RtcpReceiverReport r;
+        r.blocks = 1;
+        r.lossFraction = b.fractionLost / 256.0;
+        r.jitterMs = (double)b.jitter * 1000.0 / kRtpClockHz;
+        r.rttMs = RtcpRttMs(b, nowMid32);
+        rtcpCounters.last = r;
+        ++rtcpCounters.receiverReports;
+
+        RtcpReceiverReport& w = rtcpWindow;
+        ++w.blocks;
+        if (r.lossFraction > w.lossFraction)
+            w.lossFraction = r.lossFraction;
+        if (r.jitterMs > w.jitterMs)
+            w.jitterMs = r.jitterMs;
+        if (r.rttMs > w.rttMs)
+            w.rttMs = r.rttMs;
+    }
+}
+
+void RtspServer::Impl::SendSenderReportsLocked()
+{
+    if (!haveRtp)
+        return;
+
+    // Время RTP "сейчас" - от последнего кадра; кадров может не быть
+    // долго (статичная сцена), а SR должен описывать текущий момент.
+    RtcpSenderInfo info;
+    info.ssrc = rtpSsrc;
+    info.ntp = RtcpNtpNow();
+    info.rtpTs = lastRtpTs + (uint32_t)((SteadyNs() - lastRtpNs) * kRtpClockHz / 1000000000);
+    info.packets = sentPackets;
+    info.octets = sentOctets;
+
+    char cname[32];
+    sprintf_s(cname, "nvrtsp-%08X", (unsigned)rtpSsrc);
+    BuildRtcpSr(info, cname, srBuf);
+
+    for (auto& cp : clients) {
+        Client& c = *cp;
+        if (!c.playing || c.dead || c.multicast)
+            continue;
+        if (c.tcp) {
+            // Встаёт за хвостом outBuf - на границе пакетов RTP: кадр
+            // целиком попадает в outBuf под тем же mx.
+            framing.assign({ '$', (uint8_t)(c.rtpChannel + 1),
+                             (uint8_t)(srBuf.size() >> 8), (uint8_t)srBuf.size() });
+            framing.insert(framing.end(), srBuf.begin(), srBuf.end());
+            SendLocked(c, framing.data(), framing.size());
+        }
+        else if (udpRtcpSock != NET_INVALID_SOCKET) {
+            sendto(udpRtcpSock, (const char*)srBuf.data(), (int)srBuf.size(), 0,
+                   (const sockaddr*)&c.udpRtcp, sizeof(c.udpRtcp));
+        }
+        ++rtcpCounters.senderReports;
+    }
+
+    if (mcastSock != NET_INVALID_SOCKET) {
+        sockaddr_in to = mcastAddr;
+        to.sin_port = htons((uint16_t)(mcast.port + 1));
+        sendto(mcastSock, (const char*)srBuf.data(), (int)srBuf.size(), 0,
+               (const sockaddr*)&to, sizeof(to));
+        ++rtcpCounters.senderReports;
+    }
+}
+
+size_t RtspServer::Impl::SendvLocked(Client& c, const NetBuf* b, size_t count)
+{
+    size_t sent = 0;
+    while (count) {
+        const size_t n = count < kNetMaxBufs ? count : kNetMaxBufs;
+        size_t want = 0;
+        for (size_t i = 0; i < n; ++i)
+            want += b[i].size;
+
+        int64_t r = NetSendv(c.sock, b, n);
+        if (r < 0) {
+            if (!NetWouldBlock())
+                c.dead = true;
+            break;
+        }
+        sent += (size_t)r;
+        if ((size_t)r < want)
+            break;
+        b += n;
+        count -= n;
+    }
+    return sent;
+}
+
+void RtspServer::Impl::FlushLocked(Client& c)
+{
+    size_t sent = 0;
+    while (sent < c.outBuf.size()) {
+        int n = send(c.sock, (const char*)c.outBuf.data() + sent, (int)(c.outBuf.size() - sent), 0);
+        if (n > 0) {
+            sent += (size_t)n;
+            continue;
+        }
+        if (n < 0 && !NetWouldBlock())
+            c.dead = true;
+        break;
+    }
+    c.outBuf.erase(c.outBuf.begin(), c.outBuf.begin() + sent);
+}
+
+void RtspServer::Impl::SendLocked(Client& c, const void* data, size_t len)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    c.outBuf.insert(c.outBuf.end(), p, p + len);
+    FlushLocked(c);
+}
+
+void RtspServer::Impl::Reply(Client& c, int cseq, const char* status,
+                             const std::string& headers, const std::string& body)
+{
+    char head[128];
+    sprintf_s(head, "RTSP/1.0 %s\r\nCSeq: %d\r\n", status, cseq);
+
+    std::string resp = head;
+    resp += "Server: NvencRtspPlugin\r\n";
+    resp += headers;
+    if (!body.empty()) {
+        sprintf_s(head, "Content-Length: %u\r\n", (unsigned)body.size());
+        resp += head;
+    }
+    resp += "\r\n";
+    resp += body;
+
+    std::lock_guard<std::mutex> lk(mx);
+    SendLocked(c, resp.data(), resp.size());
+}
+
+void RtspServer::Impl::HandleRequest(Client& c, const std::string& head)
+{
+    RtspRequest req;
+    if (!ParseRequest(head, req)) {
+        std::lock_guard<std::mutex> lk(mx);
+        c.dead = true;
+        return;
+    }
+
+    if (req.method == "OPTIONS") {
+        Reply(c, req.cseq, "200 OK",
+              "Public: OPTIONS, DESCRIBE, SETUP, PLAY, PAUSE, TEARDOWN, GET_PARAMETER\r\n");
+        return;
+    }
+
+    if (req.method == "DESCRIBE") {
+        if (UrlPath(req.url) != path) {
+            Reply(c, req.cseq, "404 Not Found", "");
+            return;
+        }
+        std::string sdp;
+        {
+            std::lock_guard<std::mutex> lk(mx);
+            sdp = BuildVideoSdp(desc);
+        }
+        std::string base = req.url;
+        if (base.empty() || base.back() != '/')
+            base += '/';
+        Reply(c, req.cseq, "200 OK",
+              "Content-Base: " + base + "\r\nContent-Type: application/sdp\r\n", sdp);
+        return;
+    }
+
+    if (req.method == "SETUP") {
+        std::unique_lock<std::mutex> lk(mx);
+        std::string transport;
+        int a = 0, b = 0;
+        if (req.transport.find("multicast") != std::string::npos) {
+            if (mcastSock == NET_INVALID_SOCKET) {
+                lk.unlock();
+                Reply(c, req.cseq, "461 Unsupported Transport", "");
+                return;
+            }
+            c.tcp = false;
+            c.multicast = true;
+            char buf[160];
+            sprintf_s(buf, "RTP/AVP;multicast;destination=%s;port=%u-%u;ttl=%d",
+                mcast.group.c_str(), (unsigned)mcast.port, (unsigned)(mcast.port + 1), mcast.ttl);
+            transport = buf;
+        }
+        else if (req.transport.find("RTP/AVP/TCP") != std::string::npos) {
+            if (!TransportRange(req.transport, "interleaved=", a, b)) {
+                a = 0;
+                b = 1;
+            }
+            c.tcp = true;
+            c.multicast = false;
+            c.rtpChannel = (uint8_t)a;
+            char buf[128];
+            sprintf_s(buf, "RTP/AVP/TCP;unicast;interleaved=%d-%d", a, b);
+            transport = buf;
+        }
+        else if (TransportRange(req.transport, "client_port=", a, b) &&
+                 udpRtpSock != NET_INVALID_SOCKET)
+        {
+            c.tcp = false;
+            c.multicast = false;
+            c.udpRtp = c.peer;
+            c.udpRtp.sin_port = htons((uint16_t)a);
+            c.udpRtcp = c.peer;
+            c.udpRtcp.sin_port = htons((uint16_t)b);
+            char buf[160];
+            sprintf_s(buf, "RTP/AVP;unicast;client_port=%d-%d;server_port=%u-%u",
+                a, b, (unsigned)udpRtpPort, (unsigned)(udpRtpPort + 1));
+            transport = buf;
+        }
+        else {
+            lk.unlock();
+            Reply(c, req.cseq, "461 Unsupported Transport", "");
+            return;
+        }
+
+        if (c.session.empty()) {
+            char buf[32];
+            sprintf_s(buf, "%08X%08X", (unsigned)rng(), (unsigned)rng());
+            c.session = buf;
+        }
+        c.setup = true;
+        lk.unlock();
+        Reply(c, req.cseq, "200 OK",
+              "Transport: " + transport + "\r\nSession: " + c.session + ";timeout=60\r\n");
+        return;
+    }
+
+    if (req.method == "PLAY") {
+        if (!c.setup || req.session != c.session) {
+            Reply(c, req.cseq, "454 Session Not Found", "");
+            return;
+        }
+        uint32_t rtptime;
+        {
+            std::lock_guard<std::mutex> lk(mx);
+            rtptime = lastRtpTs;
+        }
+        char buf[64];
+        sprintf_s(buf, ";rtptime=%u\r\n", (unsigned)rtptime);
+        Reply(c, req.cseq, "200 OK",
+              "Session: " + c.session + "\r\nRange: npt=0.000-\r\nRTP-Info: url=" + req.url + buf);
+
+        std::lock_guard<std::mutex> lk(mx);
+        c.playing = true;
+        c.waitKeyframe = true;
+        if (c.multicast) {
+            // Группа уже идёт; кэш GOP ей не отдать, поэтому сразу IDR.
+            keyframeRequested.store(true, std::memory_order_relaxed);
+            Log("RTSP server: client joined multicast group");
+            return;
+        }
+        if (!c.joinPending) {
+            c.joinPending = true;
+            pendingJoins.fetch_add(1, std::memory_order_relaxed);
+        }
+        Log("RTSP server: client started playing");
+        return;
+    }
+
+    if (req.method == "PAUSE") {
+        {
+            std::lock_guard<std::mutex> lk(mx);
+            c.playing = false;
+        }
+        Reply(c, req.cseq, "200 OK", "Session: " + c.session + "\r\n");
+        return;
+    }
+
+    if (req.method == "TEARDOWN") {
+        Reply(c, req.cseq, "200 OK", "Session: " + c.session + "\r\n");
+        std::lock_guard<std::mutex> lk(mx);
+        c.playing = false;
+        c.dead = true;
+        return;
+    }
+
+    if (req.method == "GET_PARAMETER" || req.method == "SET_PARAMETER") {
+        Reply(c, req.cseq, "200 OK", c.session.empty() ? "" : "Session: " + c.session + "\r\n");
+        return;
+    }
+
+    Reply(c, req.cseq, "501 Not Implemented", "");
+}
+
+void RtspServer::Impl::ReadClient(Client& c)
+{
+    char buf[4096];
+    int n = recv(c.sock, buf, sizeof(buf), 0);
+    if (n <= 0) {
+        if (n == 0 || !NetWouldBlock()) {
+            std::lock_guard<std::mutex> lk(mx);
+            c.dead = true;
+        }
+        return;
+    }
+    c.inBuf.append(buf, (size_t)n);
+
+    // dead меняют и другие потоки (Broadcast, пейсер) - только под mx.
+    auto dead = [&]() {
+        std::lock_guard<std::mutex> lk(mx);
+        return c.dead;
+    };
+    while (!c.inBuf.empty() && !dead()) {
+        // Interleaved-данные от клиента ($, канал, длина) - RTCP.
+        if (c.inBuf[0] == '$') {
+            if (c.inBuf.size() < 4)
+                break;
+            size_t len = ((uint8_t)c.inBuf[2] << 8) | (uint8_t)c.inBuf[3];
+            if (c.inBuf.size() < 4 + len)
+                break;
+            if ((uint8_t)c.inBuf[1] == (uint8_t)(c.rtpChannel + 1)) {
+                std::lock_guard<std::mutex> lk(mx);
+                HandleRtcpLocked((const uint8_t*)c.inBuf.data() + 4, len);
+            }
+            c.inBuf.erase(0, 4 + len);
+            continue;
+        }
+
+        size_t end = c.inBuf.find("\r\n\r\n");
+        if (end == std::string::npos) {
+            if (c.inBuf.size() > 16384) {
+                std::lock_guard<std::mutex> lk(mx);
+                c.dead = true;
+            }
+            break;
+        }
+        std::string head = c.inBuf.substr(0, end + 2);
+        size_t bodyLen = (size_t)atoi(HeaderValue(head, "Content-Length").c_str());
+        if (c.inBuf.size() < end + 4 + bodyLen)
+            break;
+        c.inBuf.erase(0, end + 4 + bodyLen);
+
+        HandleRequest(c, head);
+    }
+}
+
+void RtspServer::Impl::Accept()
+{
+    sockaddr_in peer = {};
+    socklen_t len = sizeof(peer);
+    net_socket_t s = accept(listenSock, (sockaddr*)&peer, &len);
+    if (s == NET_INVALID_SOCKET)
+        return;
+
+    NetSetNonBlocking(s, true);
+    int yes = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&yes, sizeof(yes));
+
+    std::unique_ptr<Client> c(new Client());
+    c->sock = s;
+    c->peer = peer;
+
+    std::lock_guard<std::mutex> lk(mx);
+    clients.push_back(std::move(c));
+    Log("RTSP server: client connected");
+}
+
+void RtspServer::Impl::Run()
+{
+    while (running) {
+        fd_set rd;
+        fd_set wr;
+        FD_ZERO(&rd);
+        FD_ZERO(&wr);
+        net_socket_t maxFd = listenSock;
+        FD_SET(listenSock, &rd);
+        if (udpRtcpSock != NET_INVALID_SOCKET) {
+            FD_SET(udpRtcpSock, &rd);
+            if (udpRtcpSock > maxFd) maxFd = udpRtcpSock;
+        }
+
+        std::vector<Client*> snapshot;
+        net_socket_t groupRtcp;
+        {
+            std::lock_guard<std::mutex> lk(mx);
+            groupRtcp = mcastRtcpSock;
+            if (groupRtcp != NET_INVALID_SOCKET) {
+                FD_SET(groupRtcp, &rd);
+                if (groupRtcp > maxFd) maxFd = groupRtcp;
+            }
+            // Отключённые клиенты удаляются только здесь, в потоке сервера.
+            for (size_t i = 0; i < clients.size();) {
+                if (clients[i]->dead) {
+                    if (clients[i]->joinPending)
+                        pendingJoins.fetch_sub(1, std::memory_order_relaxed);
+                    NetClose(clients[i]->sock);
+                    clients.erase(clients.begin() + i);
+                    Log("RTSP server: client disconnected");
+                    continue;
+                }
+                ++i;
+            }
+            for (auto& c : clients) {
+                FD_SET(c->sock, &rd);
+                if (!c->outBuf.empty())
+                    FD_SET(c->sock, &wr);
+                if (c->sock > maxFd) maxFd = c->sock;
+                snapshot.push_back(c.get());
+            }
+        }
+
+        timeval tv = { 0, 100 * 1000 };
+        int n = select((int)(maxFd + 1), &rd, &wr, nullptr, &tv);
+
+        {
+            std::lock_guard<std::mutex> lk(mx);
+            const int64_t now = SteadyNs();
+            if (now - lastSrNs >= kSenderReportIntervalNs) {
+                lastSrNs = now;
+                SendSenderReportsLocked();
+            }
+        }
+        if (n <= 0)
+            continue;
+
+        if (FD_ISSET(listenSock, &rd))
+            Accept();
+
+        if (udpRtcpSock != NET_INVALID_SOCKET && FD_ISSET(udpRtcpSock, &rd)) {
+            char buf[1500];
+            int len;
+            while ((len = recv(udpRtcpSock, buf, sizeof(buf), 0)) > 0) {
+                std::lock_guard<std::mutex> lk(mx);
+                HandleRtcpLocked((const uint8_t*)buf, (size_t)len);
+            }
+        }
+
+        // RTCP группы; свои SR возвращаются сюда же (петля), в них нет
+        // блоков отчёта, и разбор их пропускает. Сокет мог смениться в
+        // SetMulticast, пока шёл select.
+        if (groupRtcp != NET_INVALID_SOCKET && FD_ISSET(groupRtcp, &rd)) {
+            char buf[1500];
+            std::lock_guard<std::mutex> lk(mx);
+            int len;
+            while (mcastRtcpSock == groupRtcp &&
+                   (len = recv(groupRtcp, buf, sizeof(buf), 0)) > 0)
+                HandleRtcpLocked((const uint8_t*)buf, (size_t)len);
+        }
+
+        for (Client* c : snapshot) {
+            if (FD_ISSET(c->sock, &wr)) {
+                std::lock_guard<std::mutex> lk(mx);
+                FlushLocked(*c);
+            }
+            if (FD_ISSET(c->sock, &rd))
+                ReadClient(*c);
+        }
+    }
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "NvencPacketPool.h"
+#include "Rtcp.h"
+#include "RtpPacer.h"
+#include "RtpPacketizer.h"
+#include "Sdp.h"
+#include "StreamStats.h"
+
+// Multicast-выход сервера: один поток RTP на группу для любого числа
+// приёмников в LAN. RTP - на port, RTCP приёмников - port + 1.
+struct RtpMulticastConfig
+{
+    std::string group;      // 224.0.0.0/4; пусто - multicast выключен
+    uint16_t port = 5004;
+    int ttl = 1;            // 1 - только своя подсеть
+    std::string iface;      // IPv4 исходящего интерфейса, пусто - по маршруту
+};
+
+// RTCP сервера с его старта (NVRTSP_GetStats).
+struct RtcpCounters
+{
+    uint64_t senderReports = 0;     // SR отправлено (всем клиентам и в группу)
+    uint64_t receiverReports = 0;   // блоков отчёта о приёме нашего потока
+    uint64_t nackedPackets = 0;     // пакетов, о повторе которых просили
+    RtcpReceiverReport last;        // последний блок отчёта
+};
+
+// Встроенный RTSP-сервер: клиенты сами забирают поток у плагина
+// (DESCRIBE/SETUP/PLAY), без внешнего RTSP-сервера-ретранслятора.
+// Поддерживаются RTP поверх TCP (interleaved), UDP unicast и multicast. Кадр
+// пакетизируется один раз, и одни и те же RTP-пакеты уходят всем клиентам.
+// Раз в секунду клиенты получают RTCP SR (время NTP <-> RTP для
+// синхронизации и RTT); их RR, NACK и PLI/FIR разбираются.
+class RtspServer
+{
+public:
+    RtspServer();
+    ~RtspServer();
+
+    RtspServer(const RtspServer&) = delete;
+    RtspServer& operator=(const RtspServer&) = delete;
+
+    // url - rtsp://addr:port/path, на котором слушать (addr 0.0.0.0 - все интерфейсы).
+    bool Start(const std::string& url);
+    void Stop();
+
+    // Описание потока для ответа на DESCRIBE; обновляется при смене SPS/PPS.
+    void SetVideoDesc(const SdpVideoDesc& desc);
+
+    // Включает multicast (после Start): каждый кадр уходит в группу один
+    // раз, сколько бы приёмников в ней ни было; клиенты RTSP, запросившие
+    // в SETUP multicast, получают группу вместо своей копии. RTCP приёмников
+    // группы (RR, NACK, PLI на port + 1) разбирается, как от клиентов RTSP.
+    // Пустая группа - выключить. false - адрес не multicast или сокет не
+    // открылся.
+    bool SetMulticast(const RtpMulticastConfig& cfg);
+    // Группа - IPv4 multicast, порт и TTL в допустимых пределах.
+    static bool ValidMulticast(const RtpMulticastConfig& cfg);
+
+    // SDP потока: при включённом multicast - с группой, портом и TTL для
+    // приёмников без RTSP (файл .sdp для VLC/ffplay), иначе - как на DESCRIBE.
+    std::string BuildSdp() const;
+
+    // Рассылает пакеты кадра всем клиентам в состоянии PLAY. Новый клиент
+    // начинает получать поток с ближайшего ключевого кадра. С пейсингом
+    // кадр встаёт в очередь и уходит с потока пейсера; frame - блок пула,
+    // на который ссылается batch: очередь держит ссылку на него, а не
+    // копию нагрузки. Без frame нагрузка копируется.
+    void Broadcast(const RtpPacketBatch& batch, const NvEncPacketRef& frame = NvEncPacketRef());
+
+    // Пейсинг RTP: пакеты кадра растягиваются на долю интервала кадра
+    // (RtpPacer). fraction 0 - кадр уходит сразу весь, как раньше.
+    void SetPacing(const RtpPacingConfig& cfg);
+
+    // Байт, ушедших подряд без паузы, и задержка кадра в очереди пейсера
+    // (от Broadcast до последнего пакета). Читать можно с любого потока.
+    const LatencyHistogram& BurstBytes() const;
+    const LatencyHistogram& PacingDelay() const;
+
+    // Есть клиенты, начавшие PLAY и ещё не получившие кэш GOP.
+    bool HasPendingJoins() const;
+
+    // Отдаёт burst (кэш GOP, пакеты идут сразу перед следующим живым
+    // кадром) только клиентам из HasPendingJoins. Пустой burst - кэша нет,
+    // такие клиенты, как и раньше, ждут ближайший ключевой кадр. frames -
+    // блоки кадров burst, как frame у Broadcast.
+    void SendToJoiners(const RtpPacketBatch& burst,
+                       const std::vector<NvEncPacketRef>& frames = std::vector<NvEncPacketRef>());
+
+    size_t ClientCount() const;
+
+    // RTP/UDP: датаграмм отправлено и системных вызовов на это ушло.
+    void GetUdpCounters(uint64_t& datagrams, uint64_t& sendCalls) const;
+
+    // Клиент просил ключевой кадр (RTCP PLI или FIR) с прошлого вызова.
+    bool TakeKeyframeRequest();
+
+    // Отчёты о приёме (RR) и NACK клиентов с прошлого вызова, худшее по
+    // клиентам: битрейт один на всех, и равняется он на худшего. false -
+    // отчётов не было.
+    bool TakeReceiverReport(RtcpReceiverReport& out);
+
+    void GetRtcpCounters(RtcpCounters& out) const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> m;
+};
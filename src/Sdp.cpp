@@ -0,0 +1,143 @@
+#include "Sdp.h"
+
+#include <cstdio>
+
+#include "Av1Obu.h"
+#include "Platform.h"
+
+extern "C" {
+#include <libavutil/base64.h>
+}
+
+namespace {
+
+std::string Base64(const uint8_t* p, size_t n)
+{
+    std::string out(AV_BASE64_SIZE(n), '\0');
+    if (!av_base64_encode(&out[0], (int)out.size(), p, (int)n))
+        return std::string();
+    out.resize(out.size() - 1);   // без завершающего нуля
+    return out;
+}
+
+std::string FmtpH264(const std::vector<uint8_t>& ps)
+{
+    std::vector<NalUnit> nals;
+    BuildNalIndex(ps.data(), ps.size(), NalCodec::H264, nals);
+
+    std::string sprop;
+    std::string profile;
+    for (const NalUnit& u : nals) {
+        if (u.type != 7 && u.type != 8)
+            continue;
+        if (!sprop.empty())
+            sprop += ',';
+        sprop += Base64(ps.data() + u.offset, u.size);
+
+        // profile_idc, constraint flags, level_idc - три байта после заголовка SPS.
+        if (u.type == 7 && u.size >= 4 && profile.empty()) {
+            char buf[8];
+            sprintf_s(buf, "%02X%02X%02X",
+                ps[u.offset + 1], ps[u.offset + 2], ps[u.offset + 3]);
+            profile = buf;
+        }
+    }
+
+    std::string fmtp = "packetization-mode=1";
+    if (!profile.empty())
+        fmtp += ";profile-level-id=" + profile;
+    if (!sprop.empty())
+        fmtp += ";sprop-parameter-sets=" + sprop;
+    return fmtp;
+}
+
+std::string FmtpH265(const std::vector<uint8_t>& ps)
+{
+    std::vector<NalUnit> nals;
+    BuildNalIndex(ps.data(), ps.size(), NalCodec::H265, nals);
+
+    std::string vps, sps, pps;
+    for (const NalUnit& u : nals) {
+        std::string* dst = u.type == 32 ? &vps : u.type == 33 ? &sps : u.type == 34 ? &pps : nullptr;
+        if (!dst)
+            continue;
+        if (!dst->empty())
+            *dst += ',';
+        *dst += Base64(ps.data() + u.offset, u.size);
+    }
+
+    std::string fmtp;
+    auto add = [&](const char* key, const std::string& v) {
+        if (v.empty())
+            return;
+        if (!fmtp.empty())
+            fmtp += ';';
+        fmtp += key;
+        fmtp += '=';
+        fmtp += v;
+    };
+    add("sprop-vps", vps);
+    add("sprop-sps", sps);
+    add("sprop-pps", pps);
+    return fmtp;
+}
+
+// Параметры из sequence header (AOM RTP payload for AV1, раздел 7.2).
+std::string FmtpAv1(const std::vector<uint8_t>& ps)
+{
+    Av1SequenceInfo info;
+    if (!ParseAv1SequenceHeader(ps.data(), ps.size(), info))
+        return std::string();
+
+    char buf[64];
+    sprintf_s(buf, "profile=%u;level-idx=%u;tier=%u",
+        info.profile, info.levelIdx, info.tier);
+    return buf;
+}
+
+const char* EncodingName(NalCodec codec)
+{
+    switch (codec) {
+    case NalCodec::H265: return "H265";
+    case NalCodec::AV1:  return "AV1";
+    default:             return "H264";
+    }
+}
+
+} // namespace
+
+std::string BuildVideoSdp(const SdpVideoDesc& desc)
+{
+    char line[256];
+    std::string sdp;
+
+    sdp += "v=0\r\n";
+    sdp += "o=- 0 0 IN IP4 127.0.0.1\r\n";
+    sdp += "s=" + desc.sessionName + "\r\n";
+    if (desc.ttl > 0)
+        sprintf_s(line, "c=IN IP4 %s/%d\r\n", desc.connectionAddr.c_str(), desc.ttl);
+    else
+        sprintf_s(line, "c=IN IP4 %s\r\n", desc.connectionAddr.c_str());
+    sdp += line;
+    sdp += "t=0 0\r\n";
+    sdp += "a=tool:NvencRtspPlugin\r\n";
+
+    sprintf_s(line, "m=video %u RTP/AVP %u\r\n", (unsigned)desc.port, (unsigned)desc.payloadType);
+    sdp += line;
+    sprintf_s(line, "a=rtpmap:%u %s/90000\r\n", (unsigned)desc.payloadType, EncodingName(desc.codec));
+    sdp += line;
+
+    std::string fmtp;
+    switch (desc.codec) {
+    case NalCodec::H264: fmtp = FmtpH264(desc.parameterSets); break;
+    case NalCodec::H265: fmtp = FmtpH265(desc.parameterSets); break;
+    case NalCodec::AV1:  fmtp = FmtpAv1(desc.parameterSets);  break;
+    }
+    if (!fmtp.empty()) {
+        sprintf_s(line, "a=fmtp:%u ", (unsigned)desc.payloadType);
+        sdp += line + fmtp + "\r\n";
+    }
+    if (!desc.control.empty())
+        sdp += "a=control:" + desc.control + "\r\n";
+    return sdp;
+}
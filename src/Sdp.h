@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "AnnexB.h"
+
+// Параметры описания одного видеопотока в SDP (RFC 4566).
+struct SdpVideoDesc
+{
+    NalCodec codec = NalCodec::H264;
+    uint8_t payloadType = 96;
+    // SPS/PPS (+VPS) в Annex-B виде, для AV1 - OBU sequence header;
+    // пусто - параметры только in-band.
+    std::vector<uint8_t> parameterSets;
+    // c= и m=: для RTSP - "0.0.0.0" и порт 0, для multicast - группа и её порт.
+    std::string connectionAddr = "0.0.0.0";
+    uint16_t port = 0;
+    int ttl = 0;                 // > 0 - multicast, пишется в c= как addr/ttl
+    std::string control = "trackID=0";
+    std::string sessionName = "NvencRtsp";
+};
+
+std::string BuildVideoSdp(const SdpVideoDesc& desc);
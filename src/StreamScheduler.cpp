@@ -0,0 +1,189 @@
+#include "StreamScheduler.h"
+
+#include <chrono>
+#include <functional>
+
+int64_t StreamScheduler::NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+StreamScheduler::StreamScheduler(uint32_t threads)
+{
+    if (threads == 0)
+        threads = 1;
+    m_threads.reserve(threads);
+    for (uint32_t i = 0; i < threads; ++i)
+        m_threads.emplace_back(&StreamScheduler::ThreadMain, this);
+}
+
+StreamScheduler::~StreamScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lk(m_mx);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    for (std::thread& t : m_threads) {
+        if (t.joinable())
+            t.join();
+    }
+}
+
+void StreamScheduler::ScheduleLocked(int id, Entry& e, int64_t dueNs, bool frameDeadline)
+{
+    e.dueNs = dueNs;
+    e.frameDeadline = frameDeadline;
+    e.scheduled = true;
+    ++e.gen;
+    m_heap.push(HeapItem{ dueNs, id, e.gen });
+    m_cv.notify_one();
+}
+
+int StreamScheduler::Add(ScheduledStream* stream, int64_t periodNs)
+{
+    if (!stream)
+        return -1;
+    if (periodNs <= 0)
+        periodNs = 1000000000LL / 30;
+
+    std::lock_guard<std::mutex> lk(m_mx);
+
+    // Дробная часть k * 0.618... равномерно заполняет [0, 1) при любом числе
+    // стримов, так что сроки расходятся, даже если стримы добавляют по одному.
+    double phase = (double)m_added++ * 0.6180339887498949;
+    phase -= (int64_t)phase;
+
+    int id = m_nextId++;
+    Entry& e = m_entries[id];
+    e.stream = stream;
+    e.toleranceNs = periodNs / 4;
+    ScheduleLocked(id, e, NowNs() + (int64_t)(phase * (double)periodNs), true);
+    return id;
+}
+
+void StreamScheduler::Remove(int id, StreamSchedStats* final)
+{
+    std::unique_lock<std::mutex> lk(m_mx);
+    auto it = m_entries.find(id);
+    if (it == m_entries.end())
+        return;
+
+    m_idleCv.wait(lk, [&] { return !it->second.running; });
+    if (final)
+        FillStats(it->second, *final);
+    m_entries.erase(it);
+}
+
+void StreamScheduler::SetPeriod(int id, int64_t periodNs)
+{
+    if (periodNs <= 0)
+        return;
+    std::lock_guard<std::mutex> lk(m_mx);
+    auto it = m_entries.find(id);
+    if (it != m_entries.end())
+        it->second.toleranceNs = periodNs / 4;
+}
+
+void StreamScheduler::Wake(int id)
+{
+    std::lock_guard<std::mutex> lk(m_mx);
+    auto it = m_entries.find(id);
+    if (it == m_entries.end())
+        return;
+
+    Entry& e = it->second;
+    if (e.running) {
+        e.wakePending = true;
+        return;
+    }
+    int64_t now = NowNs();
+    if (!e.scheduled || e.dueNs > now)
+        ScheduleLocked(id, e, now, false);
+}
+
+bool StreamScheduler::GetStats(int id, StreamSchedStats& out) const
+{
+    std::lock_guard<std::mutex> lk(m_mx);
+    auto it = m_entries.find(id);
+    if (it == m_entries.end())
+        return false;
+
+    FillStats(it->second, out);
+    return true;
+}
+
+void StreamScheduler::FillStats(const Entry& e, StreamSchedStats& out)
+{
+    out.steps = e.steps;
+    out.deadlineMisses = e.misses;
+    out.lateAvgNs = e.steps ? e.lateSumNs / (int64_t)e.steps : 0;
+    out.lateMaxNs = e.lateMaxNs;
+}
+
+void StreamScheduler::ThreadMain()
+{
+    std::unique_lock<std::mutex> lk(m_mx);
+
+    while (!m_stop) {
+        // Пропускаем записи кучи для снятых стримов и перенесённых сроков.
+        while (!m_heap.empty()) {
+            const HeapItem& top = m_heap.top();
+            auto it = m_entries.find(top.id);
+            if (it == m_entries.end() || it->second.gen != top.gen || it->second.running) {
+                m_heap.pop();
+                continue;
+            }
+            break;
+        }
+
+        if (m_heap.empty()) {
+            m_cv.wait(lk);
+            continue;
+        }
+
+        HeapItem item = m_heap.top();
+        int64_t now = NowNs();
+        if (item.dueNs > now) {
+            m_cv.wait_for(lk, std::chrono::nanoseconds(item.dueNs - now));
+            continue;
+        }
+        m_heap.pop();
+
+        // Узлы unordered_map не перемещаются, ссылка живёт до erase в Remove,
+        // а Remove ждёт running == false.
+        Entry& e = m_entries[item.id];
+        e.running = true;
+        e.scheduled = false;
+        e.wakePending = false;
+
+        if (e.frameDeadline) {
+            int64_t late = now - item.dueNs;
+            ++e.steps;
+            e.lateSumNs += late;
+            if (late > e.lateMaxNs)
+                e.lateMaxNs = late;
+            if (late > e.toleranceNs)
+                ++e.misses;
+        }
+
+        ScheduledStream* stream = e.stream;
+        lk.unlock();
+        StreamStep next = stream->RunStep(now);
+        lk.lock();
+
+        e.running = false;
+        if (next.dueNs >= 0 || e.wakePending) {
+            int64_t due = next.dueNs;
+            bool frame = next.frameDeadline;
+            if (e.wakePending && (due < 0 || due > NowNs())) {
+                due = NowNs();
+                frame = false;
+            }
+            ScheduleLocked(item.id, e, due, frame);
+        }
+        m_idleCv.notify_all();
+    }
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Что вернул шаг стрима: когда его вызвать снова.
+struct StreamStep
+{
+    // Срок следующего шага по steady_clock (нс); < 0 - снять стрим с расписания.
+    int64_t dueNs = -1;
+    // Срок - это кадр (опоздание считается промахом), а не служебный
+    // шаг вроде дочитывания готовых пакетов NVENC.
+    bool frameDeadline = true;
+};
+
+// Стрим, который пул вызывает по сроку. Шаг не должен надолго блокироваться:
+// поток пула один на несколько стримов.
+class ScheduledStream
+{
+public:
+    virtual ~ScheduledStream() = default;
+    virtual StreamStep RunStep(int64_t nowNs) = 0;
+};
+
+struct StreamSchedStats
+{
+    uint64_t steps = 0;          // шагов с frameDeadline
+    uint64_t deadlineMisses = 0; // из них начатых позже срока + допуск
+    int64_t  lateAvgNs = 0;
+    int64_t  lateMaxNs = 0;
+};
+
+// Пул из нескольких потоков на все стримы вместо std::thread на handle.
+// Стримы лежат в куче по сроку; свободный поток берёт самый ранний
+// наступивший. Один стрим никогда не выполняется двумя потоками сразу.
+// Первые сроки новых стримов разнесены по периоду (шаг золотого сечения),
+// чтобы кадры всех стримов не уходили в NVENC в одну и ту же миллисекунду.
+class StreamScheduler
+{
+public:
+    explicit StreamScheduler(uint32_t threads);
+    ~StreamScheduler();
+
+    StreamScheduler(const StreamScheduler&) = delete;
+    StreamScheduler& operator=(const StreamScheduler&) = delete;
+
+    // periodNs - период кадров стрима: по нему выбирается сдвиг первого
+    // срока и допуск на опоздание (четверть периода). Возвращает id.
+    int Add(ScheduledStream* stream, int64_t periodNs);
+
+    // Снимает стрим; если его шаг сейчас выполняется - дожидается конца.
+    // Итоговые счётчики стрима - в *final (если не nullptr).
+    // Нельзя вызывать из RunStep этого же стрима.
+    void Remove(int id, StreamSchedStats* final = nullptr);
+
+    // Период кадров стрима изменился (допуск на опоздание пересчитывается).
+    void SetPeriod(int id, int64_t periodNs);
+
+    // Выполнить шаг как можно скорее (например, render thread снял кадр).
+    void Wake(int id);
+
+    bool GetStats(int id, StreamSchedStats& out) const;
+
+    uint32_t ThreadCount() const { return (uint32_t)m_threads.size(); }
+
+    static int64_t NowNs();
+
+private:
+    struct Entry {
+        ScheduledStream* stream = nullptr;
+        int64_t dueNs = 0;
+        bool frameDeadline = true;
+        int64_t toleranceNs = 0;
+        uint64_t gen = 0;           // версия срока; устаревшие записи кучи пропускаются
+        bool scheduled = false;
+        bool running = false;
+        bool wakePending = false;
+
+        uint64_t steps = 0;
+        uint64_t misses = 0;
+        int64_t lateSumNs = 0;
+        int64_t lateMaxNs = 0;
+    };
+
+    struct HeapItem {
+        int64_t dueNs;
+        int id;
+        uint64_t gen;
+        bool operator>(const HeapItem& o) const { return dueNs > o.dueNs; }
+    };
+
+    void ThreadMain();
+    static void FillStats(const Entry& e, StreamSchedStats& out);
+    void ScheduleLocked(int id, Entry& e, int64_t dueNs, bool frameDeadline);
+
+    mutable std::mutex m_mx;
+    std::condition_variable m_cv;        // новые сроки / остановка
+    std::condition_variable m_idleCv;    // шаг стрима завершён (для Remove)
+
+    std::unordered_map<int, Entry> m_entries;
+    std::priority_queue<HeapItem, std::vector<HeapItem>, std::greater<HeapItem>> m_heap;
+
+    int m_nextId = 0;
+    uint64_t m_added = 0;
+    bool m_stop = false;
+
+    std::vector<std::thread> m_threads;
+};
@@ -0,0 +1,93 @@
+#include "StreamStats.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static int HighestBit(uint64_t v)
+{
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanReverse64(&idx, v);
+    return (int)idx;
+#else
+    return 63 - __builtin_clzll(v);
+#endif
+}
+
+// v < 32 - своя корзина на каждое значение; дальше корзина задаётся старшим
+// битом (shift) и следующими kSubBits битами (мантисса 16..31).
+int LatencyHistogram::BucketOf(uint64_t v)
+{
+    if (v >= (1ULL << kMaxBits))
+        v = (1ULL << kMaxBits) - 1;
+    if (v < 2 * kSub)
+        return (int)v;
+
+    int shift = HighestBit(v) - kSubBits;
+    return shift * kSub + (int)(v >> shift);
+}
+
+int64_t LatencyHistogram::BucketMid(int idx)
+{
+    if (idx < 2 * kSub)
+        return idx;
+
+    int shift = idx / kSub - 1;
+    int64_t low = (int64_t)(idx % kSub + kSub) << shift;
+    return low + ((1LL << shift) >> 1);
+}
+
+void LatencyHistogram::Record(int64_t ns)
+{
+    if (ns < 0)
+        ns = 0;
+
+    m_counts[BucketOf((uint64_t)ns)].fetch_add(1, std::memory_order_relaxed);
+    m_total.fetch_add(1, std::memory_order_relaxed);
+
+    int64_t cur = m_max.load(std::memory_order_relaxed);
+    while (ns > cur && !m_max.compare_exchange_weak(cur, ns, std::memory_order_relaxed)) {
+    }
+}
+
+LatencySummary LatencyHistogram::Summarize() const
+{
+    LatencySummary out;
+    out.maxNs = m_max.load(std::memory_order_relaxed);
+
+    uint64_t counts[kBuckets];
+    uint64_t total = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        counts[i] = m_counts[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    out.count = total;
+    if (!total)
+        return out;
+
+    // Ранг перцентиля с округлением вверх: p99 из 100 значений - 99-е.
+    uint64_t rank50 = (total * 50 + 99) / 100;
+    uint64_t rank99 = (total * 99 + 99) / 100;
+
+    uint64_t seen = 0;
+    bool have50 = false;
+    for (int i = 0; i < kBuckets; ++i) {
+        if (!counts[i])
+            continue;
+        seen += counts[i];
+        if (!have50 && seen >= rank50) {
+            out.p50Ns = BucketMid(i);
+            have50 = true;
+        }
+        if (seen >= rank99) {
+            out.p99Ns = BucketMid(i);
+            break;
+        }
+    }
+
+    // Середина корзины может оказаться выше реального максимума.
+    if (out.p50Ns > out.maxNs) out.p50Ns = out.maxNs;
+    if (out.p99Ns > out.maxNs) out.p99Ns = out.maxNs;
+    return out;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+// Снимок гистограммы задержек (нс).
+struct LatencySummary
+{
+    uint64_t count = 0;
+    int64_t  p50Ns = 0;
+    int64_t  p99Ns = 0;
+    int64_t  maxNs = 0;
+};
+
+// Гистограмма в духе HDR: корзины по степеням двойки, каждая поделена на
+// 16 равных частей (погрешность ~6%), диапазон до 2^40 нс (~18 минут).
+// Record - один relaxed fetch_add без блокировок, его можно звать из горячего
+// пути; Summarize читает корзины без остановки писателей (снимок нестрогий).
+class LatencyHistogram
+{
+public:
+    void Record(int64_t ns);
+    LatencySummary Summarize() const;
+
+private:
+    static const int kSubBits = 4;
+    static const int kSub = 1 << kSubBits;
+    static const int kMaxBits = 40;
+    static const int kBuckets = (kMaxBits - kSubBits) * kSub + 2 * kSub;
+
+    static int BucketOf(uint64_t v);
+    static int64_t BucketMid(int idx);
+
+    std::atomic<uint64_t> m_counts[kBuckets] = {};
+    std::atomic<uint64_t> m_total{0};
+    std::atomic<int64_t>  m_max{0};
+};
+
+// Счётчики одного стрима. Все поля пишутся атомарно без мьютексов; читает
+// NVRTSP_GetStats с любого потока.
+struct StreamStats
+{
+    std::atomic<uint64_t> framesEncoded{0};
+    std::atomic<uint64_t> framesDropped{0};
+    std::atomic<uint64_t> framesSent{0};
+    std::atomic<uint64_t> bytesOut{0};
+    std::atomic<uint32_t> reconnects{0};
+
+    // Реакция на отставание сети (PushSender, политика стрима).
+    std::atomic<uint64_t> framesDroppedBackpressure{0};
+    std::atomic<uint64_t> ticksSkippedBackpressure{0};
+    std::atomic<uint32_t> targetKbps{0};
+
+    LatencyHistogram muxLatency;     // av_write_frame / пакетизация + рассылка
+    LatencyHistogram pacingJitter;   // опоздание тика кадра относительно срока
+    // Размер кадра в байтах (та же гистограмма, значения - не нс): разброс
+    // показывает всплески IDR против ровного потока intra refresh.
+    LatencyHistogram frameBytes;
+
+    // Для мгновенного битрейта: предыдущее чтение (только в GetStats).
+    std::mutex rateMx;
+    uint64_t lastBytes = 0;
+    int64_t  lastNs = 0;
+    double   lastKbps = 0.0;
+};
@@ -0,0 +1,221 @@
+#include "Platform.h"
+#include "UdpBatchSender.h"
+
+#include <cstring>
+
+#ifdef __linux__
+#include <netinet/udp.h>
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#endif
+
+// Объявление логгера из NvencRtspPlugin.cpp
+void Log(const char* msg);
+
+namespace {
+
+#ifdef __linux__
+// UDP_MAX_SEGMENTS старых ядер (4.18) и предел полезной нагрузки IPv4.
+const size_t kMaxGsoSegments = 64;
+const size_t kMaxGsoBytes = 65535 - 20 - 8;
+// Сообщений на один sendmmsg (UIO_MAXIOV).
+const size_t kMaxMessages = 1024;
+#endif
+
+} // namespace
+
+UdpBatchSender::UdpBatchSender()
+#ifdef __linux__
+    : m_mode(UdpBatchMode::Gso)
+#else
+    : m_mode(UdpBatchMode::Single)
+#endif
+{
+}
+
+void UdpBatchSender::SetMode(UdpBatchMode mode)
+{
+#ifdef __linux__
+    m_mode = mode;
+#else
+    (void)mode;
+    m_mode = UdpBatchMode::Single;
+#endif
+}
+
+void UdpBatchSender::Clear()
+{
+    m_bufs.clear();
+    m_dgrams.clear();
+    m_copiesUsed = 0;
+}
+
+void UdpBatchSender::Add(const NetBuf* bufs, size_t count)
+{
+    Dgram d;
+    d.firstBuf = m_bufs.size();
+    d.size = 0;
+    for (size_t i = 0; i < count; ++i)
+        d.size += bufs[i].size;
+
+    if (count <= kNetMaxBufs) {
+        m_bufs.insert(m_bufs.end(), bufs, bufs + count);
+        d.bufCount = count;
+    }
+    else {
+        // Датаграмма из очень многих кусков (мелкие OBU): одним куском.
+        if (m_copiesUsed == m_copies.size())
+            m_copies.emplace_back();
+        std::vector<uint8_t>& copy = m_copies[m_copiesUsed++];
+        copy.resize(d.size);
+        size_t off = 0;
+        for (size_t i = 0; i < count; ++i) {
+            memcpy(copy.data() + off, bufs[i].data, bufs[i].size);
+            off += bufs[i].size;
+        }
+        m_bufs.push_back(NetBuf{ copy.data(), copy.size() });
+        d.bufCount = 1;
+    }
+    m_dgrams.push_back(d);
+}
+
+size_t UdpBatchSender::Send(net_socket_t s, const sockaddr_in& to)
+{
+    if (m_dgrams.empty())
+        return 0;
+#ifdef __linux__
+    if (m_mode != UdpBatchMode::Single)
+        return SendMmsg(s, to);
+#endif
+    return SendSingle(s, to);
+}
+
+size_t UdpBatchSender::SendSingle(net_socket_t s, const sockaddr_in& to)
+{
+    size_t sent = 0;
+    for (const Dgram& d : m_dgrams) {
+        ++m_sendCalls;
+        if (NetSendvTo(s, &m_bufs[d.firstBuf], d.bufCount, to) < 0) {
+            if (NetWouldBlock())
+                break;
+            continue;
+        }
+        ++sent;
+    }
+    m_sentDatagrams += sent;
+    return sent;
+}
+
+#ifdef __linux__
+
+void UdpBatchSender::PlanMessages(size_t first, const sockaddr_in& to)
+{
+    m_msgs.clear();
+    m_iov.clear();
+
+    const bool gso = m_mode == UdpBatchMode::Gso;
+    for (size_t i = first; i < m_dgrams.size();) {
+        const size_t seg = m_dgrams[i].size;
+        size_t count = 1;
+        size_t bytes = seg;
+        // Серия: датаграммы размера seg, последняя может быть короче.
+        while (gso && i + count < m_dgrams.size() && count < kMaxGsoSegments) {
+            const size_t next = m_dgrams[i + count].size;
+            if (next > seg || bytes + next > kMaxGsoBytes)
+                break;
+            bytes += next;
+            ++count;
+            if (next < seg)
+                break;
+        }
+
+        Msg m;
+        m.firstDgram = i;
+        m.dgramCount = count;
+        m.firstIov = m_iov.size();
+        m.segSize = count > 1 ? (uint16_t)seg : 0;
+        for (size_t k = i; k < i + count; ++k) {
+            const Dgram& d = m_dgrams[k];
+            for (size_t b = 0; b < d.bufCount; ++b) {
+                iovec v;
+                v.iov_base = const_cast<void*>(m_bufs[d.firstBuf + b].data);
+                v.iov_len = m_bufs[d.firstBuf + b].size;
+                m_iov.push_back(v);
+            }
+        }
+        m.iovCount = m_iov.size() - m.firstIov;
+        m_msgs.push_back(m);
+        i += count;
+    }
+
+    // Заголовки - после того, как m_iov перестал расти.
+    m_hdrs.assign(m_msgs.size(), mmsghdr());
+    if (m_ctrl.size() < m_msgs.size())
+        m_ctrl.resize(m_msgs.size());
+    for (size_t k = 0; k < m_msgs.size(); ++k) {
+        const Msg& m = m_msgs[k];
+        msghdr& h = m_hdrs[k].msg_hdr;
+        h.msg_name = const_cast<sockaddr_in*>(&to);
+        h.msg_namelen = sizeof(to);
+        h.msg_iov = &m_iov[m.firstIov];
+        h.msg_iovlen = m.iovCount;
+        if (!m.segSize)
+            continue;
+
+        h.msg_control = m_ctrl[k].buf;
+        h.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+        cmsghdr* cm = CMSG_FIRSTHDR(&h);
+        cm->cmsg_level = SOL_UDP;
+        cm->cmsg_type = UDP_SEGMENT;
+        cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        memcpy(CMSG_DATA(cm), &m.segSize, sizeof(uint16_t));
+    }
+}
+
+size_t UdpBatchSender::SendMmsg(net_socket_t s, const sockaddr_in& to)
+{
+    size_t sent = 0;
+    PlanMessages(0, to);
+
+    size_t done = 0;
+    while (done < m_msgs.size()) {
+        size_t n = m_msgs.size() - done;
+        if (n > kMaxMessages)
+            n = kMaxMessages;
+
+        ++m_sendCalls;
+        int r = sendmmsg(s, &m_hdrs[done], (unsigned)n, MSG_NOSIGNAL);
+        if (r > 0) {
+            for (size_t k = done; k < done + (size_t)r; ++k)
+                sent += m_msgs[k].dgramCount;
+            done += (size_t)r;
+            continue;
+        }
+        if (NetWouldBlock())
+            break;
+
+        const int err = errno;
+        if (m_msgs[done].segSize && (err == EIO || err == EINVAL || err == ENOPROTOOPT)) {
+            // GSO нет (ядро до 4.18, карта без checksum offload, MTU
+            // пакета больше MTU маршрута): дальше без него.
+            char buf[128];
+            sprintf_s(buf, "RTP/UDP: GSO unavailable (errno %d), using sendmmsg", err);
+            Log(buf);
+            m_mode = UdpBatchMode::Mmsg;
+            PlanMessages(m_msgs[done].firstDgram, to);
+            done = 0;
+            continue;
+        }
+        // Ошибка одной датаграммы (ICMP unreachable и т.п.): как раньше,
+        // пропускаем её и шлём остальное.
+        ++done;
+    }
+    m_sentDatagrams += sent;
+    return sent;
+}
+
+#endif
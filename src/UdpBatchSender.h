@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "NetSocket.h"
+
+// Как уходят датаграммы кадра.
+enum class UdpBatchMode
+{
+    Single,   // sendmsg / WSASendTo на каждую датаграмму
+    Mmsg,     // все датаграммы одним sendmmsg (Linux)
+    Gso,      // sendmmsg, серии одинаковых датаграмм - одним сообщением с UDP_SEGMENT
+};
+
+// Отправка RTP/UDP пачкой: на 50+ Мбит один send на пакет съедает больше
+// CPU, чем всё остальное вместе. Датаграммы кадра копятся через Add и
+// уходят одним Send на адресата; куски по-прежнему берутся прямо из
+// RtpPacketBatch (без копирования), поэтому они должны жить до Send.
+//
+// С GSO ядро само режет сообщение на датаграммы по gso_size: подходят
+// серии пакетов одного размера (FU-A/FU полного MTU), последний в серии
+// может быть короче. Если ядро или сетевая карта GSO не умеет (EIO,
+// EINVAL), отправитель один раз переходит на Mmsg. Вне Linux - Single.
+class UdpBatchSender
+{
+public:
+    UdpBatchSender();
+
+    UdpBatchMode Mode() const { return m_mode; }
+    // Режим выше доступного на этой платформе понижается до доступного.
+    void SetMode(UdpBatchMode mode);
+
+    // Начать новый набор датаграмм.
+    void Clear();
+    // Датаграмма из кусков (не больше UIO_MAXIOV; больше kNetMaxBufs
+    // склеиваются в свой буфер).
+    void Add(const NetBuf* bufs, size_t count);
+    size_t Datagrams() const { return m_dgrams.size(); }
+
+    // Отправляет набор на адрес to (сокет неблокирующий: при переполнении
+    // буфера остаток отбрасывается, как любая потеря UDP). Возвращает
+    // число ушедших датаграмм. Набор остаётся - его можно отправить
+    // следующему адресату.
+    size_t Send(net_socket_t s, const sockaddr_in& to);
+
+    // Счётчики за всё время: датаграмм и системных вызовов отправки.
+    uint64_t SentDatagrams() const { return m_sentDatagrams; }
+    uint64_t SendCalls() const { return m_sendCalls; }
+
+private:
+    struct Dgram
+    {
+        size_t firstBuf;
+        size_t bufCount;
+        size_t size;
+    };
+
+    size_t SendSingle(net_socket_t s, const sockaddr_in& to);
+#ifdef __linux__
+    size_t SendMmsg(net_socket_t s, const sockaddr_in& to);
+    // Раскладывает датаграммы начиная с first по сообщениям sendmmsg.
+    void PlanMessages(size_t first, const sockaddr_in& to);
+
+    struct Msg
+    {
+        size_t firstDgram;
+        size_t dgramCount;
+        size_t firstIov;
+        size_t iovCount;
+        uint16_t segSize;   // 0 - без UDP_SEGMENT
+    };
+    struct Control
+    {
+        alignas(8) uint8_t buf[64];
+    };
+
+    std::vector<Msg> m_msgs;
+    std::vector<iovec> m_iov;
+    std::vector<mmsghdr> m_hdrs;
+    std::vector<Control> m_ctrl;
+#endif
+
+    UdpBatchMode m_mode;
+    std::vector<NetBuf> m_bufs;
+    std::vector<Dgram> m_dgrams;
+    // Склеенные датаграммы; буферы внутренних векторов не двигаются при
+    // росте внешнего, поэтому указатели в m_bufs остаются верными.
+    std::vector<std::vector<uint8_t>> m_copies;
+    size_t m_copiesUsed = 0;
+
+    uint64_t m_sentDatagrams = 0;
+    uint64_t m_sendCalls = 0;
+};
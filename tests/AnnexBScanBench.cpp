@@ -0,0 +1,187 @@
+// Поиск стартовых кодов и индекс NAL на кадрах 4K / 60 Мбит/с: SIMD-сканер
+// (FindStartCode/BuildNalIndex) против побайтного сканера, который был в
+// энкодерах до AnnexB.cpp. Заодно сверяет SIMD и скалярный поиск на
+// случайных данных со стартовыми кодами на всех смещениях.
+//
+//   AnnexBScanBench [--quick]
+
+#include <random>
+
+#include "AnnexB.h"
+#include "TestSupport.h"
+
+namespace {
+
+// Прежний NvEncoderD3D11_H264::PacketHasIdrImpl: побайтный проход до IDR.
+bool LegacyPacketHasIdr(const uint8_t* p, size_t n)
+{
+    auto is_start = [&](size_t pos) -> bool {
+        if (pos + 3 >= n) return false;
+        if (p[pos] == 0 && p[pos+1] == 0 && p[pos+2] == 1)
+            return true;
+        if (pos + 4 <= n && p[pos] == 0 && p[pos+1] == 0 && p[pos+2] == 0 && p[pos+3] == 1)
+            return true;
+        return false;
+    };
+
+    size_t i = 0;
+    while (i + 4 < n) {
+        while (i + 4 < n && !is_start(i))
+            ++i;
+        if (!is_start(i)) break;
+
+        size_t nalStart = (p[i] == 0 && p[i+1] == 0 && p[i+2] == 1) ? i + 3 : i + 4;
+        if (nalStart >= n)
+            break;
+        if ((p[nalStart] & 0x1F) == 5)
+            return true;
+        i = nalStart + 1;
+    }
+    return false;
+}
+
+// Индекс на скалярном поиске - то же, что BuildNalIndex без SIMD.
+void BuildNalIndexScalar(const uint8_t* p, size_t n, std::vector<NalUnit>& out)
+{
+    out.clear();
+    size_t sc = FindStartCodeScalar(p, n, 0);
+    while (sc < n) {
+        const size_t start = sc + 3;
+        const size_t next = start < n ? FindStartCodeScalar(p, n, start) : n;
+        size_t end = next;
+        while (end > start && p[end - 1] == 0)
+            --end;
+        if (end > start) {
+            NalUnit u;
+            u.offset = (uint32_t)start;
+            u.size = (uint32_t)(end - start);
+            u.type = p[start] & 0x1F;
+            out.push_back(u);
+        }
+        sc = next;
+    }
+}
+
+// Тело среза как после CABAC: случайные байты с emulation prevention
+// (после 00 00 не бывает байта <= 3).
+void AppendSlice(std::vector<uint8_t>& out, uint8_t header, size_t size, std::mt19937& rng)
+{
+    static const uint8_t sc[] = { 0, 0, 0, 1 };
+    out.insert(out.end(), sc, sc + 4);
+    out.push_back(header);
+    int zeros = 0;
+    for (size_t i = 0; i < size; ++i) {
+        uint8_t b = (uint8_t)rng();
+        // В сжатых данных нули встречаются чаще, чем в равномерном шуме.
+        if ((rng() & 15) == 0)
+            b = 0;
+        if (zeros >= 2 && b <= 3) {
+            out.push_back(3);
+            zeros = 0;
+        }
+        out.push_back(b);
+        zeros = b ? 0 : zeros + 1;
+    }
+    if (out.back() == 0)
+        out.push_back(0x80);
+}
+
+// Access unit 4K: 4 среза, 60 Мбит/с при 60 к/с - ~125 КБ на P-кадр, IDR вчетверо больше.
+std::vector<uint8_t> MakeFrame(bool idr, std::mt19937& rng)
+{
+    const size_t frameBytes = 60000000 / 8 / 60 * (idr ? 4 : 1);
+    std::vector<uint8_t> au;
+    au.reserve(frameBytes + frameBytes / 8);
+    if (idr) {
+        AppendSlice(au, 0x67, 24, rng);
+        AppendSlice(au, 0x68, 6, rng);
+    }
+    for (int s = 0; s < 4; ++s)
+        AppendSlice(au, idr ? 0x65 : 0x41, frameBytes / 4, rng);
+    return au;
+}
+
+void CheckScannersAgree(std::mt19937& rng)
+{
+    std::vector<uint8_t> buf(4096);
+    std::vector<NalUnit> a, b;
+    for (int iter = 0; iter < 2000; ++iter) {
+        const size_t n = 1 + rng() % buf.size();
+        for (size_t i = 0; i < n; ++i)
+            buf[i] = (rng() & 3) ? (uint8_t)rng() : 0;
+        // Стартовые коды на любых смещениях, в том числе у краёв векторов.
+        for (int k = rng() % 8; k > 0; --k) {
+            size_t at = rng() % n;
+            for (size_t j = 0; j < 3 && at + j < n; ++j)
+                buf[at + j] = j == 2 ? 1 : 0;
+        }
+        for (size_t pos = 0; pos < n; pos += 1 + rng() % 64)
+            CHECK_EQ(FindStartCode(buf.data(), n, pos), FindStartCodeScalar(buf.data(), n, pos));
+
+        BuildNalIndex(buf.data(), n, NalCodec::H264, a);
+        BuildNalIndexScalar(buf.data(), n, b);
+        CHECK_EQ(a.size(), b.size());
+        for (size_t i = 0; i < a.size(); ++i) {
+            CHECK_EQ(a[i].offset, b[i].offset);
+            CHECK_EQ(a[i].size, b[i].size);
+        }
+    }
+}
+
+template <typename Fn>
+double MeasureGBps(const std::vector<std::vector<uint8_t>>& frames, int rounds, Fn fn)
+{
+    size_t bytes = 0;
+    const int64_t t0 = TestNowNs();
+    for (int r = 0; r < rounds; ++r) {
+        for (const std::vector<uint8_t>& f : frames) {
+            fn(f);
+            bytes += f.size();
+        }
+    }
+    const int64_t ns = TestNowNs() - t0;
+    return ns ? (double)bytes / (double)ns : 0.0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const bool quick = BenchQuick(argc, argv);
+    std::mt19937 rng(12345);
+
+    CheckScannersAgree(rng);
+
+    // GOP 60: один IDR и 59 P-кадров.
+    std::vector<std::vector<uint8_t>> frames;
+    for (int i = 0; i < 60; ++i)
+        frames.push_back(MakeFrame(i == 0, rng));
+
+    std::vector<NalUnit> nals;
+    for (const std::vector<uint8_t>& f : frames) {
+        BuildNalIndex(f.data(), f.size(), NalCodec::H264, nals);
+        CHECK_EQ(nals.size(), &f == &frames[0] ? 6 : 4);
+        CHECK_EQ(LegacyPacketHasIdr(f.data(), f.size()), NalIndexHasIdr(nals, NalCodec::H264));
+    }
+
+    const int rounds = quick ? 1 : 50;
+    volatile size_t sink = 0;
+    const double legacy = MeasureGBps(frames, rounds, [&](const std::vector<uint8_t>& f) {
+        sink = sink + LegacyPacketHasIdr(f.data(), f.size());
+    });
+    const double scalar = MeasureGBps(frames, rounds, [&](const std::vector<uint8_t>& f) {
+        BuildNalIndexScalar(f.data(), f.size(), nals);
+        sink = sink + nals.size();
+    });
+    const double simd = MeasureGBps(frames, rounds, [&](const std::vector<uint8_t>& f) {
+        BuildNalIndex(f.data(), f.size(), NalCodec::H264, nals);
+        sink = sink + nals.size();
+    });
+
+    printf("4K / 60 Mbps, %d frames x %d rounds\n", (int)frames.size(), rounds);
+    printf("  legacy PacketHasIdr  %7.2f GB/s\n", legacy);
+    printf("  scalar index         %7.2f GB/s\n", scalar);
+    printf("  SIMD BuildNalIndex   %7.2f GB/s  (x%.1f vs legacy)\n", simd,
+           legacy > 0 ? simd / legacy : 0.0);
+    return 0;
+}
@@ -0,0 +1,266 @@
+// Записанные временные блоки AV1 (low-overhead, как их отдаёт NVENC):
+// индекс OBU, ключевой кадр, поля sequence header для SDP и точная
+// раскладка AOM AV1 RTP - агрегационный заголовок, длины элементов,
+// фрагменты Z/Y на малых MTU.
+//
+// Векторы собраны побитово по разделу 5 спецификации AV1: sequence header
+// 720p main@4.0 (order hint, CDEF, BT.709, limited range), 1080p main@5.1
+// high tier с timing info и decoder model, OBU с obu_extension_header
+// (temporal_id 0/1), show_existing_frame. Тела кадров - псевдослучайные.
+
+#include "Av1Obu.h"
+#include "RtpPacketizer.h"
+#include "Sdp.h"
+#include "TestRtp.h"
+#include "TestSupport.h"
+
+namespace {
+
+// TD, sequence header 1280x720 main@4.0, OBU_FRAME KEY_FRAME (тело 300 байт,
+// длина в двух байтах LEB128).
+const uint8_t kKeyTu[] = {
+    0x12, 0x00, 0x0A, 0x0E, 0x00, 0x00, 0x00, 0x42, 0xA6, 0x7F, 0xD9, 0xE2,
+    0x17, 0xC8, 0x80, 0x80, 0x80, 0x82, 0x32, 0xAC, 0x02, 0x10, 0x72, 0x35,
+    0x54, 0x86, 0x58, 0xC8, 0x6F, 0x6C, 0xC4, 0x12, 0x4F, 0x31, 0x94, 0xE4,
+    0xB6, 0xAF, 0xC9, 0x0C, 0xD0, 0x76, 0x93, 0x8C, 0x24, 0x57, 0x2F, 0x11,
+    0xA5, 0x72, 0xE7, 0x26, 0x19, 0x1C, 0xA3, 0xED, 0x7E, 0x9F, 0x94, 0x42,
+    0xF5, 0xE7, 0x0A, 0x1A, 0x78, 0x7D, 0x72, 0x16, 0xFF, 0x08, 0x23, 0x83,
+    0x98, 0xDD, 0xB1, 0x96, 0xFB, 0x02, 0xB2, 0xFF, 0x98, 0x26, 0x60, 0x73,
+    0xE3, 0x16, 0xA5, 0xC0, 0xAA, 0x80, 0x9D, 0x7F, 0x59, 0x2C, 0x22, 0x74,
+    0x0B, 0x6B, 0x21, 0x4C, 0xF9, 0x6E, 0xDA, 0x3B, 0x7E, 0x9D, 0x2C, 0x66,
+    0x75, 0xE5, 0x9D, 0xB9, 0x7A, 0x24, 0xEF, 0xE8, 0x53, 0xD0, 0x8D, 0x8F,
+    0x45, 0xD7, 0xEB, 0x92, 0xC3, 0x3C, 0x90, 0x16, 0xC8, 0xB6, 0x0E, 0xAB,
+    0x77, 0x55, 0xF1, 0xD1, 0x94, 0x17, 0xC7, 0x9C, 0xF7, 0x27, 0x73, 0x2C,
+    0x97, 0xE8, 0xEF, 0xD2, 0xD7, 0x6A, 0x73, 0xF0, 0xDF, 0x72, 0x18, 0x9B,
+    0xC4, 0xC2, 0x88, 0x16, 0x19, 0xE8, 0x95, 0xAD, 0xEE, 0x89, 0x49, 0x92,
+    0x7B, 0xF6, 0x2C, 0x48, 0x5C, 0x23, 0x8D, 0xF4, 0xBF, 0x19, 0x4B, 0xDE,
+    0xEA, 0x40, 0xBD, 0x5E, 0x89, 0x8E, 0x6F, 0xFE, 0x40, 0xA6, 0x4C, 0x93,
+    0xF9, 0x9F, 0x97, 0x95, 0xD0, 0xF3, 0x83, 0x25, 0xF5, 0xA5, 0x8D, 0x9A,
+    0xD9, 0xD0, 0x28, 0x63, 0xED, 0xE0, 0x4A, 0x68, 0x24, 0xCC, 0x2F, 0xEF,
+    0x47, 0x6C, 0x8B, 0x36, 0xA5, 0xFF, 0xFC, 0x66, 0xBE, 0x5C, 0xB5, 0x2C,
+    0x88, 0x6D, 0xA8, 0xC8, 0x76, 0x3F, 0xD5, 0xC7, 0x65, 0xC9, 0xA4, 0x18,
+    0x14, 0x88, 0x70, 0xBB, 0x8D, 0x5E, 0x9A, 0x55, 0x06, 0x1B, 0x87, 0x0C,
+    0x86, 0x89, 0x5F, 0xCA, 0x05, 0xCF, 0x3F, 0x94, 0xD3, 0x6D, 0xC5, 0xC1,
+    0x0A, 0xDF, 0xF1, 0xC1, 0x16, 0x02, 0xD8, 0x24, 0xDA, 0x45, 0x9E, 0x66,
+    0x94, 0x6A, 0x4C, 0x82, 0x69, 0xD9, 0xEA, 0x0C, 0x85, 0xF2, 0x1A, 0x84,
+    0xA0, 0x4B, 0x3D, 0xDF, 0xCC, 0x12, 0xDD, 0xEC, 0x11, 0x05, 0x18, 0x6A,
+    0x83, 0xE9, 0x34, 0x0A, 0xA6, 0xE8, 0x20, 0xB2, 0x59, 0x52, 0x19, 0xFA,
+    0x14, 0xB1, 0xBF, 0x64, 0x41, 0x49, 0x86, 0xDF, 0x37,
+};
+
+// TD, OBU_FRAME INTER_FRAME.
+const uint8_t kInterTu[] = {
+    0x12, 0x00, 0x32, 0x28, 0x30, 0x22, 0x0F, 0x0F, 0x83, 0xD9, 0xCD, 0x5D,
+    0x15, 0x3C, 0x6C, 0x8B, 0x4B, 0x82, 0xC4, 0x97, 0x28, 0x9E, 0x66, 0x97,
+    0xE0, 0xF9, 0x55, 0x81, 0xEA, 0x58, 0x8E, 0xAE, 0xB6, 0xE5, 0x08, 0xD0,
+    0xB7, 0x11, 0x7D, 0xA7, 0x03, 0x09, 0x1B, 0x7F,
+};
+
+// TD, sequence header 1920x1080 main@5.1 high tier с timing info 30000/1001
+// и decoder model, два OBU_FRAME с obu_extension_header: KEY_FRAME
+// temporal_id 0 и INTER_FRAME temporal_id 1.
+const uint8_t kSvcTu[] = {
+    0x12, 0x00, 0x0A, 0x1D, 0x04, 0x00, 0x00, 0x0F, 0xA4, 0x00, 0x03, 0xA9,
+    0x82, 0xA9, 0x00, 0x00, 0x03, 0xE9, 0x4A, 0x40, 0x00, 0x06, 0xD5, 0x5D,
+    0xFE, 0x1B, 0x88, 0x5F, 0x22, 0x02, 0x02, 0x02, 0x08, 0x36, 0x00, 0x15,
+    0x10, 0x56, 0x3F, 0x4D, 0xD1, 0x1A, 0x45, 0xFB, 0xD3, 0xE0, 0x5F, 0xAB,
+    0xDB, 0xAB, 0xA6, 0xDC, 0xB5, 0x0F, 0x14, 0x99, 0xC8, 0x36, 0x20, 0x15,
+    0x30, 0x27, 0x15, 0xE0, 0x9D, 0xA7, 0x3D, 0x20, 0x5D, 0xF2, 0xC6, 0x0E,
+    0xB6, 0xA5, 0xB7, 0x5D, 0x96, 0x13, 0x7A, 0xCD, 0x54,
+};
+
+// TD, OBU_FRAME_HEADER с show_existing_frame = 1 (показ кадра из буфера).
+const uint8_t kShowExistingTu[] = {
+    0x12, 0x00, 0x1A, 0x01, 0xA0,
+};
+
+
+std::vector<NalUnit> Index(const uint8_t* p, size_t n)
+{
+    std::vector<NalUnit> obus;
+    BuildObuIndex(p, n, obus);
+    return obus;
+}
+
+// Индекс по длинам OBU, тип, ключевой кадр; OBU с расширенным заголовком.
+void TestObuIndex()
+{
+    std::vector<NalUnit> obus = Index(kKeyTu, sizeof(kKeyTu));
+    CHECK_EQ(obus.size(), 3);
+    CHECK_EQ(obus[0].type, kObuTemporalDelimiter);
+    CHECK_EQ(obus[0].offset, 0);
+    CHECK_EQ(obus[0].size, 2);
+    CHECK_EQ(obus[1].type, kObuSequenceHeader);
+    CHECK_EQ(obus[1].offset, 2);
+    CHECK_EQ(obus[1].size, 16);
+    CHECK_EQ(obus[2].type, kObuFrame);
+    CHECK_EQ(obus[2].offset, 18);
+    CHECK_EQ(obus[2].size, 303);
+    CHECK(ObuIndexHasKeyFrame(kKeyTu, obus));
+
+    ObuParts parts;
+    CHECK(SplitObu(kKeyTu + 18, 303, parts));
+    CHECK_EQ(parts.headerSize, 1);
+    CHECK_EQ(parts.payloadOffset, 3);
+    CHECK_EQ(parts.payloadSize, 300);
+
+    obus = Index(kInterTu, sizeof(kInterTu));
+    CHECK_EQ(obus.size(), 2);
+    CHECK(!ObuIndexHasKeyFrame(kInterTu, obus));
+
+    obus = Index(kShowExistingTu, sizeof(kShowExistingTu));
+    CHECK_EQ(obus.size(), 2);
+    CHECK_EQ(obus[1].type, kObuFrameHeader);
+    CHECK(!ObuIndexHasKeyFrame(kShowExistingTu, obus));
+
+    obus = Index(kSvcTu, sizeof(kSvcTu));
+    CHECK_EQ(obus.size(), 4);
+    CHECK_EQ(obus[2].type, kObuFrame);
+    CHECK_EQ(obus[3].type, kObuFrame);
+    CHECK(SplitObu(kSvcTu + obus[3].offset, obus[3].size, parts));
+    CHECK_EQ(parts.headerSize, 2);
+    CHECK_EQ(parts.payloadOffset, 3);
+    CHECK_EQ(parts.payloadSize, 21);
+    CHECK_EQ(kSvcTu[obus[3].offset + 1] >> 5, 1);
+    CHECK(ObuIndexHasKeyFrame(kSvcTu, obus));
+
+    // Обрезанный кадр: OBU, длина которого выходит за данные, в индекс не
+    // попадает.
+    obus = Index(kKeyTu, 100);
+    CHECK_EQ(obus.size(), 2);
+}
+
+// Sequence header копируется с полем длины; profile/level-idx/tier - как
+// записаны, в том числе после timing info и decoder model.
+void TestSequenceHeader()
+{
+    std::vector<uint8_t> sh;
+    CHECK(ExtractSequenceHeader(kKeyTu, Index(kKeyTu, sizeof(kKeyTu)), sh));
+    CHECK(sh == std::vector<uint8_t>(kKeyTu + 2, kKeyTu + 18));
+
+    Av1SequenceInfo info;
+    CHECK(ParseAv1SequenceHeader(sh.data(), sh.size(), info));
+    CHECK_EQ(info.profile, 0);
+    CHECK_EQ(info.levelIdx, 8);
+    CHECK_EQ(info.tier, 0);
+
+    CHECK(ParseAv1SequenceHeader(kSvcTu, sizeof(kSvcTu), info));
+    CHECK_EQ(info.profile, 0);
+    CHECK_EQ(info.levelIdx, 13);
+    CHECK_EQ(info.tier, 1);
+
+    // Те же поля уходят в a=fmtp SDP.
+    SdpVideoDesc desc;
+    desc.codec = NalCodec::AV1;
+    desc.parameterSets.assign(kSvcTu + 2, kSvcTu + 33);
+    const std::string sdp = BuildVideoSdp(desc);
+    CHECK(sdp.find("a=rtpmap:96 AV1/90000") != std::string::npos);
+    CHECK(sdp.find("profile=0;level-idx=13;tier=1") != std::string::npos);
+
+    CHECK(!ExtractSequenceHeader(kInterTu, Index(kInterTu, sizeof(kInterTu)), sh));
+    CHECK(!ParseAv1SequenceHeader(kInterTu, sizeof(kInterTu), info));
+}
+
+std::vector<std::vector<uint8_t>> Packetize(const uint8_t* tu, size_t n, size_t mtu,
+                                            size_t* counted)
+{
+    RtpPacketizer packetizer(NalCodec::AV1, 96, 0x1234, 100, mtu);
+    const std::vector<NalUnit> obus = Index(tu, n);
+    *counted = packetizer.CountPackets(tu, obus);
+
+    RtpPacketBatch batch;
+    packetizer.Packetize(tu, obus, 3003, ObuIndexHasKeyFrame(tu, obus), batch);
+    return BatchPackets(batch);
+}
+
+// Раскладка одного пакета байт в байт: без TD, у OBU снят
+// obu_has_size_field, длина - у элемента; N - на кадре с sequence header.
+void TestRtpPayloadBytes()
+{
+    size_t counted = 0;
+    std::vector<std::vector<uint8_t>> pkts =
+        Packetize(kInterTu, sizeof(kInterTu), RtpPacketizer::kRtpDefaultMtu, &counted);
+    CHECK_EQ(pkts.size(), 1);
+    CHECK_EQ(counted, 1);
+
+    RtpHeaderView h;
+    CHECK(ParseRtpHeader(pkts[0].data(), pkts[0].size(), h));
+    CHECK(h.marker);
+    CHECK_EQ(h.ts, 3003);
+    std::vector<uint8_t> expected = { 0x00, 0x29, 0x30 };
+    expected.insert(expected.end(), kInterTu + 4, kInterTu + sizeof(kInterTu));
+    CHECK(std::vector<uint8_t>(h.payload, h.payload + h.payloadSize) == expected);
+
+    pkts = Packetize(kKeyTu, sizeof(kKeyTu), RtpPacketizer::kRtpDefaultMtu, &counted);
+    CHECK_EQ(pkts.size(), 1);
+    CHECK(ParseRtpHeader(pkts[0].data(), pkts[0].size(), h));
+    expected = { 0x08, 0x0F, 0x08 };
+    expected.insert(expected.end(), kKeyTu + 4, kKeyTu + 18);
+    expected.insert(expected.end(), { 0xAD, 0x02, 0x30 });
+    expected.insert(expected.end(), kKeyTu + 21, kKeyTu + sizeof(kKeyTu));
+    CHECK(std::vector<uint8_t>(h.payload, h.payload + h.payloadSize) == expected);
+
+    // Расширенный заголовок OBU переносится целиком.
+    pkts = Packetize(kSvcTu, sizeof(kSvcTu), RtpPacketizer::kRtpDefaultMtu, &counted);
+    CHECK_EQ(pkts.size(), 1);
+    CHECK(ParseRtpHeader(pkts[0].data(), pkts[0].size(), h));
+    const uint8_t tail[] = { 0x17, 0x34, 0x20 };
+    const uint8_t* last = h.payload + h.payloadSize - 24;
+    CHECK(memcmp(last, tail, sizeof(tail)) == 0);
+    CHECK(memcmp(last + 3, kSvcTu + sizeof(kSvcTu) - 21, 21) == 0);
+}
+
+// Малые MTU: кадр режется на фрагменты, Y пакета совпадает с Z следующего,
+// N только в первом, приёмник собирает те же OBU.
+void TestRtpFragments()
+{
+    const struct { const uint8_t* tu; size_t n; } vectors[] = {
+        { kKeyTu, sizeof(kKeyTu) },
+        { kInterTu, sizeof(kInterTu) },
+        { kSvcTu, sizeof(kSvcTu) },
+    };
+    const size_t mtus[] = { RtpPacketizer::kRtpMinMtu, 300, 512, RtpPacketizer::kRtpDefaultMtu };
+
+    for (const auto& v : vectors) {
+        const std::vector<NalUnit> obus = Index(v.tu, v.n);
+        const bool newSequence = v.tu != kInterTu;
+        for (size_t mtu : mtus) {
+            size_t counted = 0;
+            std::vector<std::vector<uint8_t>> pkts = Packetize(v.tu, v.n, mtu, &counted);
+            CHECK_EQ(pkts.size(), counted);
+
+            RtpDepacketizer rx(NalCodec::AV1);
+            bool prevY = false;
+            for (size_t i = 0; i < pkts.size(); ++i) {
+                CHECK(pkts[i].size() <= mtu);
+                RtpHeaderView h;
+                CHECK(ParseRtpHeader(pkts[i].data(), pkts[i].size(), h));
+                const uint8_t agg = h.payload[0];
+                CHECK_EQ((agg & 0x80) != 0, prevY);
+                CHECK_EQ((agg & 0x30), 0);
+                CHECK_EQ((agg & 0x08) != 0, i == 0 && newSequence);
+                prevY = (agg & 0x40) != 0;
+                CHECK(rx.Push(pkts[i].data(), pkts[i].size()));
+            }
+            CHECK(!prevY);
+            CHECK(rx.FrameDone());
+            CHECK(rx.Units() == ExpectedUnits(v.tu, obus, NalCodec::AV1));
+        }
+    }
+
+    // 300-байтный KEY_FRAME в минимальный MTU не влезает.
+    size_t counted = 0;
+    CHECK(Packetize(kKeyTu, sizeof(kKeyTu), RtpPacketizer::kRtpMinMtu, &counted).size() >= 2);
+}
+
+} // namespace
+
+int main()
+{
+    TestObuIndex();
+    TestSequenceHeader();
+    TestRtpPayloadBytes();
+    TestRtpFragments();
+    printf("Av1VectorsTest OK\n");
+    return 0;
+}
@@ -0,0 +1,172 @@
+// Захват по render-событию при включённом ID3D11Multithread: сколько render
+// thread ждёт блокировку устройства, пока потоки кодирования работают.
+//   worker - кольцо только копирует кадр, масштаб и NV12 делает энкодер
+//            на immediate context с потока кодирования (как было);
+//   render - кольцо готовит кадр в размере и формате энкодера само, поток
+//            кодирования отдаёт слот в NVENC, контекст не трогая.
+// Две лесенки полный размер / половина (4 энкодера) от кадра крупнее. На
+// фейковом устройстве проходы шейдеров идут на CPU под блокировкой, поэтому
+// размеры малые, а время кадра render thread в режиме render растёт -
+// значимо ожидание блокировки.
+//
+//   CaptureContentionBench [--quick]
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "FakeNvenc.h"
+#include "FrameCaptureRing.h"
+#include "NvencEncoder.h"
+#include "TestSupport.h"
+
+namespace {
+
+const uint32_t kSrcW = 320;
+const uint32_t kSrcH = 192;
+const uint32_t kDstW = 160;
+const uint32_t kDstH = 96;
+const uint32_t kFps = 30;
+const int64_t kInterval100ns = 10000000 / kFps;
+
+struct Lane
+{
+    uint32_t w = 0;
+    uint32_t h = 0;
+    std::unique_ptr<NvEncoderD3D11Base> enc;
+    std::unique_ptr<FrameCaptureRing> ring;
+    uint64_t frames = 0;
+    int64_t lockWaitNs = 0;
+};
+
+struct Result
+{
+    double renderWaitMs = 0.0;      // на кадр
+    double renderFrameMs = 0.0;
+    double workerWaitMs = 0.0;      // на закодированный кадр, по всем потокам
+    uint64_t encoded = 0;
+};
+
+void RunWorker(Lane& lane, std::atomic<bool>& done)
+{
+    std::vector<NvEncPacket> packets;
+    while (true) {
+        CapturedFrame frame;
+        if (!lane.ring->AcquireLatest(frame, std::chrono::milliseconds(20))) {
+            if (done.load())
+                break;
+            continue;
+        }
+        uint64_t frameIdx = 0;
+        if (lane.enc->EncodeTextureNoCopy(frame.tex, frame.ts100ns, packets, &frameIdx))
+            lane.ring->MarkSubmitted(frame.slot, frameIdx);
+        else
+            lane.ring->Release(frame.slot);
+        lane.enc->WaitForPackets(packets, INFINITE);
+        lane.frames += packets.size();
+        lane.ring->SetCompletedFrames(lane.enc->CompletedFrames());
+    }
+    lane.enc->Flush(packets);
+    lane.frames += packets.size();
+    lane.lockWaitNs = FakeD3D11LockWaitNs();
+}
+
+Result Run(bool renderPrep, int frames)
+{
+    FakeGpu gpu;
+    gpu.ctx->Multithread()->SetMultithreadProtected(TRUE);
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> src = gpu.NewTexture(kSrcW, kSrcH);
+
+    std::vector<Lane> lanes(4);
+    for (size_t i = 0; i < lanes.size(); ++i) {
+        Lane& lane = lanes[i];
+        lane.w = i % 2 ? kDstW / 2 : kDstW;
+        lane.h = i % 2 ? kDstH / 2 : kDstH;
+        lane.enc = CreateNvEncoder(NVRTSP_CODEC_H264, gpu.dev.Get(), gpu.ctx.Get(),
+                                   lane.w, lane.h, kFps, 1, 2000);
+        CHECK(lane.enc && lane.enc->Initialize(FakeNvencFunctionList()));
+        CHECK(lane.enc->SetColorConversion(NVRTSP_COLOR_NV12_LIMITED));
+
+        lane.ring.reset(new FrameCaptureRing(gpu.dev.Get(), 4, kFps));
+        if (renderPrep) {
+            CaptureFormat f;
+            f.w = lane.w;
+            f.h = lane.h;
+            f.nv12 = true;
+            lane.ring->SetFormat(f);
+        }
+    }
+
+    std::atomic<bool> done{false};
+    std::vector<std::thread> workers;
+    for (Lane& lane : lanes)
+        workers.emplace_back(RunWorker, std::ref(lane), std::ref(done));
+
+    // Render thread: "рендер" кадра на immediate context, затем захват во
+    // все кольца, как в OnRenderEvent.
+    const int64_t waitBefore = FakeD3D11LockWaitNs();
+    const int64_t t0 = TestNowNs();
+    for (int i = 0; i < frames; ++i) {
+        {
+            FakeContextCall call(gpu.ctx.Get());
+            FillPattern(src.Get(), (uint32_t)i);
+        }
+        for (Lane& lane : lanes)
+            lane.ring->Capture(gpu.ctx.Get(), src.Get(), (int64_t)(i + 1) * kInterval100ns);
+        // Темп кадров Unity: дать потокам кодирования забрать кадр.
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    const int64_t renderNs = TestNowNs() - t0;
+    const int64_t renderWaitNs = FakeD3D11LockWaitNs() - waitBefore;
+
+    done = true;
+    for (Lane& lane : lanes)
+        lane.ring->Wake();
+    for (std::thread& t : workers)
+        t.join();
+
+    Result r;
+    int64_t workerWaitNs = 0;
+    for (const Lane& lane : lanes) {
+        CHECK(lane.frames > 0);
+        r.encoded += lane.frames;
+        workerWaitNs += lane.lockWaitNs;
+    }
+    r.renderWaitMs = renderWaitNs / 1e6 / frames;
+    r.renderFrameMs = renderNs / 1e6 / frames;
+    r.workerWaitMs = r.encoded ? workerWaitNs / 1e6 / (double)r.encoded : 0.0;
+    return r;
+}
+
+void Print(const char* name, const Result& r)
+{
+    printf("  %-7s render thread: lock wait %6.3f ms/frame, frame %6.2f ms; "
+           "workers: lock wait %6.3f ms/frame, %llu frames encoded\n",
+           name, r.renderWaitMs, r.renderFrameMs, r.workerWaitMs,
+           (unsigned long long)r.encoded);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const bool quick = BenchQuick(argc, argv);
+    const int frames = quick ? 10 : 300;
+
+    FakeNvencConfig cfg;
+    cfg.encodeDelayUs = 500;
+    FakeNvencSetConfig(cfg);
+
+    const Result worker = Run(false, frames);
+    const Result render = Run(true, frames);
+
+    printf("%ux%u -> 2 x (%ux%u + %ux%u) NV12, %d frames, D3D11 multithread protected\n",
+           kSrcW, kSrcH, kDstW, kDstH, kDstW / 2, kDstH / 2, frames);
+    Print("worker", worker);
+    Print("render", render);
+
+    // Кадры готовит только render thread: делить блокировку ему не с кем.
+    CHECK_EQ(render.renderWaitMs * 1e6, 0);
+    CHECK_EQ(render.workerWaitMs * 1e6, 0);
+    return 0;
+}
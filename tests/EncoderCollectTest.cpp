@@ -0,0 +1,192 @@
+// Дочитывание кадров из NVENC (CollectPackets) в синхронном режиме:
+// конечный таймаут при долгом кодировании, потеря кадра в nvEncLockBitstream
+// и склейка запросов IDR.
+
+#include <thread>
+
+#include "FakeNvenc.h"
+#include "NvencEncoder.h"
+#include "TestSupport.h"
+
+namespace {
+
+const uint32_t kW = 64;
+const uint32_t kH = 64;
+
+// Таблица FakeNvenc, у которой nvEncLockBitstream отказывает на кадре g_failFrame.
+NV_ENCODE_API_FUNCTION_LIST g_fn;
+uint32_t g_failFrame = ~0u;
+
+NVENCSTATUS NVENCAPI FailingLockBitstream(void* encoder, NV_ENC_LOCK_BITSTREAM* lock)
+{
+    NVENCSTATUS st = FakeNvencFunctionList()->nvEncLockBitstream(encoder, lock);
+    if (st != NV_ENC_SUCCESS || lock->frameIdx != g_failFrame)
+        return st;
+    // Буфер освобождается, как у драйвера после ошибки; кадр пропал.
+    FakeNvencFunctionList()->nvEncUnlockBitstream(encoder, lock->outputBitstream);
+    return NV_ENC_ERR_GENERIC;
+}
+
+std::unique_ptr<NvEncoderD3D11Base> NewEncoder(FakeGpu& gpu, uint32_t delayUs,
+                                               const NV_ENCODE_API_FUNCTION_LIST* api)
+{
+    FakeNvencConfig cfg;
+    cfg.encodeDelayUs = delayUs;
+    FakeNvencSetConfig(cfg);
+    auto enc = CreateNvEncoder(NVRTSP_CODEC_H264, gpu.dev.Get(), gpu.ctx.Get(), kW, kH, 30, 1, 2000);
+    CHECK(enc);
+    CHECK(enc->Initialize(api));
+    return enc;
+}
+
+// Кадр кодируется 60 мс: короткое ожидание возвращается по своему сроку,
+// длинное - как только кадр готов.
+void TestFiniteWait()
+{
+    FakeGpu gpu;
+    auto tex = gpu.NewTexture(kW, kH);
+    auto enc = NewEncoder(gpu, 60000, FakeNvencFunctionList());
+
+    std::vector<NvEncPacket> out;
+    const int64_t t0 = TestNowNs();
+    CHECK(enc->EncodeTexture(tex.Get(), 0, out));
+    CHECK(out.empty());
+    CHECK_EQ(enc->PendingFrames(), 1);
+
+    enc->WaitForPackets(out, 0);
+    CHECK(out.empty());
+
+    int64_t t = TestNowNs();
+    enc->WaitForPackets(out, 10);
+    const int64_t waited = TestNowNs() - t;
+    CHECK(out.empty());
+    CHECK(waited >= 10000000);
+    CHECK(waited < 40000000);
+    CHECK_EQ(enc->PendingFrames(), 1);
+
+    enc->WaitForPackets(out, 1000);
+    const int64_t total = TestNowNs() - t0;
+    CHECK_EQ(out.size(), 1);
+    CHECK(out[0].keyframe);
+    CHECK(total >= 60000000);
+    CHECK(total < 500000000);
+    CHECK_EQ(enc->PendingFrames(), 0);
+
+    // INFINITE по-прежнему ждёт кадр целиком.
+    CHECK(enc->EncodeTexture(tex.Get(), 1, out));
+    enc->WaitForPackets(out, INFINITE);
+    CHECK_EQ(out.size(), 1);
+}
+
+// Кадр, который NVENC не отдал: сообщение в лог и IDR на ближайшем кадре,
+// несмотря на лимит частоты принудительных IDR.
+void TestLockFailure()
+{
+    g_fn = *FakeNvencFunctionList();
+    g_fn.nvEncLockBitstream = FailingLockBitstream;
+    g_failFrame = 5;
+    TestLogClear();
+
+    FakeGpu gpu;
+    auto tex = gpu.NewTexture(kW, kH);
+    auto enc = NewEncoder(gpu, 300, &g_fn);
+
+    std::vector<NvEncPacket> out;
+    std::vector<NvEncPacket> all;
+    const uint32_t frames = 12;
+    for (uint32_t i = 0; i < frames; ++i) {
+        CHECK(enc->EncodeTexture(tex.Get(), i, out));
+        all.insert(all.end(), out.begin(), out.end());
+    }
+    enc->Flush(out);
+    all.insert(all.end(), out.begin(), out.end());
+
+    CHECK_EQ(all.size(), frames - 1);
+    CHECK_EQ(enc->LostFrames(), 1);
+    CHECK_EQ(enc->CompletedFrames(), frames);
+    CHECK(TestLogContains("nvEncLockBitstream failed"));
+    CHECK_EQ(enc->ForcedKeyframes(), 1);
+
+    int64_t recovery = -1;
+    for (const NvEncPacket& p : all) {
+        CHECK(p.ts100ns != g_failFrame);
+        if (p.keyframe && p.ts100ns != 0) {
+            CHECK_EQ(recovery, -1);
+            recovery = p.ts100ns;
+        }
+    }
+    // Ошибка видна не позже, чем через кольцо слотов после потерянного кадра.
+    CHECK(recovery > g_failFrame);
+    CHECK(recovery <= g_failFrame + 4);
+    g_failFrame = ~0u;
+}
+
+// Кадр целиком: отправить и дождаться пакета.
+bool EncodeKey(NvEncoderD3D11Base& enc, ID3D11Texture2D* tex, int64_t ts)
+{
+    std::vector<NvEncPacket> out;
+    CHECK(enc.EncodeTexture(tex, ts, out));
+    if (out.empty())
+        enc.WaitForPackets(out, INFINITE);
+    CHECK_EQ(out.size(), 1);
+    return out[0].keyframe;
+}
+
+// Запросы IDR склеиваются: до первого кадра их покрывает сам первый IDR,
+// внутри окна kMinForcedIdrIntervalNs сколько угодно запросов дают один IDR
+// после окна, а не теряются.
+void TestIdrCoalescing()
+{
+    FakeGpu gpu;
+    auto tex = gpu.NewTexture(kW, kH);
+    auto enc = NewEncoder(gpu, 0, FakeNvencFunctionList());
+
+    int64_t ts = 0;
+    for (int i = 0; i < 3; ++i)
+        enc->RequestKeyframe();
+    CHECK(EncodeKey(*enc, tex.Get(), ts++));
+    CHECK(!EncodeKey(*enc, tex.Get(), ts++));
+    // И после окна лишнего IDR нет.
+    std::this_thread::sleep_for(std::chrono::milliseconds(260));
+    CHECK(!EncodeKey(*enc, tex.Get(), ts++));
+    CHECK_EQ(enc->ForcedKeyframes(), 0);
+
+    // Окно считается от последнего IDR; внутри него IDR откладывается.
+    enc->RequestKeyframe();
+    const int64_t firstNs = TestNowNs();
+    CHECK(EncodeKey(*enc, tex.Get(), ts++));
+    CHECK_EQ(enc->ForcedKeyframes(), 1);
+    for (int i = 0; i < 5; ++i)
+        enc->RequestKeyframe();
+    CHECK(!EncodeKey(*enc, tex.Get(), ts++));
+    CHECK(!EncodeKey(*enc, tex.Get(), ts++));
+    CHECK_EQ(enc->ForcedKeyframes(), 1);
+
+    // После окна: ровно один IDR на все пять запросов.
+    const int64_t windowEndNs = firstNs + 260000000;
+    while (TestNowNs() < windowEndNs)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    CHECK(EncodeKey(*enc, tex.Get(), ts++));
+    for (int i = 0; i < 3; ++i)
+        CHECK(!EncodeKey(*enc, tex.Get(), ts++));
+    CHECK_EQ(enc->ForcedKeyframes(), 2);
+    CHECK_EQ(enc->KeyframeRequests(), 9);
+
+    // Окно снова закрыто: новый запрос ждёт 250 мс от последнего IDR.
+    enc->RequestKeyframe();
+    CHECK(!EncodeKey(*enc, tex.Get(), ts++));
+    std::this_thread::sleep_for(std::chrono::milliseconds(260));
+    CHECK(EncodeKey(*enc, tex.Get(), ts++));
+    CHECK_EQ(enc->ForcedKeyframes(), 3);
+}
+
+} // namespace
+
+int main()
+{
+    TestFiniteWait();
+    TestLockFailure();
+    TestIdrCoalescing();
+    printf("EncoderCollectTest OK\n");
+    return 0;
+}
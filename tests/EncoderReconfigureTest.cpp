@@ -0,0 +1,141 @@
+// Частота кадров до NVENC доходит дробью num/den: при инициализации и при
+// Reconfigure. Таблица FakeNvenc записывает параметры, с которыми её вызвали.
+
+#include "FakeNvenc.h"
+#include "NvencEncoder.h"
+#include "TestSupport.h"
+
+namespace {
+
+const uint32_t kW = 64;
+const uint32_t kH = 64;
+
+// Последние параметры nvEncInitializeEncoder / nvEncReconfigureEncoder.
+struct RecordedParams
+{
+    uint32_t calls = 0;
+    uint32_t frameRateNum = 0;
+    uint32_t frameRateDen = 0;
+    uint32_t gopLength = 0;
+    uint32_t idrPeriod = 0;
+    uint32_t averageBitRate = 0;
+    bool resetEncoder = false;
+    bool forceIDR = false;
+};
+
+NV_ENCODE_API_FUNCTION_LIST g_fn;
+RecordedParams g_init;
+RecordedParams g_reconf;
+bool g_failReconfigure = false;
+
+void Record(RecordedParams& r, const NV_ENC_INITIALIZE_PARAMS& p)
+{
+    ++r.calls;
+    r.frameRateNum = p.frameRateNum;
+    r.frameRateDen = p.frameRateDen;
+    r.gopLength = p.encodeConfig->gopLength;
+    r.idrPeriod = p.encodeConfig->encodeCodecConfig.h264Config.idrPeriod;
+    r.averageBitRate = p.encodeConfig->rcParams.averageBitRate;
+}
+
+NVENCSTATUS NVENCAPI RecordingInitialize(void* encoder, NV_ENC_INITIALIZE_PARAMS* p)
+{
+    Record(g_init, *p);
+    return FakeNvencFunctionList()->nvEncInitializeEncoder(encoder, p);
+}
+
+NVENCSTATUS NVENCAPI RecordingReconfigure(void* encoder, NV_ENC_RECONFIGURE_PARAMS* rp)
+{
+    if (g_failReconfigure)
+        return NV_ENC_ERR_INVALID_PARAM;
+    Record(g_reconf, rp->reInitEncodeParams);
+    g_reconf.resetEncoder = rp->resetEncoder != 0;
+    g_reconf.forceIDR = rp->forceIDR != 0;
+    return FakeNvencFunctionList()->nvEncReconfigureEncoder(encoder, rp);
+}
+
+std::unique_ptr<NvEncoderD3D11Base> NewEncoder(FakeGpu& gpu, uint32_t fpsNum, uint32_t fpsDen)
+{
+    g_fn = *FakeNvencFunctionList();
+    g_fn.nvEncInitializeEncoder = RecordingInitialize;
+    g_fn.nvEncReconfigureEncoder = RecordingReconfigure;
+    g_init = RecordedParams();
+    g_reconf = RecordedParams();
+
+    auto enc = CreateNvEncoder(NVRTSP_CODEC_H264, gpu.dev.Get(), gpu.ctx.Get(),
+                               kW, kH, fpsNum, fpsDen, 2000);
+    CHECK(enc);
+    CHECK(enc->Initialize(&g_fn));
+    return enc;
+}
+
+// 29.97 с самого создания: в NVENC 30000/1001, GOP - около секунды.
+void TestInitFractionalRate()
+{
+    FakeGpu gpu;
+    auto enc = NewEncoder(gpu, 30000, 1001);
+
+    CHECK_EQ(g_init.calls, 1);
+    CHECK_EQ(g_init.frameRateNum, 30000);
+    CHECK_EQ(g_init.frameRateDen, 1001);
+    CHECK_EQ(g_init.gopLength, 30);
+    CHECK_EQ(g_init.idrPeriod, 30);
+    CHECK_EQ(g_init.averageBitRate, 2000000);
+}
+
+// Смена частоты не трогает битрейт и GOP и не сбрасывает энкодер; смена
+// GOP сбрасывает, а частота остаётся дробной.
+void TestReconfigureRate()
+{
+    FakeGpu gpu;
+    auto enc = NewEncoder(gpu, 30, 1);
+
+    CHECK(enc->Reconfigure(0, 60000, 1001, 0));
+    CHECK_EQ(g_reconf.calls, 1);
+    CHECK_EQ(g_reconf.frameRateNum, 60000);
+    CHECK_EQ(g_reconf.frameRateDen, 1001);
+    CHECK_EQ(g_reconf.averageBitRate, 2000000);
+    CHECK_EQ(g_reconf.gopLength, 30);
+    CHECK(!g_reconf.resetEncoder);
+    CHECK(!g_reconf.forceIDR);
+
+    CHECK(enc->Reconfigure(3000, 0, 0, 60));
+    CHECK_EQ(g_reconf.calls, 2);
+    CHECK_EQ(g_reconf.frameRateNum, 60000);
+    CHECK_EQ(g_reconf.frameRateDen, 1001);
+    CHECK_EQ(g_reconf.averageBitRate, 3000000);
+    CHECK_EQ(g_reconf.gopLength, 60);
+    CHECK_EQ(g_reconf.idrPeriod, 60);
+    CHECK(g_reconf.resetEncoder);
+    CHECK(g_reconf.forceIDR);
+}
+
+// Отказ NVENC: текущими остаются прежние параметры, следующий вызов идёт
+// от них.
+void TestFailedReconfigureKeepsParams()
+{
+    FakeGpu gpu;
+    auto enc = NewEncoder(gpu, 25, 1);
+
+    g_failReconfigure = true;
+    CHECK(!enc->Reconfigure(1000, 30000, 1001, 0));
+    g_failReconfigure = false;
+    CHECK_EQ(g_reconf.calls, 0);
+
+    CHECK(enc->Reconfigure(0, 0, 0, 50));
+    CHECK_EQ(g_reconf.frameRateNum, 25);
+    CHECK_EQ(g_reconf.frameRateDen, 1);
+    CHECK_EQ(g_reconf.averageBitRate, 2000000);
+    CHECK_EQ(g_reconf.gopLength, 50);
+}
+
+} // namespace
+
+int main()
+{
+    TestInitFractionalRate();
+    TestReconfigureRate();
+    TestFailedReconfigureKeepsParams();
+    printf("EncoderReconfigureTest OK\n");
+    return 0;
+}
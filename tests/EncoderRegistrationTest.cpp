@@ -0,0 +1,204 @@
+// Кэш регистраций текстур NVENC (EncodeTextureNoCopy): не больше kMaxTexRegs
+// живых регистраций при смене многих текстур, снятие простаивающих через
+// kTexRegIdleFrames кадров, новые регистрации при смене формата или размера
+// входа и ни одной регистрации после уничтожения энкодера.
+// Живые регистрации считает сам FakeNvenc, а не энкодер.
+
+#include "FakeNvenc.h"
+#include "NvencEncoder.h"
+#include "TestSupport.h"
+
+namespace {
+
+const uint32_t kW = 64;
+const uint32_t kH = 64;
+const uint32_t kMaxRegs = 16;       // NvEncoderD3D11Base::kMaxTexRegs
+const uint32_t kIdleFrames = 300;   // NvEncoderD3D11Base::kTexRegIdleFrames
+
+std::unique_ptr<NvEncoderD3D11Base> NewEncoder(FakeGpu& gpu)
+{
+    FakeNvencConfig cfg;
+    cfg.encodeDelayUs = 0;
+    FakeNvencSetConfig(cfg);
+    auto enc = CreateNvEncoder(NVRTSP_CODEC_H264, gpu.dev.Get(), gpu.ctx.Get(), kW, kH, 30, 1, 2000);
+    CHECK(enc);
+    CHECK(enc->Initialize(FakeNvencFunctionList()));
+    return enc;
+}
+
+void Encode(NvEncoderD3D11Base& enc, ID3D11Texture2D* tex, int64_t ts)
+{
+    std::vector<NvEncPacket> out;
+    uint64_t idx = 0;
+    CHECK(enc.EncodeTextureNoCopy(tex, ts, out, &idx));
+}
+
+uint64_t LiveRegs()
+{
+    return FakeNvencResources().live;
+}
+
+// 40 текстур по кругу: кэш вытесняет самые старые, живых регистраций
+// в NVENC никогда не больше kMaxTexRegs.
+void TestBoundedCache()
+{
+    const uint64_t base = LiveRegs();
+    FakeGpu gpu;
+    auto enc = NewEncoder(gpu);
+
+    std::vector<Microsoft::WRL::ComPtr<ID3D11Texture2D>> texs;
+    for (int i = 0; i < 40; ++i)
+        texs.push_back(gpu.NewTexture(kW, kH));
+
+    int64_t ts = 0;
+    for (int round = 0; round < 3; ++round) {
+        for (auto& t : texs) {
+            Encode(*enc, t.Get(), ts++);
+            CHECK(enc->RegisteredTextures() <= kMaxRegs);
+            CHECK(LiveRegs() - base <= kMaxRegs);
+            CHECK_EQ(LiveRegs() - base, enc->RegisteredTextures());
+        }
+    }
+    CHECK_EQ(enc->RegisteredTextures(), kMaxRegs);
+    CHECK(enc->EvictedRegistrations() >= 120 - kMaxRegs);
+
+    enc.reset();
+    CHECK_EQ(LiveRegs(), base);
+}
+
+// Текстура, которую перестали подавать, снимается после kTexRegIdleFrames
+// кадров без неё; текстура в работе остаётся.
+void TestIdleEviction()
+{
+    const uint64_t base = LiveRegs();
+    TestLogClear();
+    FakeGpu gpu;
+    auto enc = NewEncoder(gpu);
+    auto idle = gpu.NewTexture(kW, kH);
+    auto live = gpu.NewTexture(kW, kH);
+
+    int64_t ts = 0;
+    Encode(*enc, idle.Get(), ts++);
+    Encode(*enc, live.Get(), ts++);
+    CHECK_EQ(LiveRegs() - base, 2);
+
+    // Раньше срока ничего не снимается.
+    while (ts < kIdleFrames)
+        Encode(*enc, live.Get(), ts++);
+    CHECK_EQ(LiveRegs() - base, 2);
+    CHECK_EQ(enc->EvictedRegistrations(), 0);
+
+    // Проверка простоя раз в kTexRegIdleFrames кадров: к 2 * kIdleFrames
+    // простаивающая точно снята.
+    while (ts < 2 * kIdleFrames + 2)
+        Encode(*enc, live.Get(), ts++);
+    CHECK_EQ(LiveRegs() - base, 1);
+    CHECK_EQ(enc->RegisteredTextures(), 1);
+    CHECK_EQ(enc->EvictedRegistrations(), 1);
+    CHECK(TestLogContains("unregistered 1 idle textures"));
+
+    // Снятую текстуру можно подать снова - она регистрируется заново.
+    const uint64_t before = FakeNvencResources().registered;
+    Encode(*enc, idle.Get(), ts++);
+    CHECK_EQ(FakeNvencResources().registered, before + 1);
+    CHECK_EQ(LiveRegs() - base, 2);
+
+    enc.reset();
+    CHECK_EQ(LiveRegs(), base);
+}
+
+unsigned long RefCount(ID3D11Texture2D* tex)
+{
+    tex->AddRef();
+    return tex->Release();
+}
+
+// Unity пересоздала RenderTexture в другом формате: новая текстура получает
+// свою регистрацию, старая держится кэшем (и её адрес не достаётся новой)
+// до снятия по простою, после чего кэш отпускает и ссылку на неё.
+void TestNewFormatTexture()
+{
+    const uint64_t base = LiveRegs();
+    FakeGpu gpu;
+    auto enc = NewEncoder(gpu);
+    auto bgra = gpu.NewTexture(kW, kH, DXGI_FORMAT_B8G8R8A8_UNORM);
+    auto rgba = gpu.NewTexture(kW, kH, DXGI_FORMAT_R8G8B8A8_UNORM);
+
+    int64_t ts = 0;
+    Encode(*enc, bgra.Get(), ts++);
+    CHECK_EQ(RefCount(bgra.Get()), 2);
+    const uint64_t regs = FakeNvencResources().registered;
+    Encode(*enc, rgba.Get(), ts++);
+    CHECK_EQ(FakeNvencResources().registered, regs + 1);
+    CHECK_EQ(LiveRegs() - base, 2);
+
+    // Повторная подача той же текстуры регистрацию не трогает.
+    for (int i = 0; i < 10; ++i)
+        Encode(*enc, rgba.Get(), ts++);
+    CHECK_EQ(FakeNvencResources().registered, regs + 1);
+
+    while (ts < 2 * kIdleFrames + 2)
+        Encode(*enc, rgba.Get(), ts++);
+    CHECK_EQ(LiveRegs() - base, 1);
+    CHECK_EQ(RefCount(bgra.Get()), 1);
+
+    // Кадр уже в NV12 на месте RGB - тоже своя регистрация с форматом NV12.
+    auto nv12 = gpu.NewTexture(kW, kH, DXGI_FORMAT_NV12);
+    Encode(*enc, nv12.Get(), ts++);
+    CHECK_EQ(FakeNvencResources().registered, regs + 2);
+    CHECK_EQ(LiveRegs() - base, 2);
+
+    enc.reset();
+    CHECK_EQ(LiveRegs(), base);
+    CHECK_EQ(RefCount(rgba.Get()), 1);
+    CHECK_EQ(RefCount(nv12.Get()), 1);
+}
+
+// Копирующий путь: слоты энкодера пересоздаются под другой формат входа
+// (и под проход NV12) - их старые регистрации снимаются сразу, живых
+// столько же, сколько слотов.
+void TestSlotRecreated()
+{
+    const uint64_t base = LiveRegs();
+    FakeGpu gpu;
+    auto enc = NewEncoder(gpu);
+    auto bgra = gpu.NewTexture(kW, kH, DXGI_FORMAT_B8G8R8A8_UNORM);
+    auto rgba = gpu.NewTexture(kW, kH, DXGI_FORMAT_R8G8B8A8_UNORM);
+
+    std::vector<NvEncPacket> out;
+    int64_t ts = 0;
+    for (int i = 0; i < 8; ++i)
+        CHECK(enc->EncodeTexture(bgra.Get(), ts++, out));
+    const uint64_t slots = LiveRegs() - base;
+    CHECK(slots > 0);
+    CHECK(slots <= kMaxRegs);
+
+    uint64_t regs = FakeNvencResources().registered;
+    for (int i = 0; i < 8; ++i)
+        CHECK(enc->EncodeTexture(rgba.Get(), ts++, out));
+    CHECK_EQ(FakeNvencResources().registered, regs + slots);
+    CHECK_EQ(LiveRegs() - base, slots);
+    CHECK_EQ(enc->RegisteredTextures(), slots);
+
+    CHECK(enc->SetColorConversion(NVRTSP_COLOR_NV12_LIMITED));
+    regs = FakeNvencResources().registered;
+    for (int i = 0; i < 8; ++i)
+        CHECK(enc->EncodeTexture(rgba.Get(), ts++, out));
+    CHECK_EQ(FakeNvencResources().registered, regs + slots);
+    CHECK_EQ(LiveRegs() - base, slots);
+
+    enc.reset();
+    CHECK_EQ(LiveRegs(), base);
+}
+
+} // namespace
+
+int main()
+{
+    TestBoundedCache();
+    TestIdleEviction();
+    TestNewFormatTexture();
+    TestSlotRecreated();
+    printf("EncoderRegistrationTest OK\n");
+    return 0;
+}
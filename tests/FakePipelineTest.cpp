@@ -0,0 +1,197 @@
+// Энкодер на FakeNvenc/FakeD3D11 -> индекс NAL/OBU -> RTP-пакетизатор ->
+// приёмник: кадры проходят весь путь и собираются обратно без потерь.
+// Перезапуск стрима (NVRTSP_Stop/Start): новый энкодер с прежними частотой
+// и настройками, кольцо захвата работает с ним с нуля.
+
+#include "FakeNvenc.h"
+#include "FrameCaptureRing.h"
+#include "NvencEncoder.h"
+#include "RtpPacketizer.h"
+#include "TestRtp.h"
+#include "TestSupport.h"
+
+namespace {
+
+const uint32_t kW = 320;
+const uint32_t kH = 240;
+const uint32_t kFps = 30;
+const uint32_t kFrames = 45;
+
+NalCodec ToNalCodec(NvrtspCodec codec)
+{
+    switch (codec) {
+    case NVRTSP_CODEC_H265: return NalCodec::H265;
+    case NVRTSP_CODEC_AV1:  return NalCodec::AV1;
+    default:                return NalCodec::H264;
+    }
+}
+
+void RunCodec(NvrtspCodec codec, size_t mtu)
+{
+    FakeGpu gpu;
+    auto tex = gpu.NewTexture(kW, kH);
+
+    auto enc = CreateNvEncoder(codec, gpu.dev.Get(), gpu.ctx.Get(), kW, kH, kFps, 1, 4000);
+    CHECK(enc);
+    CHECK(enc->Initialize(FakeNvencFunctionList()));
+
+    const NalCodec nc = ToNalCodec(codec);
+    RtpPacketizer packetizer(nc, 96, 0x1234, 100, mtu);
+    RtpDepacketizer rx(nc);
+    RtpPacketBatch batch;
+
+    std::vector<NvEncPacket> packets;
+    std::vector<NvEncPacket> all;
+    for (uint32_t i = 0; i < kFrames; ++i) {
+        FillPattern(tex.Get(), i);
+        CHECK(enc->EncodeTexture(tex.Get(), (int64_t)i * 333333, packets));
+        all.insert(all.end(), packets.begin(), packets.end());
+    }
+    enc->Flush(packets);
+    all.insert(all.end(), packets.begin(), packets.end());
+    CHECK_EQ(all.size(), kFrames);
+    CHECK_EQ(enc->PendingFrames(), 0);
+    CHECK(!enc->GetParameterSets().empty());
+
+    uint16_t seq = 100;
+    for (size_t i = 0; i < all.size(); ++i) {
+        const NvEncPacket& p = all[i];
+        CHECK_EQ(p.ts100ns, (int64_t)i * 333333);
+        // IDR по GOP (длина GOP - частота кадров).
+        CHECK_EQ(p.keyframe, i % kFps == 0);
+        CHECK(!p.data.nals().empty());
+
+        const uint32_t rtpTs = (uint32_t)(p.ts100ns * 9 / 1000);
+        packetizer.Packetize(p.data.data(), p.data.nals(), rtpTs, p.keyframe, batch);
+        CHECK_EQ(batch.firstSeq, seq);
+        CHECK_EQ(batch.packets.size(), packetizer.CountPackets(p.data.data(), p.data.nals()));
+        seq = (uint16_t)(seq + batch.packets.size());
+
+        for (const std::vector<uint8_t>& pkt : BatchPackets(batch)) {
+            CHECK(pkt.size() <= mtu);
+            CHECK(rx.Push(pkt.data(), pkt.size()));
+        }
+        CHECK(rx.FrameDone());
+        CHECK_EQ(rx.FrameTs(), rtpTs);
+        CHECK(rx.Units() == ExpectedUnits(p.data.data(), p.data.nals(), nc));
+    }
+}
+
+// Шаг стрима с захватом на render thread, как в плагине: кадр из кольца
+// без копии в NVENC, слот свободен, когда NVENC его отдал. false - кадра нет.
+bool StepCaptured(FrameCaptureRing& ring, NvEncoderD3D11Base& enc, std::vector<NvEncPacket>& all)
+{
+    std::vector<NvEncPacket> out;
+    if (enc.PendingFrames()) {
+        enc.WaitForPackets(out, INFINITE);
+        all.insert(all.end(), out.begin(), out.end());
+    }
+    CapturedFrame f;
+    if (!ring.AcquireLatest(f, std::chrono::milliseconds(0)))
+        return false;
+    uint64_t idx = 0;
+    CHECK(enc.EncodeTextureNoCopy(f.tex, f.ts100ns, out, &idx));
+    ring.MarkSubmitted(f.slot, idx);
+    all.insert(all.end(), out.begin(), out.end());
+    ring.SetCompletedFrames(enc.CompletedFrames());
+    return true;
+}
+
+std::unique_ptr<NvEncoderD3D11Base> NewEncoder(FakeGpu& gpu, uint32_t fpsNum, uint32_t fpsDen)
+{
+    auto enc = CreateNvEncoder(NVRTSP_CODEC_H264, gpu.dev.Get(), gpu.ctx.Get(), kW, kH,
+                               fpsNum, fpsDen, 4000);
+    CHECK(enc);
+    CHECK(enc->Initialize(FakeNvencFunctionList()));
+    return enc;
+}
+
+// Start -> Stop -> Start: энкодер закрыт на остановке (кадры в слотах
+// кольца ещё числятся за ним), новый создаётся с 30000/1001 и прежними
+// настройками. После Reset кольца кадры идут во все слоты, поток нового
+// энкодера начинается с IDR.
+void TestRestart()
+{
+    FakeGpu gpu;
+    auto src = gpu.NewTexture(kW, kH);
+    const int64_t period = 333667;   // 30000/1001 в 100 нс
+
+    FrameCaptureRing ring(gpu.dev.Get(), 4, 30);
+    ring.SetFrameRate(30000, 1001);
+    CaptureFormat fmt;
+    fmt.nv12 = true;
+    ring.SetFormat(fmt);
+
+    auto enc = NewEncoder(gpu, 30000, 1001);
+    CHECK(enc->SetColorConversion(NVRTSP_COLOR_NV12_LIMITED));
+    CHECK(enc->Reconfigure(0, 0, 0, 15));
+    enc->SetScaleFilter(NVRTSP_SCALE_LANCZOS);
+
+    std::vector<NvEncPacket> all;
+    int64_t ts = 0;
+    for (int i = 0; i < 20; ++i) {
+        CHECK(ring.Capture(gpu.ctx.Get(), src.Get(), ts));
+        ts += period;
+        CHECK(StepCaptured(ring, *enc, all));
+    }
+    // Остановка посреди работы: кадр в NVENC и готовый кадр в кольце.
+    CHECK(ring.Capture(gpu.ctx.Get(), src.Get(), ts));
+    ts += period;
+    CHECK(StepCaptured(ring, *enc, all));
+    CHECK(ring.Capture(gpu.ctx.Get(), src.Get(), ts));
+    ts += period;
+    std::vector<NvEncPacket> tail;
+    enc->Flush(tail);
+    const NvEncSettings kept = enc->Settings();
+    CHECK_EQ(kept.color, NVRTSP_COLOR_NV12_LIMITED);
+    CHECK_EQ(kept.gopLength, 15);
+    CHECK_EQ(kept.scaleFilter, NVRTSP_SCALE_LANCZOS);
+    enc.reset();
+
+    // Start: новый энкодер, настройки возвращаются до первого кадра.
+    enc = NewEncoder(gpu, 30000, 1001);
+    CHECK(enc->ApplySettings(kept));
+    CHECK_EQ(enc->ColorConversion(), NVRTSP_COLOR_NV12_LIMITED);
+    CHECK_EQ(enc->GopLength(), 15);
+    CHECK_EQ(enc->Settings().scaleFilter, NVRTSP_SCALE_LANCZOS);
+    ring.Reset();
+    CHECK(!ring.Active());
+
+    // Кадр, готовый до остановки, не всплывает после старта.
+    CapturedFrame stale;
+    CHECK(!ring.AcquireLatest(stale, std::chrono::milliseconds(0)));
+
+    all.clear();
+    const int64_t restartTs = ts + 10 * period;
+    ts = restartTs;
+    for (int i = 0; i < 40; ++i) {
+        CHECK(ring.Capture(gpu.ctx.Get(), src.Get(), ts));
+        ts += period;
+        CHECK(StepCaptured(ring, *enc, all));
+    }
+    enc->Flush(tail);
+    all.insert(all.end(), tail.begin(), tail.end());
+    CHECK_EQ(all.size(), 40);
+    CHECK_EQ(ring.DroppedFrames(), 0);
+    for (size_t i = 0; i < all.size(); ++i) {
+        CHECK_EQ(all[i].ts100ns, restartTs + (int64_t)i * period);
+        CHECK_EQ(all[i].keyframe, i % 15 == 0);
+    }
+}
+
+} // namespace
+
+int main()
+{
+    FakeNvencConfig cfg;
+    cfg.encodeDelayUs = 200;
+    FakeNvencSetConfig(cfg);
+
+    for (NvrtspCodec codec : { NVRTSP_CODEC_H264, NVRTSP_CODEC_H265, NVRTSP_CODEC_AV1 }) {
+        RunCodec(codec, RtpPacketizer::kRtpDefaultMtu);
+        RunCodec(codec, RtpPacketizer::kRtpMinMtu);
+    }
+    TestRestart();
+    printf("FakePipelineTest OK\n");
+    return 0;
+}
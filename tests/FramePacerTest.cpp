@@ -0,0 +1,156 @@
+// FramePacer на ручных часах: больше часа 29.97 fps без дрейфа, опоздания и
+// пропуски тиков, смена частоты посреди потока - без реального ожидания.
+
+#include "FramePacer.h"
+#include "TestSupport.h"
+
+namespace {
+
+const int64_t kNsPerSec = 1000000000LL;
+
+// Часы, которые двигает только тест; сон доходит ровно до срока плюс
+// oversleepNs.
+class ManualClock : public PacerClock
+{
+public:
+    int64_t NowNs() override { return m_now; }
+    void SleepUntilNs(int64_t deadlineNs) override
+    {
+        if (deadlineNs > m_now)
+            m_now = deadlineNs;
+        m_now += oversleepNs;
+    }
+    void Advance(int64_t ns) { m_now += ns; }
+
+    int64_t oversleepNs = 0;
+
+private:
+    int64_t m_now = 1000 * kNsPerSec;
+};
+
+// Срок n-го тика при частоте num/den от эпохи: точное значение с округлением вниз.
+int64_t ExactDueNs(int64_t epochNs, uint64_t n, uint32_t num, uint32_t den)
+{
+    return epochNs + (int64_t)(n * den * (uint64_t)kNsPerSec / num);
+}
+
+// Больше часа 30000/1001: каждый срок совпадает с точным до наносекунды,
+// итог - ровно 120000 кадров за 4004 с (целые 30 fps ушли бы на 4 с вперёд).
+void TestNoDriftNtsc()
+{
+    ManualClock clock;
+    FramePacer pacer(30000, 1001, PacerPolicy::Skip, &clock);
+    pacer.Reset();
+    const int64_t epoch = clock.NowNs();
+
+    const uint64_t frames = 120000;
+    for (uint64_t i = 0; i < frames; ++i) {
+        PacerTick t = pacer.WaitNext();
+        CHECK_EQ(t.frame, i);
+        CHECK_EQ(t.dueNs, ExactDueNs(epoch, i, 30000, 1001));
+        CHECK_EQ(t.lateNs, 0);
+        CHECK_EQ(t.skipped, 0);
+    }
+    CHECK_EQ(pacer.NextDueNs() - epoch, 4004 * kNsPerSec);
+
+    PacerStats st = pacer.Stats();
+    CHECK_EQ(st.ticks, frames);
+    CHECK_EQ(st.skipped, 0);
+    CHECK_EQ(st.lateMaxNs, 0);
+    CHECK_EQ(st.jitterMaxNs, 0);
+}
+
+// Поток просыпается на 1 мс позже: опоздание и дрожание видны в статистике,
+// но сроки не сдвигаются - следующий тик снова по сетке.
+void TestOversleepDoesNotDrift()
+{
+    ManualClock clock;
+    clock.oversleepNs = 1000000;
+    FramePacer pacer(60, 1, PacerPolicy::Skip, &clock);
+    pacer.Reset();
+    const int64_t epoch = clock.NowNs();
+
+    for (uint64_t i = 0; i < 600; ++i) {
+        PacerTick t = pacer.WaitNext();
+        CHECK_EQ(t.dueNs, ExactDueNs(epoch, i, 60, 1));
+        CHECK_EQ(t.lateNs, i ? 1000000 : 0);
+    }
+    PacerStats st = pacer.Stats();
+    CHECK_EQ(st.lateMaxNs, 1000000);
+    // Первый интервал длиннее на 1 мс, дальше ровно по периоду.
+    CHECK_EQ(st.jitterMaxNs, 1000000);
+    CHECK(st.jitterAvgNs < 10000);
+}
+
+// Зависание на 5.5 периода после тика 9: Skip перескакивает на последний
+// прошедший срок (тик 14), тики 10..13 пропущены; дрожание - относительно
+// пропущенных сроков.
+void TestSkipAfterStall()
+{
+    ManualClock clock;
+    FramePacer pacer(30000, 1001, PacerPolicy::Skip, &clock);
+    pacer.Reset();
+    const int64_t epoch = clock.NowNs();
+    const int64_t period = pacer.NominalPeriodNs();
+
+    for (int i = 0; i < 10; ++i)
+        pacer.WaitNext();
+    clock.Advance(5 * period + period / 2);
+
+    PacerTick t = pacer.WaitNext();
+    CHECK_EQ(t.skipped, 4);
+    CHECK_EQ(t.frame, 14);
+    CHECK_EQ(t.dueNs, ExactDueNs(epoch, 14, 30000, 1001));
+    CHECK(t.lateNs > 0 && t.lateNs < period);
+
+    t = pacer.WaitNext();
+    CHECK_EQ(t.frame, 15);
+    CHECK_EQ(t.lateNs, 0);
+
+    PacerStats st = pacer.Stats();
+    CHECK_EQ(st.skipped, 4);
+    CHECK(st.jitterMaxNs < period);
+}
+
+// Смена частоты: следующий тик - через новый период от последнего, новая
+// сетка тоже без дрейфа; интервал на стыке не считается дрожанием.
+void TestSetRateKeepsGrid()
+{
+    ManualClock clock;
+    FramePacer pacer(30, 1, PacerPolicy::Skip, &clock);
+    pacer.Reset();
+
+    PacerTick last;
+    for (int i = 0; i < 30; ++i)
+        last = pacer.WaitNext();
+
+    pacer.SetRate(60000, 1001);
+    pacer.SetRate(60000, 1001);     // повторный вызов не двигает эпоху
+    for (uint64_t i = 1; i <= 60060; ++i) {
+        PacerTick t = pacer.WaitNext();
+        CHECK_EQ(t.dueNs, ExactDueNs(last.dueNs, i, 60000, 1001));
+        CHECK_EQ(t.lateNs, 0);
+    }
+    CHECK_EQ(pacer.NextDueNs(), ExactDueNs(last.dueNs, 60061, 60000, 1001));
+
+    // Зависание сразу после смены частоты: прошлый тик - эпоха новой сетки.
+    pacer.SetRate(25, 1);
+    clock.Advance(3 * kNsPerSec / 25);
+    PacerTick t = pacer.WaitNext();
+    CHECK_EQ(t.skipped, 2);
+
+    PacerStats st = pacer.Stats();
+    CHECK(st.jitterMaxNs < kNsPerSec / 25);
+}
+
+} // namespace
+
+int main()
+{
+    TestNoDriftNtsc();
+    TestOversleepDoesNotDrift();
+    TestSkipAfterStall();
+    TestSetRateKeepsGrid();
+    printf("FramePacerTest OK\n");
+    return 0;
+}
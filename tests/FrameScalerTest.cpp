@@ -0,0 +1,376 @@
+// CPU-эталон масштабирования (ScaleRgba) бит в бит: таблицы весов, расчёт в
+// плавающей точке по тем же ядрам, постоянный кадр и копия 1:1 без
+// изменений, целочисленный цикл шейдера FrameScaler против эталона и
+// FrameScaler на фейковых текстурах. Масштаб NV12 -> NV12 по плоскостям
+// совпадает с RGBA-эталоном над теми же значениями.
+
+#include <algorithm>
+#include <cmath>
+
+#include "FrameScaler.h"
+#include "Resize.h"
+#include "TestSupport.h"
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+struct Size
+{
+    uint32_t sw, sh, dw, dh;
+};
+
+// Уменьшение 1080p -> 540p в миниатюре, нецелые шаги, увеличение и сильное
+// уменьшение (ядро упирается в предел отсчётов).
+const Size kSizes[] = {
+    { 64, 36, 32, 18 },
+    { 48, 27, 32, 18 },
+    { 30, 20, 45, 31 },
+    { 41, 23, 41, 23 },
+    { 400, 8, 10, 4 },
+};
+
+std::vector<uint8_t> Pattern(uint32_t w, uint32_t h, uint32_t seed)
+{
+    std::vector<uint8_t> px((size_t)w * h * 4);
+    for (uint32_t y = 0; y < h; ++y) {
+        for (uint32_t x = 0; x < w; ++x) {
+            uint8_t* p = &px[((size_t)y * w + x) * 4];
+            uint32_t hsh = (x * 73856093u) ^ (y * 19349663u) ^ (seed * 83492791u);
+            p[0] = (uint8_t)(x * 255 / (w - 1));
+            p[1] = (uint8_t)(y * 255 / (h - 1));
+            p[2] = (uint8_t)(hsh >> 24);
+            p[3] = (uint8_t)(x % 7 == 0 ? 0 : 255);
+        }
+    }
+    return px;
+}
+
+std::vector<uint8_t> Scale(const std::vector<uint8_t>& src, bool bgra, const Size& s,
+                           ScaleFilter filter)
+{
+    std::vector<uint8_t> dst((size_t)s.dw * s.dh * 4);
+    ScaleRgba(src.data(), s.sw * 4, bgra, s.sw, s.sh, dst.data(), s.dw * 4, s.dw, s.dh, filter);
+    return dst;
+}
+
+// Ядра по определению, без таблиц Resize.cpp.
+double KernelAt(ScaleFilter filter, double x)
+{
+    x = std::fabs(x);
+    if (filter == ScaleFilter::Bilinear)
+        return std::max(0.0, 1.0 - x);
+    if (x == 0.0)
+        return 1.0;
+    if (x >= 3.0)
+        return 0.0;
+    return std::sin(kPi * x) / (kPi * x) * std::sin(kPi * x / 3.0) / (kPi * x / 3.0);
+}
+
+// Веса одной оси в double: центр точки приёмника в координатах источника,
+// ядро растянуто на шаг при уменьшении (не больше 24 отсчётов).
+std::vector<std::vector<std::pair<int, double>>> FloatWeights(uint32_t src, uint32_t dst,
+                                                              ScaleFilter filter)
+{
+    const double scale = (double)src / dst;
+    const double radius = filter == ScaleFilter::Lanczos ? 3.0 : 1.0;
+    const double stretch = std::min(std::max(scale, 1.0), 24.0 / (2.0 * radius));
+
+    std::vector<std::vector<std::pair<int, double>>> out(dst);
+    for (uint32_t i = 0; i < dst; ++i) {
+        const double center = (i + 0.5) * scale - 0.5;
+        double sum = 0.0;
+        for (int j = (int)std::floor(center - radius * stretch);
+             j <= (int)std::ceil(center + radius * stretch); ++j) {
+            const double w = KernelAt(filter, (j - center) / stretch);
+            if (w != 0.0) {
+                out[i].push_back({ std::min(std::max(j, 0), (int)src - 1), w });
+                sum += w;
+            }
+        }
+        for (auto& tap : out[i])
+            tap.second /= sum;
+    }
+    return out;
+}
+
+// Сумма весов каждой точки - ровно 1 << 14; число отсчётов - по ядру и шагу.
+void TestTapTables()
+{
+    for (ScaleFilter filter : { ScaleFilter::Bilinear, ScaleFilter::Lanczos }) {
+        for (const Size& s : kSizes) {
+            const ScaleTaps t = BuildScaleTaps(s.sw, s.dw, filter);
+            CHECK_EQ(t.table.size(), (size_t)s.dw * (t.taps + 1));
+            for (uint32_t i = 0; i < s.dw; ++i) {
+                int32_t sum = 0;
+                for (uint32_t k = 0; k < t.taps; ++k)
+                    sum += t.table[(size_t)i * (t.taps + 1) + 1 + k];
+                CHECK_EQ(sum, 1 << 14);
+            }
+        }
+    }
+    CHECK_EQ(BuildScaleTaps(30, 45, ScaleFilter::Bilinear).taps, 2);
+    CHECK_EQ(BuildScaleTaps(64, 32, ScaleFilter::Bilinear).taps, 4);
+    CHECK_EQ(BuildScaleTaps(30, 45, ScaleFilter::Lanczos).taps, 6);
+    CHECK_EQ(BuildScaleTaps(64, 32, ScaleFilter::Lanczos).taps, 12);
+    CHECK_EQ(BuildScaleTaps(400, 10, ScaleFilter::Bilinear).taps, 24);
+    CHECK_EQ(BuildScaleTaps(400, 10, ScaleFilter::Lanczos).taps, 24);
+    CHECK(BuildScaleTaps(0, 10, ScaleFilter::Bilinear).table.empty());
+}
+
+// Эталон в целых отходит от расчёта в double не больше чем на единицу.
+void TestAgainstFloat()
+{
+    for (ScaleFilter filter : { ScaleFilter::Bilinear, ScaleFilter::Lanczos }) {
+        int maxErr = 0;
+        for (const Size& s : kSizes) {
+            const std::vector<uint8_t> src = Pattern(s.sw, s.sh, 3);
+            const std::vector<uint8_t> dst = Scale(src, false, s, filter);
+            const auto wx = FloatWeights(s.sw, s.dw, filter);
+            const auto wy = FloatWeights(s.sh, s.dh, filter);
+
+            for (uint32_t y = 0; y < s.dh; ++y) {
+                for (uint32_t x = 0; x < s.dw; ++x) {
+                    for (int c = 0; c < 4; ++c) {
+                        double v = 0.0;
+                        for (const auto& ty : wy[y])
+                            for (const auto& tx : wx[x])
+                                v += ty.second * tx.second *
+                                     src[((size_t)ty.first * s.sw + tx.first) * 4 + c];
+                        const int expected = (int)std::lround(std::min(std::max(v, 0.0), 255.0));
+                        const int got = dst[((size_t)y * s.dw + x) * 4 + c];
+                        maxErr = std::max(maxErr, std::abs(got - expected));
+                    }
+                }
+            }
+        }
+        printf("  %s: max deviation from double %d\n",
+               filter == ScaleFilter::Lanczos ? "lanczos" : "bilinear", maxErr);
+        CHECK(maxErr <= 1);
+    }
+}
+
+// Постоянный кадр остаётся постоянным (и у Lanczos с отрицательными
+// лепестками), 1:1 - точная копия, BGRA приходит в порядке RGBA.
+void TestExactCases()
+{
+    for (ScaleFilter filter : { ScaleFilter::Bilinear, ScaleFilter::Lanczos }) {
+        for (const Size& s : kSizes) {
+            std::vector<uint8_t> flat((size_t)s.sw * s.sh * 4);
+            for (size_t i = 0; i < flat.size(); i += 4) {
+                flat[i] = 200;
+                flat[i + 1] = 17;
+                flat[i + 2] = 255;
+                flat[i + 3] = 0;
+            }
+            const std::vector<uint8_t> dst = Scale(flat, false, s, filter);
+            for (size_t i = 0; i < dst.size(); i += 4) {
+                CHECK_EQ(dst[i], 200);
+                CHECK_EQ(dst[i + 1], 17);
+                CHECK_EQ(dst[i + 2], 255);
+                CHECK_EQ(dst[i + 3], 0);
+            }
+        }
+
+        const Size same = { 41, 23, 41, 23 };
+        const std::vector<uint8_t> src = Pattern(same.sw, same.sh, 5);
+        CHECK(Scale(src, false, same, filter) == src);
+
+        const std::vector<uint8_t> swapped = Scale(src, true, same, filter);
+        for (size_t i = 0; i < src.size(); i += 4) {
+            CHECK_EQ(swapped[i], src[i + 2]);
+            CHECK_EQ(swapped[i + 2], src[i]);
+        }
+    }
+}
+
+// Цикл шейдера FrameScaler в C++ один в один: строка отсчётов считается на
+// лету для каждой точки, округление строки до 7 бит, затем столбец.
+std::vector<uint8_t> ShaderLoop(const std::vector<uint8_t>& src, const Size& s,
+                                ScaleFilter filter)
+{
+    const ScaleTaps hx = BuildScaleTaps(s.sw, s.dw, filter);
+    const ScaleTaps hy = BuildScaleTaps(s.sh, s.dh, filter);
+    std::vector<uint8_t> dst((size_t)s.dw * s.dh * 4);
+
+    for (uint32_t y = 0; y < s.dh; ++y) {
+        for (uint32_t x = 0; x < s.dw; ++x) {
+            const int32_t* tx = &hx.table[(size_t)x * (hx.taps + 1)];
+            const int32_t* ty = &hy.table[(size_t)y * (hy.taps + 1)];
+            for (int c = 0; c < 4; ++c) {
+                int32_t acc = 0;
+                for (uint32_t ky = 0; ky < hy.taps; ++ky) {
+                    const int32_t py = std::min(std::max(ty[0] + (int32_t)ky, 0), (int32_t)s.sh - 1);
+                    int32_t row = 0;
+                    for (uint32_t kx = 0; kx < hx.taps; ++kx) {
+                        const int32_t px = std::min(std::max(tx[0] + (int32_t)kx, 0), (int32_t)s.sw - 1);
+                        row += tx[1 + kx] * src[((size_t)py * s.sw + px) * 4 + c];
+                    }
+                    acc += ty[1 + ky] * ((row + 64) >> 7);
+                }
+                const int32_t v = (acc + (1 << 20)) >> 21;
+                dst[((size_t)y * s.dw + x) * 4 + c] = (uint8_t)std::min(std::max(v, 0), 255);
+            }
+        }
+    }
+    return dst;
+}
+
+void TestShaderLoopMatches()
+{
+    for (ScaleFilter filter : { ScaleFilter::Bilinear, ScaleFilter::Lanczos }) {
+        for (const Size& s : kSizes) {
+            const std::vector<uint8_t> src = Pattern(s.sw, s.sh, 9);
+            CHECK(ShaderLoop(src, s, filter) == Scale(src, false, s, filter));
+        }
+    }
+}
+
+// FrameScaler на фейковом устройстве отдаёт RGBA-текстуру, равную эталону.
+void TestFrameScalerMatches()
+{
+    FakeGpu gpu;
+    FrameScaler scaler(gpu.dev.Get(), gpu.ctx.Get());
+    CHECK(scaler.Initialize());
+
+    const Size s = { 64, 36, 32, 18 };
+    auto src = gpu.NewTexture(s.sw, s.sh);
+    FillPattern(src.Get(), 11);
+    std::vector<uint8_t> packed((size_t)s.sw * s.sh * 4);
+    for (uint32_t y = 0; y < s.sh; ++y)
+        memcpy(&packed[(size_t)y * s.sw * 4], src->Data() + (size_t)y * src->RowPitch(), s.sw * 4);
+
+    for (ScaleFilter filter : { ScaleFilter::Bilinear, ScaleFilter::Lanczos }) {
+        ID3D11Texture2D* out = scaler.Scale(src.Get(), s.dw, s.dh, filter);
+        CHECK(out);
+        D3D11_TEXTURE2D_DESC d;
+        out->GetDesc(&d);
+        CHECK_EQ(d.Width, s.dw);
+        CHECK_EQ(d.Height, s.dh);
+        CHECK_EQ(d.Format, DXGI_FORMAT_R8G8B8A8_UNORM);
+
+        const std::vector<uint8_t> expected = Scale(packed, true, s, filter);
+        for (uint32_t y = 0; y < s.dh; ++y)
+            CHECK(memcmp(out->Data() + (size_t)y * out->RowPitch(),
+                         &expected[(size_t)y * s.dw * 4], s.dw * 4) == 0);
+    }
+}
+
+// Плоскость NV12 как каналы RGBA: яркость - во всех четырёх, пара UV - в
+// R и G. Проход по плоскости обязан дать то же, что ScaleRgba по каналу.
+std::vector<uint8_t> PlaneAsRgba(const std::vector<uint8_t>& plane, uint32_t w, uint32_t h,
+                                 int channels)
+{
+    std::vector<uint8_t> rgba((size_t)w * h * 4);
+    for (size_t i = 0; i < (size_t)w * h; ++i) {
+        for (int c = 0; c < 4; ++c)
+            rgba[i * 4 + c] = plane[i * channels + (channels == 1 ? 0 : c & 1)];
+    }
+    return rgba;
+}
+
+void TestNv12Planes()
+{
+    const Size kNv12Sizes[] = {
+        { 64, 36, 32, 18 },
+        { 48, 28, 32, 18 },
+        { 320, 240, 96, 72 },
+        { 40, 24, 40, 24 },
+    };
+    for (ScaleFilter filter : { ScaleFilter::Bilinear, ScaleFilter::Lanczos }) {
+        for (const Size& s : kNv12Sizes) {
+            const size_t pitch = s.sw + 6;   // шаг строки шире кадра, как в D3D11
+            std::vector<uint8_t> src(pitch * s.sh * 3 / 2);
+            for (size_t i = 0; i < src.size(); ++i)
+                src[i] = (uint8_t)((i * 2654435761u) >> 24);
+            const uint8_t* uv = src.data() + pitch * s.sh;
+
+            const size_t dpitch = s.dw;
+            std::vector<uint8_t> dst(dpitch * s.dh * 3 / 2);
+            ScaleNv12(src.data(), uv, pitch, s.sw, s.sh,
+                      dst.data(), dst.data() + dpitch * s.dh, dpitch, s.dw, s.dh, filter);
+
+            std::vector<uint8_t> y((size_t)s.sw * s.sh);
+            std::vector<uint8_t> c((size_t)s.sw * s.sh / 2);
+            for (uint32_t r = 0; r < s.sh; ++r)
+                memcpy(&y[(size_t)r * s.sw], &src[r * pitch], s.sw);
+            for (uint32_t r = 0; r < s.sh / 2; ++r)
+                memcpy(&c[(size_t)r * s.sw], uv + r * pitch, s.sw);
+
+            const Size ys = s;
+            const Size cs = { s.sw / 2, s.sh / 2, s.dw / 2, s.dh / 2 };
+            const std::vector<uint8_t> ry = Scale(PlaneAsRgba(y, ys.sw, ys.sh, 1), false, ys, filter);
+            const std::vector<uint8_t> rc = Scale(PlaneAsRgba(c, cs.sw, cs.sh, 2), false, cs, filter);
+
+            for (uint32_t r = 0; r < s.dh; ++r)
+                for (uint32_t x = 0; x < s.dw; ++x)
+                    CHECK_EQ(dst[r * dpitch + x], ry[((size_t)r * s.dw + x) * 4]);
+            const uint8_t* duv = dst.data() + dpitch * s.dh;
+            for (uint32_t r = 0; r < cs.dh; ++r) {
+                for (uint32_t x = 0; x < cs.dw; ++x) {
+                    CHECK_EQ(duv[r * dpitch + x * 2], rc[((size_t)r * cs.dw + x) * 4]);
+                    CHECK_EQ(duv[r * dpitch + x * 2 + 1], rc[((size_t)r * cs.dw + x) * 4 + 1]);
+                }
+            }
+
+            // 1:1 - точная копия обеих плоскостей.
+            if (s.sw == s.dw && s.sh == s.dh) {
+                for (uint32_t r = 0; r < s.sh * 3 / 2; ++r)
+                    CHECK(memcmp(&dst[r * dpitch], &src[r * pitch], s.sw) == 0);
+            }
+        }
+    }
+}
+
+// FrameScaler::ScaleNv12 на фейковых NV12-текстурах пишет прямо в приёмник
+// то же, что эталон.
+void TestFrameScalerNv12()
+{
+    FakeGpu gpu;
+    FrameScaler scaler(gpu.dev.Get(), gpu.ctx.Get());
+    CHECK(scaler.Initialize());
+
+    D3D11_TEXTURE2D_DESC d = {};
+    d.Width = 64;
+    d.Height = 36;
+    d.MipLevels = 1;
+    d.ArraySize = 1;
+    d.Format = DXGI_FORMAT_NV12;
+    d.SampleDesc.Count = 1;
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> src;
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> dst;
+    CHECK(SUCCEEDED(gpu.dev->CreateTexture2D(&d, nullptr, src.GetAddressOf())));
+    d.Width = 32;
+    d.Height = 18;
+    CHECK(SUCCEEDED(gpu.dev->CreateTexture2D(&d, nullptr, dst.GetAddressOf())));
+    for (size_t i = 0; i < src->DataSize(); ++i)
+        src->Data()[i] = (uint8_t)(i * 7 + (i >> 5));
+
+    for (ScaleFilter filter : { ScaleFilter::Bilinear, ScaleFilter::Lanczos }) {
+        CHECK(scaler.ScaleNv12(src.Get(), dst.Get(), filter));
+        std::vector<uint8_t> expected(dst->DataSize());
+        ScaleNv12(src->Data(), src->Data() + src->RowPitch() * 36, src->RowPitch(), 64, 36,
+                  expected.data(), expected.data() + dst->RowPitch() * 18, dst->RowPitch(),
+                  32, 18, filter);
+        CHECK(memcmp(dst->Data(), expected.data(), expected.size()) == 0);
+    }
+
+    // RGBA-источник - не NV12: отказ.
+    auto rgba = gpu.NewTexture(64, 36);
+    CHECK(!scaler.ScaleNv12(rgba.Get(), dst.Get(), ScaleFilter::Bilinear));
+}
+
+} // namespace
+
+int main()
+{
+    TestTapTables();
+    TestAgainstFloat();
+    TestExactCases();
+    TestShaderLoopMatches();
+    TestFrameScalerMatches();
+    TestNv12Planes();
+    TestFrameScalerNv12();
+    printf("FrameScalerTest OK\n");
+    return 0;
+}
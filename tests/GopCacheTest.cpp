@@ -0,0 +1,187 @@
+// Кэш последнего GOP: сброс на IDR, переполнение по байтам (кэш пуст до
+// следующего IDR), счётчики памяти для статистики, ссылки на блоки пула
+// после очистки и нумерация пакетов кэша перед живыми.
+
+#include <memory>
+
+#include "GopCache.h"
+#include "NvencPacketPool.h"
+#include "TestSupport.h"
+
+namespace {
+
+// Кадр нужного размера из пула; содержимое кэшу не важно.
+NvEncPacket Frame(NvEncPacketPool& pool, size_t bytes, bool key, int64_t ts)
+{
+    std::vector<uint8_t> buf(bytes, key ? 0x65 : 0x41);
+    NvEncPacket p;
+    p.data = pool.Copy(buf.data(), buf.size());
+    p.keyframe = key;
+    p.ts100ns = ts;
+    return p;
+}
+
+void TestResetOnIdr()
+{
+    auto pool = std::make_shared<NvEncPacketPool>();
+    GopCache cache(1 << 20);
+    std::vector<NvEncPacket> snap;
+
+    // До первого IDR кэшировать нечего.
+    cache.Push(Frame(*pool, 100, false, 0));
+    CHECK_EQ(cache.Frames(), 0);
+    CHECK_EQ(cache.Bytes(), 0);
+
+    int64_t ts = 1;
+    cache.Push(Frame(*pool, 1000, true, ts++));
+    for (int i = 0; i < 5; ++i)
+        cache.Push(Frame(*pool, 200, false, ts++));
+    CHECK_EQ(cache.Frames(), 6);
+    CHECK_EQ(cache.Bytes(), 1000 + 5 * 200);
+    cache.Snapshot(snap);
+    CHECK_EQ(snap.size(), 6);
+    CHECK(snap[0].keyframe);
+    CHECK_EQ(snap[0].ts100ns, 1);
+    CHECK_EQ(snap[5].ts100ns, 6);
+
+    // Новый IDR начинает GOP заново.
+    cache.Push(Frame(*pool, 1500, true, ts++));
+    CHECK_EQ(cache.Frames(), 1);
+    CHECK_EQ(cache.Bytes(), 1500);
+    cache.Push(Frame(*pool, 300, false, ts++));
+    cache.Snapshot(snap);
+    CHECK_EQ(snap.size(), 2);
+    CHECK(snap[0].keyframe);
+    CHECK_EQ(snap[0].ts100ns, 7);
+    CHECK_EQ(cache.Bytes(), 1800);
+
+    // Clear (остановка стрима): снова ждём IDR.
+    cache.Clear();
+    CHECK_EQ(cache.Frames(), 0);
+    CHECK_EQ(cache.Bytes(), 0);
+    cache.Push(Frame(*pool, 300, false, ts++));
+    CHECK_EQ(cache.Frames(), 0);
+    cache.Push(Frame(*pool, 400, true, ts++));
+    CHECK_EQ(cache.Frames(), 1);
+    CHECK_EQ(cache.Overflows(), 0);
+}
+
+// GOP не влез: кэш пуст и не набирает P-кадры до следующего IDR.
+void TestOverflow()
+{
+    auto pool = std::make_shared<NvEncPacketPool>();
+    GopCache cache(10000);
+    std::vector<NvEncPacket> snap;
+
+    int64_t ts = 0;
+    cache.Push(Frame(*pool, 4000, true, ts++));
+    cache.Push(Frame(*pool, 3000, false, ts++));
+    cache.Push(Frame(*pool, 3000, false, ts++));
+    CHECK_EQ(cache.Bytes(), 10000);   // ровно предел - ещё влезает
+    CHECK_EQ(cache.Frames(), 3);
+
+    cache.Push(Frame(*pool, 1, false, ts++));
+    CHECK_EQ(cache.Frames(), 0);
+    CHECK_EQ(cache.Bytes(), 0);
+    CHECK_EQ(cache.Overflows(), 1);
+    for (int i = 0; i < 10; ++i)
+        cache.Push(Frame(*pool, 100, false, ts++));
+    CHECK_EQ(cache.Frames(), 0);
+    cache.Snapshot(snap);
+    CHECK(snap.empty());
+
+    cache.Push(Frame(*pool, 2000, true, ts++));
+    cache.Push(Frame(*pool, 100, false, ts++));
+    CHECK_EQ(cache.Frames(), 2);
+    CHECK_EQ(cache.Bytes(), 2100);
+
+    // IDR, который сам больше предела, тоже не кэшируется.
+    cache.Push(Frame(*pool, 20000, true, ts++));
+    CHECK_EQ(cache.Frames(), 0);
+    CHECK_EQ(cache.Overflows(), 2);
+    cache.Push(Frame(*pool, 100, false, ts++));
+    CHECK_EQ(cache.Frames(), 0);
+}
+
+// Снимок держит блоки пула и после очистки кэша; последние ссылки
+// возвращают их в пул.
+void TestSnapshotRefs()
+{
+    auto pool = std::make_shared<NvEncPacketPool>();
+    GopCache cache(1 << 20);
+    cache.Push(Frame(*pool, 500, true, 0));
+    cache.Push(Frame(*pool, 500, false, 1));
+
+    std::vector<NvEncPacket> snap;
+    cache.Snapshot(snap);
+    cache.Clear();
+    CHECK_EQ(snap.size(), 2);
+    CHECK_EQ(snap[0].data.size(), 500);
+    CHECK_EQ(snap[0].data.data()[0], 0x65);
+    CHECK_EQ(snap[1].data.data()[499], 0x41);
+
+    const size_t blocks = pool->BlockCount();
+    snap.clear();
+    CHECK_EQ(pool->BlockCount(), blocks);
+    // Блоки вернулись: новые кадры берут их, а не выделяют заново.
+    NvEncPacket a = Frame(*pool, 500, true, 2);
+    NvEncPacket b = Frame(*pool, 500, false, 3);
+    CHECK_EQ(pool->BlockCount(), blocks);
+}
+
+// Пакеты кэша заканчиваются прямо перед следующим живым пакетом; нумерация
+// живых не сдвигается.
+void TestBurstNumbering()
+{
+    auto pool = std::make_shared<NvEncPacketPool>();
+    std::vector<NvEncPacket> gop;
+    std::vector<uint32_t> rtpTs;
+    for (int i = 0; i < 4; ++i) {
+        // Один NAL на кадр, 3000 байт - несколько FU-A.
+        std::vector<uint8_t> au = { 0, 0, 0, 1, (uint8_t)(i ? 0x41 : 0x65) };
+        au.resize(3000, 0x55);
+        NvEncPacket p;
+        p.data = pool->Copy(au.data(), au.size());
+        BuildNalIndex(p.data.data(), p.data.size(), NalCodec::H264, p.data.nals());
+        p.keyframe = i == 0;
+        gop.push_back(p);
+        rtpTs.push_back(3000 * i);
+    }
+
+    RtpPacketizer pk(NalCodec::H264, 96, 0x1234, 65530);
+    RtpPacketBatch burst;
+    std::vector<NvEncPacketRef> frames;
+    PacketizeGopBurst(pk, gop, rtpTs, burst, frames);
+    CHECK_EQ(pk.NextSeq(), 65530);
+    CHECK(burst.keyframe);
+    CHECK_EQ(frames.size(), 4);
+
+    size_t expected = 0;
+    for (const NvEncPacket& p : gop)
+        expected += pk.CountPackets(p.data.data(), p.data.nals());
+    CHECK_EQ(burst.packets.size(), expected);
+    for (size_t i = 0; i < burst.packets.size(); ++i) {
+        std::vector<uint8_t> pkt(burst.PacketSize(i));
+        burst.CopyPacket(i, pkt.data());
+        const uint16_t seq = (uint16_t)((pkt[2] << 8) | pkt[3]);
+        CHECK_EQ(seq, (uint16_t)(65530 - expected + i));
+    }
+
+    // Пустой кэш - пустой batch.
+    PacketizeGopBurst(pk, std::vector<NvEncPacket>(), rtpTs, burst, frames);
+    CHECK_EQ(burst.packets.size(), 0);
+    CHECK(frames.empty());
+    CHECK_EQ(pk.NextSeq(), 65530);
+}
+
+} // namespace
+
+int main()
+{
+    TestResetOnIdr();
+    TestOverflow();
+    TestSnapshotRefs();
+    TestBurstNumbering();
+    printf("GopCacheTest OK\n");
+    return 0;
+}
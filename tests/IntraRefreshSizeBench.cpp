@@ -0,0 +1,116 @@
+// Разброс размеров кадров: периодические IDR против intra refresh с
+// бесконечным GOP при одном битрейте. На фейковом NVENC IDR вчетверо больше
+// P-кадра, а intra refresh размазывает эту разницу по периоду обновления -
+// p99/max против p50 и показывают всплески, от которых режим избавляет.
+//
+//   IntraRefreshSizeBench [--quick]
+
+#include <algorithm>
+#include <cmath>
+
+#include "FakeNvenc.h"
+#include "NvencEncoder.h"
+#include "TestSupport.h"
+
+namespace {
+
+const uint32_t kW = 64;
+const uint32_t kH = 64;
+const uint32_t kFps = 30;
+const uint32_t kKbps = 4000;
+const uint32_t kPeriod = 30;    // GOP и период intra refresh, кадров
+
+struct SizeStats
+{
+    size_t frames = 0;
+    size_t keyframes = 0;
+    size_t p50 = 0;
+    size_t p99 = 0;
+    size_t max = 0;
+    double stddevPct = 0.0;     // от среднего
+};
+
+SizeStats Run(bool intraRefresh, int frames)
+{
+    FakeGpu gpu;
+    auto tex = gpu.NewTexture(kW, kH);
+    auto enc = CreateNvEncoder(NVRTSP_CODEC_H264, gpu.dev.Get(), gpu.ctx.Get(),
+                               kW, kH, kFps, 1, kKbps);
+    CHECK(enc && enc->Initialize(FakeNvencFunctionList()));
+    CHECK(enc->Reconfigure(0, 0, 0, kPeriod));
+    if (intraRefresh)
+        CHECK(enc->SetIntraRefresh(kPeriod));
+
+    std::vector<NvEncPacket> out;
+    std::vector<size_t> sizes;
+    SizeStats st;
+    auto collect = [&]() {
+        for (const NvEncPacket& p : out) {
+            // Первый кадр - IDR в обоих режимах: поток с него начинается.
+            if (p.ts100ns == 0)
+                continue;
+            sizes.push_back(p.data.size());
+            st.keyframes += p.keyframe ? 1 : 0;
+        }
+    };
+    for (int i = 0; i < frames; ++i) {
+        CHECK(enc->EncodeTexture(tex.Get(), i, out));
+        collect();
+        enc->WaitForPackets(out, INFINITE);
+        collect();
+    }
+    enc->Flush(out);
+    collect();
+
+    CHECK(!sizes.empty());
+    double sum = 0.0;
+    for (size_t n : sizes)
+        sum += (double)n;
+    const double mean = sum / sizes.size();
+    double var = 0.0;
+    for (size_t n : sizes)
+        var += ((double)n - mean) * ((double)n - mean);
+
+    std::sort(sizes.begin(), sizes.end());
+    st.frames = sizes.size();
+    st.p50 = sizes[sizes.size() / 2];
+    st.p99 = sizes[(sizes.size() * 99) / 100];
+    st.max = sizes.back();
+    st.stddevPct = 100.0 * std::sqrt(var / sizes.size()) / mean;
+    return st;
+}
+
+void Print(const char* name, const SizeStats& st)
+{
+    printf("  %-14s %zu frames, %zu IDR: p50 %zu B, p99 %zu B, max %zu B "
+           "(max/p50 %.2f), stddev %.1f%%\n",
+           name, st.frames, st.keyframes, st.p50, st.p99, st.max,
+           (double)st.max / st.p50, st.stddevPct);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const bool quick = BenchQuick(argc, argv);
+    const int frames = quick ? 3 * kPeriod + 1 : 30 * kPeriod + 1;
+
+    FakeNvencConfig cfg;
+    cfg.encodeDelayUs = 0;
+    FakeNvencSetConfig(cfg);
+
+    const SizeStats idr = Run(false, frames);
+    const SizeStats ir = Run(true, frames);
+
+    printf("%u kbps, %u fps, GOP / intra refresh period %u frames\n", kKbps, kFps, kPeriod);
+    Print("periodic IDR", idr);
+    Print("intra refresh", ir);
+
+    CHECK_EQ(idr.keyframes, (size_t)(frames - 1) / kPeriod);
+    CHECK_EQ(ir.keyframes, 0);
+    // IDR - всплеск в разы выше медианы; у intra refresh кадры ровные.
+    CHECK(idr.max >= 3 * idr.p50);
+    CHECK(ir.max * 10 <= ir.p50 * 12);
+    CHECK(ir.stddevPct < idr.stddevPct / 4);
+    return 0;
+}
@@ -0,0 +1,72 @@
+// Цена LatencyHistogram::Record на горячем пути (после каждого кадра и
+// отправки): один поток и несколько потоков пула, пишущих в одну
+// гистограмму. Заодно сверяет счётчик с числом записей.
+//
+//   LatencyHistogramBench [--quick]
+
+#include <thread>
+
+#include "StreamStats.h"
+#include "TestSupport.h"
+
+namespace {
+
+// Задержки как у мультиплексора: сотни микросекунд с редкими всплесками.
+int64_t Sample(uint32_t& x)
+{
+    x = x * 1664525u + 1013904223u;
+    int64_t ns = 200000 + (x >> 16) * 8;
+    if ((x & 1023) == 0)
+        ns *= 40;
+    return ns;
+}
+
+double MeasureNsPerRecord(int threads, int perThread)
+{
+    LatencyHistogram h;
+    std::vector<std::thread> ts;
+    std::vector<int64_t> cpu(threads);
+    for (int t = 0; t < threads; ++t) {
+        ts.emplace_back([&h, &cpu, t, perThread] {
+            uint32_t x = 12345u + t;
+            const int64_t c0 = TestThreadCpuNs();
+            for (int i = 0; i < perThread; ++i)
+                h.Record(Sample(x));
+            cpu[t] = TestThreadCpuNs() - c0;
+        });
+    }
+    for (std::thread& t : ts)
+        t.join();
+
+    CHECK_EQ(h.Summarize().count, (uint64_t)threads * perThread);
+    int64_t total = 0;
+    for (int64_t c : cpu)
+        total += c;
+    return (double)total / ((double)threads * perThread);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const bool quick = BenchQuick(argc, argv);
+    const int perThread = quick ? 100000 : 20000000;
+
+    printf("LatencyHistogram::Record, %d records per thread (CPU time)\n", perThread);
+    for (int threads : { 1, 2, 4 }) {
+        const double ns = MeasureNsPerRecord(threads, perThread);
+        printf("  %d thread(s)  %6.1f ns/record\n", threads, ns);
+    }
+
+    LatencyHistogram h;
+    uint32_t x = 1;
+    const int summaries = quick ? 100 : 10000;
+    for (int i = 0; i < 100000; ++i)
+        h.Record(Sample(x));
+    volatile int64_t sink = 0;
+    const int64_t t0 = TestNowNs();
+    for (int i = 0; i < summaries; ++i)
+        sink = sink + h.Summarize().p99Ns;
+    printf("  Summarize    %6.1f us\n", (double)(TestNowNs() - t0) / summaries / 1000.0);
+    return 0;
+}
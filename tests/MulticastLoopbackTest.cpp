@@ -0,0 +1,219 @@
+// Multicast-выход встроенного сервера на loopback-группе: каждый приёмник
+// группы получает поток целиком, клиенты RTSP с multicast в SETUP получают
+// группу вместо своей копии, а датаграмм и системных вызовов на кадр
+// столько же, сколько при одном приёмнике. SDP для приёмников без RTSP.
+
+#include <thread>
+
+#include "FakeNvenc.h"
+#include "NvencEncoder.h"
+#include "RtspServer.h"
+#include "TestRtp.h"
+#include "TestRtspClient.h"
+#include "TestSupport.h"
+
+namespace {
+
+const char* kGroup = "239.255.73.17";
+const uint32_t kFrames = 30;
+
+std::vector<NvEncPacket> EncodeFrames()
+{
+    FakeNvencConfig cfg;
+    cfg.encodeDelayUs = 0;
+    cfg.frameBytes = 6000;
+    FakeNvencSetConfig(cfg);
+
+    FakeGpu gpu;
+    auto tex = gpu.NewTexture(320, 240);
+    auto enc = CreateNvEncoder(NVRTSP_CODEC_H264, gpu.dev.Get(), gpu.ctx.Get(), 320, 240, 30, 1, 2000);
+    CHECK(enc && enc->Initialize(FakeNvencFunctionList()));
+
+    std::vector<NvEncPacket> out, all;
+    for (uint32_t i = 0; i < kFrames; ++i) {
+        CHECK(enc->EncodeTexture(tex.Get(), (int64_t)i * 333333, out));
+        all.insert(all.end(), out.begin(), out.end());
+        enc->WaitForPackets(out, INFINITE);
+        all.insert(all.end(), out.begin(), out.end());
+    }
+    enc->Flush(out);
+    all.insert(all.end(), out.begin(), out.end());
+    CHECK_EQ(all.size(), kFrames);
+    return all;
+}
+
+template <typename Pred>
+bool WaitFor(Pred pred, int timeoutMs = 2000)
+{
+    for (int i = 0; i < timeoutMs; ++i) {
+        if (pred())
+            return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return pred();
+}
+
+// Свободный порт для группы: чётный, и следующий за ним (RTCP) тоже свободен.
+uint16_t FreeGroupPort()
+{
+    int rtp = -1, rtcp = -1;
+    uint16_t port = 0;
+    CHECK(TestUdpBindPair(rtp, rtcp, port));
+    TestUdpClose(rtp);
+    TestUdpClose(rtcp);
+    return port;
+}
+
+// Приёмник группы собирает кадры и сверяет их с отправленными.
+void ReceiveAll(int fd, const std::vector<NvEncPacket>& frames)
+{
+    RtpDepacketizer rx(NalCodec::H264);
+    std::vector<uint8_t> data;
+    size_t next = 0;
+    while (next < frames.size()) {
+        CHECK(TestUdpRecv(fd, data, 2000));
+        CHECK(data.size() <= RtpPacketizer::kRtpDefaultMtu);
+        CHECK(rx.Push(data.data(), data.size()));
+        if (!rx.FrameDone())
+            continue;
+        const NvEncPacket& p = frames[next++];
+        CHECK_EQ(rx.FrameTs(), (uint32_t)(p.ts100ns * 9 / 1000));
+        CHECK(rx.Units() == ExpectedUnits(p.data.data(), p.data.nals(), NalCodec::H264));
+    }
+    // Лишнего (второй копии) в группе нет.
+    CHECK(!TestUdpRecv(fd, data, 100));
+}
+
+struct Egress
+{
+    uint64_t datagrams = 0;
+    uint64_t calls = 0;
+    uint64_t packets = 0;
+};
+
+Egress BroadcastFrames(RtspServer& server, RtpPacketizer& packetizer,
+                       const std::vector<NvEncPacket>& frames)
+{
+    Egress before;
+    server.GetUdpCounters(before.datagrams, before.calls);
+    Egress e;
+    RtpPacketBatch batch;
+    for (const NvEncPacket& p : frames) {
+        packetizer.Packetize(p.data.data(), p.data.nals(), (uint32_t)(p.ts100ns * 9 / 1000),
+                             p.keyframe, batch);
+        server.Broadcast(batch, p.data);
+        e.packets += batch.packets.size();
+    }
+    server.GetUdpCounters(e.datagrams, e.calls);
+    e.datagrams -= before.datagrams;
+    e.calls -= before.calls;
+    return e;
+}
+
+void TestGroupFanOut(const std::vector<NvEncPacket>& frames)
+{
+    RtspServer server;
+    uint16_t port = 0;
+    CHECK(TestStartServer(server, port));
+    SdpVideoDesc desc;
+    desc.codec = NalCodec::H264;
+    ExtractParameterSets(frames[0].data.data(), frames[0].data.nals(), NalCodec::H264,
+                         desc.parameterSets);
+    server.SetVideoDesc(desc);
+
+    RtpMulticastConfig mc;
+    mc.group = kGroup;
+    mc.port = FreeGroupPort();
+    mc.ttl = 1;
+    mc.iface = "127.0.0.1";
+    CHECK(server.SetMulticast(mc));
+
+    // SDP для VLC/ffplay: группа с TTL и порт группы.
+    const std::string sdp = server.BuildSdp();
+    CHECK(sdp.find(std::string("c=IN IP4 ") + kGroup + "/1") != std::string::npos);
+    CHECK(sdp.find("m=video " + std::to_string(mc.port) + " RTP/AVP 96") != std::string::npos);
+
+    RtpPacketizer packetizer(NalCodec::H264, 96, 0xC0FFEE, 100);
+
+    // Один приёмник группы.
+    int first = TestUdpJoinGroup(kGroup, mc.port);
+    CHECK(first >= 0);
+    const Egress one = BroadcastFrames(server, packetizer, frames);
+    ReceiveAll(first, frames);
+
+    // Ещё три приёмника и два клиента RTSP, которым SETUP отдаёт группу.
+    int more[3];
+    for (int& fd : more) {
+        fd = TestUdpJoinGroup(kGroup, mc.port);
+        CHECK(fd >= 0);
+    }
+    const std::string url = "rtsp://127.0.0.1:" + std::to_string(port) + "/live";
+    TestRtspClient clients[2];
+    for (TestRtspClient& c : clients) {
+        CHECK(c.Connect(port));
+        TestRtspResponse r;
+        CHECK(c.Request("SETUP", url + "/trackID=0", "Transport: RTP/AVP;multicast\r\n", r));
+        CHECK_EQ(r.status, 200);
+        const std::string expect = std::string("multicast;destination=") + kGroup + ";port=" +
+                                   std::to_string(mc.port) + "-" + std::to_string(mc.port + 1) +
+                                   ";ttl=1";
+        CHECK(r.Header("Transport").find(expect) != std::string::npos);
+        CHECK(c.Request("PLAY", url, "", r));
+        CHECK_EQ(r.status, 200);
+    }
+    // Группа уже идёт: вместо кэша GOP клиент получит ближайший IDR.
+    CHECK(WaitFor([&] { return server.TakeKeyframeRequest(); }));
+    CHECK(!server.HasPendingJoins());
+
+    const Egress five = BroadcastFrames(server, packetizer, frames);
+    ReceiveAll(first, frames);
+    for (int fd : more)
+        ReceiveAll(fd, frames);
+
+    printf("  1 receiver: %llu datagrams, %llu send calls; "
+           "4 receivers + 2 RTSP clients: %llu datagrams, %llu send calls\n",
+           (unsigned long long)one.datagrams, (unsigned long long)one.calls,
+           (unsigned long long)five.datagrams, (unsigned long long)five.calls);
+    // Отправка не зависит от числа подписчиков: по датаграмме на пакет.
+    CHECK_EQ(one.datagrams, one.packets);
+    CHECK_EQ(five.datagrams, five.packets);
+    CHECK_EQ(one.packets, five.packets);
+    CHECK(five.calls <= one.calls + 1);
+
+    TestUdpClose(first);
+    for (int fd : more)
+        TestUdpClose(fd);
+    server.Stop();
+}
+
+// Без группы SETUP с multicast отклоняется, адрес вне 224.0.0.0/4 не принимается.
+void TestMulticastRejected()
+{
+    RtspServer server;
+    uint16_t port = 0;
+    CHECK(TestStartServer(server, port));
+
+    RtpMulticastConfig bad;
+    bad.group = "10.1.2.3";
+    CHECK(!RtspServer::ValidMulticast(bad));
+    CHECK(!server.SetMulticast(bad));
+
+    TestRtspClient c;
+    CHECK(c.Connect(port));
+    TestRtspResponse r;
+    const std::string url = "rtsp://127.0.0.1:" + std::to_string(port) + "/live";
+    CHECK(c.Request("SETUP", url + "/trackID=0", "Transport: RTP/AVP;multicast\r\n", r));
+    CHECK_EQ(r.status, 461);
+    server.Stop();
+}
+
+} // namespace
+
+int main()
+{
+    const std::vector<NvEncPacket> frames = EncodeFrames();
+    TestGroupFanOut(frames);
+    TestMulticastRejected();
+    printf("MulticastLoopbackTest OK\n");
+    return 0;
+}
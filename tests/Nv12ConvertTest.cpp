@@ -0,0 +1,190 @@
+// Проход RGB -> NV12 (BT.709) бит в бит: CPU-эталон против формулы BT.709
+// в плавающей точке, точные значения белого, чёрного и серого, усреднение
+// цветности 2x2, Nv12Converter на фейковых текстурах против эталона, и
+// арифметика шейдера (unorm <-> целые) без потерь на всех 256 уровнях.
+
+#include <algorithm>
+#include <cmath>
+
+#include "ColorConvert.h"
+#include "Nv12Converter.h"
+#include "TestSupport.h"
+
+namespace {
+
+struct Yuv
+{
+    int y = 0;
+    int u = 0;
+    int v = 0;
+};
+
+// Один пиксель через эталон: блок 2x2 одного цвета.
+Yuv Reference(uint8_t r, uint8_t g, uint8_t b, Nv12Range range)
+{
+    const uint8_t px[4] = { r, g, b, 255 };
+    uint8_t src[16];
+    for (int i = 0; i < 4; ++i)
+        memcpy(src + i * 4, px, 4);
+    uint8_t y[4], uv[2];
+    ConvertRgbaToNv12(src, 8, false, 2, 2, y, 2, uv, 2, range);
+    CHECK(y[0] == y[1] && y[0] == y[2] && y[0] == y[3]);
+    Yuv out;
+    out.y = y[0];
+    out.u = uv[0];
+    out.v = uv[1];
+    return out;
+}
+
+// BT.709 по определению: Kr = 0.2126, Kb = 0.0722.
+void Bt709Float(double r, double g, double b, Nv12Range range, double& y, double& u, double& v)
+{
+    const double kr = 0.2126, kb = 0.0722, kg = 1.0 - kr - kb;
+    const double luma = kr * r + kg * g + kb * b;
+    const double cb = (b - luma) / (2.0 * (1.0 - kb));
+    const double cr = (r - luma) / (2.0 * (1.0 - kr));
+    if (range == Nv12Range::Full) {
+        y = luma;
+        u = 128.0 + cb;
+        v = 128.0 + cr;
+    }
+    else {
+        y = 16.0 + luma * 219.0 / 255.0;
+        u = 128.0 + cb * 224.0 / 255.0;
+        v = 128.0 + cr * 224.0 / 255.0;
+    }
+}
+
+// Целые коэффициенты отходят от округлённой формулы не больше чем на
+// единицу; белый, чёрный и любой серый - точно.
+void TestReferenceAgainstBt709()
+{
+    for (Nv12Range range : { Nv12Range::Limited, Nv12Range::Full }) {
+        const bool full = range == Nv12Range::Full;
+        int maxErr = 0;
+        for (int r = 0; r < 256; r += 5) {
+            for (int g = 0; g < 256; g += 5) {
+                for (int b = 0; b < 256; b += 5) {
+                    const Yuv q = Reference((uint8_t)r, (uint8_t)g, (uint8_t)b, range);
+                    double y, u, v;
+                    Bt709Float(r, g, b, range, y, u, v);
+                    const int err = std::max({ std::abs(q.y - (int)std::lround(y)),
+                                               std::abs(q.u - (int)std::lround(u)),
+                                               std::abs(q.v - (int)std::lround(v)) });
+                    maxErr = std::max(maxErr, err);
+                }
+            }
+        }
+        printf("  %s range: max deviation from BT.709 %d\n", full ? "full" : "limited", maxErr);
+        CHECK(maxErr <= 1);
+
+        Yuv w = Reference(255, 255, 255, range);
+        CHECK_EQ(w.y, full ? 255 : 235);
+        Yuv k = Reference(0, 0, 0, range);
+        CHECK_EQ(k.y, full ? 0 : 16);
+        for (int l = 0; l < 256; ++l) {
+            Yuv q = Reference((uint8_t)l, (uint8_t)l, (uint8_t)l, range);
+            CHECK_EQ(q.u, 128);
+            CHECK_EQ(q.v, 128);
+        }
+
+        // Насыщенные основные цвета - на краях диапазона цветности.
+        CHECK_EQ(Reference(0, 0, 255, range).u, full ? 255 : 240);
+        CHECK_EQ(Reference(255, 0, 0, range).v, full ? 255 : 240);
+    }
+}
+
+// Цветность - по среднему 2x2 с округлением к ближайшему, яркость - по
+// каждому пикселю; BGRA читается с переставленными каналами.
+void TestChromaAverage()
+{
+    // Сумма каналов 2: среднее 0.5 округляется вверх; красный, зелёный,
+    // синий и белый в среднем - серый.
+    const uint8_t rgba[2][16] = {
+        { 0, 0, 0, 255,   0, 0, 0, 255,   1, 1, 1, 255,   1, 1, 1, 255 },
+        { 255, 0, 0, 255, 0, 255, 0, 255, 0, 0, 255, 255, 255, 255, 255, 255 },
+    };
+    uint8_t y[4], uv[2];
+    ConvertRgbaToNv12(rgba[0], 8, false, 2, 2, y, 2, uv, 2, Nv12Range::Full);
+    CHECK_EQ(y[0], 0);
+    CHECK_EQ(y[2], 1);
+    CHECK_EQ(uv[0], 128);
+
+    ConvertRgbaToNv12(rgba[1], 8, false, 2, 2, y, 2, uv, 2, Nv12Range::Limited);
+    CHECK_EQ(y[0], Reference(255, 0, 0, Nv12Range::Limited).y);
+    CHECK_EQ(y[1], Reference(0, 255, 0, Nv12Range::Limited).y);
+    CHECK_EQ(y[2], Reference(0, 0, 255, Nv12Range::Limited).y);
+    CHECK_EQ(y[3], 235);
+    const Yuv avg = Reference(128, 128, 128, Nv12Range::Limited);
+    CHECK_EQ(uv[0], avg.u);
+    CHECK_EQ(uv[1], avg.v);
+
+    // Тот же блок как BGRA: красный и синий меняются местами.
+    ConvertRgbaToNv12(rgba[1], 8, true, 2, 2, y, 2, uv, 2, Nv12Range::Limited);
+    CHECK_EQ(y[0], Reference(0, 0, 255, Nv12Range::Limited).y);
+    CHECK_EQ(y[2], Reference(255, 0, 0, Nv12Range::Limited).y);
+}
+
+// Шейдер читает unorm как float и возвращает round(x * 255), а пишет
+// value / 255 в unorm8: на всех уровнях целые значения не меняются, поэтому
+// GPU-проход с той же таблицей коэффициентов совпадает с эталоном.
+void TestShaderUnormRoundTrip()
+{
+    for (int v = 0; v < 256; ++v) {
+        const float loaded = (float)v / 255.0f;
+        CHECK_EQ((int)std::lround(loaded * 255.0f), v);
+        const float stored = (float)v / 255.0f;
+        CHECK_EQ((int)std::floor(stored * 255.0f + 0.5f), v);
+    }
+}
+
+// Nv12Converter на фейковом устройстве: обе плоскости совпадают с эталоном
+// побайтно, в обоих порядках каналов и диапазонах.
+void TestConverterMatchesReference()
+{
+    const uint32_t w = 34, h = 18;
+    FakeGpu gpu;
+    Nv12Converter conv(gpu.dev.Get(), gpu.ctx.Get());
+    CHECK(conv.Initialize());
+
+    for (DXGI_FORMAT fmt : { DXGI_FORMAT_B8G8R8A8_UNORM, DXGI_FORMAT_R8G8B8A8_UNORM }) {
+        auto src = gpu.NewTexture(w, h, fmt);
+        FillPattern(src.Get(), 7);
+        auto dst = gpu.NewTexture(w, h, DXGI_FORMAT_NV12);
+
+        for (Nv12Range range : { Nv12Range::Limited, Nv12Range::Full }) {
+            CHECK(conv.Convert(src.Get(), dst.Get(), range));
+
+            std::vector<uint8_t> y(w * h), uv(w * h / 2);
+            ConvertRgbaToNv12(src->Data(), src->RowPitch(), fmt == DXGI_FORMAT_B8G8R8A8_UNORM,
+                              w, h, y.data(), w, uv.data(), w, range);
+
+            const size_t pitch = dst->RowPitch();
+            const uint8_t* dy = dst->Data();
+            const uint8_t* duv = dy + pitch * h;
+            for (uint32_t row = 0; row < h; ++row)
+                CHECK(memcmp(dy + row * pitch, &y[row * w], w) == 0);
+            for (uint32_t row = 0; row < h / 2; ++row)
+                CHECK(memcmp(duv + row * pitch, &uv[row * w], w) == 0);
+        }
+    }
+
+    // Другой размер приёмника - отказ с сообщением, кадр не трогается.
+    TestLogClear();
+    auto src = gpu.NewTexture(w, h);
+    auto small = gpu.NewTexture(w - 2, h, DXGI_FORMAT_NV12);
+    CHECK(!conv.Convert(src.Get(), small.Get(), Nv12Range::Limited));
+    CHECK(TestLogContains("NV12 pass: source/target mismatch"));
+}
+
+} // namespace
+
+int main()
+{
+    TestReferenceAgainstBt709();
+    TestChromaAverage();
+    TestShaderUnormRoundTrip();
+    TestConverterMatchesReference();
+    printf("Nv12ConvertTest OK\n");
+    return 0;
+}
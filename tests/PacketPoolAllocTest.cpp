@@ -0,0 +1,127 @@
+// Пул закодированных кадров: после прогрева путь кадра от NVENC до
+// RTP-пакетов не выделяет память, пустая ссылка безопасна.
+
+#include <atomic>
+#include <new>
+
+#include "FakeNvenc.h"
+#include "NvencEncoder.h"
+#include "RtpPacketizer.h"
+#include "TestSupport.h"
+
+namespace {
+
+std::atomic<uint64_t> g_allocs{0};
+
+} // namespace
+
+void* operator new(size_t n)
+{
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = malloc(n ? n : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+namespace {
+
+void TestEmptyRef()
+{
+    NvEncPacketRef ref;
+    CHECK(ref.data() == nullptr);
+    CHECK_EQ(ref.size(), 0);
+    CHECK(ref.empty());
+    CHECK(ref.nals().empty());
+    const NvEncPacketRef& cref = ref;
+    CHECK(cref.nals().empty());
+
+    // Запись в индекс пустой ссылки не видна при следующем обращении.
+    ref.nals().push_back(NalUnit());
+    CHECK(ref.nals().empty());
+
+    NvEncPacket pkt;
+    CHECK(pkt.data.nals().empty());
+}
+
+// Пул, индекс NAL и пакетизация: кадры разного размера, ссылки отпускаются.
+void TestPoolSteadyState()
+{
+    auto pool = std::make_shared<NvEncPacketPool>();
+    RtpPacketizer packetizer(NalCodec::H264, 96, 1, 0);
+    RtpPacketBatch batch;
+
+    // Кадр: SPS, PPS и срез; размер среза гуляет, как у P-кадров, -
+    // кадр это префикс одного буфера.
+    static const uint8_t head[] = {
+        0, 0, 0, 1, 0x67, 0x42, 0xC0, 0x1F, 0x8C,
+        0, 0, 0, 1, 0x68, 0xCE, 0x3C, 0x80,
+        0, 0, 1, 0x41,
+    };
+    std::vector<uint8_t> frame(head, head + sizeof(head));
+    for (size_t i = 0; i < 50000; ++i)
+        frame.push_back((uint8_t)(i * 7 + 1) | 1);
+
+    std::vector<NvEncPacketRef> inFlight;
+    inFlight.reserve(8);
+
+    uint64_t before = 0;
+    for (int i = 0; i < 2000; ++i) {
+        if (i == 1000)
+            before = g_allocs.load();
+        const size_t size = sizeof(head) + 20000 + (size_t)(i * 7919) % 30000;
+        NvEncPacketRef ref = pool->Copy(frame.data(), size);
+        BuildNalIndex(ref.data(), ref.size(), NalCodec::H264, ref.nals());
+        CHECK_EQ(ref.nals().size(), 3);
+        packetizer.Packetize(ref.data(), ref.nals(), (uint32_t)i * 3000, false, batch);
+
+        // Несколько кадров одновременно в пути (очередь отправки, кэш GOP).
+        if (inFlight.size() == 6)
+            inFlight.erase(inFlight.begin());
+        inFlight.push_back(std::move(ref));
+    }
+    const uint64_t steady = g_allocs.load() - before;
+    printf("pool: %zu blocks, %llu allocations in 1000 steady-state frames\n",
+           pool->BlockCount(), (unsigned long long)steady);
+    CHECK_EQ(steady, 0);
+    CHECK(pool->BlockCount() <= 7);
+}
+
+// То же через энкодер на FakeNvenc: пул и индекс внутри CollectPackets.
+void TestEncoderSteadyState()
+{
+    FakeNvencConfig cfg;
+    cfg.encodeDelayUs = 100;
+    FakeNvencSetConfig(cfg);
+
+    FakeGpu gpu;
+    auto tex = gpu.NewTexture(64, 64);
+    auto enc = CreateNvEncoder(NVRTSP_CODEC_H264, gpu.dev.Get(), gpu.ctx.Get(), 64, 64, 30, 1, 2000);
+    CHECK(enc && enc->Initialize(FakeNvencFunctionList()));
+
+    std::vector<NvEncPacket> out;
+    out.reserve(8);
+    uint64_t before = 0;
+    for (int i = 0; i < 300; ++i) {
+        if (i == 150)
+            before = g_allocs.load();
+        CHECK(enc->EncodeTexture(tex.Get(), i, out));
+    }
+    const uint64_t steady = g_allocs.load() - before;
+    printf("encoder: %llu allocations in 150 steady-state frames\n", (unsigned long long)steady);
+    CHECK_EQ(steady, 0);
+    enc->Flush(out);
+}
+
+} // namespace
+
+int main()
+{
+    TestEmptyRef();
+    TestPoolSteadyState();
+    TestEncoderSteadyState();
+    printf("PacketPoolAllocTest OK\n");
+    return 0;
+}
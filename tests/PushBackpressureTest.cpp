@@ -0,0 +1,249 @@
+// Политика DROP_NONREF на медленном соединении: энкодер с SetNonRefP выдаёт
+// каждый второй P-кадр неопорным, PushSender пишет в loopback-TCP, который
+// читатель выбирает медленнее, чем он идёт. Очередь не растёт дальше
+// бюджета, выброшены только неопорные кадры - цепочка ссылок цела, IDR не
+// нужен.
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <thread>
+
+#include "FakeNvenc.h"
+#include "NetSocket.h"
+#include "NvencEncoder.h"
+#include "PushSender.h"
+#include "TestSupport.h"
+
+namespace {
+
+const uint32_t kW = 64;
+const uint32_t kH = 64;
+const uint32_t kFrameBytes = 4000;      // P-кадр; IDR вчетверо больше
+const int64_t kTickNs = 10000000;       // 100 кадров/с - 400 КБ/с
+const uint64_t kLinkBytesPerSec = 300000;
+const int64_t kBudgetNs = 100000000;
+const int kFrames = 100;
+
+bool FrameDisposable(const NvEncPacket& p, NalCodec codec)
+{
+    return !p.keyframe && NalIndexIsDisposable(p.data.data(), p.data.nals(), codec);
+}
+
+std::unique_ptr<NvEncoderD3D11Base> NewEncoder(FakeGpu& gpu, NvrtspCodec codec)
+{
+    auto enc = CreateNvEncoder(codec, gpu.dev.Get(), gpu.ctx.Get(), kW, kH, 100, 1, 2000);
+    CHECK(enc && enc->Initialize(FakeNvencFunctionList()));
+    // Один IDR в начале: дальше ключевых кадров нет, и потеря опорного
+    // кадра была бы видна до конца потока.
+    CHECK(enc->Reconfigure(0, 0, 0, 1000));
+    return enc;
+}
+
+// Неопорные кадры чередуются с опорными и пропадают при SetNonRefP(false).
+void TestNonRefPattern()
+{
+    FakeGpu gpu;
+    auto tex = gpu.NewTexture(kW, kH);
+    const struct { NvrtspCodec codec; NalCodec nal; } kCodecs[] = {
+        { NVRTSP_CODEC_H264, NalCodec::H264 },
+        { NVRTSP_CODEC_H265, NalCodec::H265 },
+    };
+    for (const auto& c : kCodecs) {
+        auto enc = NewEncoder(gpu, c.codec);
+        CHECK(!enc->NonRefP());
+        CHECK(enc->SetNonRefP(true));
+        CHECK(enc->NonRefP());
+
+        std::vector<NvEncPacket> out;
+        std::vector<bool> disposable;
+        auto collect = [&]() {
+            for (const NvEncPacket& p : out)
+                disposable.push_back(FrameDisposable(p, c.nal));
+        };
+        for (int i = 0; i < 9; ++i) {
+            CHECK(enc->EncodeTexture(tex.Get(), i, out));
+            collect();
+            enc->WaitForPackets(out, INFINITE);
+            collect();
+        }
+        CHECK_EQ(disposable.size(), 9);
+        for (size_t i = 0; i < disposable.size(); ++i)
+            CHECK_EQ(disposable[i], i % 2 == 1);
+
+        CHECK(enc->SetNonRefP(false));
+        CHECK(!enc->NonRefP());
+        disposable.clear();
+        for (int i = 9; i < 15; ++i) {
+            CHECK(enc->EncodeTexture(tex.Get(), i, out));
+            collect();
+            enc->WaitForPackets(out, INFINITE);
+            collect();
+        }
+        CHECK_EQ(std::count(disposable.begin(), disposable.end(), true), 0);
+    }
+}
+
+// Приёмник TCP, который читает не быстрее kLinkBytesPerSec.
+class ThrottledSink
+{
+public:
+    ThrottledSink()
+    {
+        CHECK(NetInit());
+        net_socket_t listener = NetListenTcp("127.0.0.1", 0);
+        CHECK(listener != NET_INVALID_SOCKET);
+        // Маленькие буферы ядра: узкое место - читатель, а не сокет.
+        int small = 16 * 1024;
+        setsockopt(listener, SOL_SOCKET, SO_RCVBUF, (const char*)&small, sizeof(small));
+
+        m_client = socket(AF_INET, SOCK_STREAM, 0);
+        setsockopt(m_client, SOL_SOCKET, SO_SNDBUF, (const char*)&small, sizeof(small));
+        sockaddr_in a;
+        CHECK(NetParseIpv4("127.0.0.1", NetLocalPort(listener), a));
+        CHECK(connect(m_client, (sockaddr*)&a, sizeof(a)) == 0);
+        m_server = accept(listener, nullptr, nullptr);
+        CHECK(m_server != NET_INVALID_SOCKET);
+        NetClose(listener);
+
+        m_thread = std::thread([this] { ReadLoop(); });
+    }
+
+    ~ThrottledSink()
+    {
+        NetClose(m_client);
+        m_thread.join();
+        NetClose(m_server);
+    }
+
+    bool Write(const NvEncPacket& p)
+    {
+        size_t off = 0;
+        while (off < p.data.size()) {
+            NetBuf b = { p.data.data() + off, p.data.size() - off };
+            int64_t n = NetSendv(m_client, &b, 1);
+            if (n <= 0)
+                return false;
+            off += (size_t)n;
+        }
+        return true;
+    }
+
+    uint64_t Received() const { return m_received.load(); }
+
+private:
+    void ReadLoop()
+    {
+        const int64_t start = TestNowNs();
+        uint8_t buf[2048];
+        for (;;) {
+            const int64_t allowedAt = start + (int64_t)(m_received.load() * 1000000000ull / kLinkBytesPerSec);
+            const int64_t wait = allowedAt - TestNowNs();
+            if (wait > 0)
+                std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+            ssize_t n = recv(m_server, (char*)buf, sizeof(buf), 0);
+            if (n <= 0)
+                return;
+            m_received += (uint64_t)n;
+        }
+    }
+
+    net_socket_t m_client = NET_INVALID_SOCKET;
+    net_socket_t m_server = NET_INVALID_SOCKET;
+    std::atomic<uint64_t> m_received{0};
+    std::thread m_thread;
+};
+
+// Шаг стрима как в apply_backpressure: после постановки кадра, если самый
+// старый кадр старше бюджета, выбросить неопорные.
+void TestDropNonRefOnThrottledLink()
+{
+    FakeNvencConfig cfg;
+    cfg.encodeDelayUs = 0;
+    cfg.frameBytes = kFrameBytes;
+    FakeNvencSetConfig(cfg);
+
+    FakeGpu gpu;
+    auto tex = gpu.NewTexture(kW, kH);
+    auto enc = NewEncoder(gpu, NVRTSP_CODEC_H264);
+    CHECK(enc->SetNonRefP(true));
+
+    StreamStats stats;
+    ThrottledSink sink;
+    PushSender sender(stats);
+
+    std::mutex mx;
+    std::vector<int64_t> written;
+    sender.Activate([&](const NvEncPacket& p) {
+        if (!sink.Write(p))
+            return false;
+        std::lock_guard<std::mutex> lk(mx);
+        written.push_back(p.ts100ns);
+        return true;
+    });
+
+    std::map<int64_t, bool> enqueued;      // ts -> неопорный
+    std::vector<NvEncPacket> out;
+    auto push = [&]() {
+        for (const NvEncPacket& p : out) {
+            enqueued[p.ts100ns] = FrameDisposable(p, NalCodec::H264);
+            CHECK(sender.Enqueue(p));
+        }
+    };
+
+    size_t dropped = 0;
+    int64_t maxAge = 0;
+    const int64_t start = TestNowNs();
+    for (int i = 0; i < kFrames; ++i) {
+        CHECK(enc->EncodeTexture(tex.Get(), i, out));
+        push();
+        enc->WaitForPackets(out, INFINITE);
+        push();
+
+        const int64_t now = TestNowNs();
+        if (sender.OldestAgeNs(now) > kBudgetNs)
+            dropped += sender.DropDisposable(NalCodec::H264);
+        maxAge = std::max(maxAge, sender.OldestAgeNs(now));
+
+        const int64_t next = start + (int64_t)(i + 1) * kTickNs;
+        const int64_t wait = next - TestNowNs();
+        if (wait > 0)
+            std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+    }
+    CHECK(sender.Drain(2000000000));
+    CHECK(sender.Stop());
+    CHECK(!sender.TakeFailed());
+
+    printf("  %d frames, %zu non-reference dropped, %llu bytes received, "
+           "max queue age after drop %.1f ms\n",
+           kFrames, dropped, (unsigned long long)sink.Received(), maxAge / 1e6);
+
+    // Поток на треть шире канала: без сброса неопорных очередь росла бы
+    // без предела; без неопорных он вдвое уже и укладывается в канал.
+    CHECK(dropped > 0);
+    CHECK_EQ(stats.framesDroppedBackpressure.load(), dropped);
+    CHECK(maxAge < 3 * kBudgetNs);
+
+    // Каждый невыписанный кадр - неопорный, а все опорные дошли по порядку.
+    std::lock_guard<std::mutex> lk(mx);
+    CHECK(std::is_sorted(written.begin(), written.end()));
+    CHECK_EQ(written.size() + dropped, enqueued.size());
+    size_t w = 0;
+    for (const auto& e : enqueued) {
+        if (w < written.size() && written[w] == e.first)
+            ++w;
+        else
+            CHECK(e.second);
+    }
+    CHECK_EQ(w, written.size());
+}
+
+} // namespace
+
+int main()
+{
+    TestNonRefPattern();
+    TestDropNonRefOnThrottledLink();
+    printf("PushBackpressureTest OK\n");
+    return 0;
+}
@@ -0,0 +1,475 @@
+// RTCP от приёмников: эмулятор приёмника RTP с заданными потерями, разбросом
+// и задержкой считает отчёт по RFC 3550 (A.3, A.8) и шлёт RR серверу - на
+// RTCP-порт сервера для клиента unicast и на port + 1 группы для приёмника
+// multicast. Сервер видит те же потери, разброс и RTT, а RtcpRateControl по
+// ним снижает и поднимает битрейт.
+
+#include <cmath>
+#include <random>
+#include <thread>
+
+#include "FakeNvenc.h"
+#include "NvencEncoder.h"
+#include "RtcpRateControl.h"
+#include "RtspServer.h"
+#include "TestRtp.h"
+#include "TestRtspClient.h"
+#include "TestSupport.h"
+
+namespace {
+
+const char* kGroup = "239.255.73.18";
+const uint32_t kFrames = 40;
+const uint32_t kFrameTicks = 3000;      // 30 кадров/с на часах RTP 90 кГц
+const int64_t kNsPerSec = 1000000000LL;
+
+std::vector<NvEncPacket> EncodeFrames()
+{
+    FakeNvencConfig cfg;
+    cfg.encodeDelayUs = 0;
+    cfg.frameBytes = 6000;
+    FakeNvencSetConfig(cfg);
+
+    FakeGpu gpu;
+    auto tex = gpu.NewTexture(320, 240);
+    auto enc = CreateNvEncoder(NVRTSP_CODEC_H264, gpu.dev.Get(), gpu.ctx.Get(), 320, 240, 30, 1, 2000);
+    CHECK(enc && enc->Initialize(FakeNvencFunctionList()));
+
+    std::vector<NvEncPacket> out, all;
+    for (uint32_t i = 0; i < kFrames; ++i) {
+        CHECK(enc->EncodeTexture(tex.Get(), (int64_t)i * 333333, out));
+        all.insert(all.end(), out.begin(), out.end());
+        enc->WaitForPackets(out, INFINITE);
+        all.insert(all.end(), out.begin(), out.end());
+    }
+    enc->Flush(out);
+    all.insert(all.end(), out.begin(), out.end());
+    CHECK_EQ(all.size(), kFrames);
+    return all;
+}
+
+template <typename Pred>
+bool WaitFor(Pred pred, int timeoutMs = 2000)
+{
+    for (int i = 0; i < timeoutMs; ++i) {
+        if (pred())
+            return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return pred();
+}
+
+// Свободный порт для группы: чётный, и следующий за ним (RTCP) тоже свободен.
+uint16_t FreeGroupPort()
+{
+    int rtp = -1, rtcp = -1;
+    uint16_t port = 0;
+    CHECK(TestUdpBindPair(rtp, rtcp, port));
+    TestUdpClose(rtp);
+    TestUdpClose(rtcp);
+    return port;
+}
+
+void Put32(std::vector<uint8_t>& out, uint32_t v)
+{
+    out.push_back((uint8_t)(v >> 24));
+    out.push_back((uint8_t)(v >> 16));
+    out.push_back((uint8_t)(v >> 8));
+    out.push_back((uint8_t)v);
+}
+
+uint32_t Get32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// Что делает сеть между сервером и приёмником.
+struct Link
+{
+    uint32_t lossPercent = 0;   // доля выброшенных пакетов RTP, ровно на каждую сотню
+    uint32_t jitterMs = 0;      // пакет приходит позже на случайные 0..jitterMs
+    uint32_t delayMs = 0;       // на столько RR задерживается в пути, RTT растёт на столько же
+};
+
+// Приёмник RTP: статистика по RFC 3550 A.3 и A.8 и RR о потоке сервера.
+// Тест шлёт кадры быстрее реального времени, поэтому время прихода пакета
+// считается по его метке RTP плюс разброс Link, а не по часам.
+class ReceiverEmulator
+{
+public:
+    ReceiverEmulator(uint32_t ssrc, const Link& link)
+        : m_ssrc(ssrc), m_link(link), m_rng(ssrc)
+    {
+    }
+
+    void SetLink(const Link& link) { m_link = link; }
+
+    // Пакет RTP из сети; false - выброшен эмулятором.
+    bool OnRtp(const std::vector<uint8_t>& data)
+    {
+        RtpHeaderView h;
+        CHECK(ParseRtpHeader(data.data(), data.size(), h));
+        if ((m_index++ * 37) % 100 < m_link.lossPercent)
+            return false;
+
+        if (!m_received) {
+            m_mediaSsrc = h.ssrc;
+            m_baseSeq = m_maxSeq = h.seq;
+        }
+        else if ((uint16_t)(h.seq - m_maxSeq) < 0x8000) {
+            if (h.seq < m_maxSeq)
+                m_cycles += 0x10000;
+            m_maxSeq = h.seq;
+        }
+        ++m_received;
+
+        std::uniform_int_distribution<uint32_t> spread(0, m_link.jitterMs * 90);
+        const int64_t transit = (int64_t)spread(m_rng);
+        if (m_received > 1) {
+            const double d = (double)std::llabs(transit - m_transit);
+            m_jitter += (d - m_jitter) / 16.0;
+        }
+        m_transit = transit;
+        return true;
+    }
+
+    // Пакет RTCP из сети: запоминает SR сервера для LSR/DLSR.
+    void OnRtcp(const std::vector<uint8_t>& data)
+    {
+        if (data.size() < 28 || data[1] != 200)
+            return;
+        const uint64_t ntp = ((uint64_t)Get32(&data[8]) << 32) | Get32(&data[12]);
+        m_lsr = RtcpNtpMid32(ntp);
+        m_srAtNs = TestNowNs();
+    }
+
+    bool SawSr() const { return m_lsr != 0; }
+
+    // RR с одним блоком о потоке сервера; интервал потерь - с прошлого RR.
+    void BuildRr(std::vector<uint8_t>& out)
+    {
+        CHECK(m_received > 0);
+        const uint32_t extMax = m_cycles + m_maxSeq;
+        const uint32_t expected = extMax - m_baseSeq + 1;
+        const int32_t lost = (int32_t)(expected - m_received);
+        const uint32_t expectedInterval = expected - m_expectedPrior;
+        const uint32_t receivedInterval = m_received - m_receivedPrior;
+        const int32_t lostInterval = (int32_t)(expectedInterval - receivedInterval);
+        m_expectedPrior = expected;
+        m_receivedPrior = m_received;
+        const uint8_t fraction = expectedInterval == 0 || lostInterval <= 0
+            ? 0 : (uint8_t)(((uint32_t)lostInterval << 8) / expectedInterval);
+        const uint32_t dlsr = m_lsr
+            ? (uint32_t)((TestNowNs() - m_srAtNs) * 65536 / kNsPerSec) : 0;
+
+        out.clear();
+        out.push_back(0x81);                    // V=2, RC=1
+        out.push_back(201);                     // RR
+        out.push_back(0);
+        out.push_back(7);                       // 8 слов - 1
+        Put32(out, m_ssrc);
+        Put32(out, m_mediaSsrc);
+        Put32(out, ((uint32_t)fraction << 24) | ((uint32_t)lost & 0xFFFFFF));
+        Put32(out, extMax);
+        Put32(out, (uint32_t)m_jitter);
+        Put32(out, m_lsr);
+        Put32(out, dlsr);
+    }
+
+    // PSFB PLI о потоке сервера.
+    void BuildPli(std::vector<uint8_t>& out) const
+    {
+        out.clear();
+        out.push_back(0x81);                    // V=2, FMT=1
+        out.push_back(206);
+        out.push_back(0);
+        out.push_back(2);
+        Put32(out, m_ssrc);
+        Put32(out, m_mediaSsrc);
+    }
+
+    // RR уходит после задержки Link: так приёмник видит сервер дальше.
+    void SendRr(int fd, const char* addr, uint16_t port)
+    {
+        std::vector<uint8_t> rr;
+        BuildRr(rr);
+        if (m_link.delayMs)
+            std::this_thread::sleep_for(std::chrono::milliseconds(m_link.delayMs));
+        CHECK(TestUdpSendTo(fd, addr, port, rr.data(), rr.size()));
+    }
+
+    uint32_t Received() const { return m_received; }
+
+private:
+    uint32_t m_ssrc;
+    Link m_link;
+    std::mt19937 m_rng;
+    uint64_t m_index = 0;
+
+    uint32_t m_mediaSsrc = 0;
+    uint16_t m_baseSeq = 0;
+    uint16_t m_maxSeq = 0;
+    uint32_t m_cycles = 0;
+    uint32_t m_received = 0;
+    uint32_t m_expectedPrior = 0;
+    uint32_t m_receivedPrior = 0;
+    int64_t m_transit = 0;
+    double m_jitter = 0.0;          // в тиках RTP
+
+    uint32_t m_lsr = 0;
+    int64_t m_srAtNs = 0;
+};
+
+// Раунд - kFrames кадров с метками RTP после предыдущего раунда.
+void BroadcastRound(RtspServer& server, RtpPacketizer& packetizer,
+                    const std::vector<NvEncPacket>& frames, uint32_t round)
+{
+    RtpPacketBatch batch;
+    for (size_t i = 0; i < frames.size(); ++i) {
+        const NvEncPacket& p = frames[i];
+        const uint32_t ts = (uint32_t)((round * kFrames + i) * kFrameTicks);
+        packetizer.Packetize(p.data.data(), p.data.nals(), ts, p.keyframe, batch);
+        server.Broadcast(batch, p.data);
+    }
+}
+
+// SR, уже лежащие в сокете RTCP. Время SR для DLSR - момент чтения, поэтому
+// сокет RTCP опрашивается без ожидания и между пакетами RTP.
+void PollRtcp(ReceiverEmulator& rx, int rtcpFd)
+{
+    std::vector<uint8_t> data;
+    while (TestUdpRecv(rtcpFd, data, 0))
+        rx.OnRtcp(data);
+}
+
+// Вычитывает RTP, пока 200 мс ничего не приходит.
+void Drain(ReceiverEmulator& rx, int rtpFd, int rtcpFd)
+{
+    std::vector<uint8_t> data;
+    for (int idle = 0; idle < 20;) {
+        PollRtcp(rx, rtcpFd);
+        if (TestUdpRecv(rtpFd, data, 10)) {
+            rx.OnRtp(data);
+            idle = 0;
+        }
+        else {
+            ++idle;
+        }
+    }
+    PollRtcp(rx, rtcpFd);
+}
+
+int ParseServerRtcpPort(const std::string& transport)
+{
+    const size_t at = transport.find("server_port=");
+    CHECK(at != std::string::npos);
+    return atoi(transport.c_str() + at + 12) + 1;
+}
+
+// Клиент unicast по очереди: чистый канал, задержка, потери с разбросом и
+// снова чистый канал. На каждый RR сервер отдаёт то, что задал эмулятор, а
+// контроллер держит, снижает по RTT, снижает по потерям и поднимает битрейт.
+void TestUnicastReports(const std::vector<NvEncPacket>& frames)
+{
+    RtspServer server;
+    uint16_t port = 0;
+    CHECK(TestStartServer(server, port));
+    const std::string url = "rtsp://127.0.0.1:" + std::to_string(port) + "/live";
+
+    int rtpFd = -1, rtcpFd = -1;
+    uint16_t rtpPort = 0;
+    CHECK(TestUdpBindPair(rtpFd, rtcpFd, rtpPort));
+
+    TestRtspClient c;
+    CHECK(c.Connect(port));
+    TestRtspResponse r;
+    CHECK(c.Request("SETUP", url + "/trackID=0",
+                    "Transport: RTP/AVP;unicast;client_port=" + std::to_string(rtpPort) + "-" +
+                    std::to_string(rtpPort + 1) + "\r\n", r));
+    CHECK_EQ(r.status, 200);
+    const uint16_t serverRtcp = (uint16_t)ParseServerRtcpPort(r.Header("Transport"));
+    CHECK(c.Request("PLAY", url, "", r));
+    CHECK_EQ(r.status, 200);
+    CHECK(WaitFor([&] { return server.HasPendingJoins(); }));
+    server.SendToJoiners(RtpPacketBatch());
+
+    RtpPacketizer packetizer(NalCodec::H264, 96, 0xFEED, 0);
+    ReceiverEmulator rx(0x5EC0, Link());
+    RtcpRateControl rate;
+    rate.Reset(4000, 250);
+
+    struct Phase
+    {
+        Link link;
+        const char* name;
+    };
+    Link clean;
+    Link delayed;
+    delayed.delayMs = 150;
+    Link lossy;
+    lossy.lossPercent = 20;
+    lossy.jitterMs = 20;
+    const Phase phases[] = {
+        { clean, "clean" },
+        { delayed, "+150 ms RTT" },
+        { lossy, "20% loss, 20 ms jitter" },
+        { clean, "clean" },
+    };
+
+    uint32_t kbps = rate.Kbps();
+    int64_t nowNs = 0;
+    for (uint32_t i = 0; i < 4; ++i) {
+        const Phase& ph = phases[i];
+        rx.SetLink(ph.link);
+        BroadcastRound(server, packetizer, frames, i);
+        Drain(rx, rtpFd, rtcpFd);
+        // SR раз в секунду: первый RR ждёт его, дальше LSR уже есть.
+        if (i == 0)
+            CHECK(WaitFor([&] { PollRtcp(rx, rtcpFd); return rx.SawSr(); }, 2500));
+        rx.SendRr(rtcpFd, "127.0.0.1", serverRtcp);
+
+        RtcpReceiverReport rep;
+        CHECK(WaitFor([&] { return server.TakeReceiverReport(rep); }));
+        CHECK_EQ(rep.blocks, 1);
+        nowNs += 3 * kNsPerSec / 2;
+        const uint32_t prev = kbps;
+        kbps = rate.OnReport(rep, nowNs);
+        printf("  %-24s loss %.3f, jitter %.1f ms, RTT %.1f ms -> %u kbps\n", ph.name,
+               rep.lossFraction, rep.jitterMs, rep.rttMs, kbps);
+
+        const double loss = ph.link.lossPercent / 100.0;
+        CHECK(std::fabs(rep.lossFraction - loss) < 0.04);
+        CHECK(rep.rttMs >= ph.link.delayMs);
+        CHECK(rep.rttMs < ph.link.delayMs + 100.0);
+        switch (i) {
+        case 0:
+            CHECK(rep.jitterMs < 1.0);
+            CHECK_EQ(kbps, 4000);
+            break;
+        case 1:
+            CHECK(kbps < prev);
+            break;
+        case 2:
+            // Равномерный разброс 0..20 мс: средняя разность соседних ~7 мс.
+            CHECK(rep.jitterMs > 3.0);
+            CHECK(rep.jitterMs < 15.0);
+            CHECK(kbps < prev);
+            break;
+        case 3:
+            CHECK(kbps > prev);
+            break;
+        }
+    }
+
+    RtcpCounters counters;
+    server.GetRtcpCounters(counters);
+    CHECK_EQ(counters.receiverReports, 4);
+    CHECK(counters.senderReports > 0);
+
+    CHECK(c.Request("TEARDOWN", url, "", r));
+    TestUdpClose(rtpFd);
+    TestUdpClose(rtcpFd);
+    server.Stop();
+}
+
+// Два приёмника группы без RTSP шлют RR и PLI на port + 1 группы: сервер их
+// принимает, окно отчётов равняется на худший приёмник.
+void TestGroupReports(const std::vector<NvEncPacket>& frames)
+{
+    RtspServer server;
+    uint16_t port = 0;
+    CHECK(TestStartServer(server, port));
+
+    RtpMulticastConfig mc;
+    mc.group = kGroup;
+    mc.port = FreeGroupPort();
+    mc.ttl = 1;
+    mc.iface = "127.0.0.1";
+    CHECK(server.SetMulticast(mc));
+
+    struct Member
+    {
+        int rtpFd;
+        int rtcpFd;
+        ReceiverEmulator rx;
+    };
+    Link light;
+    light.lossPercent = 10;
+    Link heavy;
+    heavy.lossPercent = 30;
+    Member members[] = {
+        { TestUdpJoinGroup(kGroup, mc.port), TestUdpJoinGroup(kGroup, mc.port + 1),
+          ReceiverEmulator(0xA1, light) },
+        { TestUdpJoinGroup(kGroup, mc.port), TestUdpJoinGroup(kGroup, mc.port + 1),
+          ReceiverEmulator(0xA2, heavy) },
+    };
+    for (Member& m : members)
+        CHECK(m.rtpFd >= 0 && m.rtcpFd >= 0);
+
+    RtpPacketizer packetizer(NalCodec::H264, 96, 0xD00D, 0);
+    BroadcastRound(server, packetizer, frames, 0);
+    // Оба приёмника читаются вперемешку: SR, пролежавший в сокете, пока
+    // читался другой, дал бы лишнее к RTT.
+    std::vector<uint8_t> data;
+    for (int idle = 0; idle < 20;) {
+        bool got = false;
+        for (Member& m : members) {
+            PollRtcp(m.rx, m.rtcpFd);
+            if (TestUdpRecv(m.rtpFd, data, 5)) {
+                m.rx.OnRtp(data);
+                got = true;
+            }
+        }
+        idle = got ? 0 : idle + 1;
+    }
+    for (Member& m : members)
+        CHECK(m.rx.Received() > 0);
+    // SR группы приходит обоим приёмникам сразу.
+    CHECK(WaitFor([&] {
+        bool all = true;
+        for (Member& m : members) {
+            PollRtcp(m.rx, m.rtcpFd);
+            all = all && m.rx.SawSr();
+        }
+        return all;
+    }, 2500));
+    for (Member& m : members)
+        m.rx.SendRr(m.rtcpFd, kGroup, (uint16_t)(mc.port + 1));
+
+    RtcpCounters counters;
+    CHECK(WaitFor([&] {
+        server.GetRtcpCounters(counters);
+        return counters.receiverReports == 2;
+    }));
+    RtcpReceiverReport rep;
+    CHECK(server.TakeReceiverReport(rep));
+    printf("  group: %u reports, worst loss %.3f, RTT %.1f ms\n", rep.blocks,
+           rep.lossFraction, rep.rttMs);
+    CHECK_EQ(rep.blocks, 2);
+    CHECK(std::fabs(rep.lossFraction - 0.3) < 0.04);
+    CHECK(rep.rttMs >= 0.0 && rep.rttMs < 100.0);
+
+    // PLI из группы - запрос IDR, как от клиента RTSP.
+    CHECK(!server.TakeKeyframeRequest());
+    std::vector<uint8_t> pli;
+    members[0].rx.BuildPli(pli);
+    CHECK(TestUdpSendTo(members[0].rtcpFd, kGroup, (uint16_t)(mc.port + 1), pli.data(), pli.size()));
+    CHECK(WaitFor([&] { return server.TakeKeyframeRequest(); }));
+
+    for (Member& m : members) {
+        TestUdpClose(m.rtpFd);
+        TestUdpClose(m.rtcpFd);
+    }
+    server.Stop();
+}
+
+} // namespace
+
+int main()
+{
+    const std::vector<NvEncPacket> frames = EncodeFrames();
+    TestUnicastReports(frames);
+    TestGroupReports(frames);
+    printf("RtcpReceiverTest OK\n");
+    return 0;
+}
@@ -0,0 +1,221 @@
+// RtpPacer на ручных часах: IDR растягивается на долю интервала кадра
+// ровными промежутками, подряд уходит не больше ведра, опоздавший поток
+// наверстывает, без пейсинга кадр уходит сразу. Очередь пейсера в
+// RtspServer держит блок кадра по ссылке, а не копирует нагрузку.
+
+#include <algorithm>
+#include <memory>
+
+#include "AnnexB.h"
+#include "NvencPacketPool.h"
+#include "RtpPacer.h"
+#include "RtpPacketizer.h"
+#include "RtspServer.h"
+#include "TestSupport.h"
+
+namespace {
+
+const int64_t kNsPerSec = 1000000000LL;
+const int64_t kInterval = kNsPerSec / 30;
+const size_t kPacket = 1400;
+
+// Часы, которые двигает только тест; каждый сон дольше срока на oversleepNs.
+class ManualClock : public PacerClock
+{
+public:
+    int64_t NowNs() override { return m_now; }
+    void SleepUntilNs(int64_t deadlineNs) override
+    {
+        if (deadlineNs > m_now)
+            m_now = deadlineNs;
+        m_now += oversleepNs;
+    }
+
+    int64_t oversleepNs = 0;
+
+private:
+    int64_t m_now = 1000 * kNsPerSec;
+};
+
+RtpPacingConfig Config(double fraction, uint32_t kbps)
+{
+    RtpPacingConfig cfg;
+    cfg.fraction = fraction;
+    cfg.frameIntervalNs = kInterval;
+    cfg.bitrateKbps = kbps;
+    return cfg;
+}
+
+struct Drained
+{
+    int64_t firstNs = 0;
+    int64_t lastNs = 0;
+    size_t maxBurst = 0;        // байт подряд без ожидания
+    int wakes = 0;
+    // Перед полными пакетами после первой пачки; первый промежуток короче -
+    // остаток ведра.
+    int64_t maxGapNs = 0;
+    int64_t minGapNs = 0;
+};
+
+// Отдаёт кадр frameBytes пакетами kPacket, как RunPacer: пока ведро
+// разрешает - сразу, иначе сон до срока.
+Drained Drain(RtpPacer& pacer, ManualClock& clock, size_t frameBytes, size_t queuedBytes)
+{
+    pacer.OnFrame(frameBytes, queuedBytes);
+    Drained d;
+    d.firstNs = clock.NowNs();
+    d.minGapNs = kInterval;
+
+    size_t burst = 0;
+    int64_t prevNs = -1;
+    int gaps = 0;
+    for (size_t left = frameBytes; left > 0;) {
+        const size_t size = std::min(left, kPacket);
+        const int64_t waitNs = pacer.WaitNs(size);
+        if (waitNs > 0) {
+            clock.SleepUntilNs(clock.NowNs() + waitNs);
+            ++d.wakes;
+            burst = 0;
+            continue;
+        }
+        pacer.Consume(size);
+        burst += size;
+        d.maxBurst = std::max(d.maxBurst, burst);
+        if (prevNs >= 0 && clock.NowNs() != prevNs && gaps++ > 0 && size == kPacket) {
+            d.maxGapNs = std::max(d.maxGapNs, clock.NowNs() - prevNs);
+            d.minGapNs = std::min(d.minGapNs, clock.NowNs() - prevNs);
+        }
+        prevNs = clock.NowNs();
+        left -= size;
+    }
+    d.lastNs = clock.NowNs();
+    return d;
+}
+
+// IDR 200 КБ при половине интервала: первая пачка - ведро, дальше по
+// пакету с равным шагом, весь кадр укладывается в окно и почти заполняет его.
+void TestIdrSpreadOverWindow()
+{
+    ManualClock clock;
+    RtpPacer pacer(&clock);
+    pacer.SetConfig(Config(0.5, 8000));
+    CHECK(pacer.Enabled());
+
+    const size_t idr = 200000;
+    const int64_t window = kInterval / 2;
+    const Drained d = Drain(pacer, clock, idr, idr);
+    const int64_t took = d.lastNs - d.firstNs;
+    const int64_t step = (int64_t)(kPacket * window / idr);
+
+    printf("  IDR %zu B: %.2f ms of %.2f ms window, burst %zu B, gap %.1f..%.1f us\n", idr,
+           took / 1e6, window / 1e6, d.maxBurst, d.minGapNs / 1e3, d.maxGapNs / 1e3);
+    CHECK(took <= window);
+    CHECK(took >= window * 8 / 10);
+    CHECK(d.maxBurst <= pacer.Config().burstBytes + kPacket);
+    // Шаг - время пакета при скорости "очередь за окно", с точностью до нс.
+    CHECK(d.maxGapNs <= step + 2);
+    CHECK(d.minGapNs >= step - 2);
+}
+
+// Поток P-кадров по битрейту: каждый кадр уходит до следующего, очередь не
+// копится, средняя скорость равна входной.
+void TestSteadyStream()
+{
+    ManualClock clock;
+    RtpPacer pacer(&clock);
+    pacer.SetConfig(Config(0.5, 8000));
+
+    const size_t frame = 8000 * 1000 / 8 / 30;
+    const int64_t start = clock.NowNs();
+    for (int i = 0; i < 90; ++i) {
+        const int64_t due = start + i * kInterval;
+        CHECK(clock.NowNs() <= due);
+        clock.SleepUntilNs(due);
+        const Drained d = Drain(pacer, clock, frame, frame);
+        CHECK(d.lastNs - d.firstNs <= kInterval / 2);
+    }
+}
+
+// Поток пейсера просыпается на 300 мкс позже срока: токены копятся, пока
+// очередь не пуста, за пробуждение уходит несколько пакетов, и кадр всё
+// равно укладывается в окно плюс один сон (по пакету на пробуждение он
+// шёл бы втрое дольше окна).
+void TestLateWakeupsCatchUp()
+{
+    ManualClock clock;
+    clock.oversleepNs = 300000;
+    RtpPacer pacer(&clock);
+    pacer.SetConfig(Config(0.5, 8000));
+
+    const size_t idr = 200000;
+    const Drained d = Drain(pacer, clock, idr, idr);
+    CHECK(d.lastNs - d.firstNs <= kInterval / 2 + clock.oversleepNs);
+    CHECK(d.wakes * 3 < (int)(idr / kPacket));
+}
+
+// fraction 0 - кадр уходит разом, ведро не тратится.
+void TestDisabled()
+{
+    ManualClock clock;
+    RtpPacer pacer(&clock);
+    pacer.SetConfig(Config(0.0, 8000));
+    CHECK(!pacer.Enabled());
+    const Drained d = Drain(pacer, clock, 200000, 200000);
+    CHECK_EQ(d.lastNs, d.firstNs);
+    CHECK_EQ(d.maxBurst, 200000);
+}
+
+// Кадр в очереди пейсера держит свой блок пула: пока кадр не ушёл, блок не
+// выдаётся снова; после очистки очереди возвращается. Без ссылки на блок
+// очередь копирует нагрузку и блок свободен сразу.
+void TestQueueHoldsFrameBlock()
+{
+    auto pool = std::make_shared<NvEncPacketPool>();
+    std::vector<uint8_t> au = { 0, 0, 0, 1, 0x65 };
+    au.resize(6000, 0x5A);
+
+    NvEncPacketRef frame = pool->Copy(au.data(), au.size());
+    BuildNalIndex(frame.data(), frame.size(), NalCodec::H264, frame.nals());
+    RtpPacketizer packetizer(NalCodec::H264, 96, 1, 0);
+    RtpPacketBatch batch;
+    packetizer.Packetize(frame.data(), frame.nals(), 0, true, batch);
+    CHECK(batch.packets.size() > 1);
+
+    // Сервер не запущен: поток пейсера не работает, кадр остаётся в очереди.
+    RtspServer server;
+    server.SetPacing(Config(0.5, 2000));
+    server.Broadcast(batch, frame);
+    frame.Reset();
+    NvEncPacketRef other = pool->Copy(au.data(), au.size());
+    CHECK_EQ(pool->BlockCount(), 2);
+
+    server.Stop();
+    other.Reset();
+    frame = pool->Copy(au.data(), au.size());
+    other = pool->Copy(au.data(), au.size());
+    CHECK_EQ(pool->BlockCount(), 2);
+
+    // Копия: оба блока свободны, хотя кадр ещё в очереди.
+    BuildNalIndex(frame.data(), frame.size(), NalCodec::H264, frame.nals());
+    packetizer.Packetize(frame.data(), frame.nals(), 0, true, batch);
+    server.Broadcast(batch);
+    frame.Reset();
+    other.Reset();
+    frame = pool->Copy(au.data(), au.size());
+    other = pool->Copy(au.data(), au.size());
+    CHECK_EQ(pool->BlockCount(), 2);
+}
+
+} // namespace
+
+int main()
+{
+    TestIdrSpreadOverWindow();
+    TestSteadyStream();
+    TestLateWakeupsCatchUp();
+    TestDisabled();
+    TestQueueHoldsFrameBlock();
+    printf("RtpPacerTest OK\n");
+    return 0;
+}
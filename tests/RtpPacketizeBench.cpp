@@ -0,0 +1,268 @@
+// Пакетизация H.264 в RTP, пакетов в секунду на ядро (процессорное время
+// потока): RtpPacketizer по индексу NAL энкодера со scatter/gather против
+// прежнего пути, где send_annexb_packet_locked отдавал кадр RTP-мультиплексору
+// libavformat. Тот заново ищет стартовые коды по всему кадру и копирует
+// каждый NAL или кусок FU-A в буфер пакета; его схема повторена здесь
+// ("copying"). Если тесты собраны с FFmpeg, меряется и сам мультиплексор
+// rtp через AVIOContext, который только считает пакеты.
+//
+// Пакет считается отправленным, когда готово то, что уходит в сокет:
+// список NetBuf для sendmsg или непрерывный буфер.
+//
+//   RtpPacketizeBench [--quick]
+
+#include <algorithm>
+
+#include "FakeNvenc.h"
+#include "NetSocket.h"
+#include "NvencEncoder.h"
+#include "RtpPacketizer.h"
+#include "TestSupport.h"
+
+#ifdef NVRTSP_BENCH_LIBAV
+extern "C" {
+#include <libavformat/avformat.h>
+}
+#endif
+
+namespace {
+
+const uint32_t kW = 1920;
+const uint32_t kH = 1080;
+const uint32_t kFps = 60;
+const uint32_t kKbps = 60000;           // ~125 КБ на P-кадр, IDR вчетверо больше
+const size_t kMtu = 1400;
+const uint8_t kPayloadType = 96;
+const uint32_t kSsrc = 0x1234abcd;
+
+struct Frame
+{
+    NvEncPacket pkt;
+    uint32_t rtpTs = 0;
+};
+
+// GOP 60: один IDR и 59 P-кадров с фейкового NVENC.
+std::vector<Frame> EncodeGop()
+{
+    FakeNvencConfig cfg;
+    cfg.encodeDelayUs = 0;
+    FakeNvencSetConfig(cfg);
+
+    FakeGpu gpu;
+    auto tex = gpu.NewTexture(kW, kH);
+    auto enc = CreateNvEncoder(NVRTSP_CODEC_H264, gpu.dev.Get(), gpu.ctx.Get(),
+                               kW, kH, kFps, 1, kKbps);
+    CHECK(enc && enc->Initialize(FakeNvencFunctionList()));
+
+    std::vector<NvEncPacket> out;
+    std::vector<Frame> frames;
+    auto collect = [&]() {
+        for (const NvEncPacket& p : out) {
+            Frame f;
+            f.pkt = p;
+            f.rtpTs = (uint32_t)(p.ts100ns * 9 / 1000);
+            frames.push_back(f);
+        }
+    };
+    for (uint32_t i = 0; i < kFps; ++i) {
+        CHECK(enc->EncodeTexture(tex.Get(), (int64_t)i * 10000000 / kFps, out));
+        collect();
+        enc->WaitForPackets(out, INFINITE);
+        collect();
+    }
+    enc->Flush(out);
+    collect();
+    CHECK_EQ(frames.size(), kFps);
+    CHECK(frames[0].pkt.keyframe);
+    return frames;
+}
+
+struct Result
+{
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+    size_t maxPacket = 0;
+    int64_t cpuNs = 0;
+
+    void Count(size_t size)
+    {
+        ++packets;
+        bytes += size;
+        maxPacket = std::max(maxPacket, size);
+    }
+
+    double PacketsPerSec() const { return cpuNs ? packets * 1e9 / cpuNs : 0.0; }
+};
+
+Result RunInTree(const std::vector<Frame>& frames, int rounds)
+{
+    RtpPacketizer packetizer(NalCodec::H264, kPayloadType, kSsrc, 0, kMtu);
+    RtpPacketBatch batch;
+    NetBuf bufs[kNetMaxBufs];
+    Result r;
+
+    const int64_t t0 = TestThreadCpuNs();
+    for (int round = 0; round < rounds; ++round) {
+        for (const Frame& f : frames) {
+            const NvEncPacketRef& d = f.pkt.data;
+            packetizer.Packetize(d.data(), d.nals(), f.rtpTs, f.pkt.keyframe, batch);
+            for (size_t i = 0; i < batch.packets.size(); ++i) {
+                const RtpSegment* seg = batch.PacketSegments(i);
+                const size_t n = batch.PacketSegmentCount(i);
+                size_t size = 0;
+                for (size_t k = 0; k < n; ++k) {
+                    bufs[k].data = batch.SegmentData(seg[k]);
+                    bufs[k].size = seg[k].size;
+                    size += seg[k].size;
+                }
+                r.Count(size);
+            }
+        }
+    }
+    r.cpuNs = TestThreadCpuNs() - t0;
+    return r;
+}
+
+// Схема rtpenc_h264_hevc: поиск стартовых кодов по кадру, NAL целиком или
+// FU-A, каждый кусок копируется за заголовок RTP.
+Result RunCopying(const std::vector<Frame>& frames, int rounds)
+{
+    const size_t maxPayload = kMtu - kRtpHeaderSize;
+    std::vector<uint8_t> buf(kMtu);
+    uint16_t seq = 0;
+    Result r;
+
+    const int64_t t0 = TestThreadCpuNs();
+    for (int round = 0; round < rounds; ++round) {
+        for (const Frame& f : frames) {
+            const uint8_t* au = f.pkt.data.data();
+            const size_t n = f.pkt.data.size();
+            size_t sc = FindStartCodeScalar(au, n, 0);
+            while (sc < n) {
+                const size_t start = sc + 3;
+                const size_t next = start < n ? FindStartCodeScalar(au, n, start) : n;
+                size_t end = next;
+                while (end > start && au[end - 1] == 0)
+                    --end;
+                const uint8_t* nal = au + start;
+                const size_t size = end - start;
+                const bool lastNal = next >= n;
+
+                if (size <= maxPayload) {
+                    WriteRtpHeader(buf.data(), kPayloadType, lastNal, seq++, f.rtpTs, kSsrc);
+                    memcpy(&buf[kRtpHeaderSize], nal, size);
+                    r.Count(kRtpHeaderSize + size);
+                }
+                else {
+                    const uint8_t indicator = (uint8_t)((nal[0] & 0xE0) | 28);
+                    uint8_t fuHeader = (uint8_t)(0x80 | (nal[0] & 0x1F));
+                    for (size_t off = 1; off < size;) {
+                        const size_t chunk = std::min(size - off, maxPayload - 2);
+                        const bool lastChunk = off + chunk == size;
+                        if (lastChunk)
+                            fuHeader |= 0x40;
+                        WriteRtpHeader(buf.data(), kPayloadType, lastNal && lastChunk, seq++,
+                                       f.rtpTs, kSsrc);
+                        buf[kRtpHeaderSize] = indicator;
+                        buf[kRtpHeaderSize + 1] = fuHeader;
+                        memcpy(&buf[kRtpHeaderSize + 2], nal + off, chunk);
+                        r.Count(kRtpHeaderSize + 2 + chunk);
+                        fuHeader &= 0x7F;
+                        off += chunk;
+                    }
+                }
+                sc = next;
+            }
+        }
+    }
+    r.cpuNs = TestThreadCpuNs() - t0;
+    return r;
+}
+
+#ifdef NVRTSP_BENCH_LIBAV
+// Мультиплексор пишет в AVIOContext по пакету на вызов (max_packet_size = MTU).
+int CountLibavPacket(void* opaque, const uint8_t* buf, int size)
+{
+    (void)buf;
+    ((Result*)opaque)->Count((size_t)size);
+    return size;
+}
+
+Result RunLibav(const std::vector<Frame>& frames, int rounds)
+{
+    Result r;
+    AVFormatContext* fmt = nullptr;
+    CHECK(avformat_alloc_output_context2(&fmt, nullptr, "rtp", nullptr) >= 0);
+    uint8_t* ioBuf = (uint8_t*)av_malloc(kMtu);
+    fmt->pb = avio_alloc_context(ioBuf, (int)kMtu, 1, &r, nullptr, CountLibavPacket, nullptr);
+    CHECK(fmt->pb);
+    fmt->pb->max_packet_size = (int)kMtu;
+
+    AVStream* st = avformat_new_stream(fmt, nullptr);
+    CHECK(st);
+    st->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+    st->codecpar->codec_id = AV_CODEC_ID_H264;
+    st->codecpar->width = kW;
+    st->codecpar->height = kH;
+    st->time_base = AVRational{ 1, 90000 };
+    CHECK(avformat_write_header(fmt, nullptr) >= 0);
+
+    AVPacket* pkt = av_packet_alloc();
+    int64_t pts = 0;
+    const int64_t t0 = TestThreadCpuNs();
+    for (int round = 0; round < rounds; ++round) {
+        for (const Frame& f : frames) {
+            pkt->data = const_cast<uint8_t*>(f.pkt.data.data());
+            pkt->size = (int)f.pkt.data.size();
+            pkt->pts = pkt->dts = pts;
+            pkt->stream_index = 0;
+            pkt->flags = f.pkt.keyframe ? AV_PKT_FLAG_KEY : 0;
+            CHECK(av_write_frame(fmt, pkt) >= 0);
+            pts += 90000 / kFps;
+        }
+    }
+    r.cpuNs = TestThreadCpuNs() - t0;
+
+    av_packet_free(&pkt);
+    av_write_trailer(fmt);
+    av_freep(&fmt->pb->buffer);
+    avio_context_free(&fmt->pb);
+    avformat_free_context(fmt);
+    return r;
+}
+#endif
+
+void Print(const char* name, const Result& r, const Result& base)
+{
+    printf("  %-10s %8llu packets, max %zu B, %9.0f packets/s per core (x%.2f)\n", name,
+           (unsigned long long)r.packets, r.maxPacket, r.PacketsPerSec(),
+           base.PacketsPerSec() > 0 ? r.PacketsPerSec() / base.PacketsPerSec() : 0.0);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const bool quick = BenchQuick(argc, argv);
+    const int rounds = quick ? 1 : 20;
+
+    const std::vector<Frame> frames = EncodeGop();
+    const Result copying = RunCopying(frames, rounds);
+    const Result tree = RunInTree(frames, rounds);
+
+    printf("1080p / %u Mbps / %u fps, MTU %zu, %zu frames x %d rounds\n", kKbps / 1000, kFps,
+           kMtu, frames.size(), rounds);
+    Print("copying", copying, copying);
+    Print("in-tree", tree, copying);
+#ifdef NVRTSP_BENCH_LIBAV
+    const Result libav = RunLibav(frames, rounds);
+    Print("libav rtp", libav, copying);
+    CHECK(libav.maxPacket <= kMtu);
+#endif
+
+    CHECK(copying.maxPacket <= kMtu);
+    CHECK(tree.maxPacket <= kMtu);
+    // SPS и PPS перед IDR уходят одним STAP-A, остальное режется одинаково.
+    CHECK_EQ(tree.packets + rounds, copying.packets);
+    return 0;
+}
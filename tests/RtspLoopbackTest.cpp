@@ -0,0 +1,351 @@
+// Встроенный RTSP-сервер на loopback с настоящим клиентом: OPTIONS,
+// DESCRIBE, SETUP (TCP interleaved и UDP), PLAY, кадры FakeNvenc до
+// клиента без искажений, кэш GOP для клиента, пришедшего посреди GOP,
+// RTCP PLI, TEARDOWN и переполнение заголовка.
+
+#include <thread>
+
+#include "FakeNvenc.h"
+#include "GopCache.h"
+#include "NvencEncoder.h"
+#include "RtspServer.h"
+#include "TestRtp.h"
+#include "TestRtspClient.h"
+#include "TestSupport.h"
+
+namespace {
+
+const uint32_t kFrames = 40;
+
+std::vector<NvEncPacket> EncodeFrames(uint32_t count)
+{
+    FakeNvencConfig cfg;
+    cfg.encodeDelayUs = 100;
+    cfg.frameBytes = 6000;
+    FakeNvencSetConfig(cfg);
+
+    FakeGpu gpu;
+    auto tex = gpu.NewTexture(320, 240);
+    auto enc = CreateNvEncoder(NVRTSP_CODEC_H264, gpu.dev.Get(), gpu.ctx.Get(), 320, 240, 30, 1, 2000);
+    CHECK(enc && enc->Initialize(FakeNvencFunctionList()));
+
+    std::vector<NvEncPacket> out, all;
+    for (uint32_t i = 0; i < count; ++i) {
+        CHECK(enc->EncodeTexture(tex.Get(), (int64_t)i * 333333, out));
+        all.insert(all.end(), out.begin(), out.end());
+    }
+    enc->Flush(out);
+    all.insert(all.end(), out.begin(), out.end());
+    CHECK_EQ(all.size(), count);
+    return all;
+}
+
+// RTP-время кадра, как в BroadcastFrames.
+uint32_t FrameRtpTs(const NvEncPacket& p)
+{
+    return (uint32_t)(p.ts100ns * 9 / 1000);
+}
+
+SdpVideoDesc VideoDesc(const std::vector<NvEncPacket>& frames)
+{
+    SdpVideoDesc desc;
+    desc.codec = NalCodec::H264;
+    ExtractParameterSets(frames[0].data.data(), frames[0].data.nals(), NalCodec::H264,
+                         desc.parameterSets);
+    return desc;
+}
+
+template <typename Pred>
+bool WaitFor(Pred pred, int timeoutMs = 2000)
+{
+    for (int i = 0; i < timeoutMs; ++i) {
+        if (pred())
+            return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return pred();
+}
+
+// Рассылает кадры; клиент, начавший PLAY, получает их с первого IDR.
+void BroadcastFrames(RtspServer& server, RtpPacketizer& packetizer,
+                     const std::vector<NvEncPacket>& frames)
+{
+    RtpPacketBatch batch;
+    for (const NvEncPacket& p : frames) {
+        packetizer.Packetize(p.data.data(), p.data.nals(), FrameRtpTs(p), p.keyframe, batch);
+        server.Broadcast(batch);
+    }
+}
+
+// Принятые пакеты собираются в кадры и сверяются с отправленными.
+struct FrameChecker
+{
+    RtpDepacketizer rx{ NalCodec::H264 };
+    const std::vector<NvEncPacket>& frames;
+    size_t next = 0;
+    bool haveSeq = false;
+    uint16_t seq = 0;
+
+    explicit FrameChecker(const std::vector<NvEncPacket>& f) : frames(f) {}
+
+    void Push(const std::vector<uint8_t>& pkt)
+    {
+        RtpHeaderView h;
+        CHECK(ParseRtpHeader(pkt.data(), pkt.size(), h));
+        CHECK_EQ(h.pt, 96);
+        if (haveSeq)
+            CHECK_EQ(h.seq, (uint16_t)(seq + 1));
+        haveSeq = true;
+        seq = h.seq;
+        CHECK(rx.Push(pkt.data(), pkt.size()));
+        if (!rx.FrameDone())
+            return;
+        CHECK(next < frames.size());
+        const NvEncPacket& p = frames[next++];
+        CHECK_EQ(rx.FrameTs(), FrameRtpTs(p));
+        CHECK(rx.Units() == ExpectedUnits(p.data.data(), p.data.nals(), NalCodec::H264));
+    }
+};
+
+void TestTcpSession(const std::vector<NvEncPacket>& frames)
+{
+    RtspServer server;
+    uint16_t port = 0;
+    CHECK(TestStartServer(server, port));
+    server.SetVideoDesc(VideoDesc(frames));
+    const std::string url = "rtsp://127.0.0.1:" + std::to_string(port) + "/live";
+
+    TestRtspClient c;
+    CHECK(c.Connect(port));
+    TestRtspResponse r;
+
+    CHECK(c.Request("OPTIONS", url, "", r));
+    CHECK_EQ(r.status, 200);
+    CHECK(r.Header("Public").find("PLAY") != std::string::npos);
+
+    CHECK(c.Request("DESCRIBE", "rtsp://127.0.0.1:" + std::to_string(port) + "/other", "", r));
+    CHECK_EQ(r.status, 404);
+
+    CHECK(c.Request("DESCRIBE", url, "Accept: application/sdp\r\n", r));
+    CHECK_EQ(r.status, 200);
+    CHECK(r.Header("Content-Type") == "application/sdp");
+    CHECK(r.body.find("a=rtpmap:96 H264/90000") != std::string::npos);
+    CHECK(r.body.find("sprop-parameter-sets=") != std::string::npos);
+
+    // PLAY до SETUP - сессии нет.
+    CHECK(c.Request("PLAY", url, "", r));
+    CHECK_EQ(r.status, 454);
+
+    CHECK(c.Request("SETUP", url + "/trackID=0", "Transport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n", r));
+    CHECK_EQ(r.status, 200);
+    CHECK(r.Header("Transport").find("interleaved=0-1") != std::string::npos);
+    CHECK(!c.Session().empty());
+
+    CHECK(c.Request("PLAY", url, "Range: npt=0.000-\r\n", r));
+    CHECK_EQ(r.status, 200);
+    CHECK(r.Header("RTP-Info").find("rtptime=") != std::string::npos);
+    CHECK(WaitFor([&] { return server.HasPendingJoins(); }));
+    // Кэша GOP нет - клиент ждёт ближайший IDR, как в плагине.
+    server.SendToJoiners(RtpPacketBatch());
+
+    RtpPacketizer packetizer(NalCodec::H264, 96, 0xCAFE, 1000);
+    BroadcastFrames(server, packetizer, frames);
+
+    FrameChecker check(frames);
+    uint8_t ch = 0;
+    std::vector<uint8_t> data;
+    while (check.next < frames.size()) {
+        CHECK(c.ReadInterleaved(ch, data, 2000));
+        if (ch == 1)
+            continue;   // SR
+        CHECK_EQ(ch, 0);
+        check.Push(data);
+    }
+
+    // RTCP PLI (RFC 4585) по каналу 1 - запрос ключевого кадра.
+    const uint8_t pli[] = { 0x81, 206, 0, 2, 0, 0, 0, 1, 0, 0, 0xCA, 0xFE };
+    CHECK(c.SendInterleaved(1, pli, sizeof(pli)));
+    CHECK(WaitFor([&] { return server.TakeKeyframeRequest(); }));
+
+    CHECK(c.Request("TEARDOWN", url, "", r));
+    CHECK_EQ(r.status, 200);
+    CHECK(c.WaitClosed(2000));
+    CHECK(WaitFor([&] { return server.ClientCount() == 0; }));
+    server.Stop();
+}
+
+void TestUdpSession(const std::vector<NvEncPacket>& frames)
+{
+    RtspServer server;
+    uint16_t port = 0;
+    CHECK(TestStartServer(server, port));
+    server.SetVideoDesc(VideoDesc(frames));
+    const std::string url = "rtsp://127.0.0.1:" + std::to_string(port) + "/live";
+
+    int rtpFd = -1, rtcpFd = -1;
+    uint16_t rtpPort = 0;
+    CHECK(TestUdpBindPair(rtpFd, rtcpFd, rtpPort));
+
+    TestRtspClient c;
+    CHECK(c.Connect(port));
+    TestRtspResponse r;
+    CHECK(c.Request("SETUP", url + "/trackID=0",
+                    "Transport: RTP/AVP;unicast;client_port=" + std::to_string(rtpPort) + "-" +
+                    std::to_string(rtpPort + 1) + "\r\n", r));
+    CHECK_EQ(r.status, 200);
+    CHECK(r.Header("Transport").find("server_port=") != std::string::npos);
+    CHECK(c.Request("PLAY", url, "", r));
+    CHECK_EQ(r.status, 200);
+    CHECK(WaitFor([&] { return server.HasPendingJoins(); }));
+    server.SendToJoiners(RtpPacketBatch());
+
+    RtpPacketizer packetizer(NalCodec::H264, 96, 0xBEEF, 7);
+    BroadcastFrames(server, packetizer, frames);
+
+    FrameChecker check(frames);
+    std::vector<uint8_t> data;
+    while (check.next < frames.size()) {
+        CHECK(TestUdpRecv(rtpFd, data, 2000));
+        check.Push(data);
+    }
+
+    // SR приходит на RTCP-порт клиента не позже чем через секунду.
+    bool sr = false;
+    for (int i = 0; i < 5 && !sr; ++i)
+        sr = TestUdpRecv(rtcpFd, data, 500) && data.size() >= 28 && data[1] == 200;
+    CHECK(sr);
+
+    CHECK(c.Request("TEARDOWN", url, "", r));
+    CHECK_EQ(r.status, 200);
+    TestUdpClose(rtpFd);
+    TestUdpClose(rtcpFd);
+    server.Stop();
+}
+
+// SETUP по TCP и PLAY; сервер ждёт SendToJoiners для этого клиента.
+void PlayTcp(RtspServer& server, TestRtspClient& c, uint16_t port)
+{
+    const std::string url = "rtsp://127.0.0.1:" + std::to_string(port) + "/live";
+    CHECK(c.Connect(port));
+    TestRtspResponse r;
+    CHECK(c.Request("SETUP", url + "/trackID=0", "Transport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n", r));
+    CHECK_EQ(r.status, 200);
+    CHECK(c.Request("PLAY", url, "", r));
+    CHECK_EQ(r.status, 200);
+    CHECK(WaitFor([&] { return server.HasPendingJoins(); }));
+}
+
+void ReadFramesTcp(TestRtspClient& c, FrameChecker& check)
+{
+    uint8_t ch = 0;
+    std::vector<uint8_t> data;
+    while (check.next < check.frames.size()) {
+        CHECK(c.ReadInterleaved(ch, data, 2000));
+        if (ch == 1)
+            continue;
+        CHECK_EQ(ch, 0);
+        check.Push(data);
+    }
+}
+
+// Клиент пришёл посреди GOP: как в плагине, он сразу получает кэш от
+// последнего IDR, и нумерация RTP непрерывно переходит в живые кадры.
+// Клиент, смотрящий с начала, кэша не видит - у него ни пропусков, ни
+// повторов.
+void TestMidGopJoin(const std::vector<NvEncPacket>& frames)
+{
+    // IDR каждые 10 кадров; новый клиент приходит на 6-м кадре GOP.
+    const size_t kGop = 10;
+    const size_t kJoinAt = 2 * kGop + 6;
+    std::vector<NvEncPacket> gopFrames(frames);
+    for (size_t i = 0; i < gopFrames.size(); ++i)
+        gopFrames[i].keyframe = i % kGop == 0;
+
+    RtspServer server;
+    uint16_t port = 0;
+    CHECK(TestStartServer(server, port));
+    server.SetVideoDesc(VideoDesc(frames));
+
+    TestRtspClient early;
+    PlayTcp(server, early, port);
+    server.SendToJoiners(RtpPacketBatch());
+
+    GopCache cache(4 * 1024 * 1024);
+    RtpPacketizer packetizer(NalCodec::H264, 96, 0xF00D, 65500);
+    RtpPacketBatch batch;
+    auto live = [&](const NvEncPacket& p) {
+        packetizer.Packetize(p.data.data(), p.data.nals(), FrameRtpTs(p), p.keyframe, batch);
+        server.Broadcast(batch, p.data);
+        cache.Push(p);
+    };
+    for (size_t i = 0; i < kJoinAt; ++i)
+        live(gopFrames[i]);
+    CHECK_EQ(cache.Frames(), kJoinAt - 2 * kGop);
+
+    TestRtspClient late;
+    PlayTcp(server, late, port);
+
+    std::vector<NvEncPacket> gop;
+    cache.Snapshot(gop);
+    CHECK(gop[0].keyframe);
+    std::vector<uint32_t> rtpTs;
+    for (const NvEncPacket& p : gop)
+        rtpTs.push_back(FrameRtpTs(p));
+    RtpPacketBatch burst;
+    std::vector<NvEncPacketRef> burstFrames;
+    PacketizeGopBurst(packetizer, gop, rtpTs, burst, burstFrames);
+    server.SendToJoiners(burst, burstFrames);
+
+    for (size_t i = kJoinAt; i < gopFrames.size(); ++i)
+        live(gopFrames[i]);
+
+    FrameChecker all(gopFrames);
+    ReadFramesTcp(early, all);
+
+    // Поздний клиент: кадры с последнего IDR до конца, номера подряд,
+    // последний пакет кэша - прямо перед первым живым.
+    std::vector<NvEncPacket> expect(gopFrames.begin() + 2 * kGop, gopFrames.end());
+    FrameChecker fromIdr(expect);
+    ReadFramesTcp(late, fromIdr);
+    CHECK_EQ(fromIdr.seq, (uint16_t)(packetizer.NextSeq() - 1));
+    CHECK_EQ(all.seq, fromIdr.seq);
+
+    server.Stop();
+}
+
+// Заголовок запроса без конца больше 16 КБ - клиент отключается.
+void TestHeaderOverflow()
+{
+    RtspServer server;
+    uint16_t port = 0;
+    CHECK(TestStartServer(server, port));
+
+    TestRtspClient c;
+    CHECK(c.Connect(port));
+    std::string junk = "OPTIONS rtsp://127.0.0.1/live RTSP/1.0\r\nX-Pad: ";
+    junk.append(20000, 'a');
+    CHECK(c.SendRaw(junk.data(), junk.size()));
+    CHECK(c.WaitClosed(2000));
+    CHECK(WaitFor([&] { return server.ClientCount() == 0; }));
+
+    // Сервер жив и принимает следующих.
+    TestRtspClient c2;
+    CHECK(c2.Connect(port));
+    TestRtspResponse r;
+    CHECK(c2.Request("OPTIONS", "rtsp://127.0.0.1/live", "", r));
+    CHECK_EQ(r.status, 200);
+    server.Stop();
+}
+
+} // namespace
+
+int main()
+{
+    const std::vector<NvEncPacket> frames = EncodeFrames(kFrames);
+    TestTcpSession(frames);
+    TestUdpSession(frames);
+    TestMidGopJoin(frames);
+    TestHeaderOverflow();
+    printf("RtspLoopbackTest OK\n");
+    return 0;
+}
@@ -0,0 +1,298 @@
+// Simulcast на FakeNvenc/FakeD3D11, как его ведёт плагин: render thread
+// снимает кадр в кольцо ladder (RGB -> NV12 один раз), кольца ступеней
+// берут этот NV12 и масштабируют под свой размер, каждая ступень кодирует
+// своим энкодером. Ступень, убранная или остановленная посреди работы, не
+// мешает остальным; Stop/Start лесенки открывает новые энкодеры всем
+// ступеням, и они снова кодируют с IDR.
+
+#include <memory>
+
+#include "ColorConvert.h"
+#include "FakeNvenc.h"
+#include "FrameCaptureRing.h"
+#include "NvencEncoder.h"
+#include "Resize.h"
+#include "TestSupport.h"
+
+namespace {
+
+const uint32_t kW = 320;
+const uint32_t kH = 240;
+const int64_t kPeriod = 333333;   // 30 fps в 100 нс
+
+struct Rung
+{
+    uint32_t w = 0;
+    uint32_t h = 0;
+    ScaleFilter filter = ScaleFilter::Bilinear;
+    std::unique_ptr<FrameCaptureRing> ring;
+    std::unique_ptr<NvEncoderD3D11Base> enc;
+    NvEncSettings settings;
+    bool running = false;
+    std::vector<NvEncPacket> packets;
+};
+
+std::unique_ptr<NvEncoderD3D11Base> NewEncoder(FakeGpu& gpu, uint32_t w, uint32_t h)
+{
+    auto enc = CreateNvEncoder(NVRTSP_CODEC_H264, gpu.dev.Get(), gpu.ctx.Get(), w, h, 30, 1, 2000);
+    CHECK(enc);
+    CHECK(enc->Initialize(FakeNvencFunctionList()));
+    CHECK(enc->SetColorConversion(NVRTSP_COLOR_NV12_LIMITED));
+    return enc;
+}
+
+// Ступень (и ladder - ступень без масштаба): кольцо с форматом, как его
+// задаёт update_capture_format, и свой энкодер.
+std::unique_ptr<Rung> NewRung(FakeGpu& gpu, uint32_t w, uint32_t h, ScaleFilter filter)
+{
+    std::unique_ptr<Rung> r(new Rung());
+    r->w = w;
+    r->h = h;
+    r->filter = filter;
+    r->ring.reset(new FrameCaptureRing(gpu.dev.Get(), 4, 30));
+    CaptureFormat fmt;
+    fmt.w = w;
+    fmt.h = h;
+    fmt.nv12 = true;
+    fmt.filter = filter;
+    r->ring->SetFormat(fmt);
+    r->enc = NewEncoder(gpu, w, h);
+    r->running = true;
+    return r;
+}
+
+// NV12 ступени - это плоскости NV12 ladder, масштабированные эталоном.
+void CheckScaledFrom(ID3D11Texture2D* ladder, ID3D11Texture2D* rung, ScaleFilter filter)
+{
+    D3D11_TEXTURE2D_DESC ld;
+    D3D11_TEXTURE2D_DESC rd;
+    ladder->GetDesc(&ld);
+    rung->GetDesc(&rd);
+    CHECK_EQ(ld.Format, DXGI_FORMAT_NV12);
+    CHECK_EQ(rd.Format, DXGI_FORMAT_NV12);
+
+    std::vector<uint8_t> expected(rung->DataSize());
+    ScaleNv12(ladder->Data(), ladder->Data() + (size_t)ladder->RowPitch() * ld.Height,
+              ladder->RowPitch(), ld.Width, ld.Height,
+              expected.data(), expected.data() + (size_t)rung->RowPitch() * rd.Height,
+              rung->RowPitch(), rd.Width, rd.Height, filter);
+    CHECK(memcmp(rung->Data(), expected.data(), expected.size()) == 0);
+}
+
+// Кадр ступени, снятый без ladder: масштаб RGBA и свой проход NV12.
+void CheckConvertedFrom(ID3D11Texture2D* src, ID3D11Texture2D* rung, ScaleFilter filter)
+{
+    D3D11_TEXTURE2D_DESC rd;
+    rung->GetDesc(&rd);
+
+    std::vector<uint8_t> rgba((size_t)rd.Width * rd.Height * 4);
+    ScaleRgba(src->Data(), src->RowPitch(), true, kW, kH,
+              rgba.data(), rd.Width * 4, rd.Width, rd.Height, filter);
+    std::vector<uint8_t> expected(rung->DataSize());
+    ConvertRgbaToNv12(rgba.data(), rd.Width * 4, false, rd.Width, rd.Height,
+                      expected.data(), rung->RowPitch(),
+                      expected.data() + (size_t)rung->RowPitch() * rd.Height, rung->RowPitch(),
+                      Nv12Range::Limited);
+    CHECK(memcmp(rung->Data(), expected.data(), expected.size()) == 0);
+}
+
+// Шаг пула: ladder и работающие ступени забирают свежий кадр и кодируют его
+// без копии (NV12 другого размера энкодер бы отклонил). Кадр ступени
+// сверяется с NV12 ladder до того, как слоты уйдут в NVENC.
+void Step(Rung& ladder, std::vector<std::unique_ptr<Rung>>& rungs)
+{
+    CapturedFrame lf;
+    CHECK(ladder.ring->AcquireLatest(lf, std::chrono::milliseconds(0)));
+
+    std::vector<CapturedFrame> frames(rungs.size());
+    for (size_t i = 0; i < rungs.size(); ++i) {
+        if (!rungs[i]->running)
+            continue;
+        CHECK(rungs[i]->ring->AcquireLatest(frames[i], std::chrono::milliseconds(0)));
+        CHECK_EQ(frames[i].ts100ns, lf.ts100ns);
+        CheckScaledFrom(lf.tex, frames[i].tex, rungs[i]->filter);
+    }
+
+    auto encode = [](Rung& r, const CapturedFrame& f) {
+        std::vector<NvEncPacket> out;
+        uint64_t idx = 0;
+        CHECK(r.enc->EncodeTextureNoCopy(f.tex, f.ts100ns, out, &idx));
+        r.ring->MarkSubmitted(f.slot, idx);
+        if (out.empty())
+            r.enc->WaitForPackets(out, INFINITE);
+        r.packets.insert(r.packets.end(), out.begin(), out.end());
+        r.ring->SetCompletedFrames(r.enc->CompletedFrames());
+    };
+    encode(ladder, lf);
+    for (size_t i = 0; i < rungs.size(); ++i) {
+        if (rungs[i]->running)
+            encode(*rungs[i], frames[i]);
+    }
+}
+
+// Render thread: кадр в ladder, затем в работающие ступени из его NV12.
+void Capture(FakeGpu& gpu, ID3D11Texture2D* src, int64_t ts, Rung& ladder,
+             std::vector<std::unique_ptr<Rung>>& rungs)
+{
+    CHECK(ladder.ring->Capture(gpu.ctx.Get(), src, ts));
+    for (auto& r : rungs) {
+        if (r->running)
+            CHECK(r->ring->Capture(gpu.ctx.Get(), src, ts, ladder.ring.get()));
+    }
+}
+
+// Кадры стрима подряд с шагом kPeriod от first, IDR по GOP от начала.
+void CheckStream(Rung& r, size_t frames, int64_t first, uint32_t gop)
+{
+    std::vector<NvEncPacket> tail;
+    r.enc->Flush(tail);
+    r.packets.insert(r.packets.end(), tail.begin(), tail.end());
+    CHECK_EQ(r.packets.size(), frames);
+    for (size_t i = 0; i < r.packets.size(); ++i) {
+        CHECK_EQ(r.packets[i].ts100ns, first + (int64_t)i * kPeriod);
+        CHECK_EQ(r.packets[i].keyframe, i % gop == 0);
+    }
+    r.packets.clear();
+}
+
+// Один захват - кадры всех размеров: ступень того же размера копирует NV12
+// ladder, меньшие масштабируют его (билинейно и Lanczos).
+void TestRenditionSizes()
+{
+    FakeGpu gpu;
+    auto src = gpu.NewTexture(kW, kH);
+
+    auto ladder = NewRung(gpu, kW, kH, ScaleFilter::Bilinear);
+    std::vector<std::unique_ptr<Rung>> rungs;
+    rungs.push_back(NewRung(gpu, kW, kH, ScaleFilter::Bilinear));
+    rungs.push_back(NewRung(gpu, 160, 120, ScaleFilter::Bilinear));
+    rungs.push_back(NewRung(gpu, 96, 72, ScaleFilter::Lanczos));
+
+    for (uint32_t i = 0; i < 12; ++i) {
+        FillPattern(src.Get(), i);
+        Capture(gpu, src.Get(), (int64_t)i * kPeriod, *ladder, rungs);
+        Step(*ladder, rungs);
+    }
+    CheckStream(*ladder, 12, 0, 30);
+    for (auto& r : rungs)
+        CheckStream(*r, 12, 0, 30);
+}
+
+// Ladder кадр пропустил (другой момент времени) - ступень не берёт чужой
+// NV12, а снимает сама: масштаб RGBA и свой проход NV12. Ступень крупнее
+// кадра ladder из него тоже не растягивает.
+void TestFallback()
+{
+    FakeGpu gpu;
+    auto src = gpu.NewTexture(kW, kH);
+    FillPattern(src.Get(), 3);
+
+    auto ladder = NewRung(gpu, 160, 120, ScaleFilter::Bilinear);
+    auto small = NewRung(gpu, 96, 72, ScaleFilter::Bilinear);
+    auto large = NewRung(gpu, 240, 180, ScaleFilter::Bilinear);
+
+    CHECK(ladder->ring->Capture(gpu.ctx.Get(), src.Get(), 0));
+    CHECK(small->ring->Capture(gpu.ctx.Get(), src.Get(), kPeriod, ladder->ring.get()));
+    CHECK(large->ring->Capture(gpu.ctx.Get(), src.Get(), 0, ladder->ring.get()));
+
+    CapturedFrame f;
+    CHECK(small->ring->AcquireLatest(f, std::chrono::milliseconds(0)));
+    CheckConvertedFrom(src.Get(), f.tex, ScaleFilter::Bilinear);
+    CHECK(large->ring->AcquireLatest(f, std::chrono::milliseconds(0)));
+    CheckConvertedFrom(src.Get(), f.tex, ScaleFilter::Bilinear);
+}
+
+// Посреди работы одна ступень уничтожена (NVRTSP_Destroy), другая
+// остановлена (NVRTSP_Stop): ladder и оставшаяся ступень не теряют кадров.
+// Stop/Start лесенки: все энкодеры новые с прежними настройками, кольца
+// сброшены, и остановленная раньше ступень снова кодирует с IDR.
+void TestRemoveAndRestart()
+{
+    FakeGpu gpu;
+    auto src = gpu.NewTexture(kW, kH);
+
+    auto ladder = NewRung(gpu, kW, kH, ScaleFilter::Bilinear);
+    CHECK(ladder->enc->Reconfigure(0, 0, 0, 10));
+    std::vector<std::unique_ptr<Rung>> rungs;
+    rungs.push_back(NewRung(gpu, 160, 120, ScaleFilter::Bilinear));
+    rungs.push_back(NewRung(gpu, 96, 72, ScaleFilter::Lanczos));
+    rungs.push_back(NewRung(gpu, 128, 96, ScaleFilter::Bilinear));
+    for (auto& r : rungs)
+        CHECK(r->enc->Reconfigure(0, 0, 0, 10));
+
+    int64_t ts = 0;
+    for (int i = 0; i < 8; ++i, ts += kPeriod) {
+        FillPattern(src.Get(), (uint32_t)i);
+        Capture(gpu, src.Get(), ts, *ladder, rungs);
+        Step(*ladder, rungs);
+    }
+
+    // Destroy ступени 128x96: хвост энкодера, ступень убрана из лесенки.
+    std::vector<NvEncPacket> tail;
+    rungs[2]->enc->Flush(tail);
+    rungs.pop_back();
+    // Stop ступени 96x72: энкодер закрыт, render thread и шаг её пропускают.
+    rungs[1]->enc->Flush(tail);
+    rungs[1]->settings = rungs[1]->enc->Settings();
+    rungs[1]->enc.reset();
+    rungs[1]->running = false;
+    rungs[1]->packets.clear();
+
+    for (int i = 8; i < 20; ++i, ts += kPeriod) {
+        FillPattern(src.Get(), (uint32_t)i);
+        Capture(gpu, src.Get(), ts, *ladder, rungs);
+        Step(*ladder, rungs);
+    }
+    CheckStream(*ladder, 20, 0, 10);
+    CheckStream(*rungs[0], 20, 0, 10);
+
+    // Stop лесенки.
+    ladder->settings = ladder->enc->Settings();
+    ladder->enc.reset();
+    for (auto& r : rungs) {
+        if (r->running)
+            r->settings = r->enc->Settings();
+        r->enc.reset();
+        r->running = false;
+    }
+
+    // Start: prepare_encoder_locked для ladder и каждой ступени.
+    auto restart = [&gpu](Rung& r) {
+        r.enc = NewEncoder(gpu, r.w, r.h);
+        CHECK(r.enc->ApplySettings(r.settings));
+        CHECK_EQ(r.enc->GopLength(), 10);
+        r.ring->Reset();
+        r.running = true;
+    };
+    restart(*ladder);
+    for (auto& r : rungs)
+        restart(*r);
+
+    const int64_t restartTs = ts + 5 * kPeriod;
+    ts = restartTs;
+    for (int i = 0; i < 15; ++i, ts += kPeriod) {
+        FillPattern(src.Get(), (uint32_t)(100 + i));
+        Capture(gpu, src.Get(), ts, *ladder, rungs);
+        Step(*ladder, rungs);
+    }
+    CheckStream(*ladder, 15, restartTs, 10);
+    for (auto& r : rungs) {
+        CheckStream(*r, 15, restartTs, 10);
+        CHECK_EQ(r->ring->DroppedFrames(), 0);
+    }
+}
+
+} // namespace
+
+int main()
+{
+    FakeNvencConfig cfg;
+    cfg.encodeDelayUs = 200;
+    FakeNvencSetConfig(cfg);
+
+    TestRenditionSizes();
+    TestFallback();
+    TestRemoveAndRestart();
+    printf("SimulcastPipelineTest OK\n");
+    return 0;
+}
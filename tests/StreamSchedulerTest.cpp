@@ -0,0 +1,197 @@
+// StreamScheduler с многими стримами на малом пуле: каждый стрим идёт со
+// своей частотой, один стрим не выполняется двумя потоками сразу, сроки
+// новых стримов разнесены, опоздания на перегруженном пуле видны в
+// счётчиках, Remove дожидается идущего шага и отдаёт итог.
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "StreamScheduler.h"
+#include "TestSupport.h"
+
+namespace {
+
+const int64_t kNsPerMs = 1000000;
+
+void BusyNs(int64_t ns)
+{
+    const int64_t end = StreamScheduler::NowNs() + ns;
+    while (StreamScheduler::NowNs() < end) {
+    }
+}
+
+// Стрим с фиксированным периодом и работой на шаг; сроки - по сетке от
+// первого шага, как у FramePacer.
+class TestStream : public ScheduledStream
+{
+public:
+    TestStream(int64_t periodNs, int64_t workNs) : m_periodNs(periodNs), m_workNs(workNs) {}
+
+    StreamStep RunStep(int64_t) override
+    {
+        if (m_inStep.exchange(true))
+            m_overlap = true;
+
+        const int64_t now = StreamScheduler::NowNs();
+        if (!m_firstNs)
+            m_firstNs = now;
+        ++m_steps;
+        if (m_workNs)
+            BusyNs(m_workNs);
+
+        StreamStep next;
+        m_next = m_next ? m_next + m_periodNs : now + m_periodNs;
+        // Отстали - на ближайший будущий срок, как Skip у пейсера.
+        while (m_next <= StreamScheduler::NowNs())
+            m_next += m_periodNs;
+        next.dueNs = m_next;
+
+        m_inStep = false;
+        return next;
+    }
+
+    uint64_t Steps() const { return m_steps.load(); }
+    int64_t FirstNs() const { return m_firstNs; }
+    bool Overlapped() const { return m_overlap.load(); }
+
+private:
+    int64_t m_periodNs;
+    int64_t m_workNs;
+    int64_t m_next = 0;
+    int64_t m_firstNs = 0;
+    std::atomic<uint64_t> m_steps{0};
+    std::atomic<bool> m_inStep{false};
+    std::atomic<bool> m_overlap{false};
+};
+
+// 48 стримов 60/30/25 fps на 2 потоках в течение секунды: шагов по частоте,
+// промахов почти нет, ни один шаг не перекрылся.
+void TestManyStreams()
+{
+    StreamScheduler sched(2);
+    const int64_t periods[3] = { 1000000000LL / 60, 1000000000LL / 30, 1000000000LL / 25 };
+
+    std::vector<std::unique_ptr<TestStream>> streams;
+    std::vector<int> ids;
+    for (int i = 0; i < 48; ++i) {
+        const int64_t period = periods[i % 3];
+        streams.emplace_back(new TestStream(period, 50000));
+        ids.push_back(sched.Add(streams.back().get(), period));
+    }
+
+    const int64_t runNs = 1000 * kNsPerMs;
+    std::this_thread::sleep_for(std::chrono::nanoseconds(runNs));
+
+    uint64_t steps = 0;
+    uint64_t misses = 0;
+    for (size_t i = 0; i < streams.size(); ++i) {
+        StreamSchedStats st;
+        sched.Remove(ids[i], &st);
+        CHECK(!streams[i]->Overlapped());
+
+        const int64_t period = periods[i % 3];
+        const uint64_t expected = (uint64_t)(runNs / period);
+        CHECK(streams[i]->Steps() + 2 >= expected * 8 / 10);
+        CHECK(streams[i]->Steps() <= expected + 2);
+        CHECK_EQ(st.steps, streams[i]->Steps());
+        CHECK(st.lateMaxNs >= 0);
+        steps += st.steps;
+        misses += st.deadlineMisses;
+    }
+    printf("  48 streams / 2 threads: %llu steps, %llu deadline misses\n",
+           (unsigned long long)steps, (unsigned long long)misses);
+    CHECK(misses * 20 <= steps);
+}
+
+// Сроки первых шагов разнесены по периоду: 16 стримов, добавленных
+// одновременно, не стартуют в одну миллисекунду.
+void TestFirstDeadlinesSpread()
+{
+    StreamScheduler sched(4);
+    const int64_t period = 100 * kNsPerMs;
+
+    std::vector<std::unique_ptr<TestStream>> streams;
+    std::vector<int> ids;
+    const int64_t t0 = StreamScheduler::NowNs();
+    for (int i = 0; i < 16; ++i) {
+        streams.emplace_back(new TestStream(period, 0));
+        ids.push_back(sched.Add(streams.back().get(), period));
+    }
+    std::this_thread::sleep_for(std::chrono::nanoseconds(period + 20 * kNsPerMs));
+    for (int id : ids)
+        sched.Remove(id);
+
+    std::vector<int64_t> firsts;
+    for (const auto& s : streams) {
+        CHECK(s->FirstNs() > 0);
+        firsts.push_back(s->FirstNs() - t0);
+    }
+    std::sort(firsts.begin(), firsts.end());
+    CHECK(firsts.back() < period + 20 * kNsPerMs);
+    // Шаг золотого сечения: разброс 16 стартов - больше половины периода.
+    CHECK(firsts.back() - firsts.front() > period / 2);
+}
+
+// Один поток и стрим с шагом длиннее периода: второй стрим начинает шаги
+// позже срока - промахи и опоздание видны в его счётчиках, но шаги идут.
+void TestOverloadedPool()
+{
+    StreamScheduler sched(1);
+    const int64_t period = 20 * kNsPerMs;
+
+    TestStream slow(period, 30 * kNsPerMs);
+    TestStream fast(period, 0);
+    const int slowId = sched.Add(&slow, period);
+    const int fastId = sched.Add(&fast, period);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    StreamSchedStats slowSt, fastSt;
+    sched.Remove(slowId, &slowSt);
+    sched.Remove(fastId, &fastSt);
+
+    CHECK(slowSt.steps > 0);
+    CHECK(fastSt.steps >= 5);
+    CHECK(fastSt.deadlineMisses > 0);
+    CHECK(fastSt.lateMaxNs > period / 4);
+    CHECK(fastSt.lateAvgNs > 0 && fastSt.lateAvgNs <= fastSt.lateMaxNs);
+}
+
+// Remove ждёт идущий шаг; Wake вызывает шаг раньше срока.
+void TestRemoveAndWake()
+{
+    StreamScheduler sched(1);
+    // Первый стрим пула стартует сразу, второй - через 0.618 периода.
+    TestStream first(1000 * kNsPerMs, 0);
+    const int firstId = sched.Add(&first, 1000 * kNsPerMs);
+    TestStream stream(1000 * kNsPerMs, 50 * kNsPerMs);
+    const int id = sched.Add(&stream, 1000 * kNsPerMs);
+    sched.Wake(id);
+
+    // Первый шаг (по Wake) идёт 50 мс; Remove должен его дождаться.
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    StreamSchedStats st;
+    sched.Remove(id, &st);
+    CHECK_EQ(stream.Steps(), 1);
+    CHECK(!stream.Overlapped());
+    // Шаг по Wake - служебный, в счётчики сроков не входит.
+    CHECK_EQ(st.steps, 0);
+
+    StreamSchedStats gone;
+    CHECK(!sched.GetStats(id, gone));
+    sched.Remove(firstId);
+}
+
+} // namespace
+
+int main()
+{
+    TestManyStreams();
+    TestFirstDeadlinesSpread();
+    TestOverloadedPool();
+    TestRemoveAndWake();
+    printf("StreamSchedulerTest OK\n");
+    return 0;
+}
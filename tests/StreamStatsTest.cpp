@@ -0,0 +1,172 @@
+// LatencyHistogram: перцентили на известных выборках, границы корзин,
+// пустая гистограмма, значения за пределами диапазона и запись из
+// нескольких потоков.
+
+#include <thread>
+
+#include "StreamStats.h"
+#include "TestSupport.h"
+
+namespace {
+
+// Погрешность корзины - 1/16 значения (16 частей на степень двойки).
+void CheckNear(int64_t got, int64_t exact)
+{
+    const int64_t err = got > exact ? got - exact : exact - got;
+    if (err * 16 > exact) {
+        fprintf(stderr, "value %lld, expected %lld +- 1/16\n", (long long)got, (long long)exact);
+        CHECK(err * 16 <= exact);
+    }
+}
+
+void TestEmpty()
+{
+    LatencyHistogram h;
+    LatencySummary s = h.Summarize();
+    CHECK_EQ(s.count, 0);
+    CHECK_EQ(s.p50Ns, 0);
+    CHECK_EQ(s.p99Ns, 0);
+    CHECK_EQ(s.maxNs, 0);
+}
+
+// Значения меньше 32 - каждое в своей корзине, перцентили точные.
+void TestSmallValuesExact()
+{
+    LatencyHistogram h;
+    for (int v = 0; v < 32; ++v)
+        h.Record(v);
+    LatencySummary s = h.Summarize();
+    CHECK_EQ(s.count, 32);
+    CHECK_EQ(s.p50Ns, 15);   // 16-е по порядку
+    CHECK_EQ(s.p99Ns, 31);   // ранг ceil(32 * 0.99) = 32
+    CHECK_EQ(s.maxNs, 31);
+}
+
+// 1..100: p50 - 50-е значение, p99 - 99-е (ранг с округлением вверх).
+void TestKnownSamples()
+{
+    LatencyHistogram h;
+    for (int v = 1; v <= 100; ++v)
+        h.Record(v);
+    LatencySummary s = h.Summarize();
+    CHECK_EQ(s.count, 100);
+    CheckNear(s.p50Ns, 50);
+    CheckNear(s.p99Ns, 99);
+    CHECK_EQ(s.maxNs, 100);
+
+    // 1 мкс..1 мс шагом 1 мкс, в обратном порядке - порядок записи не важен.
+    LatencyHistogram us;
+    for (int i = 1000; i >= 1; --i)
+        us.Record((int64_t)i * 1000);
+    s = us.Summarize();
+    CHECK_EQ(s.count, 1000);
+    CheckNear(s.p50Ns, 500000);
+    CheckNear(s.p99Ns, 990000);
+    CHECK_EQ(s.maxNs, 1000000);
+
+    // Хвост: 1% медленных кадров ещё не p99, 1.1% - уже он.
+    LatencyHistogram tail;
+    for (int i = 0; i < 990; ++i)
+        tail.Record(2000000);
+    for (int i = 0; i < 10; ++i)
+        tail.Record(50000000);
+    s = tail.Summarize();
+    CheckNear(s.p50Ns, 2000000);
+    CheckNear(s.p99Ns, 2000000);
+    CHECK_EQ(s.maxNs, 50000000);
+    tail.Record(50000000);
+    s = tail.Summarize();
+    CheckNear(s.p99Ns, 50000000);
+}
+
+// Границы корзин: 32 и 33 - одна корзина шириной 2 (середина 33), 63 и 64 -
+// соседние; середина корзины не выше реального максимума.
+void TestBucketEdges()
+{
+    LatencyHistogram a;
+    a.Record(32);
+    a.Record(33);
+    LatencySummary s = a.Summarize();
+    CHECK_EQ(s.p50Ns, 33);
+    CHECK_EQ(s.p99Ns, 33);
+
+    LatencyHistogram b;
+    b.Record(63);
+    b.Record(64);
+    s = b.Summarize();
+    CHECK_EQ(s.p50Ns, 63);   // корзина [62, 64)
+    CHECK_EQ(s.p99Ns, 64);   // середина [64, 68) - 66, срезана по максимуму
+
+    LatencyHistogram c;
+    c.Record(31);
+    c.Record(32);
+    s = c.Summarize();
+    CHECK_EQ(s.p50Ns, 31);
+    CHECK_EQ(s.p99Ns, 32);
+
+    // Каждая степень двойки - нижняя граница своей корзины.
+    for (int bit = 5; bit < 40; ++bit) {
+        LatencyHistogram p;
+        const int64_t v = 1LL << bit;
+        p.Record(v - 1);
+        p.Record(v);
+        s = p.Summarize();
+        CHECK(s.p50Ns < v);
+        CheckNear(s.p50Ns, v - 1);
+        CHECK_EQ(s.p99Ns, v);
+    }
+}
+
+// Отрицательное значение - 0, сверх 2^40 нс - последняя корзина, но
+// максимум честный.
+void TestOutOfRange()
+{
+    LatencyHistogram h;
+    h.Record(-5);
+    LatencySummary s = h.Summarize();
+    CHECK_EQ(s.count, 1);
+    CHECK_EQ(s.p50Ns, 0);
+    CHECK_EQ(s.maxNs, 0);
+
+    LatencyHistogram big;
+    const int64_t huge = (1LL << 40) + 12345;
+    big.Record(huge);
+    s = big.Summarize();
+    CHECK_EQ(s.maxNs, huge);
+    CHECK_EQ(s.p50Ns, (1LL << 40) - (1LL << 34));
+}
+
+// Запись без блокировок из нескольких потоков: ничего не теряется.
+void TestConcurrentRecord()
+{
+    LatencyHistogram h;
+    const int threads = 4;
+    const int perThread = 100000;
+    std::vector<std::thread> ts;
+    for (int t = 0; t < threads; ++t) {
+        ts.emplace_back([&h, t] {
+            for (int i = 0; i < perThread; ++i)
+                h.Record(1000 + (i % 1000) + t);
+        });
+    }
+    for (std::thread& t : ts)
+        t.join();
+    LatencySummary s = h.Summarize();
+    CHECK_EQ(s.count, (uint64_t)threads * perThread);
+    CHECK_EQ(s.maxNs, 1000 + 999 + threads - 1);
+    CheckNear(s.p50Ns, 1500);
+}
+
+} // namespace
+
+int main()
+{
+    TestEmpty();
+    TestSmallValuesExact();
+    TestKnownSamples();
+    TestBucketEdges();
+    TestOutOfRange();
+    TestConcurrentRecord();
+    printf("StreamStatsTest OK\n");
+    return 0;
+}
@@ -0,0 +1,172 @@
+#include "TestRtp.h"
+
+#include "Av1Obu.h"
+
+bool ParseRtpHeader(const uint8_t* p, size_t n, RtpHeaderView& out)
+{
+    if (n < kRtpHeaderSize || (p[0] >> 6) != 2)
+        return false;
+    out.marker = (p[1] & 0x80) != 0;
+    out.pt = p[1] & 0x7F;
+    out.seq = (uint16_t)((p[2] << 8) | p[3]);
+    out.ts = ((uint32_t)p[4] << 24) | ((uint32_t)p[5] << 16) | ((uint32_t)p[6] << 8) | p[7];
+    out.ssrc = ((uint32_t)p[8] << 24) | ((uint32_t)p[9] << 16) | ((uint32_t)p[10] << 8) | p[11];
+    const size_t hdr = kRtpHeaderSize + (p[0] & 0x0F) * 4;
+    if (n < hdr)
+        return false;
+    out.payload = p + hdr;
+    out.payloadSize = n - hdr;
+    return true;
+}
+
+std::vector<std::vector<uint8_t>> BatchPackets(const RtpPacketBatch& batch)
+{
+    std::vector<std::vector<uint8_t>> out(batch.packets.size());
+    for (size_t i = 0; i < batch.packets.size(); ++i) {
+        out[i].resize(batch.PacketSize(i));
+        batch.CopyPacket(i, out[i].data());
+    }
+    return out;
+}
+
+std::vector<std::vector<uint8_t>> ExpectedUnits(const uint8_t* au, const std::vector<NalUnit>& nals,
+                                                NalCodec codec)
+{
+    std::vector<std::vector<uint8_t>> out;
+    for (const NalUnit& u : nals) {
+        const uint8_t* p = au + u.offset;
+        if (codec != NalCodec::AV1) {
+            out.emplace_back(p, p + u.size);
+            continue;
+        }
+        if (u.type == kObuTemporalDelimiter || u.type == kObuTileList || u.type == kObuPadding)
+            continue;
+        ObuParts parts;
+        if (!SplitObu(p, u.size, parts))
+            continue;
+        std::vector<uint8_t> obu(p, p + parts.headerSize);
+        obu[0] &= (uint8_t)~0x02;
+        obu.insert(obu.end(), p + parts.payloadOffset, p + parts.payloadOffset + parts.payloadSize);
+        out.push_back(obu);
+    }
+    return out;
+}
+
+bool RtpDepacketizer::Push(const uint8_t* p, size_t n)
+{
+    RtpHeaderView h;
+    if (!ParseRtpHeader(p, n, h))
+        return false;
+
+    if (m_done) {
+        m_units.clear();
+        m_inFragment = false;
+        m_ts = h.ts;
+    }
+    else if (h.ts != m_ts || (uint16_t)(m_seq + 1) != h.seq) {
+        return false;
+    }
+    m_seq = h.seq;
+    m_done = h.marker;
+
+    return m_codec == NalCodec::AV1 ? PushAv1(h.payload, h.payloadSize)
+                                    : PushH26x(h.payload, h.payloadSize);
+}
+
+bool RtpDepacketizer::PushH26x(const uint8_t* p, size_t n)
+{
+    const bool h264 = m_codec == NalCodec::H264;
+    const size_t nalHdr = h264 ? 1 : 2;
+    if (n < nalHdr)
+        return false;
+    const uint8_t type = h264 ? (p[0] & 0x1F) : ((p[0] >> 1) & 0x3F);
+
+    if (type == (h264 ? 24 : 48)) {
+        // STAP-A / AP: 16-битная длина перед каждым NAL.
+        size_t pos = nalHdr;
+        while (pos + 2 <= n) {
+            const size_t len = ((size_t)p[pos] << 8) | p[pos + 1];
+            pos += 2;
+            if (!len || pos + len > n)
+                return false;
+            m_units.emplace_back(p + pos, p + pos + len);
+            pos += len;
+        }
+        return pos == n;
+    }
+
+    if (type == (h264 ? 28 : 49)) {
+        const size_t fuHdr = nalHdr + 1;
+        if (n <= fuHdr)
+            return false;
+        const uint8_t fu = p[fuHdr - 1];
+        const bool start = (fu & 0x80) != 0;
+        const bool end = (fu & 0x40) != 0;
+        if (start) {
+            if (m_inFragment)
+                return false;
+            m_partial.clear();
+            // Заголовок NAL восстанавливается из заголовка FU.
+            if (h264) {
+                m_partial.push_back((uint8_t)((p[0] & 0xE0) | (fu & 0x1F)));
+            }
+            else {
+                m_partial.push_back((uint8_t)((p[0] & 0x81) | ((fu & 0x3F) << 1)));
+                m_partial.push_back(p[1]);
+            }
+            m_inFragment = true;
+        }
+        else if (!m_inFragment) {
+            return false;
+        }
+        m_partial.insert(m_partial.end(), p + fuHdr, p + n);
+        if (end) {
+            m_units.push_back(m_partial);
+            m_inFragment = false;
+        }
+        return true;
+    }
+
+    m_units.emplace_back(p, p + n);
+    return true;
+}
+
+bool RtpDepacketizer::PushAv1(const uint8_t* p, size_t n)
+{
+    if (n < 1)
+        return false;
+    const uint8_t agg = p[0];
+    const bool z = (agg & 0x80) != 0;
+    const bool y = (agg & 0x40) != 0;
+    const uint8_t w = (agg >> 4) & 3;
+    if (w != 0 || z != m_inFragment)
+        return false;
+
+    size_t pos = 1;
+    bool first = true;
+    while (pos < n) {
+        uint64_t len = 0;
+        const size_t lb = ReadLeb128(p + pos, n - pos, len);
+        if (!lb || pos + lb + len > n)
+            return false;
+        pos += lb;
+        const bool last = pos + len == n;
+
+        if (first && z)
+            m_partial.insert(m_partial.end(), p + pos, p + pos + len);
+        else
+            m_partial.assign(p + pos, p + pos + len);
+
+        // Последний элемент с Y продолжится в следующем пакете.
+        if (last && y) {
+            m_inFragment = true;
+        }
+        else {
+            m_units.push_back(m_partial);
+            m_inFragment = false;
+        }
+        pos += len;
+        first = false;
+    }
+    return true;
+}
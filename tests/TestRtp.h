@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "AnnexB.h"
+#include "RtpPacketizer.h"
+
+// Приёмная сторона RTP для тестов: разбор заголовка и сборка NAL/OBU
+// обратно из пакетов (RFC 6184, RFC 7798, AOM AV1 RTP).
+
+struct RtpHeaderView
+{
+    uint8_t  pt = 0;
+    bool     marker = false;
+    uint16_t seq = 0;
+    uint32_t ts = 0;
+    uint32_t ssrc = 0;
+    const uint8_t* payload = nullptr;
+    size_t   payloadSize = 0;
+};
+
+bool ParseRtpHeader(const uint8_t* p, size_t n, RtpHeaderView& out);
+
+// Пакеты batch по отдельности, как их увидит получатель.
+std::vector<std::vector<uint8_t>> BatchPackets(const RtpPacketBatch& batch);
+
+// Что должно получиться у приёмника из кадра: NAL без стартовых кодов
+// (H.264/HEVC) или OBU без поля длины и без temporal delimiter/padding (AV1).
+std::vector<std::vector<uint8_t>> ExpectedUnits(const uint8_t* au, const std::vector<NalUnit>& nals,
+                                                NalCodec codec);
+
+// Собирает юниты кадра; кадр закончен на пакете с маркером.
+class RtpDepacketizer
+{
+public:
+    explicit RtpDepacketizer(NalCodec codec) : m_codec(codec) {}
+
+    // false - пакет не разобран (или нарушена нумерация внутри кадра).
+    bool Push(const uint8_t* p, size_t n);
+
+    bool FrameDone() const { return m_done; }
+    uint32_t FrameTs() const { return m_ts; }
+    // Юниты законченного кадра; следующий Push начинает новый кадр.
+    const std::vector<std::vector<uint8_t>>& Units() const { return m_units; }
+
+private:
+    bool PushH26x(const uint8_t* p, size_t n);
+    bool PushAv1(const uint8_t* p, size_t n);
+
+    NalCodec m_codec;
+    std::vector<std::vector<uint8_t>> m_units;
+    std::vector<uint8_t> m_partial;     // FU или фрагмент OBU
+    bool m_inFragment = false;
+    bool m_done = true;
+    bool m_haveSeq = false;
+    uint16_t m_seq = 0;
+    uint32_t m_ts = 0;
+};
@@ -0,0 +1,317 @@
+#include "TestRtspClient.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+#include "RtspServer.h"
+
+namespace {
+
+int64_t NowMs()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+bool WaitReadable(int fd, int timeoutMs)
+{
+    pollfd p = { fd, POLLIN, 0 };
+    return poll(&p, 1, timeoutMs) > 0;
+}
+
+} // namespace
+
+std::string TestRtspResponse::Header(const char* name) const
+{
+    const size_t len = strlen(name);
+    size_t pos = 0;
+    while (pos < head.size()) {
+        size_t eol = head.find("\r\n", pos);
+        if (eol == std::string::npos)
+            eol = head.size();
+        if (eol - pos > len && head[pos + len] == ':' &&
+            strncasecmp(head.c_str() + pos, name, len) == 0) {
+            size_t v = pos + len + 1;
+            while (v < eol && head[v] == ' ')
+                ++v;
+            return head.substr(v, eol - v);
+        }
+        pos = eol + 2;
+    }
+    return std::string();
+}
+
+TestRtspClient::~TestRtspClient()
+{
+    Close();
+}
+
+bool TestRtspClient::Connect(uint16_t port)
+{
+    Close();
+    m_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (m_fd < 0)
+        return false;
+    sockaddr_in a = {};
+    a.sin_family = AF_INET;
+    a.sin_port = htons(port);
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(m_fd, (sockaddr*)&a, sizeof(a)) != 0) {
+        Close();
+        return false;
+    }
+    int yes = 1;
+    setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    return true;
+}
+
+void TestRtspClient::Close()
+{
+    if (m_fd >= 0)
+        close(m_fd);
+    m_fd = -1;
+    m_in.clear();
+    m_interleaved.clear();
+    m_session.clear();
+}
+
+bool TestRtspClient::Fill(int timeoutMs)
+{
+    if (m_fd < 0 || !WaitReadable(m_fd, timeoutMs))
+        return false;
+    char buf[65536];
+    ssize_t n = recv(m_fd, buf, sizeof(buf), 0);
+    if (n <= 0) {
+        close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    m_in.append(buf, (size_t)n);
+    return true;
+}
+
+bool TestRtspClient::SendRaw(const void* p, size_t n)
+{
+    const char* c = (const char*)p;
+    while (n) {
+        ssize_t r = send(m_fd, c, n, MSG_NOSIGNAL);
+        if (r <= 0)
+            return false;
+        c += r;
+        n -= (size_t)r;
+    }
+    return true;
+}
+
+bool TestRtspClient::Request(const std::string& method, const std::string& url,
+                             const std::string& headers, TestRtspResponse& out, int timeoutMs)
+{
+    if (m_fd < 0)
+        return false;
+    std::string req = method + " " + url + " RTSP/1.0\r\nCSeq: " + std::to_string(++m_cseq) + "\r\n";
+    if (!m_session.empty())
+        req += "Session: " + m_session + "\r\n";
+    req += headers + "\r\n";
+    if (!SendRaw(req.data(), req.size()))
+        return false;
+
+    const int64_t deadline = NowMs() + timeoutMs;
+    for (;;) {
+        // Сначала всё interleaved, что пришло до ответа.
+        while (!m_in.empty() && m_in[0] == '$') {
+            if (m_in.size() < 4)
+                break;
+            const size_t len = ((uint8_t)m_in[2] << 8) | (uint8_t)m_in[3];
+            if (m_in.size() < 4 + len)
+                break;
+            m_interleaved.emplace_back((uint8_t)m_in[1],
+                std::vector<uint8_t>(m_in.begin() + 4, m_in.begin() + 4 + len));
+            m_in.erase(0, 4 + len);
+        }
+        if (!m_in.empty() && m_in[0] != '$') {
+            const size_t end = m_in.find("\r\n\r\n");
+            if (end != std::string::npos) {
+                out.head = m_in.substr(0, end + 2);
+                const size_t bodyLen = (size_t)atoi(out.Header("Content-Length").c_str());
+                if (m_in.size() >= end + 4 + bodyLen) {
+                    out.body = m_in.substr(end + 4, bodyLen);
+                    m_in.erase(0, end + 4 + bodyLen);
+                    out.status = atoi(out.head.c_str() + 9);   // "RTSP/1.0 "
+                    std::string s = out.Header("Session");
+                    if (!s.empty())
+                        m_session = s.substr(0, s.find(';'));
+                    return true;
+                }
+            }
+        }
+        const int64_t left = deadline - NowMs();
+        if (left <= 0 || !Fill((int)left))
+            return false;
+    }
+}
+
+bool TestRtspClient::ReadInterleaved(uint8_t& channel, std::vector<uint8_t>& data, int timeoutMs)
+{
+    const int64_t deadline = NowMs() + timeoutMs;
+    for (;;) {
+        if (!m_interleaved.empty()) {
+            channel = m_interleaved.front().first;
+            data.swap(m_interleaved.front().second);
+            m_interleaved.erase(m_interleaved.begin());
+            return true;
+        }
+        if (m_in.size() >= 4 && m_in[0] == '$') {
+            const size_t len = ((uint8_t)m_in[2] << 8) | (uint8_t)m_in[3];
+            if (m_in.size() >= 4 + len) {
+                channel = (uint8_t)m_in[1];
+                data.assign(m_in.begin() + 4, m_in.begin() + 4 + len);
+                m_in.erase(0, 4 + len);
+                return true;
+            }
+        }
+        else if (!m_in.empty() && m_in[0] != '$') {
+            return false;   // ответ RTSP без запроса
+        }
+        const int64_t left = deadline - NowMs();
+        if (left <= 0 || !Fill((int)left))
+            return false;
+    }
+}
+
+bool TestRtspClient::SendInterleaved(uint8_t channel, const uint8_t* p, size_t n)
+{
+    std::vector<uint8_t> f = { '$', channel, (uint8_t)(n >> 8), (uint8_t)n };
+    f.insert(f.end(), p, p + n);
+    return SendRaw(f.data(), f.size());
+}
+
+bool TestRtspClient::WaitClosed(int timeoutMs)
+{
+    const int64_t deadline = NowMs() + timeoutMs;
+    while (m_fd >= 0) {
+        const int64_t left = deadline - NowMs();
+        if (left <= 0)
+            return false;
+        Fill((int)left);
+    }
+    return true;
+}
+
+int TestUdpBind(uint16_t port, uint16_t* boundPort)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+        return -1;
+    int big = 4 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &big, sizeof(big));
+    sockaddr_in a = {};
+    a.sin_family = AF_INET;
+    a.sin_port = htons(port);
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (sockaddr*)&a, sizeof(a)) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (boundPort) {
+        socklen_t len = sizeof(a);
+        getsockname(fd, (sockaddr*)&a, &len);
+        *boundPort = ntohs(a.sin_port);
+    }
+    return fd;
+}
+
+bool TestUdpBindPair(int& rtpFd, int& rtcpFd, uint16_t& rtpPort)
+{
+    for (uint16_t port = 40000; port < 41000; port += 2) {
+        rtpFd = TestUdpBind(port);
+        if (rtpFd < 0)
+            continue;
+        rtcpFd = TestUdpBind((uint16_t)(port + 1));
+        if (rtcpFd >= 0) {
+            rtpPort = port;
+            return true;
+        }
+        close(rtpFd);
+    }
+    return false;
+}
+
+bool TestUdpRecv(int fd, std::vector<uint8_t>& out, int timeoutMs, uint16_t* fromPort)
+{
+    if (!WaitReadable(fd, timeoutMs))
+        return false;
+    out.resize(65536);
+    sockaddr_in from = {};
+    socklen_t len = sizeof(from);
+    ssize_t n = recvfrom(fd, out.data(), out.size(), 0, (sockaddr*)&from, &len);
+    if (n < 0)
+        return false;
+    out.resize((size_t)n);
+    if (fromPort)
+        *fromPort = ntohs(from.sin_port);
+    return true;
+}
+
+bool TestUdpSendTo(int fd, const char* addr, uint16_t port, const uint8_t* p, size_t n)
+{
+    sockaddr_in a = {};
+    a.sin_family = AF_INET;
+    a.sin_port = htons(port);
+    inet_pton(AF_INET, addr, &a.sin_addr);
+    return sendto(fd, p, n, 0, (sockaddr*)&a, sizeof(a)) == (ssize_t)n;
+}
+
+int TestUdpJoinGroup(const char* group, uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+        return -1;
+    int yes = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    int big = 4 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &big, sizeof(big));
+    sockaddr_in a = {};
+    a.sin_family = AF_INET;
+    a.sin_port = htons(port);
+    if (inet_pton(AF_INET, group, &a.sin_addr) != 1) {
+        close(fd);
+        return -1;
+    }
+    ip_mreq mreq = {};
+    mreq.imr_multiaddr = a.sin_addr;
+    mreq.imr_interface.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (sockaddr*)&a, sizeof(a)) != 0 ||
+        setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) != 0 ||
+        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &mreq.imr_interface,
+                   sizeof(mreq.imr_interface)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void TestUdpClose(int fd)
+{
+    if (fd >= 0)
+        close(fd);
+}
+
+bool TestStartServer(RtspServer& server, uint16_t& port)
+{
+    for (uint16_t p = 18554; p < 18654; ++p) {
+        if (server.Start("rtsp://127.0.0.1:" + std::to_string(p) + "/live")) {
+            port = p;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+class RtspServer;
+
+// Простой блокирующий клиент RTSP для тестов сервера на loopback: запросы,
+// interleaved RTP/RTCP и UDP-сокеты приёмника. Только POSIX.
+
+struct TestRtspResponse
+{
+    int status = 0;
+    std::string head;
+    std::string body;
+
+    std::string Header(const char* name) const;
+};
+
+class TestRtspClient
+{
+public:
+    TestRtspClient() = default;
+    ~TestRtspClient();
+
+    bool Connect(uint16_t port);
+    void Close();
+    bool Connected() const { return m_fd >= 0; }
+
+    // Запрос с CSeq и Session (если уже есть); ждёт ответ, interleaved-данные
+    // до него складываются в очередь. false - соединение закрыто.
+    bool Request(const std::string& method, const std::string& url,
+                 const std::string& headers, TestRtspResponse& out, int timeoutMs = 2000);
+
+    // Следующий interleaved-пакет ($ канал длина); false - таймаут или закрыто.
+    bool ReadInterleaved(uint8_t& channel, std::vector<uint8_t>& data, int timeoutMs);
+    bool SendInterleaved(uint8_t channel, const uint8_t* p, size_t n);
+    bool SendRaw(const void* p, size_t n);
+
+    // Сервер закрыл соединение (ждёт не дольше timeoutMs).
+    bool WaitClosed(int timeoutMs);
+
+    const std::string& Session() const { return m_session; }
+
+private:
+    // Дочитывает из сокета; false - таймаут или закрыто.
+    bool Fill(int timeoutMs);
+
+    int m_fd = -1;
+    int m_cseq = 0;
+    std::string m_session;
+    std::string m_in;
+    std::vector<std::pair<uint8_t, std::vector<uint8_t>>> m_interleaved;
+};
+
+// UDP-сокет приёмника на 127.0.0.1 (port 0 - любой свободный).
+int TestUdpBind(uint16_t port, uint16_t* boundPort = nullptr);
+// Пара соседних портов RTP/RTCP; fd закрывает вызывающий.
+bool TestUdpBindPair(int& rtpFd, int& rtcpFd, uint16_t& rtpPort);
+// Датаграмма с таймаутом; false - ничего не пришло.
+bool TestUdpRecv(int fd, std::vector<uint8_t>& out, int timeoutMs, uint16_t* fromPort = nullptr);
+bool TestUdpSendTo(int fd, const char* addr, uint16_t port, const uint8_t* p, size_t n);
+// Приёмник multicast-группы group:port на loopback (SO_REUSEADDR: таких
+// приёмников на одном порту может быть много); отправленное с него в
+// группу тоже уходит через loopback.
+int TestUdpJoinGroup(const char* group, uint16_t port);
+void TestUdpClose(int fd);
+
+// Запускает сервер на свободном порту 127.0.0.1 с путём /live; порт в port.
+bool TestStartServer(RtspServer& server, uint16_t& port);
@@ -0,0 +1,135 @@
+#include "TestSupport.h"
+
+#include <chrono>
+#include <ctime>
+#include <mutex>
+
+namespace {
+
+std::mutex g_logMx;
+std::vector<std::string> g_log;
+
+} // namespace
+
+// Логгер плагина (в плагине он в NvencRtspPlugin.cpp).
+void Log(const char* msg)
+{
+    static const bool print = getenv("NVRTSP_TEST_LOG") != nullptr;
+    if (print)
+        fprintf(stderr, "[log] %s\n", msg);
+    std::lock_guard<std::mutex> lk(g_logMx);
+    g_log.push_back(msg);
+}
+
+std::vector<std::string> TestLogMessages()
+{
+    std::lock_guard<std::mutex> lk(g_logMx);
+    return g_log;
+}
+
+void TestLogClear()
+{
+    std::lock_guard<std::mutex> lk(g_logMx);
+    g_log.clear();
+}
+
+bool TestLogContains(const char* substr)
+{
+    std::lock_guard<std::mutex> lk(g_logMx);
+    for (const std::string& m : g_log) {
+        if (m.find(substr) != std::string::npos)
+            return true;
+    }
+    return false;
+}
+
+bool BenchQuick(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--quick"))
+            return true;
+    }
+    return false;
+}
+
+int64_t TestNowNs()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t TestThreadCpuNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+FakeGpu::FakeGpu()
+{
+    CHECK(SUCCEEDED(FakeD3D11CreateDevice(dev.GetAddressOf(), ctx.GetAddressOf())));
+}
+
+Microsoft::WRL::ComPtr<ID3D11Texture2D> FakeGpu::NewTexture(UINT w, UINT h, DXGI_FORMAT fmt)
+{
+    D3D11_TEXTURE2D_DESC d = {};
+    d.Width = w;
+    d.Height = h;
+    d.MipLevels = 1;
+    d.ArraySize = 1;
+    d.Format = fmt;
+    d.SampleDesc.Count = 1;
+    d.Usage = D3D11_USAGE_DEFAULT;
+    d.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> tex;
+    CHECK(SUCCEEDED(dev->CreateTexture2D(&d, nullptr, tex.GetAddressOf())));
+    return tex;
+}
+
+void FillPattern(ID3D11Texture2D* tex, uint32_t seed)
+{
+    D3D11_TEXTURE2D_DESC d;
+    tex->GetDesc(&d);
+    for (UINT y = 0; y < d.Height; ++y) {
+        uint8_t* row = tex->Data() + (size_t)y * tex->RowPitch();
+        for (UINT x = 0; x < d.Width; ++x) {
+            // Градиенты плюс хэш: и гладкие области, и резкие края.
+            uint32_t h = (x * 73856093u) ^ (y * 19349663u) ^ (seed * 83492791u);
+            row[x * 4 + 0] = (uint8_t)(x * 255 / (d.Width > 1 ? d.Width - 1 : 1));
+            row[x * 4 + 1] = (uint8_t)(y * 255 / (d.Height > 1 ? d.Height - 1 : 1));
+            row[x * 4 + 2] = (uint8_t)(h >> 24);
+            row[x * 4 + 3] = 255;
+        }
+    }
+}
+
+#ifdef NVRTSP_TEST_BASE64
+// Без FFmpeg: то же, что av_base64_encode из libavutil (нужен Sdp.cpp).
+extern "C" char* av_base64_encode(char* out, int out_size, const uint8_t* in, int in_size)
+{
+    static const char kAbc[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    if (in_size < 0 || out_size < (in_size + 2) / 3 * 4 + 1)
+        return nullptr;
+    char* dst = out;
+    int i = 0;
+    for (; i + 2 < in_size; i += 3) {
+        const uint32_t v = ((uint32_t)in[i] << 16) | ((uint32_t)in[i + 1] << 8) | in[i + 2];
+        *dst++ = kAbc[v >> 18];
+        *dst++ = kAbc[(v >> 12) & 63];
+        *dst++ = kAbc[(v >> 6) & 63];
+        *dst++ = kAbc[v & 63];
+    }
+    if (i < in_size) {
+        uint32_t v = (uint32_t)in[i] << 16;
+        if (i + 1 < in_size)
+            v |= (uint32_t)in[i + 1] << 8;
+        *dst++ = kAbc[v >> 18];
+        *dst++ = kAbc[(v >> 12) & 63];
+        *dst++ = i + 1 < in_size ? kAbc[(v >> 6) & 63] : '=';
+        *dst++ = '=';
+    }
+    *dst = '\0';
+    return out;
+}
+#endif
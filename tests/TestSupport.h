@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "D3D11Compat.h"
+
+// Общее для тестов и бенчмарков: проверки, перехват Log, фейковый GPU.
+
+// Проверка: при неудаче печатает место и выражение и завершает тест.
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1);                                                         \
+        }                                                                    \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                       \
+    do {                                                                     \
+        const long long va_ = (long long)(a);                                \
+        const long long vb_ = (long long)(b);                                \
+        if (va_ != vb_) {                                                    \
+            fprintf(stderr, "%s:%d: CHECK_EQ failed: %s = %lld, %s = %lld\n", \
+                    __FILE__, __LINE__, #a, va_, #b, vb_);                   \
+            exit(1);                                                         \
+        }                                                                    \
+    } while (0)
+
+// Сообщения Log за время теста; с NVRTSP_TEST_LOG=1 они ещё и печатаются.
+std::vector<std::string> TestLogMessages();
+void TestLogClear();
+bool TestLogContains(const char* substr);
+
+// Бенчмарк запущен из ctest (--quick): меньше итераций, только проверка,
+// что он работает.
+bool BenchQuick(int argc, char** argv);
+
+int64_t TestNowNs();
+// Процессорное время вызывающего потока: пакетов в секунду на ядро и т.п.
+int64_t TestThreadCpuNs();
+
+// Фейковое устройство D3D11 и текстуры на нём.
+struct FakeGpu
+{
+    Microsoft::WRL::ComPtr<ID3D11Device> dev;
+    Microsoft::WRL::ComPtr<ID3D11DeviceContext> ctx;
+
+    FakeGpu();
+
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> NewTexture(
+        UINT w, UINT h, DXGI_FORMAT fmt = DXGI_FORMAT_B8G8R8A8_UNORM);
+};
+
+// Заливает BGRA/RGBA-текстуру детерминированным узором (seed - номер кадра).
+void FillPattern(ID3D11Texture2D* tex, uint32_t seed);
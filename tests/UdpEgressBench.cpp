@@ -0,0 +1,240 @@
+// Отправка RTP/UDP на loopback: системных вызовов на кадр и процессорное
+// время потока отправки на гигабит в режимах UdpBatchSender - датаграмма на
+// вызов (как раньше), sendmmsg на кадр и sendmmsg с UDP GSO. Кадры 1080p /
+// 60 Мбит/с с фейкового NVENC упакованы заранее, меряется только отправка.
+// На loopback приём тоже идёт в контексте отправителя, поэтому время
+// включает и путь до сокета приёмника.
+//
+//   UdpEgressBench [--quick]
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "FakeNvenc.h"
+#include "NetSocket.h"
+#include "NvencEncoder.h"
+#include "RtpPacketizer.h"
+#include "TestSupport.h"
+#include "UdpBatchSender.h"
+
+namespace {
+
+const uint32_t kW = 1920;
+const uint32_t kH = 1080;
+const uint32_t kFps = 60;
+const uint32_t kKbps = 60000;
+const size_t kMtu = 1400;
+
+struct Gop
+{
+    std::vector<NvEncPacket> frames;
+    std::vector<RtpPacketBatch> batches;
+    uint64_t datagrams = 0;
+    uint64_t bytes = 0;
+};
+
+void EncodeGop(Gop& gop)
+{
+    FakeNvencConfig cfg;
+    cfg.encodeDelayUs = 0;
+    FakeNvencSetConfig(cfg);
+
+    FakeGpu gpu;
+    auto tex = gpu.NewTexture(kW, kH);
+    auto enc = CreateNvEncoder(NVRTSP_CODEC_H264, gpu.dev.Get(), gpu.ctx.Get(),
+                               kW, kH, kFps, 1, kKbps);
+    CHECK(enc && enc->Initialize(FakeNvencFunctionList()));
+
+    std::vector<NvEncPacket> out;
+    for (uint32_t i = 0; i < kFps; ++i) {
+        CHECK(enc->EncodeTexture(tex.Get(), (int64_t)i * 10000000 / kFps, out));
+        gop.frames.insert(gop.frames.end(), out.begin(), out.end());
+        enc->WaitForPackets(out, INFINITE);
+        gop.frames.insert(gop.frames.end(), out.begin(), out.end());
+    }
+    enc->Flush(out);
+    gop.frames.insert(gop.frames.end(), out.begin(), out.end());
+    CHECK_EQ(gop.frames.size(), kFps);
+
+    RtpPacketizer packetizer(NalCodec::H264, 96, 0x1234abcd, 0, kMtu);
+    gop.batches.resize(gop.frames.size());
+    for (size_t i = 0; i < gop.frames.size(); ++i) {
+        const NvEncPacket& p = gop.frames[i];
+        packetizer.Packetize(p.data.data(), p.data.nals(), (uint32_t)(p.ts100ns * 9 / 1000),
+                             p.keyframe, gop.batches[i]);
+        gop.datagrams += gop.batches[i].packets.size();
+        for (size_t k = 0; k < gop.batches[i].packets.size(); ++k)
+            gop.bytes += gop.batches[i].PacketSize(k);
+    }
+}
+
+// Приёмник на loopback: вычитывает сокет, пока не остановят.
+class Receiver
+{
+public:
+    Receiver()
+    {
+        m_sock = NetBindUdp(0);
+        CHECK(m_sock != NET_INVALID_SOCKET);
+        int big = 8 * 1024 * 1024;
+        setsockopt(m_sock, SOL_SOCKET, SO_RCVBUF, (const char*)&big, sizeof(big));
+        NetSetNonBlocking(m_sock, true);
+        CHECK(NetParseIpv4("127.0.0.1", NetLocalPort(m_sock), m_addr));
+        m_thread = std::thread([this] { Loop(); });
+    }
+
+    ~Receiver()
+    {
+        m_stop = true;
+        m_thread.join();
+        NetClose(m_sock);
+    }
+
+    const sockaddr_in& Addr() const { return m_addr; }
+    uint64_t Datagrams() const { return m_datagrams.load(); }
+    size_t MaxDatagram() const { return m_maxDatagram.load(); }
+
+private:
+    void Loop()
+    {
+        std::vector<uint8_t> buf(65536);
+        while (!m_stop) {
+            fd_set rd;
+            FD_ZERO(&rd);
+            FD_SET(m_sock, &rd);
+            timeval tv = { 0, 20000 };
+            if (select(m_sock + 1, &rd, nullptr, nullptr, &tv) <= 0)
+                continue;
+            for (;;) {
+                ssize_t n = recv(m_sock, (char*)buf.data(), buf.size(), 0);
+                if (n < 0)
+                    break;
+                ++m_datagrams;
+                if ((size_t)n > m_maxDatagram)
+                    m_maxDatagram = (size_t)n;
+            }
+        }
+    }
+
+    net_socket_t m_sock = NET_INVALID_SOCKET;
+    sockaddr_in m_addr = {};
+    std::atomic<bool> m_stop{false};
+    std::atomic<uint64_t> m_datagrams{0};
+    std::atomic<size_t> m_maxDatagram{0};
+    std::thread m_thread;
+};
+
+struct Result
+{
+    UdpBatchMode mode = UdpBatchMode::Single;
+    uint64_t frames = 0;
+    uint64_t calls = 0;
+    uint64_t sent = 0;
+    uint64_t bytes = 0;
+    uint64_t received = 0;
+    size_t maxReceived = 0;
+    int64_t cpuNs = 0;
+
+    double CallsPerFrame() const { return frames ? (double)calls / frames : 0.0; }
+    // Секунд процессора на гигабит.
+    double CpuPerGbit() const { return bytes ? cpuNs / (bytes * 8.0) : 0.0; }
+};
+
+Result Run(const Gop& gop, UdpBatchMode mode, int rounds)
+{
+    Receiver rx;
+    net_socket_t s = NetBindUdp(0);
+    CHECK(s != NET_INVALID_SOCKET);
+    int big = 4 * 1024 * 1024;
+    setsockopt(s, SOL_SOCKET, SO_SNDBUF, (const char*)&big, sizeof(big));
+    NetSetNonBlocking(s, true);
+
+    UdpBatchSender udp;
+    udp.SetMode(mode);
+    std::vector<NetBuf> bufs;
+
+    Result r;
+    const int64_t t0 = TestThreadCpuNs();
+    for (int round = 0; round < rounds; ++round) {
+        for (const RtpPacketBatch& batch : gop.batches) {
+            udp.Clear();
+            for (size_t i = 0; i < batch.packets.size(); ++i) {
+                const RtpSegment* seg = batch.PacketSegments(i);
+                bufs.clear();
+                for (size_t k = 0; k < batch.PacketSegmentCount(i); ++k)
+                    bufs.push_back(NetBuf{ batch.SegmentData(seg[k]), seg[k].size });
+                udp.Add(bufs.data(), bufs.size());
+            }
+            udp.Send(s, rx.Addr());
+            ++r.frames;
+        }
+        r.bytes += gop.bytes;
+    }
+    r.cpuNs = TestThreadCpuNs() - t0;
+    r.mode = udp.Mode();
+    r.calls = udp.SendCalls();
+    r.sent = udp.SentDatagrams();
+
+    // Приёмник дочитывает то, что уже в сокете.
+    const uint64_t expected = r.sent;
+    for (int i = 0; i < 200 && rx.Datagrams() < expected; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    r.received = rx.Datagrams();
+    r.maxReceived = rx.MaxDatagram();
+    NetClose(s);
+    return r;
+}
+
+const char* ModeName(UdpBatchMode mode)
+{
+    switch (mode) {
+    case UdpBatchMode::Single: return "single";
+    case UdpBatchMode::Mmsg:   return "sendmmsg";
+    case UdpBatchMode::Gso:    return "sendmmsg+GSO";
+    }
+    return "?";
+}
+
+void Print(const Result& r, const Result& base)
+{
+    printf("  %-13s %6.1f syscalls/frame, %llu/%llu datagrams sent/received, "
+           "%.3f CPU s per Gbit (x%.2f)\n",
+           ModeName(r.mode), r.CallsPerFrame(), (unsigned long long)r.sent,
+           (unsigned long long)r.received, r.CpuPerGbit(),
+           r.CpuPerGbit() > 0 ? base.CpuPerGbit() / r.CpuPerGbit() : 0.0);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const bool quick = BenchQuick(argc, argv);
+    const int rounds = quick ? 1 : 20;
+    CHECK(NetInit());
+
+    Gop gop;
+    EncodeGop(gop);
+
+    const Result single = Run(gop, UdpBatchMode::Single, rounds);
+    const Result mmsg = Run(gop, UdpBatchMode::Mmsg, rounds);
+    const Result gso = Run(gop, UdpBatchMode::Gso, rounds);
+
+    printf("1080p / %u Mbps / %u fps, MTU %zu, %.1f datagrams/frame, %d rounds\n",
+           kKbps / 1000, kFps, kMtu, (double)gop.datagrams / gop.frames.size(), rounds);
+    Print(single, single);
+    Print(mmsg, single);
+    Print(gso, single);
+
+    CHECK(single.CallsPerFrame() >= (double)gop.datagrams / gop.frames.size() * 0.9);
+    CHECK(single.received > 0 && mmsg.received > 0 && gso.received > 0);
+#ifdef __linux__
+    // Кадр - меньше 1024 сообщений, значит один sendmmsg; GSO может один
+    // раз откатиться на sendmmsg, если ядро его не умеет.
+    CHECK(mmsg.CallsPerFrame() == 1.0);
+    CHECK(gso.calls <= gso.frames + 1);
+    // Ядро режет сообщение GSO на датаграммы не больше MTU.
+    CHECK(gso.maxReceived <= kMtu);
+#endif
+    return 0;
+}